@@ -0,0 +1,590 @@
+//  BenchmarkSuite.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * BenchmarkSuite Module: A fixed matrix of headless runs, timed against stored baselines
+ *
+ * Description:
+ * Every scenario of the matrix (initial conditions model x number of bodies x theta x threads) is one 'RunHeadless'
+ * with 'warmup' untimed and 'repetitions' timed steps, reduced to three metrics:
+ * 			build      insertion, pruning and mass distribution of the step's tree
+ * 			walk       the force walk of every body
+ * 			integrate  the leapfrog update of the bodies
+ * each the fastest of the repetitions, which is the least disturbed by whatever else the machine is doing. The
+ * matrix is run 'passes' times over and every scenario keeps its fastest pass, so that a slow spell of the machine,
+ * which slows all steps of whatever scenario is running, does not land on any one scenario's every measurement.
+ *
+ * Results are written as JSON, one scenario per line, and the same files serve as baselines: a result is a regression
+ * when one of its metrics is slower than the baseline's by more than 'threshold' (relative) and 'minimumDelta'
+ * (absolute, so sub-millisecond phases don't fail on timer noise). Scenarios missing from the baseline are reported,
+ * not failed.
+ *
+ * Absolute timings are only comparable on the machine and build they were recorded with, so every file also records
+ * its 'BenchmarkHost' (host name, CPU model, hardware threads, compiler, build type and whether the phase timers are
+ * compiled in), and 'BenchmarkHostDifferences' lists what differs between two of them; a baseline from another host
+ * or build is refused rather than compared.
+ */
+#pragma once
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <ostream>
+#include <istream>
+#include <algorithm>
+#include "HeadlessSimulation.hpp"
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
+
+
+
+/**
+ * BenchmarkScenario: One point of the matrix.
+ */
+class BenchmarkScenario
+{
+public:
+	GalaxyModel model = GalaxyModel::Plummer;  // Initial conditions
+	size_t numBodies = 10000;  // Number of bodies
+	float theta = 0.5;  // Barnes-Hut theta parameter for MAC
+	unsigned int threadCount = 1;  // Threads of the force walk
+};
+
+
+
+/**
+ * BenchmarkMatrix: The scenarios to run, every combination of the lists, and how each is run.
+ */
+class BenchmarkMatrix
+{
+public:
+	std::vector<GalaxyModel> models = {GalaxyModel::ColdStart, GalaxyModel::KeplerOrbit, GalaxyModel::CollidingDisk, GalaxyModel::Disk, GalaxyModel::Plummer};  // The five initial conditions modes
+	std::vector<size_t> bodyCounts = {10000, 100000, 1000000};  // Numbers of bodies
+	std::vector<float> thetas = {0.3f, 0.5f, 1.0f};  // Opening angles
+	std::vector<unsigned int> threadCounts;  // Thread counts, empty selects 'DefaultBenchmarkThreadCounts'
+	int warmupSteps = 1;  // Untimed steps of every scenario
+	int repetitions = 5;  // Timed steps of every scenario
+	int passes = 3;  // Runs of the whole matrix
+	Precision precision = Precision::Float;  // Scalar type of the bodies, the tree and the kernels
+	uint64_t seed = 1;  // Seed of every galaxy
+};
+
+
+
+/**
+ * BenchmarkResult: The metrics of one scenario, in milliseconds per step.
+ */
+class BenchmarkResult
+{
+public:
+	std::string id;  // "model/bodies/theta/threads/precision", what results and baselines are matched by
+	BenchmarkScenario scenario;  // What was run
+	double buildMilliseconds = 0;  // Fastest build, prune and mass distribution
+	double walkMilliseconds = 0;  // Fastest force walk
+	double integrateMilliseconds = 0;  // Fastest integration
+	double checksum = 0;  // Checksum of the final positions, see 'HeadlessResult'
+};
+
+
+
+/**
+ * BenchmarkHost: The machine and build a run was measured on, timings are only compared between equal hosts.
+ */
+class BenchmarkHost
+{
+public:
+	std::string name;  // Host name
+	std::string cpu;  // CPU model
+	unsigned int hardwareThreads = 0;  // Hardware threads
+	std::string compiler;  // Compiler and its version
+	std::string build;  // Build type, and whether the phase timers are compiled in
+};
+
+
+
+/**
+ * BenchmarkRegression: A metric of a scenario slower than its baseline by more than the thresholds.
+ */
+class BenchmarkRegression
+{
+public:
+	std::string id;  // Scenario
+	std::string metric;  // "build_ms", "walk_ms" or "integrate_ms"
+	double baseline = 0;  // Baseline milliseconds
+	double current = 0;  // Measured milliseconds
+};
+
+
+
+
+
+
+
+
+
+/**
+ * DefaultBenchmarkThreadCounts: 1, 2, 4, 8, ... up to the hardware threads, and the hardware threads themselves.
+ */
+static inline std::vector<unsigned int> DefaultBenchmarkThreadCounts();
+
+
+
+/**
+ * ExpandBenchmarkMatrix: Every scenario of the matrix, models outermost and thread counts innermost.
+ */
+static inline std::vector<BenchmarkScenario> ExpandBenchmarkMatrix(const BenchmarkMatrix &matrix);
+
+
+
+/**
+ * BenchmarkId: The identifier results and baselines are matched by.
+ */
+static inline std::string BenchmarkId(const BenchmarkScenario &scenario, Precision precision);
+
+
+
+/**
+ * RunBenchmarkScenario: Run one scenario and reduce its phase timings to the three metrics.
+ */
+static inline BenchmarkResult RunBenchmarkScenario(const BenchmarkScenario &scenario, const BenchmarkMatrix &matrix);
+
+
+
+/**
+ * KeepFastest: Lower every metric of 'fastest' to that of 'result' where 'result' is faster.
+ */
+static inline void KeepFastest(BenchmarkResult &fastest, const BenchmarkResult &result);
+
+
+
+/**
+ * CurrentBenchmarkHost: The host and build this program runs on, "unknown" for what the platform doesn't tell.
+ */
+static inline BenchmarkHost CurrentBenchmarkHost();
+
+
+
+/**
+ * BenchmarkHostDifferences: What differs between two hosts, one "field: 'a' vs 'b'" line each, empty if they are equal.
+ */
+static inline std::vector<std::string> BenchmarkHostDifferences(const BenchmarkHost &a, const BenchmarkHost &b);
+
+
+
+/**
+ * WriteBenchmarkJson: Write the host and the results as JSON, one scenario per line, the format 'ReadBenchmarkJson' reads back.
+ */
+static inline void WriteBenchmarkJson(const BenchmarkMatrix &matrix, const BenchmarkHost &host, const std::vector<BenchmarkResult> &results, std::ostream &out);
+
+
+
+/**
+ * ReadBenchmarkJson: The host and results of a file written by 'WriteBenchmarkJson', only 'id' and the metrics of the results are read.
+ *
+ * @param host Set to the recorded host, fields the file lacks stay empty
+ * @return False if no result could be read
+ */
+static inline bool ReadBenchmarkJson(std::istream &in, BenchmarkHost &host, std::vector<BenchmarkResult> &results);
+
+
+
+/**
+ * FindBenchmarkRegressions: The metrics of 'results' slower than in 'baseline' by more than 'threshold' times the
+ * baseline and more than 'minimumDelta' milliseconds.
+ *
+ * @param missing Set to the ids of 'results' the baseline has no entry for
+ */
+static inline std::vector<BenchmarkRegression> FindBenchmarkRegressions(const std::vector<BenchmarkResult> &results, const std::vector<BenchmarkResult> &baseline, double threshold, double minimumDelta, std::vector<std::string> &missing);
+
+
+
+/**
+ * ReadJsonNumber: The number after '"key":' in 'line', false if there is none.
+ */
+static inline bool ReadJsonNumber(const std::string &line, const std::string &key, double &value);
+
+
+
+/**
+ * ReadJsonString: The string after '"key": ' in 'line', unescaped, false if there is none.
+ */
+static inline bool ReadJsonString(const std::string &line, const std::string &key, std::string &value);
+
+
+
+/**
+ * WriteJsonString: Write 'text' as a JSON string.
+ */
+static inline void WriteJsonString(std::ostream &out, const std::string &text);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline std::vector<unsigned int> DefaultBenchmarkThreadCounts()
+{
+	unsigned int hardwareThreads = DefaultThreadCount();
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int t = 1; t < hardwareThreads; t *= 2)
+	{
+		threadCounts.push_back(t);
+	}
+	threadCounts.push_back(hardwareThreads);
+	return threadCounts;
+}
+
+
+
+static inline std::vector<BenchmarkScenario> ExpandBenchmarkMatrix(const BenchmarkMatrix &matrix)
+{
+	std::vector<unsigned int> threadCounts = matrix.threadCounts.empty() ? DefaultBenchmarkThreadCounts() : matrix.threadCounts;
+	std::vector<BenchmarkScenario> scenarios;
+	for (GalaxyModel model : matrix.models)
+	{
+		for (size_t numBodies : matrix.bodyCounts)
+		{
+			for (float theta : matrix.thetas)
+			{
+				for (unsigned int threadCount : threadCounts)
+				{
+					BenchmarkScenario scenario;
+					scenario.model = model;
+					scenario.numBodies = numBodies;
+					scenario.theta = theta;
+					scenario.threadCount = threadCount;
+					scenarios.push_back(scenario);
+				}
+			}
+		}
+	}
+	return scenarios;
+}
+
+
+
+static inline std::string BenchmarkId(const BenchmarkScenario &scenario, Precision precision)
+{
+	std::ostringstream id;
+	id << GalaxyModelName(scenario.model) << '/' << scenario.numBodies << '/' << scenario.theta << '/' << scenario.threadCount << '/' << PrecisionName(precision);
+	return id.str();
+}
+
+
+
+static inline BenchmarkResult RunBenchmarkScenario(const BenchmarkScenario &scenario, const BenchmarkMatrix &matrix)
+{
+	HeadlessConfig config;
+	config.scenario = scenario.model;
+	config.numBodies = scenario.numBodies;
+	config.theta = scenario.theta;
+	config.threadCount = scenario.threadCount;
+	config.precision = matrix.precision;
+	config.seed = matrix.seed;
+	config.warmupSteps = matrix.warmupSteps;
+	config.steps = std::max(matrix.repetitions, 1);
+	HeadlessResult run = RunHeadless(config);
+
+
+	auto phase = [&run](const std::string &name) -> const std::vector<double>&
+	{
+		for (const PhaseTiming &timing : run.phases)
+		{
+			if (timing.name == name)
+			{
+				return timing.milliseconds;
+			}
+		}
+		static const std::vector<double> none;
+		return none;
+	};
+	const std::vector<double> &build = phase("build"), &prune = phase("prune"), &mass = phase("mass");
+	const std::vector<double> &forces = phase("forces"), &integrate = phase("integrate");
+
+
+	BenchmarkResult result;
+	result.id = BenchmarkId(scenario, matrix.precision);
+	result.scenario = scenario;
+	result.buildMilliseconds = result.walkMilliseconds = result.integrateMilliseconds = HUGE_VAL;
+	for (size_t s = 0; s < forces.size(); s++)
+	{
+		result.buildMilliseconds = std::min(result.buildMilliseconds, build[s] + prune[s] + mass[s]);
+		result.walkMilliseconds = std::min(result.walkMilliseconds, forces[s]);
+		result.integrateMilliseconds = std::min(result.integrateMilliseconds, integrate[s]);
+	}
+	result.checksum = run.checksum;
+	return result;
+}
+
+
+
+static inline void KeepFastest(BenchmarkResult &fastest, const BenchmarkResult &result)
+{
+	fastest.buildMilliseconds = std::min(fastest.buildMilliseconds, result.buildMilliseconds);
+	fastest.walkMilliseconds = std::min(fastest.walkMilliseconds, result.walkMilliseconds);
+	fastest.integrateMilliseconds = std::min(fastest.integrateMilliseconds, result.integrateMilliseconds);
+}
+
+
+
+static inline BenchmarkHost CurrentBenchmarkHost()
+{
+	BenchmarkHost host;
+	host.name = host.cpu = host.compiler = "unknown";
+	host.hardwareThreads = DefaultThreadCount();
+#if defined(__unix__) || defined(__APPLE__)
+	char name[256] = {};
+	if (gethostname(name, sizeof(name) - 1) == 0 && name[0] != '\0')
+	{
+		host.name = name;
+	}
+#endif
+#if defined(__linux__)
+	std::ifstream cpuinfo("/proc/cpuinfo");
+	std::string line;
+	while (std::getline(cpuinfo, line))
+	{
+		size_t colon = line.find(':');
+		if (line.compare(0, 10, "model name") == 0 && colon != std::string::npos)
+		{
+			host.cpu = line.substr(line.find_first_not_of(' ', colon + 1));
+			break;
+		}
+	}
+#elif defined(__APPLE__)
+	char brand[256] = {};
+	size_t size = sizeof(brand) - 1;
+	if (sysctlbyname("machdep.cpu.brand_string", brand, &size, nullptr, 0) == 0)
+	{
+		host.cpu = brand;
+	}
+#endif
+#if defined(__clang__)
+	host.compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+	host.compiler = "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+	host.compiler = "msvc " + std::to_string(_MSC_FULL_VER);
+#endif
+#if defined(NBODY_BUILD_TYPE)
+	host.build = NBODY_BUILD_TYPE;
+#else
+	host.build = "unknown";
+#endif
+	host.build += NBODY_PROFILE ? ", phase timers" : ", no phase timers";
+	return host;
+}
+
+
+
+static inline std::vector<std::string> BenchmarkHostDifferences(const BenchmarkHost &a, const BenchmarkHost &b)
+{
+	std::vector<std::string> differences;
+	auto compare = [&differences](const char* field, const std::string &first, const std::string &second)
+	{
+		if (first != second)
+		{
+			differences.push_back(std::string(field) + ": '" + first + "' vs '" + second + "'");
+		}
+	};
+	compare("host", a.name, b.name);
+	compare("cpu", a.cpu, b.cpu);
+	compare("hardware threads", std::to_string(a.hardwareThreads), std::to_string(b.hardwareThreads));
+	compare("compiler", a.compiler, b.compiler);
+	compare("build", a.build, b.build);
+	return differences;
+}
+
+
+
+static inline void WriteBenchmarkJson(const BenchmarkMatrix &matrix, const BenchmarkHost &host, const std::vector<BenchmarkResult> &results, std::ostream &out)
+{
+	std::streamsize precision = out.precision(6);
+	out << "{\n";
+	out << "  \"host\": ";
+	WriteJsonString(out, host.name);
+	out << ",\n  \"cpu\": ";
+	WriteJsonString(out, host.cpu);
+	out << ",\n  \"hardware_threads\": " << host.hardwareThreads << ",\n";
+	out << "  \"compiler\": ";
+	WriteJsonString(out, host.compiler);
+	out << ",\n  \"build\": ";
+	WriteJsonString(out, host.build);
+	out << ",\n";
+	out << "  \"warmup_steps\": " << matrix.warmupSteps << ",\n";
+	out << "  \"repetitions\": " << matrix.repetitions << ",\n";
+	out << "  \"passes\": " << matrix.passes << ",\n";
+	out << "  \"precision\": \"" << PrecisionName(matrix.precision) << "\",\n";
+	out << "  \"seed\": " << matrix.seed << ",\n";
+	out << "  \"results\": [";
+	for (size_t r = 0; r < results.size(); r++)
+	{
+		const BenchmarkResult &result = results[r];
+		out << ((r == 0) ? "\n" : ",\n");
+		out << "    {\"id\": \"" << result.id << "\", \"scenario\": \"" << GalaxyModelName(result.scenario.model) << "\", \"bodies\": " << result.scenario.numBodies
+			<< ", \"theta\": " << result.scenario.theta << ", \"threads\": " << result.scenario.threadCount
+			<< ", \"build_ms\": " << result.buildMilliseconds << ", \"walk_ms\": " << result.walkMilliseconds << ", \"integrate_ms\": " << result.integrateMilliseconds;
+		out.precision(17);
+		out << ", \"checksum\": " << result.checksum << "}";
+		out.precision(6);
+	}
+	out << "\n  ]\n";
+	out << "}\n";
+	out.precision(precision);
+}
+
+
+
+static inline bool ReadBenchmarkJson(std::istream &in, BenchmarkHost &host, std::vector<BenchmarkResult> &results)
+{
+	results.clear();
+	host = BenchmarkHost();
+	std::string line;
+	const std::string idKey = "\"id\": \"";
+	while (std::getline(in, line))
+	{
+		size_t idStart = line.find(idKey);
+		if (idStart == std::string::npos)
+		{
+			double hardwareThreads = 0;
+			ReadJsonString(line, "host", host.name);
+			ReadJsonString(line, "cpu", host.cpu);
+			ReadJsonString(line, "compiler", host.compiler);
+			ReadJsonString(line, "build", host.build);
+			if (ReadJsonNumber(line, "hardware_threads", hardwareThreads))
+			{
+				host.hardwareThreads = (unsigned int)hardwareThreads;
+			}
+			continue;
+		}
+		idStart += idKey.size();
+		size_t idEnd = line.find('"', idStart);
+		if (idEnd == std::string::npos)
+		{
+			continue;
+		}
+
+
+		BenchmarkResult result;
+		result.id = line.substr(idStart, idEnd - idStart);
+		if (ReadJsonNumber(line, "build_ms", result.buildMilliseconds) && ReadJsonNumber(line, "walk_ms", result.walkMilliseconds) && ReadJsonNumber(line, "integrate_ms", result.integrateMilliseconds))
+		{
+			results.push_back(result);
+		}
+	}
+	return !results.empty();
+}
+
+
+
+static inline std::vector<BenchmarkRegression> FindBenchmarkRegressions(const std::vector<BenchmarkResult> &results, const std::vector<BenchmarkResult> &baseline, double threshold, double minimumDelta, std::vector<std::string> &missing)
+{
+	std::vector<BenchmarkRegression> regressions;
+	missing.clear();
+	for (const BenchmarkResult &result : results)
+	{
+		auto match = std::find_if(baseline.begin(), baseline.end(), [&result](const BenchmarkResult &entry) { return entry.id == result.id; });
+		if (match == baseline.end())
+		{
+			missing.push_back(result.id);
+			continue;
+		}
+
+
+		const char* metrics[3] = {"build_ms", "walk_ms", "integrate_ms"};
+		double current[3] = {result.buildMilliseconds, result.walkMilliseconds, result.integrateMilliseconds};
+		double previous[3] = {match->buildMilliseconds, match->walkMilliseconds, match->integrateMilliseconds};
+		for (int m = 0; m < 3; m++)
+		{
+			double delta = current[m] - previous[m];
+			if (delta > threshold * previous[m] && delta > minimumDelta)
+			{
+				regressions.push_back({result.id, metrics[m], previous[m], current[m]});
+			}
+		}
+	}
+	return regressions;
+}
+
+
+
+static inline bool ReadJsonNumber(const std::string &line, const std::string &key, double &value)
+{
+	std::string quotedKey = "\"" + key + "\":";
+	size_t start = line.find(quotedKey);
+	if (start == std::string::npos)
+	{
+		return false;
+	}
+
+
+	const char* text = line.c_str() + start + quotedKey.size();
+	char* end = nullptr;
+	value = std::strtod(text, &end);
+	return end != text;
+}
+
+
+
+static inline bool ReadJsonString(const std::string &line, const std::string &key, std::string &value)
+{
+	std::string quotedKey = "\"" + key + "\": \"";
+	size_t start = line.find(quotedKey);
+	if (start == std::string::npos)
+	{
+		return false;
+	}
+
+
+	value.clear();
+	for (size_t c = start + quotedKey.size(); c < line.size(); c++)
+	{
+		if (line[c] == '"')
+		{
+			return true;
+		}
+		if (line[c] == '\\' && c + 1 < line.size())
+		{
+			c++;
+		}
+		value += line[c];
+	}
+	return false;
+}
+
+
+
+static inline void WriteJsonString(std::ostream &out, const std::string &text)
+{
+	out << '"';
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out << '\\' << c;
+		}
+		else if ((unsigned char)c < 0x20)
+		{
+			out << ' ';
+		}
+		else
+		{
+			out << c;
+		}
+	}
+	out << '"';
+}
@@ -0,0 +1,280 @@
+//  main.cpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * Benchmark driver: Runs the scenario matrix on the headless core and checks it against a stored baseline
+ *
+ * Description:
+ * 		nbody_benchmark [--models LIST] [--bodies LIST] [--thetas LIST] [--threads LIST] [--warmup W]
+ * 		                [--repetitions R] [--passes P] [--precision float|double|double-float] [--seed S]
+ * 		                [--output PATH] [--baseline PATH] [--threshold X] [--min-delta MS]
+ * LISTs are comma separated. Without arguments it runs the whole matrix: the five initial conditions models, 10k,
+ * 100k and 1M bodies, theta 0.3, 0.5 and 1.0 and 1, 2, 4, ... hardware threads. The results go to '--output' (standard
+ * output without it) as JSON, which is also the baseline format, along with the host and build it ran on. With
+ * '--baseline' every metric more than '--threshold' (default 0.15, i.e. 15%) and '--min-delta' milliseconds (default
+ * 0.05) slower than the baseline is listed on standard error and the exit status is 1. Scenarios the baseline has no
+ * entry for are listed in a warning after the run and not checked. A baseline recorded on another host or build is
+ * refused before anything runs, with exit status 3, record one on this host instead. Bad arguments exit with status 2.
+ *
+ * 		nbody_benchmark --bodies 10000 --threads 1,2,4 --output Benchmarks/baselines/quick.json       record a baseline
+ * 		nbody_benchmark --bodies 10000 --threads 1,2,4 --baseline Benchmarks/baselines/quick.json     check against it
+ *
+ * The stored baselines cover the matrix in three sizes, each checked with the arguments it was recorded with:
+ * 		quick.json     --bodies 10000 --threads 1,2,4
+ * 		standard.json  --bodies 100000 --threads 1,2 --passes 2
+ * 		large.json     --bodies 1000000 --thetas 0.3,0.5,1 --threads 1,2,4 --passes 1 --repetitions 2
+ * Baselines are per-host artifacts: timings only compare on the machine and build that recorded them, which is why a
+ * foreign one is refused. The stored ones were recorded on a single-core VM, so their 2 and 4 thread entries measure
+ * oversubscription rather than scaling. Before checking on another machine, record its own baselines there with
+ * '--output' over the files above (same arguments) and check against those.
+ */
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <stdexcept>
+#include "BenchmarkSuite.hpp"
+
+
+
+
+/**
+ * BenchmarkOptions: The matrix and what to do with its results.
+ */
+class BenchmarkOptions
+{
+public:
+	BenchmarkMatrix matrix;  // Scenarios and how they are run
+	std::string outputPath;  // Results file, empty writes them to standard output
+	std::string baselinePath;  // Baseline to compare with, empty compares with none
+	double threshold = 0.15;  // Relative slowdown that counts as a regression, above the run-to-run spread of a shared machine
+	double minimumDelta = 0.05;  // Milliseconds a metric must also slow down by
+};
+
+
+
+/**
+ * ParseBenchmarkArguments: The options the command line asks for, throws std::invalid_argument on bad arguments.
+ */
+static inline BenchmarkOptions ParseBenchmarkArguments(int argc, char* argv[]);
+
+
+
+/**
+ * SplitList: The comma separated items of 'list', each converted by 'convert'.
+ */
+template<typename T, typename Convert>
+static inline std::vector<T> SplitList(const std::string &list, Convert convert);
+
+
+
+/**
+ * PrintBenchmarkUsage: Write the command line arguments to 'out'.
+ */
+static inline void PrintBenchmarkUsage(std::ostream &out);
+
+
+
+
+
+
+
+
+
+int main(int argc, char* argv[])
+{
+	BenchmarkOptions options;
+	try
+	{
+		options = ParseBenchmarkArguments(argc, argv);
+	}
+	catch (const std::invalid_argument &error)
+	{
+		std::cerr << "nbody_benchmark: " << error.what() << "\n";
+		PrintBenchmarkUsage(std::cerr);
+		return 2;
+	}
+
+
+	BenchmarkHost host = CurrentBenchmarkHost();
+	std::vector<BenchmarkResult> baseline;
+	if (!options.baselinePath.empty())
+	{
+		BenchmarkHost baselineHost;
+		std::ifstream in(options.baselinePath);
+		if (!ReadBenchmarkJson(in, baselineHost, baseline))
+		{
+			std::cerr << "nbody_benchmark: could not read a baseline from " << options.baselinePath << "\n";
+			return 1;
+		}
+
+
+		std::vector<std::string> differences = BenchmarkHostDifferences(baselineHost, host);
+		if (!differences.empty()) // absolute times of another machine or build say nothing about this one
+		{
+			std::cerr << "nbody_benchmark: " << options.baselinePath << " was recorded on another host or build, refusing to compare (baseline vs this run):\n";
+			for (const std::string &difference : differences)
+			{
+				std::cerr << "    " << difference << "\n";
+			}
+			std::cerr << "nbody_benchmark: record a baseline on this host with --output\n";
+			return 3;
+		}
+	}
+
+
+	std::vector<BenchmarkScenario> scenarios = ExpandBenchmarkMatrix(options.matrix);
+	std::vector<BenchmarkResult> results;
+	for (int pass = 0; pass < options.matrix.passes; pass++)
+	{
+		for (size_t s = 0; s < scenarios.size(); s++)
+		{
+			BenchmarkResult result = RunBenchmarkScenario(scenarios[s], options.matrix);
+			std::cerr << "[" << (pass + 1) << "/" << options.matrix.passes << " " << (s + 1) << "/" << scenarios.size() << "] " << result.id << "  build " << result.buildMilliseconds << " ms  walk " << result.walkMilliseconds << " ms  integrate " << result.integrateMilliseconds << " ms\n";
+			if (pass == 0)
+			{
+				results.push_back(result);
+			}
+			else
+			{
+				KeepFastest(results[s], result);
+			}
+		}
+	}
+
+
+	if (options.outputPath.empty())
+	{
+		WriteBenchmarkJson(options.matrix, host, results, std::cout);
+	}
+	else
+	{
+		std::ofstream out(options.outputPath, std::ios::out | std::ios::trunc);
+		WriteBenchmarkJson(options.matrix, host, results, out);
+		if (!out.good())
+		{
+			std::cerr << "nbody_benchmark: could not write " << options.outputPath << "\n";
+			return 1;
+		}
+	}
+	if (options.baselinePath.empty())
+	{
+		return 0;
+	}
+
+
+	std::vector<std::string> missing;
+	std::vector<BenchmarkRegression> regressions = FindBenchmarkRegressions(results, baseline, options.threshold, options.minimumDelta, missing);
+	for (const BenchmarkRegression &regression : regressions)
+	{
+		std::cerr << "nbody_benchmark: regression " << regression.id << " " << regression.metric << " " << regression.baseline << " -> " << regression.current
+			<< " (+" << (regression.current / regression.baseline - 1) * 100 << "%)\n";
+	}
+	if (!missing.empty())
+	{
+		std::cerr << "\nnbody_benchmark: WARNING: " << missing.size() << " of " << results.size() << " scenarios have no baseline in " << options.baselinePath << " and were NOT checked:\n";
+		for (const std::string &id : missing)
+		{
+			std::cerr << "    " << id << "\n";
+		}
+		std::cerr << "\n";
+	}
+	std::cerr << "nbody_benchmark: " << regressions.size() << " regressions in " << (results.size() - missing.size()) << " checked scenarios against " << options.baselinePath << "\n";
+	return regressions.empty() ? 0 : 1;
+}
+
+
+
+static inline BenchmarkOptions ParseBenchmarkArguments(int argc, char* argv[])
+{
+	BenchmarkOptions options;
+	BenchmarkMatrix &matrix = options.matrix;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (argument == "--help" || argument == "-h")
+		{
+			PrintBenchmarkUsage(std::cout);
+			std::exit(0);
+		}
+		if (i + 1 >= argc)
+		{
+			throw std::invalid_argument("Missing value of '" + argument + "'");
+		}
+
+
+		std::string value = argv[++i];
+		try
+		{
+			if (argument == "--models") matrix.models = SplitList<GalaxyModel>(value, [](const std::string &item) { return GalaxyModelFromName(item); });
+			else if (argument == "--bodies") matrix.bodyCounts = SplitList<size_t>(value, [](const std::string &item) { return (size_t)std::stoull(item); });
+			else if (argument == "--thetas") matrix.thetas = SplitList<float>(value, [](const std::string &item) { return std::stof(item); });
+			else if (argument == "--threads") matrix.threadCounts = SplitList<unsigned int>(value, [](const std::string &item) { return (unsigned int)std::stoul(item); });
+			else if (argument == "--warmup") matrix.warmupSteps = std::stoi(value);
+			else if (argument == "--repetitions") matrix.repetitions = std::stoi(value);
+			else if (argument == "--passes") matrix.passes = std::stoi(value);
+			else if (argument == "--precision") matrix.precision = PrecisionFromName(value);
+			else if (argument == "--seed") matrix.seed = std::stoull(value);
+			else if (argument == "--output") options.outputPath = value;
+			else if (argument == "--baseline") options.baselinePath = value;
+			else if (argument == "--threshold") options.threshold = std::stod(value);
+			else if (argument == "--min-delta") options.minimumDelta = std::stod(value);
+			else throw std::invalid_argument("Unknown argument '" + argument + "'");
+		}
+		catch (const std::out_of_range &)
+		{
+			throw std::invalid_argument("Value of '" + argument + "' out of range: " + value);
+		}
+	}
+
+
+	if (matrix.warmupSteps < 0 || matrix.repetitions < 1 || matrix.passes < 1)
+	{
+		throw std::invalid_argument("Needs at least one repetition and pass, and no negative warm-up");
+	}
+	if (options.threshold < 0 || options.minimumDelta < 0)
+	{
+		throw std::invalid_argument("Thresholds can't be negative");
+	}
+	for (unsigned int threadCount : matrix.threadCounts)
+	{
+		if (threadCount == 0)
+		{
+			throw std::invalid_argument("Thread counts must be at least 1");
+		}
+	}
+	return options;
+}
+
+
+
+template<typename T, typename Convert>
+static inline std::vector<T> SplitList(const std::string &list, Convert convert)
+{
+	std::vector<T> items;
+	std::stringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		if (!item.empty())
+		{
+			items.push_back(convert(item));
+		}
+	}
+	if (items.empty())
+	{
+		throw std::invalid_argument("Empty list '" + list + "'");
+	}
+	return items;
+}
+
+
+
+static inline void PrintBenchmarkUsage(std::ostream &out)
+{
+	out << "usage: nbody_benchmark [--models LIST] [--bodies LIST] [--thetas LIST] [--threads LIST] [--warmup W]\n"
+		<< "                       [--repetitions R] [--passes P] [--precision float|double|double-float] [--seed S]\n"
+		<< "                       [--output PATH] [--baseline PATH] [--threshold X] [--min-delta MS]\n"
+		<< "LISTs are comma separated, e.g. --models disk,plummer --bodies 10000,100000 --thetas 0.5 --threads 1,4\n";
+}
@@ -0,0 +1,230 @@
+//  AdaptiveTimestep.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * AdaptiveTimestep Module: Global timestep chosen every step from the accelerations, with optional energy-error control
+ *
+ * Description:
+ * Instead of a hand-tuned constant, the step is chosen every frame from the accelerations just computed,
+ * 			dt_criterion = eta * min_i sqrt(epsilon / |a_i|)
+ * i.e., no body may move more than a fraction of the softening length under its current acceleration. Quiet phases
+ * get large steps, the step only shrinks while some pair is in a close encounter. The result is
+ * 			- bounded, minimumDt <= dt <= maximumDt
+ * 			- smoothed, dt may shrink at once but grow by at most 'growthLimit' per step, so a single quiet step after
+ * 			  an encounter can't jump straight back to the largest step
+ *
+ * With energy control on, the force walk also accumulates every body's potential (the same nodes, the same
+ * distances, so it costs a few flops per interaction rather than a second walk) and the controller compares the
+ * relative energy change per unit time against 'energyBudget'. 'eta' is scaled down when the drift exceeds the
+ * budget and relaxed back up when it stays well below, so the accuracy target, not the step, is what is tuned.
+ */
+#pragma once
+#include <cmath>
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "Quadtree.hpp"
+#include "PhysicsLogic.hpp"
+#include "ParallelUtilities.hpp"
+#include "SymplecticIntegrators.hpp"
+#include "ofMain.h"
+
+
+
+
+/**
+ * AdaptiveTimestep: Criterion, bounds, smoothing, and the state of the energy controller.
+ */
+class AdaptiveTimestep
+{
+public:
+	// ------------- Configuration -------------
+	float eta = 0.05;  // Base accuracy parameter of the acceleration criterion
+	float minimumDt = 0.0005;  // Smallest step ever taken
+	float maximumDt = 0.05;  // Largest step ever taken
+	float growthLimit = 1.25;  // Largest factor the step may grow by from one step to the next
+	double energyBudget = 1e-3;  // Largest tolerated relative energy change per unit of simulated time
+	float minimumEtaScale = 0.25;  // The controller never tightens 'eta' below this fraction, tree-force noise alone must not stall the run
+	unsigned int threadCount = 0;  // Threads used by the reductions and the walk, 0 selects the number of hardware threads
+
+
+	// ------------- Controller State -------------
+	float etaScale = 1;  // Factor the energy controller applies to 'eta'
+	float dt = 0;  // Step chosen last, 0 before the first step
+	float criterionDt = 0;  // Unbounded, unsmoothed step of the acceleration criterion, for diagnostics
+	std::vector<double> potentials;  // Potential of every body from the fused walk
+	bool hasPreviousEnergy = false;  // Whether 'previousEnergy' belongs to the previous step
+	double previousEnergy = 0;  // Total energy at the previous step
+	double relativeEnergyDrift = 0;  // Relative energy change per unit time, averaged over the last few dozen steps
+};
+
+
+
+
+
+
+
+
+/**
+ * ComputeAllForcesWithPotential: 'ComputeAllForces', also accumulating every body's potential in the same walk.
+ *
+ * @param rootNode            Root of the quadtree data structure, built from 'bodies'
+ * @param bodies              The bodies, whose ax and ay receive the accelerations
+ * @param adaptive            Receives the potentials
+ * @param G                   Universal gravitational constant
+ * @param theta               Barnes-Hut theta parameter for MAC
+ */
+static inline void ComputeAllForcesWithPotential(Quadtree* &rootNode, BodyStore &bodies, AdaptiveTimestep &adaptive, float G, float theta);
+
+
+
+/**
+ * ComputeTreeForceAndPotential: 'ComputeTreeForce' for one body, adding the potential of every interaction to 'potential'.
+ */
+static inline void ComputeTreeForceAndPotential(Quadtree* &rootNode, const BodyStore &bodies, size_t index, ofVec2f &bodiesAccelerations, double &potential, float G, float theta);
+
+
+
+/**
+ * ChooseAdaptiveTimestep: Step for the coming integration from the current accelerations (and potentials, if fresh).
+ *
+ * @param bodies              The bodies, with their accelerations (ax, ay) at the current positions
+ * @param adaptive            Criterion, bounds and controller state
+ * @param potentialsValid     Whether 'adaptive.potentials' were computed this step, enabling the energy controller
+ * @return The step to integrate with
+ */
+static inline float ChooseAdaptiveTimestep(const BodyStore &bodies, AdaptiveTimestep &adaptive, bool potentialsValid);
+
+
+
+/**
+ * ResetAdaptiveTimestep: Forget the smoothing and controller history, e.g., when the adaptive step is switched back on.
+ */
+static inline void ResetAdaptiveTimestep(AdaptiveTimestep &adaptive);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline void ComputeAllForcesWithPotential(Quadtree* &rootNode, BodyStore &bodies, AdaptiveTimestep &adaptive, float G, float theta)
+{
+	adaptive.potentials.assign(bodies.size(), 0.0);
+	ParallelFor(0, bodies.size(), adaptive.threadCount, [&rootNode, &bodies, &adaptive, G, theta](size_t begin, size_t end, unsigned int)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			ofVec2f acceleration(0, 0);
+			ComputeTreeForceAndPotential(rootNode, bodies, i, acceleration, adaptive.potentials[i], G, theta);
+			AddAcceleration(bodies, i, acceleration);
+		}
+	}, 256);
+}
+
+
+
+static inline void ComputeTreeForceAndPotential(Quadtree* &rootNode, const BodyStore &bodies, size_t index, ofVec2f &bodiesAccelerations, double &potential, float G, float theta)
+{
+	ofVec2f position = PositionOf(bodies, index);
+	WalkTree(rootNode, index, [&](Quadtree* cell)
+	{
+		float distance = cell->centerOfMass.distance(position);
+		float size = cell->bounds.width;
+		if (size / distance < theta)
+		{
+			ComputeAccelerationDueTo<float>(position, cell->centerOfMass, cell->totalMass, bodiesAccelerations, G, distance);
+			potential += SoftenedPotential(cell->totalMass, distance, G);
+			return true;
+		}
+		return false;
+	},
+	[&](Quadtree* leaf)
+	{
+		ofVec2f leafPosition = PositionOf(bodies, leaf->nodeBodyIndex);
+		float dist = leafPosition.distance(position);
+		ComputeAccelerationDueTo<float>(position, leafPosition, bodies.mass[leaf->nodeBodyIndex], bodiesAccelerations, G, dist);
+		potential += SoftenedPotential(bodies.mass[leaf->nodeBodyIndex], dist, G);
+	});
+}
+
+
+
+static inline float ChooseAdaptiveTimestep(const BodyStore &bodies, AdaptiveTimestep &adaptive, bool potentialsValid)
+{
+	// Largest acceleration, and the energy if the walk produced potentials, in one pass
+	unsigned int threadCount = (adaptive.threadCount > 0) ? adaptive.threadCount : DefaultThreadCount();
+	std::vector<float> threadMaxima(threadCount, 0.0f);
+	std::vector<double> threadEnergies(threadCount, 0.0);
+	bool withEnergy = potentialsValid && adaptive.potentials.size() == bodies.size();
+
+	const float* ax = bodies.ax.data();
+	const float* ay = bodies.ay.data();
+	ParallelFor(0, bodies.size(), threadCount, [&bodies, ax, ay, &adaptive, &threadMaxima, &threadEnergies, withEnergy](size_t begin, size_t end, unsigned int threadIndex)
+	{
+		float maximum = 0;
+		double energy = 0;
+		for (size_t i = begin; i < end; i++)
+		{
+			maximum = std::max(maximum, ax[i] * ax[i] + ay[i] * ay[i]);
+			if (withEnergy)
+			{
+				energy += bodies.mass[i] * (0.5 * VelocityOf(bodies, i).lengthSquared() + 0.5 * adaptive.potentials[i]);
+			}
+		}
+		threadMaxima[threadIndex] = std::max(threadMaxima[threadIndex], maximum);
+		threadEnergies[threadIndex] += energy;
+	}, 1024);
+
+	float maximumAcceleration = 0;
+	double energy = 0;
+	for (unsigned int t = 0; t < threadCount; t++)
+	{
+		maximumAcceleration = std::max(maximumAcceleration, std::sqrt(threadMaxima[t]));
+		energy += threadEnergies[t];
+	}
+
+
+	// Energy controller, the drift since the last step is charged to the step that caused it
+	if (withEnergy)
+	{
+		if (adaptive.hasPreviousEnergy && adaptive.dt > 0 && energy != 0)
+		{
+			double drift = std::fabs((energy - adaptive.previousEnergy) / energy) / adaptive.dt;
+			adaptive.relativeEnergyDrift = (adaptive.relativeEnergyDrift > 0) ? 0.95 * adaptive.relativeEnergyDrift + 0.05 * drift : drift; // single steps are dominated by tree noise
+			float correction = (adaptive.relativeEnergyDrift > 0) ? (float)std::pow(adaptive.energyBudget / adaptive.relativeEnergyDrift, 0.25) : 2.0f;
+			adaptive.etaScale = ofClamp(adaptive.etaScale * ofClamp(correction, 0.9f, 1.05f), adaptive.minimumEtaScale, 4.0f);
+		}
+		adaptive.previousEnergy = energy;
+		adaptive.hasPreviousEnergy = true;
+	}
+	else
+	{
+		adaptive.hasPreviousEnergy = false;
+	}
+
+
+	adaptive.criterionDt = (maximumAcceleration > 0) ? adaptive.eta * adaptive.etaScale * std::sqrt(epsilon / maximumAcceleration) : adaptive.maximumDt;
+	float dt = adaptive.criterionDt;
+	if (adaptive.dt > 0)
+	{
+		dt = std::min(dt, adaptive.dt * adaptive.growthLimit); // shrink at once, grow gradually
+	}
+	adaptive.dt = ofClamp(dt, adaptive.minimumDt, adaptive.maximumDt);
+	return adaptive.dt;
+}
+
+
+
+static inline void ResetAdaptiveTimestep(AdaptiveTimestep &adaptive)
+{
+	adaptive.etaScale = 1;
+	adaptive.dt = 0;
+	adaptive.hasPreviousEnergy = false;
+	adaptive.relativeEnergyDrift = 0;
+}
@@ -0,0 +1,280 @@
+//  BlockTimesteps.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * BlockTimesteps Module: Hierarchical (power-of-two) individual timesteps
+ *
+ * Description:
+ * A single global dt has to be small enough for the fastest body in the system, yet in a centrally concentrated
+ * system most bodies sit in the outskirts where the dynamics are orders of magnitude slower. With block timesteps
+ * every body i gets its own step
+ * 			dt_i = dt / 2^level_i,   0 <= level_i <= maxLevel
+ * chosen from its own acceleration and jerk:
+ * 			dt_i <= sqrt(2 eta epsilon / |a_i|)          (acceleration criterion, epsilon is the softening length)
+ * 			dt_i <= eta |a_i| / |da_i/dt|                (jerk criterion, jerk from the last two force evaluations)
+ *
+ * The frame step dt is cut into 2^maxLevel ticks. At every tick where some bodies finish their step ("active" bodies):
+ * 			- all bodies drift to the current time (cheap, O(N))
+ * 			- the tree is refit, the topology built at the start of the frame is kept and only centres of mass are updated
+ * 			- only the active bodies have their forces computed and get a closing half kick, a new step and an opening half kick
+ * Because every step is a power-of-two fraction of dt and a body may only lengthen its step at times that are
+ * multiples of the longer step, all bodies are synchronized again at the end of the frame.
+ *
+ * The forces at the end of the frame are not computed here, the next frame's force computation provides them and the
+ * pending closing kicks are applied at the start of the next call, so no body is evaluated twice at the same time.
+ */
+#pragma once
+#include <cmath>
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "Quadtree.hpp"
+#include "PhysicsLogic.hpp"
+#include "ParallelUtilities.hpp"
+#include "ofMain.h"
+
+
+
+
+/**
+ * BlockTimesteps: Per-body step levels, previous accelerations for the jerk estimate, and diagnostics.
+ */
+class BlockTimesteps
+{
+public:
+	// ------------- Configuration -------------
+	int maxLevel = 6;  // Smallest step is dt / 2^maxLevel (64 times smaller than dt by default)
+	float eta = 0.025;  // Accuracy parameter of the step criteria
+	unsigned int threadCount = 0;  // Threads used for the force evaluations, 0 selects the number of hardware threads
+
+
+	// ------------- Per-Body State, indexed like 'bodies' -------------
+	std::vector<int> levels;  // Step level of each body
+	std::vector<float> previousAx;  // Acceleration at the body's previous force evaluation
+	std::vector<float> previousAy;
+	std::vector<int> stepStart;  // Tick the body's current step started at
+	bool pendingClosingKick = false;  // Whether the bodies still owe the closing half kick of the previous frame's last step
+	float previousDt = 0;  // Frame step of the previous call, the owed kicks belong to its levels
+
+
+	// ------------- Diagnostics -------------
+	std::vector<size_t> activeBodies;  // Scratch list of the bodies active at the current tick
+	size_t forceEvaluations = 0;  // Number of single-body force evaluations
+	double simulatedTime = 0;  // Simulated time covered
+	int deepestLevel = 0;  // Deepest level in use during the last frame
+};
+
+
+
+
+
+
+
+
+/**
+ * ResetBlockTimesteps: Forget all per-body state, e.g., after bodies were added or removed.
+ */
+static inline void ResetBlockTimesteps(BlockTimesteps &blocks);
+
+
+
+/**
+ * ChooseBlockLevel: Level for a body from its acceleration and jerk, limited to what is synchronized at 'tick'.
+ *
+ * @param blocks       The block timestep state
+ * @param acceleration The body's current acceleration
+ * @param jerk         Its estimated jerk, or zero if unknown
+ * @param dt           The frame (largest) step
+ * @param tick         The current tick, the new step must start on a multiple of its own length
+ */
+static inline int ChooseBlockLevel(BlockTimesteps &blocks, const ofVec2f &acceleration, const ofVec2f &jerk, float dt, int tick);
+
+
+
+/**
+ * AdvanceBlockTimesteps: Advance all bodies by one frame step 'dt' with individual block steps.
+ *
+ * @param rootNode            Quadtree built over the positions at the start of the frame, refit at every tick
+ * @param bodies              The bodies, with their accelerations (ax, ay) at the start of the frame
+ * @param blocks              The block timestep state
+ * @param G                   Universal gravitational constant
+ * @param theta               Barnes-Hut theta parameter for MAC
+ * @param dt                  The frame step, the longest individual step
+ */
+static inline void AdvanceBlockTimesteps(Quadtree* &rootNode, BodyStore &bodies, BlockTimesteps &blocks, float G, float theta, float dt);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline void ResetBlockTimesteps(BlockTimesteps &blocks)
+{
+	blocks.levels.clear();
+	blocks.previousAx.clear();
+	blocks.previousAy.clear();
+	blocks.stepStart.clear();
+	blocks.pendingClosingKick = false;
+}
+
+
+
+static inline int ChooseBlockLevel(BlockTimesteps &blocks, const ofVec2f &acceleration, const ofVec2f &jerk, float dt, int tick)
+{
+	float magnitude = acceleration.length();
+	float step = dt;
+	if (magnitude > 0)
+	{
+		step = std::min(step, std::sqrt(2 * blocks.eta * epsilon / magnitude));
+	}
+	float jerkMagnitude = jerk.length();
+	if (jerkMagnitude > 0)
+	{
+		step = std::min(step, blocks.eta * magnitude / jerkMagnitude);
+	}
+
+
+	int level = (int)std::ceil(std::log2(dt / std::max(step, 1e-30f)));
+	level = std::max(0, std::min(level, blocks.maxLevel));
+
+	// A longer step may only start where that step length divides the elapsed ticks, otherwise the body would overshoot the frame
+	while (level > 0 && tick % (1 << (blocks.maxLevel - level)) != 0)
+	{
+		level++;
+	}
+	return std::min(level, blocks.maxLevel);
+}
+
+
+
+static inline void AdvanceBlockTimesteps(Quadtree* &rootNode, BodyStore &bodies, BlockTimesteps &blocks, float G, float theta, float dt)
+{
+	PROFILE_PHASE(Integrate);
+	size_t n = bodies.size();
+	if (blocks.levels.size() != n)
+	{
+		ResetBlockTimesteps(blocks);
+		blocks.levels.assign(n, 0);
+		blocks.previousAx.assign(n, 0);
+		blocks.previousAy.assign(n, 0);
+		blocks.stepStart.assign(n, 0);
+	}
+	float* x = bodies.x.data();
+	float* y = bodies.y.data();
+	float* vx = bodies.vx.data();
+	float* vy = bodies.vy.data();
+	float* ax = bodies.ax.data();
+	float* ay = bodies.ay.data();
+
+	const int ticks = 1 << blocks.maxLevel;
+	const float tickDt = dt / ticks;
+	blocks.deepestLevel = 0;
+
+
+	// Start of the frame, every body is synchronized here and has a fresh acceleration
+	for (size_t i = 0; i < n; i++)
+	{
+		ofVec2f acceleration(ax[i], ay[i]);
+		ofVec2f jerk(0, 0);
+		if (blocks.pendingClosingKick)
+		{
+			float previousStep = blocks.previousDt / (1 << blocks.levels[i]);
+			vx[i] += ax[i] * (previousStep * 0.5f); // close the last step of the previous frame
+			vy[i] += ay[i] * (previousStep * 0.5f);
+			jerk.set((ax[i] - blocks.previousAx[i]) / previousStep, (ay[i] - blocks.previousAy[i]) / previousStep);
+		}
+
+		blocks.levels[i] = ChooseBlockLevel(blocks, acceleration, jerk, dt, 0);
+		blocks.deepestLevel = std::max(blocks.deepestLevel, blocks.levels[i]);
+		blocks.previousAx[i] = ax[i];
+		blocks.previousAy[i] = ay[i];
+		blocks.stepStart[i] = 0;
+		vx[i] += ax[i] * (dt / (1 << blocks.levels[i]) * 0.5f); // opening half kick
+		vy[i] += ay[i] * (dt / (1 << blocks.levels[i]) * 0.5f);
+	}
+	blocks.forceEvaluations += n;
+
+
+	int tick = 0;
+	while (tick < ticks)
+	{
+		// Next tick at which some body finishes its step
+		int nextTick = ticks;
+		for (size_t i = 0; i < n; i++)
+		{
+			nextTick = std::min(nextTick, blocks.stepStart[i] + (ticks >> blocks.levels[i]));
+		}
+
+
+		// Drift everyone to the new time
+		float drift = (nextTick - tick) * tickDt;
+		for (size_t i = 0; i < n; i++)
+		{
+			x[i] += vx[i] * drift;
+			y[i] += vy[i] * drift;
+		}
+		tick = nextTick;
+
+		if (tick == ticks)
+		{
+			break; // the end of frame forces come from the next frame's force computation
+		}
+
+
+		blocks.activeBodies.clear();
+		for (size_t i = 0; i < n; i++)
+		{
+			if (blocks.stepStart[i] + (ticks >> blocks.levels[i]) == tick)
+			{
+				blocks.activeBodies.push_back(i);
+			}
+		}
+
+
+		// Forces for the active bodies only, on the refit tree
+		ComputeQuadtreeMassDistribution(rootNode, bodies);
+		ParallelFor(0, blocks.activeBodies.size(), blocks.threadCount, [&rootNode, &bodies, ax, ay, &blocks, G, theta](size_t begin, size_t end, unsigned int)
+		{
+			for (size_t k = begin; k < end; k++)
+			{
+				size_t i = blocks.activeBodies[k];
+				ofVec2f acceleration(0, 0);
+				ComputeTreeForce(rootNode, bodies, i, PositionOf(bodies, i), acceleration, G, theta);
+				ax[i] = acceleration.x;
+				ay[i] = acceleration.y;
+			}
+		}, 64);
+		blocks.forceEvaluations += blocks.activeBodies.size();
+
+
+		// Closing kick, new step, opening kick
+		for (size_t i : blocks.activeBodies)
+		{
+			float previousStep = dt / (1 << blocks.levels[i]);
+			ofVec2f acceleration(ax[i], ay[i]);
+			vx[i] += ax[i] * (previousStep * 0.5f);
+			vy[i] += ay[i] * (previousStep * 0.5f);
+
+			ofVec2f jerk((ax[i] - blocks.previousAx[i]) / previousStep, (ay[i] - blocks.previousAy[i]) / previousStep);
+			blocks.levels[i] = ChooseBlockLevel(blocks, acceleration, jerk, dt, tick);
+			blocks.deepestLevel = std::max(blocks.deepestLevel, blocks.levels[i]);
+			blocks.previousAx[i] = ax[i];
+			blocks.previousAy[i] = ay[i];
+			blocks.stepStart[i] = tick;
+
+			vx[i] += ax[i] * (dt / (1 << blocks.levels[i]) * 0.5f);
+			vy[i] += ay[i] * (dt / (1 << blocks.levels[i]) * 0.5f);
+		}
+	}
+
+
+	blocks.pendingClosingKick = true;
+	blocks.previousDt = dt;
+	blocks.simulatedTime += dt;
+}
@@ -0,0 +1,278 @@
+//  BodyDataTable.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * BodyDataTable Module: The cold per-body state of the visualizations, kept only while a visualization shows it
+ *
+ * Description:
+ * 'BodyData' bundles the state no force or integrator reads: kinetic and potential energy, angular velocity,
+ * orientation and moment of inertia. The simulation keeps it as a structure-of-arrays side table indexed like
+ * 'bodies', in two groups that are allocated independently:
+ * 			energies   kineticEnergy, potentialEnergy                      ('Visualize Body Energy Gradient')
+ * 			rotation   angularVelocity, orientation, momentOfInertia       ('Visualize Body Angular Orientation')
+ * A group is allocated and initialized from the bodies when its toggle turns on, updated once per step after the
+ * forces while it is on, and freed when the toggle turns off. With both off the step does no cold work and the
+ * arrays hold no memory, the only cost left is the check of two flags.
+ *
+ * The potential energies come from a tree walk of their own, as expensive as the force walk, which is why the
+ * energies are a group of their own. Rotation is integrated from the torque of the body's acceleration acting
+ * half a radius off its centre, with the step's dt.
+ *
+ * Removals move the table with the bodies ('SwapAndPop' on the table, 'RemoveBodyAt' accepts it as a per-body
+ * array), appended bodies are initialized by 'SyncBodyData'.
+ */
+#pragma once
+#include <cmath>
+#include "SimulationEntities.hpp"
+#include "AlignedArray.hpp"
+#include "BodyHandles.hpp"
+#include "Quadtree.hpp"
+#include "SymplecticIntegrators.hpp"
+#include "ParallelUtilities.hpp"
+#include "ofMain.h"
+
+
+
+
+/**
+ * BodyDataTable: BodyData of every body as one array per member, each group present only while it is enabled.
+ */
+class BodyDataTable
+{
+public:
+	size_t size() const { return count; }
+	bool isEnabled() const { return energies || rotation; }
+
+	AlignedArray<float> kineticEnergy;  // Kinetic energy of each body, while 'energies'
+	AlignedArray<float> potentialEnergy;  // Potential energy of each body, while 'energies'
+	AlignedArray<float> angularVelocity;  // Angular velocity of each body, while 'rotation'
+	AlignedArray<float> orientation;  // Current angle of each body, while 'rotation'
+	AlignedArray<float> momentOfInertia;  // Moment of inertia of each body, while 'rotation'
+
+	bool energies = false;  // Whether the energy group is allocated and kept up to date
+	bool rotation = false;  // Whether the rotation group is allocated and kept up to date
+	size_t count = 0;  // Bodies the enabled groups hold, 0 while none is
+	unsigned int threadCount = 0;  // Threads of the potential walk, 0 selects DefaultThreadCount()
+};
+
+
+
+
+
+
+
+
+/**
+ * ConfigureBodyData: Allocate the groups that were just switched on and free the ones that were switched off.
+ *
+ * Either way the table ends up matching the bodies, see 'SyncBodyData'.
+ *
+ * @param bodyData The table
+ * @param bodies   The bodies, newly enabled groups are initialized from them
+ * @param energies Whether the energy group is wanted
+ * @param rotation Whether the rotation group is wanted
+ */
+static inline void ConfigureBodyData(BodyDataTable &bodyData, const BodyStore &bodies, bool energies, bool rotation);
+
+
+
+/**
+ * SyncBodyData: Match the table to the number of bodies, initializing appended bodies and dropping removed ones.
+ */
+static inline void SyncBodyData(BodyDataTable &bodyData, const BodyStore &bodies);
+
+
+
+/**
+ * UpdateBodyData: Bring the enabled groups up to date after a step, does nothing while neither is enabled.
+ *
+ * @param bodyData            The table
+ * @param rootNode            Tree over the bodies, for the potentials
+ * @param bodies              The bodies, with the accelerations (ax, ay) of the step for the torques
+ * @param G                   Universal gravitational constant
+ * @param theta               Barnes-Hut theta parameter for MAC
+ * @param dt                  Step size the rotation is integrated with
+ */
+static inline void UpdateBodyData(BodyDataTable &bodyData, Quadtree* &rootNode, const BodyStore &bodies, float G, float theta, float dt);
+
+
+
+/**
+ * SwapAndPop: Move the last body's data into 'index' and drop the last entry, as for any other per-body array.
+ *
+ * The table must match the bodies ('SyncBodyData') before any of them is removed.
+ */
+static inline void SwapAndPop(BodyDataTable &bodyData, size_t index, size_t last);
+
+
+
+/**
+ * InitializeBodyData: Set the given groups of entry 'index' from body 'index', as the BodyData constructor does.
+ */
+static inline void InitializeBodyData(BodyDataTable &bodyData, size_t index, const BodyStore &bodies, bool energies, bool rotation);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline void ConfigureBodyData(BodyDataTable &bodyData, const BodyStore &bodies, bool energies, bool rotation)
+{
+	if (energies == bodyData.energies && rotation == bodyData.rotation)
+	{
+		SyncBodyData(bodyData, bodies); // bodies may have been spliced in since the last step
+		return;
+	}
+
+
+	if (!energies)
+	{
+		bodyData.kineticEnergy = AlignedArray<float>(); // frees the memory, not just the count
+		bodyData.potentialEnergy = AlignedArray<float>();
+	}
+	if (!rotation)
+	{
+		bodyData.angularVelocity = AlignedArray<float>();
+		bodyData.orientation = AlignedArray<float>();
+		bodyData.momentOfInertia = AlignedArray<float>();
+	}
+	bool enabledEnergies = energies && !bodyData.energies;
+	bool enabledRotation = rotation && !bodyData.rotation;
+	bodyData.energies = energies;
+	bodyData.rotation = rotation;
+
+
+	// Newly enabled groups start from the bodies, the groups already on keep their state
+	size_t kept = std::min(bodyData.count, bodies.size());
+	if (enabledEnergies)
+	{
+		bodyData.kineticEnergy.resize(kept);
+		bodyData.potentialEnergy.resize(kept);
+	}
+	if (enabledRotation)
+	{
+		bodyData.angularVelocity.resize(kept);
+		bodyData.orientation.resize(kept);
+		bodyData.momentOfInertia.resize(kept);
+	}
+	bodyData.count = bodyData.isEnabled() ? kept : 0;
+	for (size_t i = 0; i < bodyData.count; i++)
+	{
+		InitializeBodyData(bodyData, i, bodies, enabledEnergies, enabledRotation);
+	}
+	SyncBodyData(bodyData, bodies);
+}
+
+
+
+static inline void SyncBodyData(BodyDataTable &bodyData, const BodyStore &bodies)
+{
+	if (!bodyData.isEnabled() || bodyData.count == bodies.size())
+	{
+		return;
+	}
+
+
+	size_t previous = bodyData.count;
+	bodyData.count = bodies.size();
+	if (bodyData.energies)
+	{
+		bodyData.kineticEnergy.resize(bodyData.count);
+		bodyData.potentialEnergy.resize(bodyData.count);
+	}
+	if (bodyData.rotation)
+	{
+		bodyData.angularVelocity.resize(bodyData.count);
+		bodyData.orientation.resize(bodyData.count);
+		bodyData.momentOfInertia.resize(bodyData.count);
+	}
+	for (size_t i = previous; i < bodyData.count; i++)
+	{
+		InitializeBodyData(bodyData, i, bodies, bodyData.energies, bodyData.rotation);
+	}
+}
+
+
+
+static inline void UpdateBodyData(BodyDataTable &bodyData, Quadtree* &rootNode, const BodyStore &bodies, float G, float theta, float dt)
+{
+	if (!bodyData.isEnabled())
+	{
+		return;
+	}
+	SyncBodyData(bodyData, bodies);
+
+
+	if (bodyData.energies)
+	{
+		ParallelFor(0, bodies.size(), bodyData.threadCount, [&bodyData, &rootNode, &bodies, G, theta](size_t begin, size_t end, unsigned int)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				bodyData.kineticEnergy[i] = 0.5f * bodies.mass[i] * VelocityOf(bodies, i).lengthSquared();
+				bodyData.potentialEnergy[i] = (float)(bodies.mass[i] * ComputeTreePotential(rootNode, bodies, i, G, theta));
+			}
+		});
+	}
+
+
+	if (bodyData.rotation)
+	{
+		for (size_t i = 0; i < bodies.size(); i++)
+		{
+			// The acceleration acts half a radius off centre along the x axis, its torque is the 2D cross product r x F
+			float d = 0.5f * bodies.mass[i];
+			float torque = d * bodies.ay[i] * bodies.mass[i];
+			bodyData.angularVelocity[i] += torque / bodyData.momentOfInertia[i] * dt;
+			bodyData.orientation[i] += bodyData.angularVelocity[i] * dt;
+		}
+	}
+}
+
+
+
+static inline void SwapAndPop(BodyDataTable &bodyData, size_t index, size_t last)
+{
+	if (!bodyData.isEnabled())
+	{
+		return;
+	}
+	if (bodyData.energies)
+	{
+		SwapAndPop(bodyData.kineticEnergy, index, last);
+		SwapAndPop(bodyData.potentialEnergy, index, last);
+	}
+	if (bodyData.rotation)
+	{
+		SwapAndPop(bodyData.angularVelocity, index, last);
+		SwapAndPop(bodyData.orientation, index, last);
+		SwapAndPop(bodyData.momentOfInertia, index, last);
+	}
+	bodyData.count--;
+}
+
+
+
+static inline void InitializeBodyData(BodyDataTable &bodyData, size_t index, const BodyStore &bodies, bool energies, bool rotation)
+{
+	float mass = bodies.mass[index];
+	float speedSquared = VelocityOf(bodies, index).lengthSquared();
+	if (energies)
+	{
+		bodyData.kineticEnergy[index] = 0.5f * mass * speedSquared;
+		bodyData.potentialEnergy[index] = 0; // filled by the next update
+	}
+	if (rotation)
+	{
+		bodyData.momentOfInertia[index] = 0.25f * mass * (mass * mass); // I = 1/4 * mass * radius^2
+		bodyData.angularVelocity[index] = speedSquared / (mass * mass); // mass is analogous to radius for rigid 2D bodies
+		bodyData.orientation[index] = bodyData.angularVelocity[index];
+	}
+}
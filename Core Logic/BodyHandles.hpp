@@ -0,0 +1,288 @@
+//  BodyHandles.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * BodyHandles Module: Stable names for bodies whose dense index changes, and O(1) removal across every per-body array
+ *
+ * Description:
+ * The bodies live in dense arrays (the BodyStore and whatever else is indexed like it), so that the
+ * solvers stream them without holes. Removing a body from the middle by erasing shifts every later body down one
+ * index, O(N) per removal and a silent misalignment of any array that wasn't shifted with it. Instead a removal moves
+ * the last body into the freed index and pops the back of every array (swap-and-pop), O(1) however many bodies go.
+ *
+ * That renames the moved body, so anything that must follow a body across removals holds a BodyHandle instead of
+ * an index: a slot in the handle table plus the slot's generation. The table maps
+ * 			slot -> dense index    (to resolve a handle)
+ * 			dense index -> slot    (to fix up the moved body's slot on a swap-and-pop)
+ * and bumps the slot's generation when its body is removed, so a handle to a removed body resolves to nothing rather
+ * than to whichever body reuses the slot. Freed slots are reused last-in first-out.
+ */
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "AlignedArray.hpp"
+#include "CoreTypes.hpp"
+
+
+
+
+/**
+ * BodyHandle: Stable name of one body, valid until the body is removed.
+ */
+class BodyHandle
+{
+public:
+	bool operator==(const BodyHandle &other) const { return slot == other.slot && generation == other.generation; }
+	bool operator!=(const BodyHandle &other) const { return !(*this == other); }
+
+	uint32_t slot = UINT32_MAX;  // Entry of the handle table
+	uint32_t generation = 0;  // Generation of the slot when the handle was made
+};
+
+
+
+/**
+ * BodyHandleTable: Two-way mapping between handle slots and dense body indices.
+ */
+class BodyHandleTable
+{
+public:
+	size_t size() const { return slotOfIndex.size(); }
+
+	std::vector<uint32_t> indexOfSlot;  // Dense index of the body each slot names, meaningful while the slot is in use
+	std::vector<uint32_t> generationOfSlot;  // Incremented whenever a slot's body is removed
+	std::vector<uint32_t> slotOfIndex;  // Slot naming the body at each dense index
+	std::vector<uint32_t> freeSlots;  // Slots of removed bodies, reused last-in first-out
+};
+
+
+static const size_t InvalidBodyIndex = SIZE_MAX;  // What a handle to a removed body resolves to
+
+
+
+
+
+
+
+
+/**
+ * ResetBodyHandles: Drop every handle and name the bodies 0..count-1 afresh. Handles made before the reset are invalid.
+ */
+static inline void ResetBodyHandles(BodyHandleTable &handles, size_t count);
+
+
+
+/**
+ * SyncBodyHandles: Give the bodies appended since the last call handles of their own, leaving existing handles valid.
+ *
+ * @param handles The table
+ * @param count   Number of bodies now in the dense arrays, bodies are only ever appended at the back
+ */
+static inline void SyncBodyHandles(BodyHandleTable &handles, size_t count);
+
+
+
+/**
+ * GetBodyHandle: The handle of the body at dense index 'index'.
+ */
+static inline BodyHandle GetBodyHandle(const BodyHandleTable &handles, size_t index);
+
+
+
+/**
+ * ResolveBodyHandle: The dense index of the body a handle names, or InvalidBodyIndex if it was removed.
+ */
+static inline size_t ResolveBodyHandle(const BodyHandleTable &handles, BodyHandle handle);
+
+
+
+/**
+ * RemoveBodyHandle: Update the table for a swap-and-pop of dense index 'index', the body's handle becomes invalid.
+ *
+ * The caller moves the per-body data itself, 'RemoveBodyAt' does both.
+ */
+static inline void RemoveBodyHandle(BodyHandleTable &handles, size_t index);
+
+
+
+/**
+ * SwapAndPop: Move the last element of a per-body array into 'index' and drop the last element.
+ *
+ * Raw arrays can't shrink, their last element is zeroed instead and 'last' gives its index.
+ */
+template<typename T>
+static inline void SwapAndPop(std::vector<T> &array, size_t index, size_t last);
+
+template<typename T, size_t Alignment>
+static inline void SwapAndPop(AlignedArray<T, Alignment> &array, size_t index, size_t last);
+
+template<typename T>
+static inline void SwapAndPop(T* array, size_t index, size_t last);
+
+
+
+/**
+ * RemoveBodyAt: Remove the body at dense index 'index' in O(1), keeping every array aligned.
+ *
+ * @param bodies       The bodies, the last one moves into 'index' ('RemoveBody')
+ * @param handles      Handle table of the bodies, the removed body's handle becomes invalid
+ * @param index        Dense index of the body to remove
+ * @param perBodyArray Every other array indexed like 'bodies' (BodyData, trails, ...), moved alike
+ */
+template<typename... PerBodyArrays>
+static inline void RemoveBodyAt(BodyStore &bodies, BodyHandleTable &handles, size_t index, PerBodyArrays&&... perBodyArray);
+
+
+
+/**
+ * RemoveBodyByHandle: 'RemoveBodyAt' for the body a handle names, returns false if it was already removed.
+ */
+template<typename... PerBodyArrays>
+static inline bool RemoveBodyByHandle(BodyStore &bodies, BodyHandleTable &handles, BodyHandle handle, PerBodyArrays&&... perBodyArray);
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+static inline void ResetBodyHandles(BodyHandleTable &handles, size_t count)
+{
+	handles.indexOfSlot.clear();
+	handles.slotOfIndex.clear();
+	handles.freeSlots.clear();
+	for (auto &generation : handles.generationOfSlot)
+	{
+		generation++; // slots are renumbered below, outstanding handles must not resolve to the new bodies
+	}
+	SyncBodyHandles(handles, count);
+}
+
+
+
+static inline void SyncBodyHandles(BodyHandleTable &handles, size_t count)
+{
+	while (handles.slotOfIndex.size() < count)
+	{
+		uint32_t index = (uint32_t)handles.slotOfIndex.size();
+		uint32_t slot;
+		if (!handles.freeSlots.empty())
+		{
+			slot = handles.freeSlots.back();
+			handles.freeSlots.pop_back();
+		}
+		else
+		{
+			slot = (uint32_t)handles.indexOfSlot.size();
+			handles.indexOfSlot.push_back(0);
+			if (handles.generationOfSlot.size() <= slot)
+			{
+				handles.generationOfSlot.push_back(0);
+			}
+		}
+		handles.indexOfSlot[slot] = index;
+		handles.slotOfIndex.push_back(slot);
+	}
+}
+
+
+
+static inline BodyHandle GetBodyHandle(const BodyHandleTable &handles, size_t index)
+{
+	BodyHandle handle;
+	handle.slot = handles.slotOfIndex[index];
+	handle.generation = handles.generationOfSlot[handle.slot];
+	return handle;
+}
+
+
+
+static inline size_t ResolveBodyHandle(const BodyHandleTable &handles, BodyHandle handle)
+{
+	if (handle.slot >= handles.indexOfSlot.size() || handles.generationOfSlot[handle.slot] != handle.generation)
+	{
+		return InvalidBodyIndex;
+	}
+	return handles.indexOfSlot[handle.slot];
+}
+
+
+
+static inline void RemoveBodyHandle(BodyHandleTable &handles, size_t index)
+{
+	size_t last = handles.slotOfIndex.size() - 1;
+	uint32_t removedSlot = handles.slotOfIndex[index];
+	uint32_t movedSlot = handles.slotOfIndex[last];
+
+	handles.slotOfIndex[index] = movedSlot;
+	handles.indexOfSlot[movedSlot] = (uint32_t)index;
+	handles.slotOfIndex.pop_back();
+
+	handles.generationOfSlot[removedSlot]++;
+	handles.freeSlots.push_back(removedSlot);
+}
+
+
+
+template<typename T>
+static inline void SwapAndPop(std::vector<T> &array, size_t index, size_t last)
+{
+	if (index != last)
+	{
+		array[index] = std::move(array[last]);
+	}
+	array.pop_back();
+}
+
+template<typename T, size_t Alignment>
+static inline void SwapAndPop(AlignedArray<T, Alignment> &array, size_t index, size_t last)
+{
+	array[index] = array[last];
+	array.pop_back();
+}
+
+template<typename T>
+static inline void SwapAndPop(T* array, size_t index, size_t last)
+{
+	array[index] = array[last];
+	array[last] = T();
+}
+
+
+
+template<typename... PerBodyArrays>
+static inline void RemoveBodyAt(BodyStore &bodies, BodyHandleTable &handles, size_t index, PerBodyArrays&&... perBodyArray)
+{
+	size_t last = bodies.size() - 1;
+	SyncBodyHandles(handles, bodies.size()); // bodies appended since the last sync need a slot to be moved
+	RemoveBodyHandle(handles, index);
+	RemoveBody(bodies, (BodyIndex)index);
+
+	int expand[] = { 0, (SwapAndPop(perBodyArray, index, last), 0)... };
+	(void)expand;
+}
+
+
+
+template<typename... PerBodyArrays>
+static inline bool RemoveBodyByHandle(BodyStore &bodies, BodyHandleTable &handles, BodyHandle handle, PerBodyArrays&&... perBodyArray)
+{
+	size_t index = ResolveBodyHandle(handles, handle);
+	if (index == InvalidBodyIndex)
+	{
+		return false;
+	}
+	RemoveBodyAt(bodies, handles, index, std::forward<PerBodyArrays>(perBodyArray)...);
+	return true;
+}
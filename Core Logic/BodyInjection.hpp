@@ -0,0 +1,393 @@
+//  BodyInjection.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * BodyInjection Module: Adding a whole galaxy to a running simulation in one step boundary
+ *
+ * Description:
+ * Generating a galaxy serially on the calling thread takes long for large galaxies, and appending the
+ * result to 'bodies' one body at a time leaves every other per-body array (body data, handles) at the old size.
+ * Injecting N bodies is split in two instead:
+ * 			- generation, on a background thread that spreads the bodies over worker threads with ParallelFor, into a
+ * 			  BodyStore of its own sized up front, so every worker writes its own range of indices and nothing is locked.
+ * 			  Every body draws its random numbers from its own counter-based stream keyed by (seed, index),
+ * 			  see CounterRandom.hpp, so a seed gives the same galaxy bit for bit whatever the number of threads.
+ * 			- splicing, by whichever thread steps the bodies, at a step boundary. Once the galaxy is ready its arrays
+ * 			  are appended to those of 'bodies' and every per-body array grows to match in one go, each to at least
+ * 			  twice its capacity, so a 50k body galaxy costs one reallocation per array and a single slow frame.
+ * The stepping thread never waits for the generation, it simply splices at the first step boundary after it is done.
+ */
+#pragma once
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <cstdint>
+#include "SimulationEntities.hpp"
+#include "AlignedArray.hpp"
+#include "BodyStore.hpp"
+#include "BodyHandles.hpp"
+#include "ParallelUtilities.hpp"
+#include "CounterRandom.hpp"
+#include "CoreTypes.hpp"
+
+
+
+
+/**
+ * GalaxyModel: The galaxy models of the initial conditions functions, in the order of 'initialConditionsMode'.
+ */
+enum class GalaxyModel { ColdStart, KeplerOrbit, CollidingDisk, Disk, Plummer };
+
+
+
+/**
+ * GalaxySpec: What to inject, the parameters of the matching initial conditions function.
+ */
+class GalaxySpec
+{
+public:
+	GalaxyModel model = GalaxyModel::Plummer;  // Distribution of the bodies
+	size_t numBodies = 50000;  // Number of bodies to add
+	float bodiesMass = 5;  // Mass of the bodies
+	float anchorMass = 500;  // Mass of the central body (Kepler, disks), or the distribution's scale mass
+	float galaxyRadius = 2500;  // Size of the galaxy (side of the cold start square, orbital radius otherwise)
+	ofVec2f anchorPoint = ofVec2f(0, 0);  // Centre of the galaxy
+	float secondaryAnchorMass = 400;  // Second disk of 'CollidingDisk'
+	float secondaryRadius = 2000;
+	ofVec2f secondaryAnchorPoint = ofVec2f(0, 0);
+	float galaxyScatter = 1;  // Upper bound of the uniform variate of 'Plummer'
+	uint64_t seed = 1;  // Seed of the random streams
+};
+
+
+
+/**
+ * BodyInjection: A galaxy being generated in the background and waiting to be spliced in.
+ */
+class BodyInjection
+{
+public:
+	enum State { Idle, Generating, Ready };
+
+	// ------------- Configuration -------------
+	unsigned int threadCount = 0;  // Threads generating the bodies, 0 selects the number of hardware threads
+	size_t blockSize = 4096;  // Fewest bodies a generating thread takes on
+
+
+	// ------------- Generation State -------------
+	std::thread generator;  // Background generation, owned by the thread that requests injections
+	std::atomic<int> state{Idle};  // Idle -> Generating (requesting thread) -> Ready (generator) -> Idle (splice)
+	GalaxySpec spec;  // The galaxy being generated
+	BodyStore pending;  // The generated bodies, written by the generator and taken by the splice
+
+
+	// ------------- Diagnostics -------------
+	size_t injectedBodies = 0;  // Bodies spliced in since the start
+	double generationSeconds = 0;  // Wall-clock time the last generation took
+};
+
+
+
+
+
+
+
+
+/**
+ * GenerateGalaxyBodies: Initialize 'spec.numBodies' bodies on worker threads.
+ *
+ * @param spec         The galaxy to generate
+ * @param galaxyBodies Replaced by the new bodies, in the order of the serial generator's indices, at rest (zero acceleration)
+ * @param threadCount  Maximum number of threads, 0 selects DefaultThreadCount()
+ * @param blockSize    Fewest bodies a thread takes on, the bodies are the same for any value
+ */
+static inline void GenerateGalaxyBodies(const GalaxySpec &spec, BodyStore &galaxyBodies, unsigned int threadCount = 0, size_t blockSize = 4096);
+
+
+
+/**
+ * RequestBodyInjection: Start generating a galaxy in the background.
+ *
+ * @param injection The injection state, must be owned by the calling thread
+ * @param spec      The galaxy to inject
+ * @return False if the previous galaxy hasn't been spliced in yet, nothing is started then
+ */
+static inline bool RequestBodyInjection(BodyInjection &injection, const GalaxySpec &spec);
+
+
+
+/**
+ * SpliceInjectedBodies: At a step boundary, append the generated galaxy if it is ready and grow every per-body array.
+ *
+ * Everything that refers to bodies by index (the tree, cached lists, per-body integrator state) has to be rebuilt
+ * for the new count afterwards, the same as after mergers.
+ *
+ * @param injection           The injection state
+ * @param bodies              The bodies, the galaxy is appended with zero accelerations
+ * @param bodyHandles         Handle table of the bodies, the new bodies get handles
+ * @return The number of bodies added, 0 if no galaxy was ready
+ */
+static inline size_t SpliceInjectedBodies(BodyInjection &injection, BodyStore &bodies, BodyHandleTable &bodyHandles);
+
+
+
+/**
+ * FinishBodyInjection: Wait for a running generation and drop its bodies if they were never spliced.
+ */
+static inline void FinishBodyInjection(BodyInjection &injection);
+
+
+
+/**
+ * ReserveGeometrically: Make room for 'count' elements, at least doubling the capacity whenever it has to grow.
+ */
+template<typename Array>
+static inline void ReserveGeometrically(Array &array, size_t count);
+
+
+
+/**
+ * GalaxyBodyState: Position, velocity and mass of body 'i' of a galaxy, from its random stream (spec.seed, i).
+ */
+static inline void GalaxyBodyState(const GalaxySpec &spec, size_t i, ofVec2f &position, ofVec2f &velocity, float &mass);
+
+
+
+/**
+ * GalaxyModelName / GalaxyModelFromName: The name of a galaxy model as written on the command line, and back.
+ */
+static inline const char* GalaxyModelName(GalaxyModel model);
+static inline GalaxyModel GalaxyModelFromName(const std::string &name);
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+static inline void GenerateGalaxyBodies(const GalaxySpec &spec, BodyStore &galaxyBodies, unsigned int threadCount, size_t blockSize)
+{
+	ResizeBodyStore(galaxyBodies, spec.numBodies);
+
+
+	ParallelFor(0, spec.numBodies, threadCount, [&spec, &galaxyBodies](size_t begin, size_t end, unsigned int) // every worker writes its own indices
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			ofVec2f position, velocity;
+			float mass;
+			GalaxyBodyState(spec, i, position, velocity, mass);
+
+			SetPosition(galaxyBodies, i, position);
+			SetVelocity(galaxyBodies, i, velocity);
+			galaxyBodies.ax[i] = 0;
+			galaxyBodies.ay[i] = 0;
+			galaxyBodies.mass[i] = mass;
+		}
+	}, std::max<size_t>(1, blockSize));
+}
+
+
+
+static inline bool RequestBodyInjection(BodyInjection &injection, const GalaxySpec &spec)
+{
+	if (injection.state.load(std::memory_order_acquire) != BodyInjection::Idle)
+	{
+		return false;
+	}
+	if (injection.generator.joinable())
+	{
+		injection.generator.join(); // the previous generator finished before its galaxy was spliced
+	}
+
+
+	injection.spec = spec;
+	injection.state.store(BodyInjection::Generating, std::memory_order_relaxed);
+	injection.generator = std::thread([&injection]()
+	{
+		auto start = std::chrono::steady_clock::now();
+		GenerateGalaxyBodies(injection.spec, injection.pending, injection.threadCount, injection.blockSize);
+		injection.generationSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		injection.state.store(BodyInjection::Ready, std::memory_order_release); // publishes 'pending' to the splice
+	});
+	return true;
+}
+
+
+
+static inline size_t SpliceInjectedBodies(BodyInjection &injection, BodyStore &bodies, BodyHandleTable &bodyHandles)
+{
+	if (injection.state.load(std::memory_order_acquire) != BodyInjection::Ready)
+	{
+		return 0;
+	}
+
+
+	size_t added = injection.pending.size();
+	size_t count = bodies.size() + added;
+	AlignedArray<float>* arrays[] = { &bodies.x, &bodies.y, &bodies.vx, &bodies.vy, &bodies.ax, &bodies.ay, &bodies.mass };
+	for (AlignedArray<float>* array : arrays)
+	{
+		ReserveGeometrically(*array, count);
+	}
+	ReserveGeometrically(bodyHandles.slotOfIndex, count);
+
+	AppendBodies(bodies, injection.pending); // the new bodies start with no acceleration, like the initial ones
+	SyncBodyHandles(bodyHandles, count);
+
+
+	ResizeBodyStore(injection.pending, 0);
+	injection.injectedBodies += added;
+	injection.state.store(BodyInjection::Idle, std::memory_order_release);
+	return added;
+}
+
+
+
+static inline void FinishBodyInjection(BodyInjection &injection)
+{
+	if (injection.generator.joinable())
+	{
+		injection.generator.join();
+	}
+	ResizeBodyStore(injection.pending, 0);
+	injection.state.store(BodyInjection::Idle);
+}
+
+
+
+template<typename Array>
+static inline void ReserveGeometrically(Array &array, size_t count)
+{
+	if (count > array.capacity())
+	{
+		array.reserve(std::max(count, 2 * array.capacity()));
+	}
+}
+
+
+
+static inline void GalaxyBodyState(const GalaxySpec &spec, size_t i, ofVec2f &position, ofVec2f &velocity, float &mass)
+{
+	CounterRandom random(spec.seed, i);
+	const ofVec2f anchor = spec.anchorPoint;
+	velocity.set(0, 0);
+	mass = spec.bodiesMass;
+
+
+	switch (spec.model)
+	{
+		case GalaxyModel::ColdStart: // uniform in a square, at rest
+		{
+			float size = spec.galaxyRadius;
+			position.set(anchor.x + (random.uniform() - 0.5f) * size, anchor.y + (random.uniform() - 0.5f) * size);
+			break;
+		}
+		case GalaxyModel::KeplerOrbit: // a ring on a circular orbit around the anchor, body 0 is the anchor
+		{
+			float phase = i * 2 * PI / std::max<size_t>(spec.numBodies - 1, 1);
+			float speed = 6.67430e-11 * spec.anchorMass / spec.galaxyRadius;
+			position.set(anchor.x + spec.galaxyRadius * cos(phase), anchor.y + spec.galaxyRadius * sin(phase));
+			velocity.set(-speed * sin(phase), speed * cos(phase));
+			if (i == 0)
+			{
+				position = anchor;
+				velocity.set(0, 0);
+				mass = spec.anchorMass;
+			}
+			break;
+		}
+		case GalaxyModel::Disk: // uniform in radius around a heavier central body
+		{
+			float theta = random.uniform(0, 2 * PI);
+			float r = 1.5f * spec.bodiesMass * 10 + random.uniform() * 10.5f * spec.bodiesMass * 10;
+			float v = sqrt(6.67430e-11 * (spec.bodiesMass * 5) / r);
+			position.set(r * cos(theta) + anchor.x, r * sin(theta) + anchor.y);
+			velocity.set(-v * sin(theta), v * cos(theta));
+			if (i == 0)
+			{
+				position = anchor;
+				velocity.set(0, 0);
+				mass = spec.bodiesMass * 5;
+			}
+			break;
+		}
+		case GalaxyModel::CollidingDisk: // three quarters around the main anchor, the rest around the secondary one
+		{
+			float theta = random.uniform(0, 2 * PI);
+			bool mainDisk = i <= 3 * spec.numBodies / 4;
+			float anchorMass = mainDisk ? spec.anchorMass : spec.secondaryAnchorMass;
+			ofVec2f centre = mainDisk ? anchor : spec.secondaryAnchorPoint;
+			float r = mainDisk ? anchorMass * (1.5f + random.uniform() * 10.5f) : anchorMass * (1 + random.uniform() * 7);
+			float v = sqrt(6.67430e-11 * anchorMass / r);
+			position.set(r * cos(theta) + centre.x, r * sin(theta) + centre.y);
+			velocity.set(-v * sin(theta), v * cos(theta));
+			if (i <= 1)
+			{
+				position = (i == 0) ? anchor : spec.secondaryAnchorPoint;
+				velocity.set(0, 0);
+				mass = ((i == 0) ? spec.anchorMass : spec.secondaryAnchorMass) * 0.5;
+			}
+			break;
+		}
+		case GalaxyModel::Plummer: // Plummer radii, Box-Muller speeds
+		{
+			float uniformRandom = std::max(random.uniform() * spec.galaxyScatter, 1e-6f);
+			float r = spec.galaxyRadius * std::sqrt(1 / std::cbrt(uniformRandom * uniformRandom) - 1); // u^(-2/3), cbrt is cheaper than pow
+			float theta = 2 * (float)PI * random.uniform();
+			float cosPhi = 1 - 2 * random.uniform(); // phi = acos(cosPhi), only its sine is needed
+			float sinPhi = std::sqrt(std::max(1 - cosPhi * cosPhi, 0.0f));
+			position.set(r * sinPhi * std::cos(theta) + anchor.x, r * sinPhi * std::sin(theta) + anchor.y);
+
+			float u1 = std::max(random.uniform(), 1e-7f);
+			float u2 = random.uniform();
+			float z1 = std::sqrt(-2.0f * std::log(u1)) * std::cos(2 * (float)PI * u2);
+			float v = std::sqrt(2.0f) / std::sqrt(std::sqrt(1 + r * r)); // sqrt(2) * (1 + r^2)^(-1/4)
+			float vx = v * v * z1; // v * sqrt(2) * (1 + r^2)^-1/4 * z1, the speed scale of the serial generator
+			float vy = std::sqrt(std::max(v * v - vx * vx, 0.0f)) * (random.uniform() > 0.5f ? 1 : -1);
+			velocity.set(vx, vy);
+			break;
+		}
+	}
+}
+
+
+
+static inline const char* GalaxyModelName(GalaxyModel model)
+{
+	switch (model)
+	{
+		case GalaxyModel::ColdStart: return "cold-start";
+		case GalaxyModel::KeplerOrbit: return "kepler";
+		case GalaxyModel::CollidingDisk: return "colliding-disk";
+		case GalaxyModel::Disk: return "disk";
+		case GalaxyModel::Plummer:
+		default: return "plummer";
+	}
+}
+
+
+
+static inline GalaxyModel GalaxyModelFromName(const std::string &name)
+{
+	for (GalaxyModel model : {GalaxyModel::ColdStart, GalaxyModel::KeplerOrbit, GalaxyModel::CollidingDisk, GalaxyModel::Disk, GalaxyModel::Plummer})
+	{
+		if (name == GalaxyModelName(model))
+		{
+			return model;
+		}
+	}
+	throw std::invalid_argument("Unknown galaxy model '" + name + "', expected cold-start, kepler, colliding-disk, disk or plummer");
+}
@@ -0,0 +1,354 @@
+//  BodyStore.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * BodyStore Module: Structure-of-arrays storage of the bodies' state
+ *
+ * Description:
+ * A 'Body' is a 20-byte record reached through a pointer, so a loop that only needs positions still loads every
+ * record's velocity and mass and chases one pointer per body. The BodyStore keeps each component in its own
+ * contiguous, cache-line aligned array,
+ * 			x, y, vx, vy, ax, ay, mass
+ * and names a body by its index into them (BodyIndex). A loop touching k components streams exactly k arrays, unit
+ * stride, which the compiler vectorizes without gathers (e.g. a drift is x += vx * h, y += vy * h over four arrays).
+ *
+ * Removal moves the last body into the freed index (swap-and-pop), so the arrays stay dense and removing is O(1);
+ * the price is that the moved body's index changes, which 'RemoveBody' reports to the caller.
+ *
+ * The store is the simulation's bodies: galaxies are generated into one, the quadtree's leaves hold body indices and
+ * every walk reads positions and masses from x, y and mass, every force evaluation adds into ax and ay, and every
+ * integrator streams the arrays it updates. The snapshots the physics thread hands to the renderer are copies of it.
+ * 'BasicBody' remains as the value of one body on its own, e.g., as a galaxy model generates it.
+ *
+ * Like 'BasicBody' the store is a template on the scalar type 'Real' (see Precision.hpp), BodyStore is the float one.
+ */
+#pragma once
+#include <cstdint>
+#include "SimulationEntities.hpp"
+#include "AlignedArray.hpp"
+#include "Precision.hpp"
+#include "CoreTypes.hpp"
+
+
+
+
+typedef uint32_t BodyIndex;  // Position of a body in every array of a BodyStore
+
+
+
+/**
+ * BasicBodyStore: One aligned array per component, all of the same length.
+ */
+template<typename Real>
+class BasicBodyStore
+{
+public:
+	typedef typename PrecisionTraits<Real>::Vector Vector;
+
+	size_t size() const { return mass.size(); }
+	bool empty() const { return mass.empty(); }
+
+	AlignedArray<Real> x;  // Positions
+	AlignedArray<Real> y;
+	AlignedArray<Real> vx;  // Velocities
+	AlignedArray<Real> vy;
+	AlignedArray<Real> ax;  // Accelerations
+	AlignedArray<Real> ay;
+	AlignedArray<Real> mass;  // Masses
+};
+
+typedef BasicBodyStore<float> BodyStore;
+
+
+
+
+
+
+
+
+
+/**
+ * ResizeBodyStore: Set the number of bodies, new ones are zero.
+ */
+template<typename Real>
+static inline void ResizeBodyStore(BasicBodyStore<Real> &store, size_t count);
+
+
+
+/**
+ * AddBody: Append a body with zero acceleration.
+ *
+ * @return The new body's index
+ */
+template<typename Real>
+static inline BodyIndex AddBody(BasicBodyStore<Real> &store, typename PrecisionTraits<Real>::Vector position, typename PrecisionTraits<Real>::Vector velocity, Real mass);
+
+
+
+/**
+ * RemoveBody: Remove a body in O(1) by moving the last body into its index.
+ *
+ * @param store The bodies
+ * @param index Index of the body to remove
+ * @return The former index of the body now at 'index', equal to the new size if the removed body was the last one
+ */
+template<typename Real>
+static inline BodyIndex RemoveBody(BasicBodyStore<Real> &store, BodyIndex index);
+
+
+
+/**
+ * AppendBodies: Append every body of 'source' with its acceleration, in order, e.g., a generated galaxy.
+ */
+template<typename Real>
+static inline void AppendBodies(BasicBodyStore<Real> &store, const BasicBodyStore<Real> &source);
+
+
+
+/**
+ * SetBodyPlacement: Have every array allocate through MemoryPlacement.hpp from now on, see 'AlignedArray::setPlacement'.
+ */
+template<typename Real>
+static inline void SetBodyPlacement(BasicBodyStore<Real> &store, bool enabled);
+
+
+
+
+
+
+
+
+// ------------- Single Bodies -------------
+/**
+ * PositionOf: The position of body 'index' as a vector.
+ */
+template<typename Real>
+static inline typename PrecisionTraits<Real>::Vector PositionOf(const BasicBodyStore<Real> &store, size_t index);
+
+
+
+/**
+ * VelocityOf: The velocity of body 'index' as a vector.
+ */
+template<typename Real>
+static inline typename PrecisionTraits<Real>::Vector VelocityOf(const BasicBodyStore<Real> &store, size_t index);
+
+
+
+/**
+ * SetPosition: Move body 'index' to 'position'.
+ */
+template<typename Real>
+static inline void SetPosition(BasicBodyStore<Real> &store, size_t index, const typename PrecisionTraits<Real>::Vector &position);
+
+
+
+/**
+ * SetVelocity: Set the velocity of body 'index'.
+ */
+template<typename Real>
+static inline void SetVelocity(BasicBodyStore<Real> &store, size_t index, const typename PrecisionTraits<Real>::Vector &velocity);
+
+
+
+
+
+
+
+
+// ------------- Accelerations -------------
+/**
+ * ClearAccelerations: Zero ax and ay, before a force evaluation adds into them.
+ */
+template<typename Real>
+static inline void ClearAccelerations(BasicBodyStore<Real> &store);
+
+
+
+/**
+ * AccelerationOf: The acceleration of body 'index' as a vector.
+ */
+template<typename Real>
+static inline typename PrecisionTraits<Real>::Vector AccelerationOf(const BasicBodyStore<Real> &store, size_t index);
+
+
+
+/**
+ * AddAcceleration: Add 'acceleration' to body 'index', how a force walk's per-body sum lands in the store.
+ */
+template<typename Real>
+static inline void AddAcceleration(BasicBodyStore<Real> &store, size_t index, const typename PrecisionTraits<Real>::Vector &acceleration);
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+template<typename Real>
+static inline void ResizeBodyStore(BasicBodyStore<Real> &store, size_t count)
+{
+	store.x.resize(count);
+	store.y.resize(count);
+	store.vx.resize(count);
+	store.vy.resize(count);
+	store.ax.resize(count);
+	store.ay.resize(count);
+	store.mass.resize(count);
+}
+
+
+
+template<typename Real>
+static inline BodyIndex AddBody(BasicBodyStore<Real> &store, typename PrecisionTraits<Real>::Vector position, typename PrecisionTraits<Real>::Vector velocity, Real mass)
+{
+	BodyIndex index = (BodyIndex)store.size();
+	store.x.push_back(position.x);
+	store.y.push_back(position.y);
+	store.vx.push_back(velocity.x);
+	store.vy.push_back(velocity.y);
+	store.ax.push_back(0);
+	store.ay.push_back(0);
+	store.mass.push_back(mass);
+	return index;
+}
+
+
+
+template<typename Real>
+static inline BodyIndex RemoveBody(BasicBodyStore<Real> &store, BodyIndex index)
+{
+	BodyIndex last = (BodyIndex)store.size() - 1;
+	store.x[index] = store.x[last];
+	store.y[index] = store.y[last];
+	store.vx[index] = store.vx[last];
+	store.vy[index] = store.vy[last];
+	store.ax[index] = store.ax[last];
+	store.ay[index] = store.ay[last];
+	store.mass[index] = store.mass[last];
+
+	store.x.pop_back();
+	store.y.pop_back();
+	store.vx.pop_back();
+	store.vy.pop_back();
+	store.ax.pop_back();
+	store.ay.pop_back();
+	store.mass.pop_back();
+	return last;
+}
+
+
+
+template<typename Real>
+static inline void AppendBodies(BasicBodyStore<Real> &store, const BasicBodyStore<Real> &source)
+{
+	size_t first = store.size();
+	ResizeBodyStore(store, first + source.size());
+	for (size_t i = 0; i < source.size(); i++)
+	{
+		store.x[first + i] = source.x[i];
+		store.y[first + i] = source.y[i];
+		store.vx[first + i] = source.vx[i];
+		store.vy[first + i] = source.vy[i];
+		store.ax[first + i] = source.ax[i];
+		store.ay[first + i] = source.ay[i];
+		store.mass[first + i] = source.mass[i];
+	}
+}
+
+
+
+template<typename Real>
+static inline void SetBodyPlacement(BasicBodyStore<Real> &store, bool enabled)
+{
+	AlignedArray<Real>* arrays[] = { &store.x, &store.y, &store.vx, &store.vy, &store.ax, &store.ay, &store.mass };
+	for (AlignedArray<Real>* array : arrays)
+	{
+		array->setPlacement(enabled);
+	}
+}
+
+
+
+
+
+
+
+
+template<typename Real>
+static inline typename PrecisionTraits<Real>::Vector PositionOf(const BasicBodyStore<Real> &store, size_t index)
+{
+	return typename PrecisionTraits<Real>::Vector(store.x[index], store.y[index]);
+}
+
+
+
+template<typename Real>
+static inline typename PrecisionTraits<Real>::Vector VelocityOf(const BasicBodyStore<Real> &store, size_t index)
+{
+	return typename PrecisionTraits<Real>::Vector(store.vx[index], store.vy[index]);
+}
+
+
+
+template<typename Real>
+static inline void SetPosition(BasicBodyStore<Real> &store, size_t index, const typename PrecisionTraits<Real>::Vector &position)
+{
+	store.x[index] = position.x;
+	store.y[index] = position.y;
+}
+
+
+
+template<typename Real>
+static inline void SetVelocity(BasicBodyStore<Real> &store, size_t index, const typename PrecisionTraits<Real>::Vector &velocity)
+{
+	store.vx[index] = velocity.x;
+	store.vy[index] = velocity.y;
+}
+
+
+
+
+
+
+
+
+template<typename Real>
+static inline void ClearAccelerations(BasicBodyStore<Real> &store)
+{
+	Real* ax = store.ax.data();
+	Real* ay = store.ay.data();
+	for (size_t i = 0; i < store.ax.size(); i++)
+	{
+		ax[i] = 0;
+		ay[i] = 0;
+	}
+}
+
+
+
+template<typename Real>
+static inline typename PrecisionTraits<Real>::Vector AccelerationOf(const BasicBodyStore<Real> &store, size_t index)
+{
+	return typename PrecisionTraits<Real>::Vector(store.ax[index], store.ay[index]);
+}
+
+
+
+template<typename Real>
+static inline void AddAcceleration(BasicBodyStore<Real> &store, size_t index, const typename PrecisionTraits<Real>::Vector &acceleration)
+{
+	store.ax[index] += acceleration.x;
+	store.ay[index] += acceleration.y;
+}
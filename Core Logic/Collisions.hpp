@@ -0,0 +1,370 @@
+//  Collisions.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * Collisions Module: Tree-accelerated collision detection and restitution-based resolution
+ *
+ * Description:
+ * Bodies are rigid circles whose radius is their mass. Collisions are handled in three stages:
+ * 			- broad phase, every body queries the quadtree already built for gravity, descending only into nodes whose
+ * 			  bounds are closer to it than its radius plus the largest radius within the node ('maximumRadius', kept
+ * 			  by the mass distribution); one heavy body only widens the queries near it, and the leaves hand back
+ * 			  their bodies' indices, so no second spatial structure or lookup table is built and the cost is
+ * 			  O(N log N) instead of O(N^2)
+ * 			- narrow phase, candidate pairs are tested for circle overlap, |x_a - x_b| < r_a + r_b
+ * 			- resolution, overlapping pairs that are approaching exchange an impulse with coefficient of restitution 'e',
+ * 			  and a fraction of the overlap is removed by pushing them apart in inverse proportion to their masses
+ *
+ * Resolution writes to both bodies of a pair, so pairs sharing a body cannot be resolved at the same time. The
+ * contacts are therefore split into batches in which every body appears at most once (a greedy coloring of the
+ * contact graph), the pairs of a batch are resolved in parallel and the batches one after another.
+ *
+ * When the tree is older than the current positions (cached interaction lists, multi-rate far field) the caller
+ * passes how far bodies may have moved since it was built, and the query grows every node's bounds by that much.
+ */
+#pragma once
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "Quadtree.hpp"
+#include "ParallelUtilities.hpp"
+#include "ofMain.h"
+
+
+
+
+/**
+ * CollisionContact: An overlapping pair of bodies found by the narrow phase.
+ */
+class CollisionContact
+{
+public:
+	size_t indexA; // Index of the first body of the pair
+	size_t indexB; // Index of the second body of the pair, always the higher one
+};
+
+
+
+/**
+ * CollisionSystem: Contacts, their conflict-free batches, and the settings of the collision response.
+ */
+class CollisionSystem
+{
+public:
+	// ------------- Configuration -------------
+	float positionCorrection = 0.5;  // Fraction of the overlap removed per step, 1 separates the pair completely
+	unsigned int threadCount = 0;  // Threads used by every stage, 0 selects the number of hardware threads
+
+
+	// ------------- Per-Step State -------------
+	std::vector<CollisionContact> contacts;  // Overlapping pairs found this step, each pair once
+	std::vector<std::vector<size_t>> batches;  // Indices into 'contacts', no body appears twice within a batch
+	std::vector<std::vector<CollisionContact>> threadContacts;  // Contacts found by each worker thread before they are merged
+	std::vector<int> nextBatch;  // First batch each body is still free in, indexed like 'bodies'
+};
+
+
+
+
+
+
+
+
+// ------------- Broad Phase -------------
+/**
+ * QueryQuadtreeAABB: Collect the bodies of all leaves whose bounds (grown by 'slack') overlap 'region'.
+ *
+ * @param rootNode The current node of the query
+ * @param region   The query rectangle
+ * @param slack    How far the bodies may have moved since the tree was built
+ * @param results  The indices of the bodies found are appended here
+ */
+static inline void QueryQuadtreeAABB(Quadtree* &rootNode, const ofRectangle &region, float slack, std::vector<size_t> &results);
+
+
+
+/**
+ * BodyAABB: Axis-aligned bounding box of body 'index', grown by 'margin' on every side.
+ */
+static inline ofRectangle BodyAABB(const BodyStore &bodies, size_t index, float margin);
+
+
+
+/**
+ * QueryQuadtreeContacts: Collect the overlapping pairs of the body at 'index' with the bodies of higher index.
+ *
+ * A node is skipped when the gap between its bounds (grown by 'slack') and the body exceeds the body's radius plus
+ * the node's 'maximumRadius'.
+ *
+ * @param rootNode The current node of the query, built from 'bodies'
+ * @param bodies   The bodies
+ * @param index    Index of the querying body
+ * @param slack    How far the bodies may have moved since the tree was built
+ * @param found    The contacts found are appended here
+ */
+static inline void QueryQuadtreeContacts(Quadtree* rootNode, const BodyStore &bodies, size_t index, float slack, std::vector<CollisionContact> &found);
+
+
+
+
+
+
+
+
+// ------------- Collision Pipeline -------------
+/**
+ * DetectCollisions: Broad phase through the quadtree and narrow phase circle tests, filling 'collisions.contacts'.
+ *
+ * @param rootNode   Root of the quadtree built for gravity
+ * @param bodies     The bodies
+ * @param collisions The collision state
+ * @param slack      How far the bodies may have moved since the tree was built
+ */
+static inline void DetectCollisions(Quadtree* &rootNode, const BodyStore &bodies, CollisionSystem &collisions, float slack);
+
+
+
+/**
+ * BatchCollisions: Split the contacts into batches in which no body appears twice.
+ */
+static inline void BatchCollisions(const BodyStore &bodies, CollisionSystem &collisions);
+
+
+
+/**
+ * ResolveCollision: Apply the restitution impulse and positional correction to one contact.
+ *
+ * @param bodies             The bodies, whose velocities and positions are updated
+ * @param contact            The overlapping pair
+ * @param e                  Coefficient of restitution, 0 perfectly inelastic, 1 perfectly elastic
+ * @param positionCorrection Fraction of the overlap removed
+ */
+static inline void ResolveCollision(BodyStore &bodies, const CollisionContact &contact, float e, float positionCorrection);
+
+
+
+/**
+ * ComputeCollisions: Detect, batch and resolve all collisions of this step.
+ *
+ * @param rootNode   Root of the quadtree built for gravity
+ * @param bodies     The bodies
+ * @param collisions The collision state
+ * @param e          Coefficient of restitution
+ * @param slack      How far the bodies may have moved since the tree was built
+ * @return The number of contacts resolved
+ */
+static inline size_t ComputeCollisions(Quadtree* &rootNode, BodyStore &bodies, CollisionSystem &collisions, float e, float slack = 0);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline void QueryQuadtreeAABB(Quadtree* &rootNode, const ofRectangle &region, float slack, std::vector<size_t> &results)
+{
+	if (rootNode == nullptr)
+	{
+		return;
+	}
+
+
+	const ofRectangle &bounds = rootNode->bounds;
+	if (bounds.x - slack > region.x + region.width || region.x > bounds.x + bounds.width + slack ||
+		bounds.y - slack > region.y + region.height || region.y > bounds.y + bounds.height + slack)
+	{
+		return;
+	}
+
+
+	if (rootNode->hasChildren)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			if (rootNode->children[i] != nullptr)
+			{
+				QueryQuadtreeAABB(rootNode->children[i], region, slack, results);
+			}
+		}
+	}
+	else if (rootNode->nodeBodyIndex != SIZE_MAX)
+	{
+		results.push_back(rootNode->nodeBodyIndex);
+	}
+}
+
+
+
+static inline ofRectangle BodyAABB(const BodyStore &bodies, size_t index, float margin)
+{
+	float extent = bodies.mass[index] + margin;
+	return ofRectangle(bodies.x[index] - extent, bodies.y[index] - extent, 2 * extent, 2 * extent);
+}
+
+
+
+
+
+
+
+
+static inline void QueryQuadtreeContacts(Quadtree* rootNode, const BodyStore &bodies, size_t index, float slack, std::vector<CollisionContact> &found)
+{
+	const ofRectangle &bounds = rootNode->bounds;
+	float x = bodies.x[index], y = bodies.y[index];
+	float gapX = std::max(0.0f, std::max(bounds.x - x, x - (bounds.x + bounds.width)) - slack);
+	float gapY = std::max(0.0f, std::max(bounds.y - y, y - (bounds.y + bounds.height)) - slack);
+	float reach = bodies.mass[index] + rootNode->maximumRadius;
+	if (gapX * gapX + gapY * gapY > reach * reach)
+	{
+		return;
+	}
+
+
+	if (rootNode->hasChildren)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			if (rootNode->children[i] != nullptr)
+			{
+				QueryQuadtreeContacts(rootNode->children[i], bodies, index, slack, found);
+			}
+		}
+	}
+	else if (rootNode->nodeBodyIndex != SIZE_MAX && rootNode->nodeBodyIndex > index) // every pair is reached from both bodies, keep it once
+	{
+		size_t other = rootNode->nodeBodyIndex;
+		float dx = bodies.x[other] - x, dy = bodies.y[other] - y;
+		float radii = bodies.mass[index] + bodies.mass[other];
+		if (dx * dx + dy * dy < radii * radii)
+		{
+			found.push_back({index, other});
+		}
+	}
+}
+
+
+
+
+
+
+
+
+static inline void DetectCollisions(Quadtree* &rootNode, const BodyStore &bodies, CollisionSystem &collisions, float slack)
+{
+	collisions.contacts.clear();
+	if (rootNode == nullptr || bodies.empty())
+	{
+		return;
+	}
+
+
+	unsigned int threadCount = (collisions.threadCount > 0) ? collisions.threadCount : DefaultThreadCount();
+	collisions.threadContacts.resize(threadCount);
+	for (auto &found : collisions.threadContacts)
+	{
+		found.clear();
+	}
+
+	Quadtree* root = rootNode;
+	ParallelFor(0, bodies.size(), threadCount, [root, &bodies, &collisions, slack](size_t begin, size_t end, unsigned int threadIndex)
+	{
+		std::vector<CollisionContact> &found = collisions.threadContacts[threadIndex];
+		for (size_t i = begin; i < end; i++)
+		{
+			QueryQuadtreeContacts(root, bodies, i, slack, found);
+		}
+	}, 256);
+
+
+	for (auto &found : collisions.threadContacts)
+	{
+		collisions.contacts.insert(collisions.contacts.end(), found.begin(), found.end());
+	}
+}
+
+
+
+static inline void BatchCollisions(const BodyStore &bodies, CollisionSystem &collisions)
+{
+	collisions.batches.clear();
+	collisions.nextBatch.assign(bodies.size(), 0);
+
+
+	// Every body's batches strictly increase, so a batch can never hold the same body twice
+	for (size_t c = 0; c < collisions.contacts.size(); c++)
+	{
+		CollisionContact &contact = collisions.contacts[c];
+		int batch = std::max(collisions.nextBatch[contact.indexA], collisions.nextBatch[contact.indexB]);
+		if (batch >= (int)collisions.batches.size())
+		{
+			collisions.batches.resize(batch + 1);
+		}
+
+		collisions.batches[batch].push_back(c);
+		collisions.nextBatch[contact.indexA] = batch + 1;
+		collisions.nextBatch[contact.indexB] = batch + 1;
+	}
+}
+
+
+
+static inline void ResolveCollision(BodyStore &bodies, const CollisionContact &contact, float e, float positionCorrection)
+{
+	size_t a = contact.indexA;
+	size_t b = contact.indexB;
+
+	ofVec2f offset = PositionOf(bodies, b) - PositionOf(bodies, a);
+	float distance = offset.length();
+	float inverseMassA = 1.0f / bodies.mass[a];
+	float inverseMassB = 1.0f / bodies.mass[b];
+	float inverseMassSum = inverseMassA + inverseMassB;
+
+	ofVec2f normal = (distance > 0) ? offset / distance : ofVec2f(1, 0); // coincident centres, push apart along an arbitrary axis
+
+
+	// Impulse, only if the bodies are still approaching each other
+	float approachSpeed = (VelocityOf(bodies, b) - VelocityOf(bodies, a)).dot(normal);
+	if (approachSpeed < 0)
+	{
+		float impulse = -(1 + e) * approachSpeed / inverseMassSum;
+		SetVelocity(bodies, a, VelocityOf(bodies, a) - normal * (impulse * inverseMassA));
+		SetVelocity(bodies, b, VelocityOf(bodies, b) + normal * (impulse * inverseMassB));
+	}
+
+
+	// Positional correction, so resting contacts don't sink into each other under gravity
+	float overlap = bodies.mass[a] + bodies.mass[b] - distance;
+	if (overlap > 0)
+	{
+		ofVec2f correction = normal * (positionCorrection * overlap / inverseMassSum);
+		SetPosition(bodies, a, PositionOf(bodies, a) - correction * inverseMassA);
+		SetPosition(bodies, b, PositionOf(bodies, b) + correction * inverseMassB);
+	}
+}
+
+
+
+static inline size_t ComputeCollisions(Quadtree* &rootNode, BodyStore &bodies, CollisionSystem &collisions, float e, float slack)
+{
+	DetectCollisions(rootNode, bodies, collisions, slack);
+	BatchCollisions(bodies, collisions);
+
+
+	for (auto &batch : collisions.batches)
+	{
+		ParallelFor(0, batch.size(), collisions.threadCount, [&bodies, &collisions, &batch, e](size_t begin, size_t end, unsigned int)
+		{
+			for (size_t k = begin; k < end; k++)
+			{
+				ResolveCollision(bodies, collisions.contacts[batch[k]], e, collisions.positionCorrection);
+			}
+		}, 128);
+	}
+	return collisions.contacts.size();
+}
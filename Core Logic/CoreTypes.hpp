@@ -0,0 +1,124 @@
+//  CoreTypes.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * CoreTypes Module: The openFrameworks types and functions the physics core uses, with or without openFrameworks
+ *
+ * Description:
+ * The physics core (bodies, pool, quadtree, force walks, integrators, galaxy generation) needs very little of
+ * openFrameworks: ofVec2f and ofRectangle to store positions and bounds, ofRandom, ofGetElapsedTimef, and the
+ * namespace std and PI that ofMain.h brings along. The core headers include this header rather than ofMain.h.
+ *
+ * In the application it is just ofMain.h. Defining NBODY_HEADLESS (the CMake build of the 'nbody_core' library
+ * and the command line driver does) replaces it by the standalone definitions below, with the same names and the
+ * same arithmetic, so the core compiles and computes identically without openFrameworks, a window or OpenGL. The
+ * drawing members of the core classes are left out of a headless build.
+ */
+#pragma once
+#if !defined(NBODY_HEADLESS)
+#include "ofMain.h"
+#else
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;  // ofMain.h does the same, the core relies on it for cout and endl
+
+#ifndef PI
+#define PI 3.14159265358979323846
+#endif
+#ifndef TWO_PI
+#define TWO_PI 6.28318530717958647693
+#endif
+#ifndef HALF_PI
+#define HALF_PI 1.57079632679489661923
+#endif
+
+
+
+
+/**
+ * ofVec2f: Two float components, the part of openFrameworks' ofVec2f the core uses.
+ */
+class ofVec2f
+{
+public:
+	ofVec2f() : x(0), y(0) {}
+	ofVec2f(float _x, float _y) : x(_x), y(_y) {}
+
+	ofVec2f& set(float _x, float _y) { x = _x; y = _y; return *this; }
+	float length() const { return std::sqrt(x * x + y * y); }
+	float lengthSquared() const { return x * x + y * y; }
+	float distance(const ofVec2f &other) const { return std::sqrt(squareDistance(other)); }
+	float squareDistance(const ofVec2f &other) const { return (x - other.x) * (x - other.x) + (y - other.y) * (y - other.y); }
+	float dot(const ofVec2f &other) const { return x * other.x + y * other.y; }
+	ofVec2f getNormalized() const { float l = length(); return (l > 0) ? ofVec2f(x / l, y / l) : ofVec2f(); }
+	ofVec2f& normalize() { *this = getNormalized(); return *this; }
+
+	ofVec2f operator+(const ofVec2f &other) const { return ofVec2f(x + other.x, y + other.y); }
+	ofVec2f operator-(const ofVec2f &other) const { return ofVec2f(x - other.x, y - other.y); }
+	ofVec2f operator-() const { return ofVec2f(-x, -y); }
+	ofVec2f operator*(float scalar) const { return ofVec2f(x * scalar, y * scalar); }
+	ofVec2f operator/(float scalar) const { return ofVec2f(x / scalar, y / scalar); }
+	ofVec2f& operator+=(const ofVec2f &other) { x += other.x; y += other.y; return *this; }
+	ofVec2f& operator-=(const ofVec2f &other) { x -= other.x; y -= other.y; return *this; }
+	ofVec2f& operator*=(float scalar) { x *= scalar; y *= scalar; return *this; }
+	ofVec2f& operator/=(float scalar) { x /= scalar; y /= scalar; return *this; }
+	bool operator==(const ofVec2f &other) const { return x == other.x && y == other.y; }
+	bool operator!=(const ofVec2f &other) const { return !(*this == other); }
+
+	float x;
+	float y;
+};
+
+inline ofVec2f operator*(float scalar, const ofVec2f &vector) { return vector * scalar; }
+
+
+
+/**
+ * ofRectangle: Axis-aligned float rectangle, the part of openFrameworks' ofRectangle the core uses.
+ */
+class ofRectangle
+{
+public:
+	ofRectangle() : x(0), y(0), width(0), height(0) {}
+	ofRectangle(float _x, float _y, float _width, float _height) : x(_x), y(_y), width(_width), height(_height) {}
+
+	void set(float _x, float _y, float _width, float _height) { x = _x; y = _y; width = _width; height = _height; }
+	void setPosition(float _x, float _y) { x = _x; y = _y; }
+	float getX() const { return x; }
+	float getY() const { return y; }
+	float getWidth() const { return width; }
+	float getHeight() const { return height; }
+	ofVec2f getCenter() const { return ofVec2f(x + width * 0.5f, y + height * 0.5f); }
+	bool inside(float px, float py) const { return px > x && py > y && px < x + width && py < y + height; } // strict, as openFrameworks
+	bool inside(const ofVec2f &point) const { return inside(point.x, point.y); }
+	bool intersects(const ofRectangle &other) const { return x < other.x + other.width && other.x < x + width && y < other.y + other.height && other.y < y + height; }
+
+	float x;
+	float y;
+	float width;
+	float height;
+};
+
+
+
+
+inline float ofRandom(float max) { return max * (std::rand() / (RAND_MAX + 1.0f)); } // [0, max), like openFrameworks
+inline float ofRandom(float min, float max) { return min + ofRandom(max - min); }
+
+inline float ofGetElapsedTimef() // Seconds since the first call, openFrameworks counts from the start of the app
+{
+	static const auto start = std::chrono::steady_clock::now();
+	return std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline std::string ofToDataPath(const std::string &path, bool = false) { return path; } // relative to the working directory
+#endif
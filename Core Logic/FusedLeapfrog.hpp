@@ -0,0 +1,123 @@
+//  FusedLeapfrog.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * FusedLeapfrog Module: Leapfrog kick and drift applied inside the force walk
+ *
+ * Description:
+ * The separate passes of a frame, walk (write accelerations), integrate (read them back) and reset (zero them),
+ * each stream all N bodies plus an N-sized accelerations array through memory. In the staggered leapfrog
+ * 			v_{n+1/2} = v_{n-1/2} + a(x_n) dt
+ * 			x_{n+1}   = x_n + v_{n+1/2} dt
+ * a body's acceleration is needed exactly once, right after it is computed, so each worker keeps it in a local,
+ * kicks the body's velocity and stages its drifted position while the body is still in cache. There is no
+ * accelerations array to write, read back or reset.
+ *
+ * Other walkers still read the body's position x_n through the tree's leaves, so the drifted position can't be
+ * written in place; it goes to the second position buffer. Each worker then waits at a barrier until every walk has
+ * finished and commits the positions of its own chunk, in parallel and while they are still in its cache.
+ * The first step after switching to this scheme kicks by dt/2 to stagger the velocities half a step behind.
+ */
+#pragma once
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "AlignedArray.hpp"
+#include "Quadtree.hpp"
+#include "PhysicsLogic.hpp"
+#include "ParallelUtilities.hpp"
+#include "ofMain.h"
+
+
+
+
+/**
+ * FusedLeapfrog: The staged (second) position buffer and the velocity staggering state.
+ */
+class FusedLeapfrog
+{
+public:
+	unsigned int threadCount = 0;  // Threads used by the walk, 0 selects the number of hardware threads
+	AlignedArray<float> stagedX;  // x_{n+1} of every body, committed by each worker once every walk has finished
+	AlignedArray<float> stagedY;
+	bool velocitiesStaggered = false;  // Whether the velocities already lag the positions by half a step
+	float previousDt = 0;  // Step of the previous call, the kick spans half of it and half of the current one
+};
+
+
+
+
+
+
+
+
+/**
+ * ComputeForcesKickDrift: Walk the tree for every body, kick its velocity and stage its drifted position, then commit.
+ *
+ * @param rootNode Root of the quadtree built over the current positions
+ * @param bodies   The bodies
+ * @param leapfrog The staged positions and staggering state
+ * @param G        Universal gravitational constant
+ * @param theta    Barnes-Hut theta parameter for MAC
+ * @param dt       Time step
+ */
+static inline void ComputeForcesKickDrift(Quadtree* &rootNode, BodyStore &bodies, FusedLeapfrog &leapfrog, float G, float theta, float dt);
+
+
+
+/**
+ * ResetFusedLeapfrog: Mark the velocities as synchronized again, e.g., after another integrator advanced the bodies.
+ */
+static inline void ResetFusedLeapfrog(FusedLeapfrog &leapfrog);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline void ComputeForcesKickDrift(Quadtree* &rootNode, BodyStore &bodies, FusedLeapfrog &leapfrog, float G, float theta, float dt)
+{
+	PROFILE_PHASE(ComputeForces); // the kick and drift ride along with the walk
+	leapfrog.stagedX.resize(bodies.size());
+	leapfrog.stagedY.resize(bodies.size());
+	float kick = leapfrog.velocitiesStaggered ? 0.5f * (leapfrog.previousDt + dt) : dt * 0.5f; // the velocities sit halfway through the previous step
+
+
+	ThreadBarrier walksDone(ParallelForChunks(bodies.size(), leapfrog.threadCount, 256)); // one thread per chunk
+	ParallelFor(0, bodies.size(), leapfrog.threadCount, [&rootNode, &bodies, &leapfrog, &walksDone, G, theta, kick, dt](size_t begin, size_t end, unsigned int)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			ofVec2f acceleration(0, 0);
+			ComputeTreeForce(rootNode, bodies, i, PositionOf(bodies, i), acceleration, G, theta);
+
+			bodies.vx[i] += acceleration.x * kick; // nobody else reads velocities during the walk
+			bodies.vy[i] += acceleration.y * kick;
+			leapfrog.stagedX[i] = bodies.x[i] + bodies.vx[i] * dt;
+			leapfrog.stagedY[i] = bodies.y[i] + bodies.vy[i] * dt;
+		}
+
+
+		walksDone.arriveAndWait(); // no walker reads x_n any more
+		for (size_t i = begin; i < end; i++)
+		{
+			bodies.x[i] = leapfrog.stagedX[i];
+			bodies.y[i] = leapfrog.stagedY[i];
+		}
+	}, 256);
+	leapfrog.velocitiesStaggered = true;
+	leapfrog.previousDt = dt;
+}
+
+
+
+static inline void ResetFusedLeapfrog(FusedLeapfrog &leapfrog)
+{
+	leapfrog.velocitiesStaggered = false;
+}
@@ -0,0 +1,332 @@
+//  InteractionLists.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * InteractionLists Module: Reusing each body's accepted quadtree nodes across timesteps
+ *
+ * Description:
+ * For quiescent systems (a Keplerian ring, a relaxed Plummer sphere) the set of nodes a body accepts
+ * with the multipole acceptance criterion (MAC) barely changes from one step to the next, yet 'ComputeTreeForce'
+ * re-evaluates the MAC against every visited node every frame. This module records, for every body, the list of
+ * nodes (accepted cells and leaf bodies) that its tree walk interacted with, and reuses that list for up to
+ * 'maxReuseSteps' steps. While a list is being reused the tree topology is kept as-is and only the node
+ * centres of mass are refreshed, so the force is still evaluated against current positions, only the MAC
+ * work of the walk is skipped.
+ *
+ * To keep the reused lists valid the MAC is evaluated with a safety margin when the lists are recorded:
+ * a cell is only accepted if it would still satisfy the MAC after the body and the cell's center of mass
+ * have each moved by up to 'margin'. As soon as any body has drifted further than 'margin' from where it was
+ * when the lists were recorded, the lists are discarded and a full re-walk on a freshly built tree happens.
+ *
+ * This trades memory (one list of node pointers per body) for skipping most of the MAC work.
+ */
+#pragma once
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "Quadtree.hpp"
+#include "PhysicsLogic.hpp"
+#include "ParallelUtilities.hpp"
+#include "ofMain.h"
+
+
+
+
+/**
+ * InteractionListCache: Per-body interaction lists and the bookkeeping needed to decide when they expire.
+ *
+ * The lists hold raw pointers into the quadtree, so they are only valid as long as the tree they were
+ * recorded on is alive, the owner must keep the tree (and its topology) intact while 'isValid' is true.
+ */
+class InteractionListCache
+{
+public:
+	// ------------- Member variables -------------
+	std::vector<std::vector<Quadtree*>> interactionLists; // Accepted cells and leaves recorded for each body, indexed like 'bodies'
+	std::vector<ofVec2f> referencePositions; // Positions of the bodies at the time the lists were recorded
+
+	float margin = 25;  // Safety margin (in simulation units) applied to the MAC when recording, also the max allowed displacement before a re-walk
+	int maxReuseSteps = 8;  // Maximum number of steps a recorded set of lists is reused for (K)
+	int stepsSinceWalk = 0;  // Number of steps the current lists have been reused for
+	bool isValid = false;  // Whether the lists currently match the tree held by the owner
+	unsigned int threadCount = 0;  // Threads used by the recording walk and the list evaluation, 0 selects the number of hardware threads
+
+	size_t fullWalks = 0;  // Number of full (recording) tree walks performed, for diagnostics
+	size_t reusedSteps = 0;  // Number of steps served from the cached lists, for diagnostics
+};
+
+
+
+
+
+
+
+
+// ------------- Interaction List Maintenance -------------
+/**
+ * InteractionListsNeedRebuild: Decide whether the cached lists can be reused for this step.
+ *
+ * The lists expire when they have been reused 'maxReuseSteps' times, when the number of bodies changed,
+ * or when any body has moved further than 'margin' from its reference position.
+ *
+ * @param cache  The interaction list cache to test
+ * @param bodies The bodies
+ * @return true if a full re-walk on a freshly built tree is required
+ */
+static inline bool InteractionListsNeedRebuild(InteractionListCache &cache, const BodyStore &bodies);
+
+
+
+/**
+ * InteractionListsCoverPositions: Whether the cached lists are valid for the bodies' current positions.
+ *
+ * Unlike 'InteractionListsNeedRebuild' the reuse count is not considered, so the trial positions of a multi-stage
+ * integrator can be evaluated from the lists recorded at the start of the step.
+ *
+ * @param cache  The interaction list cache to test
+ * @param bodies The bodies
+ * @return true if every body is still within 'margin' of its reference position
+ */
+static inline bool InteractionListsCoverPositions(InteractionListCache &cache, const BodyStore &bodies);
+
+
+
+/**
+ * InvalidateInteractionLists: Mark the cached lists as stale, e.g., after the tree they reference was freed.
+ */
+static inline void InvalidateInteractionLists(InteractionListCache &cache);
+
+
+
+
+
+
+
+
+// ------------- Gravitational Computations -------------
+/**
+ * ComputeAllForcesRecordingInteractions: Full tree walk for every body that also records its interaction list.
+ *
+ * Identical in structure to 'ComputeAllForces', except that the MAC is tightened by the cache's safety
+ * margin and every accepted node is appended to the body's interaction list.
+ *
+ * @param rootNode            Root of the quadtree data structure, built from 'bodies'
+ * @param bodies              The bodies, whose ax and ay receive the accelerations
+ * @param cache               Interaction list cache to fill
+ * @param G                   Universal gravitational constant
+ * @param theta               Barnes-Hut theta parameter for MAC
+ * @param potentials          Receives every body's potential for the energy controller, indexed like 'bodies', nullptr skips them
+ */
+static inline void ComputeAllForcesRecordingInteractions(Quadtree* &rootNode, BodyStore &bodies, InteractionListCache &cache, float G, float theta, std::vector<double>* potentials = nullptr);
+
+
+
+/**
+ * ComputeTreeForceRecordingInteractions: Compute the force on a single body and record every node it interacts with.
+ *
+ * @param rootNode            The current node of the walk.
+ * @param bodies              The bodies the tree was built from.
+ * @param index               Index of the body for which the force is being calculated.
+ * @param bodiesAccelerations The computed acceleration for this body.
+ * @param interactionList     The body's interaction list, accepted nodes are appended to it.
+ * @param G                   The gravitational constant.
+ * @param theta               The Barnes-Hut opening angle.
+ * @param margin              Safety margin subtracted (twice, once for the body and once for the node) from the distance in the MAC.
+ * @param potential           The potential of every interaction is added here, nullptr skips it.
+ */
+static inline void ComputeTreeForceRecordingInteractions(Quadtree* &rootNode, const BodyStore &bodies, size_t index, ofVec2f &bodiesAccelerations, std::vector<Quadtree*> &interactionList, float G, float theta, float margin, double* potential);
+
+
+
+/**
+ * ComputeAllForcesFromInteractionLists: Evaluate every body's force from its cached interaction list.
+ *
+ * No MAC is evaluated, each recorded node is applied directly using its refreshed center of mass
+ * (or, for leaves, the current position of its body).
+ *
+ * @param bodies              The bodies, whose ax and ay receive the accelerations
+ * @param cache               Interaction list cache recorded on the current tree
+ * @param G                   Universal gravitational constant
+ * @param potentials          Receives every body's potential for the energy controller, indexed like 'bodies', nullptr skips them
+ */
+static inline void ComputeAllForcesFromInteractionLists(BodyStore &bodies, InteractionListCache &cache, float G, std::vector<double>* potentials = nullptr);
+
+
+
+/**
+ * EvaluateInteractionLists: Apply every body's cached interaction list, without counting it as a reused step.
+ *
+ * @param bodies              The bodies, whose ax and ay receive the accelerations
+ * @param cache               Interaction list cache recorded on the current tree
+ * @param G                   Universal gravitational constant
+ * @param potentials          Receives every body's potential for the energy controller, indexed like 'bodies', nullptr skips them
+ */
+static inline void EvaluateInteractionLists(BodyStore &bodies, InteractionListCache &cache, float G, std::vector<double>* potentials = nullptr);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline bool InteractionListsNeedRebuild(InteractionListCache &cache, const BodyStore &bodies)
+{
+	return cache.stepsSinceWalk >= cache.maxReuseSteps || !InteractionListsCoverPositions(cache, bodies);
+}
+
+
+static inline bool InteractionListsCoverPositions(InteractionListCache &cache, const BodyStore &bodies)
+{
+	if(!cache.isValid || cache.interactionLists.size() != bodies.size())
+	{
+		return false;
+	}
+
+
+	float marginSquared = cache.margin * cache.margin;
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		ofVec2f displacement = PositionOf(bodies, i) - cache.referencePositions[i];
+		if (displacement.lengthSquared() > marginSquared)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+static inline void InvalidateInteractionLists(InteractionListCache &cache)
+{
+	cache.isValid = false;
+	cache.stepsSinceWalk = 0;
+}
+
+
+
+
+
+
+
+
+static inline void ComputeAllForcesRecordingInteractions(Quadtree* &rootNode, BodyStore &bodies, InteractionListCache &cache, float G, float theta, std::vector<double>* potentials)
+{
+	cache.interactionLists.resize(bodies.size());
+	cache.referencePositions.resize(bodies.size());
+	if (potentials != nullptr)
+	{
+		potentials->assign(bodies.size(), 0.0);
+	}
+
+	ParallelFor(0, bodies.size(), cache.threadCount, [&rootNode, &bodies, &cache, potentials, G, theta](size_t begin, size_t end, unsigned int) // every body only writes its own list
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			cache.interactionLists[i].clear(); // keeps the capacity from the previous walk, so steady state does not allocate
+			cache.referencePositions[i] = PositionOf(bodies, i);
+			ofVec2f acceleration(0, 0);
+			double* potential = (potentials != nullptr) ? &(*potentials)[i] : nullptr;
+			ComputeTreeForceRecordingInteractions(rootNode, bodies, i, acceleration, cache.interactionLists[i], G, theta, cache.margin, potential);
+			AddAcceleration(bodies, i, acceleration);
+		}
+	}, 256);
+
+
+	cache.isValid = true;
+	cache.stepsSinceWalk = 0;
+	cache.fullWalks++;
+}
+
+
+static inline void ComputeTreeForceRecordingInteractions(Quadtree* &rootNode, const BodyStore &bodies, size_t index, ofVec2f &bodiesAccelerations, std::vector<Quadtree*> &interactionList, float G, float theta, float margin, double* potential)
+{
+	ofVec2f position = PositionOf(bodies, index);
+	WalkTree(rootNode, index, [&](Quadtree* cell)
+	{
+		float distance = cell->centerOfMass.distance(position);
+		float size = cell->bounds.width;
+		float guardedDistance = distance - 2 * margin; // worst case separation once both the body and the node's COM have moved by 'margin'
+		if (guardedDistance > 0 && size / guardedDistance < theta) // the MAC holds now and for as long as the lists stay valid
+		{
+			ComputeAccelerationDueTo<float>(position, cell->centerOfMass, cell->totalMass, bodiesAccelerations, G, distance);
+			if (potential != nullptr)
+			{
+				*potential += SoftenedPotential(cell->totalMass, distance, G);
+			}
+			interactionList.push_back(cell);
+			return true;
+		}
+		return false;
+	},
+	[&](Quadtree* leaf)
+	{
+		ofVec2f leafPosition = PositionOf(bodies, leaf->nodeBodyIndex);
+		float dist = leafPosition.distance(position);
+		ComputeAccelerationDueTo<float>(position, leafPosition, bodies.mass[leaf->nodeBodyIndex], bodiesAccelerations, G, dist);
+		if (potential != nullptr)
+		{
+			*potential += SoftenedPotential(bodies.mass[leaf->nodeBodyIndex], dist, G);
+		}
+		interactionList.push_back(leaf);
+	});
+}
+
+
+static inline void ComputeAllForcesFromInteractionLists(BodyStore &bodies, InteractionListCache &cache, float G, std::vector<double>* potentials)
+{
+	EvaluateInteractionLists(bodies, cache, G, potentials);
+	cache.stepsSinceWalk++;
+	cache.reusedSteps++;
+}
+
+
+static inline void EvaluateInteractionLists(BodyStore &bodies, InteractionListCache &cache, float G, std::vector<double>* potentials)
+{
+	if (potentials != nullptr)
+	{
+		potentials->assign(bodies.size(), 0.0);
+	}
+	ParallelFor(0, bodies.size(), cache.threadCount, [&bodies, &cache, potentials, G](size_t begin, size_t end, unsigned int)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			ofVec2f position = PositionOf(bodies, i);
+			ofVec2f acceleration(0, 0);
+			double potential = 0;
+			std::vector<Quadtree*> &interactionList = cache.interactionLists[i];
+			for (size_t j = 0; j < interactionList.size(); j++)
+			{
+				Quadtree* node = interactionList[j];
+				if (node->hasChildren) // accepted cell, use its refreshed center of mass
+				{
+					float distance = node->centerOfMass.distance(position);
+					ComputeAccelerationDueTo<float>(position, node->centerOfMass, node->totalMass, acceleration, G, distance);
+					if (potentials != nullptr)
+					{
+						potential += SoftenedPotential(node->totalMass, distance, G);
+					}
+				}
+				else // leaf, interact directly with the body it holds
+				{
+					ofVec2f leafPosition = PositionOf(bodies, node->nodeBodyIndex);
+					float distance = leafPosition.distance(position);
+					ComputeAccelerationDueTo<float>(position, leafPosition, bodies.mass[node->nodeBodyIndex], acceleration, G, distance);
+					if (potentials != nullptr)
+					{
+						potential += SoftenedPotential(bodies.mass[node->nodeBodyIndex], distance, G);
+					}
+				}
+			}
+			AddAcceleration(bodies, i, acceleration);
+			if (potentials != nullptr)
+			{
+				(*potentials)[i] = potential;
+			}
+		}
+	}, 256);
+}
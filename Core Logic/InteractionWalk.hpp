@@ -0,0 +1,209 @@
+//  InteractionWalk.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * InteractionWalk Module: Barnes-Hut force evaluation as an explicit-stack walk followed by an interaction list
+ *
+ * Description:
+ * The walk-list/interact-list formulation of the tree walk (after A. Brandt's distributed N-body work): instead
+ * of recursing, a body's walk keeps the nodes still to be opened on an explicit stack (the walk list) and appends
+ * every node it accepts, cells by the MAC and leaves, to an interaction list; the force is then a flat loop over
+ * that list. Children are pushed in reverse so nodes are visited, and forces summed, in the order of the recursive
+ * 'ComputeTreeForce', which gives identical accelerations.
+ *
+ * Both lists are scratch, built and dropped for every body, so they are DynamicBufferArrays: the stack of a
+ * quadtree walk is at most about three times the tree depth and the interaction list a few hundred nodes, the
+ * inline buffers cover that without allocating. Longer lists spill into the worker thread's ScratchArena, kept in
+ * a 'TraversalScratch' across steps and rewound after every chunk of bodies, so after warm-up a walk never touches
+ * the heap. The walk functions are templates on the list types, the benchmark runs them on std::vector too.
+ */
+#pragma once
+#include "SequenceContainers.hpp"
+#include "ParallelUtilities.hpp"
+#include "SimulationEntities.hpp"
+#include "Quadtree.hpp"
+#include "PhysicsLogic.hpp"
+#include "CoreTypes.hpp"
+
+
+
+
+typedef DynamicBufferArray<Quadtree*, 64> WalkList;  // Nodes still to be opened, inline for trees up to ~20 levels deep
+typedef DynamicBufferArray<Quadtree*, 512> InteractList;  // Accepted cells and leaves of one walk, ~300 at theta 0.5
+
+
+
+/**
+ * TraversalScratch: Per-thread scratch of the interaction walk, kept by the caller across steps.
+ */
+class TraversalScratch
+{
+public:
+	std::vector<ScratchArena> arenas;  // One per worker thread, indexed by ParallelFor's thread index
+	unsigned int threadCount = 0;  // Worker threads, 0 selects DefaultThreadCount()
+
+	size_t walks = 0;  // Bodies walked, for diagnostics
+	size_t interactions = 0;  // Nodes on their interaction lists, for diagnostics
+};
+
+
+
+
+
+
+
+
+/**
+ * ComputeQuadTreeForce: Calculate the net gravitational forces on all bodies with the interaction walk.
+ *
+ * Same accelerations as 'ComputeAllForces', spread over the scratch's worker threads.
+ *
+ * @param rootNode            Root of the quadtree data structure, built from 'bodies'
+ * @param bodies              The bodies, whose ax and ay the accelerations are added to
+ * @param scratch             Per-thread arenas, grown to the thread count on first use
+ * @param G                   Universal gravitational constant
+ * @param theta               Barnes-Hut theta parameter for MAC
+ */
+static inline void ComputeQuadTreeForce(Quadtree* &rootNode, BodyStore &bodies, TraversalScratch &scratch, float G, float theta);
+
+
+
+/**
+ * TraverseInteractionList: Walk the tree for one body with an explicit stack and collect the nodes it interacts with.
+ *
+ * @param rootNode     Root of the quadtree data structure
+ * @param index        Index of the body the walk is for, its own leaf is skipped
+ * @param position     Position of the body
+ * @param walkList     Empty stack the walk works on, empty again on return
+ * @param interactList Receives the accepted cells and leaves, in the order the recursive walk applies them
+ * @param theta        Barnes-Hut theta parameter for MAC
+ */
+template<typename WalkListType, typename InteractListType>
+static inline void TraverseInteractionList(Quadtree* rootNode, size_t index, const ofVec2f &position, WalkListType &walkList, InteractListType &interactList, float theta);
+
+
+
+/**
+ * ComputeForceInteractionList: Add the acceleration due to every node of an interaction list.
+ *
+ * @param bodies              The bodies the tree was built from, the leaves' positions and masses are read there
+ * @param position            Position of the body the list was collected for
+ * @param bodiesAccelerations The body's acceleration, added to
+ * @param interactList        Cells (their center of mass) and leaves (their body)
+ * @param G                   Universal gravitational constant
+ */
+template<typename InteractListType>
+static inline void ComputeForceInteractionList(const BodyStore &bodies, const ofVec2f &position, ofVec2f &bodiesAccelerations, const InteractListType &interactList, float G);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline void ComputeQuadTreeForce(Quadtree* &rootNode, BodyStore &bodies, TraversalScratch &scratch, float G, float theta)
+{
+	PROFILE_PHASE(ComputeForces);
+	unsigned int threadCount = (scratch.threadCount > 0) ? scratch.threadCount : DefaultThreadCount();
+	if (scratch.arenas.size() < threadCount)
+	{
+		scratch.arenas.resize(threadCount);
+	}
+
+
+	std::vector<size_t> threadInteractions(threadCount, 0);
+	ParallelFor(0, bodies.size(), threadCount, [&rootNode, &bodies, &scratch, &threadInteractions, G, theta](size_t begin, size_t end, unsigned int threadIndex)
+	{
+		ScratchArena &arena = scratch.arenas[threadIndex];
+		{
+			WalkList walkList(&arena);
+			InteractList interactList(&arena);
+			for (size_t i = begin; i < end; i++)
+			{
+				ofVec2f position = PositionOf(bodies, i);
+				interactList.clear();
+				TraverseInteractionList(rootNode, i, position, walkList, interactList, theta);
+				ofVec2f acceleration(0, 0);
+				ComputeForceInteractionList(bodies, position, acceleration, interactList, G);
+				AddAcceleration(bodies, i, acceleration);
+				threadInteractions[threadIndex] += interactList.size();
+			}
+		}
+		arena.reset(); // the lists that spilled into the arena are gone
+	});
+
+
+	scratch.walks += bodies.size();
+	for (size_t interactions : threadInteractions)
+	{
+		scratch.interactions += interactions;
+	}
+}
+
+
+
+template<typename WalkListType, typename InteractListType>
+static inline void TraverseInteractionList(Quadtree* rootNode, size_t index, const ofVec2f &position, WalkListType &walkList, InteractListType &interactList, float theta)
+{
+	if (rootNode == nullptr)
+	{
+		return;
+	}
+
+
+	walkList.push_back(rootNode);
+	while (!walkList.empty())
+	{
+		Quadtree* node = walkList.back();
+		walkList.pop_back();
+
+		if (node->hasChildren)
+		{
+			float distance = node->centerOfMass.distance(position);
+			if (node->bounds.width / distance < theta) // MAC holds, the cell interacts as a whole
+			{
+				interactList.push_back(node);
+				continue;
+			}
+			for (int i = 3; i >= 0; i--) // reversed, so children 0..3 are popped in order
+			{
+				if (node->children[i] != nullptr)
+				{
+					walkList.push_back(node->children[i]);
+				}
+			}
+		}
+		else if (node->nodeBodyIndex != SIZE_MAX && node->nodeBodyIndex != index)
+		{
+			interactList.push_back(node);
+		}
+	}
+}
+
+
+
+template<typename InteractListType>
+static inline void ComputeForceInteractionList(const BodyStore &bodies, const ofVec2f &position, ofVec2f &bodiesAccelerations, const InteractListType &interactList, float G)
+{
+	for (size_t j = 0; j < interactList.size(); j++)
+	{
+		Quadtree* node = interactList[j];
+		if (node->hasChildren)
+		{
+			float distance = node->centerOfMass.distance(position);
+			ComputeAccelerationDueTo<float>(position, node->centerOfMass, node->totalMass, bodiesAccelerations, G, distance);
+		}
+		else
+		{
+			ofVec2f leafPosition = PositionOf(bodies, node->nodeBodyIndex);
+			float distance = leafPosition.distance(position);
+			ComputeAccelerationDueTo<float>(position, leafPosition, bodies.mass[node->nodeBodyIndex], bodiesAccelerations, G, distance);
+		}
+	}
+}
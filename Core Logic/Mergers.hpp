@@ -0,0 +1,286 @@
+//  Mergers.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * Mergers Module: Merging (accretion) of bodies that come too close, shrinking N over time
+ *
+ * Description:
+ * In collapse scenarios many bodies pile up at the centres, where they cost the most per step (deep trees, many
+ * near-field pairs). With mergers on, two bodies closer than a mass-dependent merge radius,
+ * 			r_merge = mergeRadiusScale * (m_a + m_b)    (mass doubles as radius, so 1 means "touching")
+ * are replaced by a single body that conserves their mass and momentum:
+ * 			m = m_a + m_b,   x = (m_a x_a + m_b x_b) / m,   v = (m_a v_a + m_b v_b) / m,   a = (m_a a_a + m_b a_b) / m
+ *
+ * Detection costs nothing extra, the leaf branch of the gravity walk already computes the distance of every
+ * near pair, so the walk below simply records the pairs within the merge radius as it goes. It can also sum every
+ * body's potential on the way, so the adaptive step's energy-error control keeps working with mergers on.
+ *
+ * The walk records both bodies' indices in 'bodies' (the leaf's 'nodeBodyIndex'), so merging needs no lookup over
+ * all N bodies. The pairs are merged in place first, then the absorbed bodies are removed with 'RemoveBodyAt' from the
+ * highest index down: the last body moves into the freed index of every array of the store (its acceleration with it),
+ * the cold body data and the handle table alike, and since it always comes from above every index still to be removed, the recorded indices
+ * stay valid throughout. Removal is O(1), the arrays stay dense and handles to the survivors stay valid.
+ * A body takes part in at most one merger per step, chains of mergers simply complete over the next steps.
+ */
+#pragma once
+#include <unordered_set>
+#include <functional>
+#include <algorithm>
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "BodyHandles.hpp"
+#include "BodyDataTable.hpp"
+#include "Quadtree.hpp"
+#include "PhysicsLogic.hpp"
+#include "ParallelUtilities.hpp"
+#include "ofMain.h"
+
+
+
+
+/**
+ * MergerCandidate: A pair of bodies found within the merge radius during the force walk.
+ */
+class MergerCandidate
+{
+public:
+	size_t indexA; // Index of the body whose walk found the pair
+	size_t indexB; // Index of the leaf body found within the merge radius
+	float distance; // Their separation
+};
+
+
+
+/**
+ * BodyMergers: Settings, per-step candidates, and totals of the merger rule.
+ */
+class BodyMergers
+{
+public:
+	// ------------- Configuration -------------
+	float mergeRadiusScale = 0.5;  // Merge radius in units of (m_a + m_b), 1 merges bodies as soon as they touch
+	unsigned int threadCount = 0;  // Threads used by the force walk, 0 selects the number of hardware threads
+
+
+	// ------------- Per-Step State -------------
+	std::vector<std::vector<MergerCandidate>> threadCandidates;  // Pairs found by each worker thread during the walk
+	std::vector<MergerCandidate> candidates;  // All pairs found this step, closest first once merged
+	std::unordered_set<size_t> mergedIndices;  // Indices of the bodies already merged this step
+	std::vector<size_t> absorbedIndices;  // Indices of the bodies to remove, highest first once merged
+
+
+	// ------------- Totals -------------
+	size_t totalMerged = 0;  // Number of bodies absorbed since the start, for diagnostics
+};
+
+
+
+
+
+
+
+
+// ------------- Detection -------------
+/**
+ * ComputeAllForcesDetectingMergers: 'ComputeAllForces', additionally recording the pairs within the merge radius.
+ *
+ * @param rootNode            Root of the quadtree data structure, built from 'bodies'
+ * @param bodies              The bodies, whose ax and ay receive the accelerations
+ * @param mergers             The merger state, receives the candidate pairs
+ * @param G                   Universal gravitational constant
+ * @param theta               Barnes-Hut theta parameter for MAC
+ * @param potentials          Receives every body's potential for the energy controller, indexed like 'bodies', nullptr skips them
+ */
+static inline void ComputeAllForcesDetectingMergers(Quadtree* &rootNode, BodyStore &bodies, BodyMergers &mergers, float G, float theta, std::vector<double>* potentials = nullptr);
+
+
+
+/**
+ * ComputeTreeForceDetectingMergers: 'ComputeTreeForce' for one body, recording leaf bodies within the merge radius.
+ *
+ * @param rootNode            The current node of the walk.
+ * @param bodies              The bodies the tree was built from.
+ * @param index               Index of the body the force is calculated for, pairs are recorded from the body with the lower index.
+ * @param bodiesAccelerations The computed acceleration for this body.
+ * @param candidates          Pairs within the merge radius are appended here.
+ * @param mergeRadiusScale    Merge radius in units of the summed masses.
+ * @param G                   The gravitational constant.
+ * @param theta               The Barnes-Hut opening angle.
+ * @param potential           The potential of every interaction is added here, nullptr skips it.
+ */
+static inline void ComputeTreeForceDetectingMergers(Quadtree* &rootNode, const BodyStore &bodies, size_t index, ofVec2f &bodiesAccelerations, std::vector<MergerCandidate> &candidates, float mergeRadiusScale, float G, float theta, double* potential);
+
+
+
+
+
+
+
+
+// ------------- Merging -------------
+/**
+ * ApplyMergers: Merge the recorded pairs and remove the absorbed bodies, compacting every per-body array.
+ *
+ * Everything that refers to bodies by index (the tree, cached lists) is stale afterwards if anything merged.
+ *
+ * @param bodies              The bodies, with the accelerations (ax, ay) of this step
+ * @param bodyHandles         Handle table of the bodies, the absorbed bodies' handles become invalid
+ * @param bodyData            Cold per-body data, compacted alongside 'bodies' while any of it is kept
+ * @param mergers             The merger state holding this step's candidates
+ * @return The number of bodies absorbed this step
+ */
+static inline size_t ApplyMergers(BodyStore &bodies, BodyHandleTable &bodyHandles, BodyDataTable &bodyData, BodyMergers &mergers);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline void ComputeAllForcesDetectingMergers(Quadtree* &rootNode, BodyStore &bodies, BodyMergers &mergers, float G, float theta, std::vector<double>* potentials)
+{
+	unsigned int threadCount = (mergers.threadCount > 0) ? mergers.threadCount : DefaultThreadCount();
+	mergers.threadCandidates.resize(threadCount);
+	for (auto &found : mergers.threadCandidates)
+	{
+		found.clear();
+	}
+	if (potentials != nullptr)
+	{
+		potentials->assign(bodies.size(), 0.0);
+	}
+
+	ParallelFor(0, bodies.size(), threadCount, [&rootNode, &bodies, &mergers, potentials, G, theta](size_t begin, size_t end, unsigned int threadIndex)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			ofVec2f acceleration(0, 0);
+			double* potential = (potentials != nullptr) ? &(*potentials)[i] : nullptr;
+			ComputeTreeForceDetectingMergers(rootNode, bodies, i, acceleration, mergers.threadCandidates[threadIndex], mergers.mergeRadiusScale, G, theta, potential);
+			AddAcceleration(bodies, i, acceleration);
+		}
+	}, 256);
+
+
+	mergers.candidates.clear();
+	for (auto &found : mergers.threadCandidates)
+	{
+		mergers.candidates.insert(mergers.candidates.end(), found.begin(), found.end());
+	}
+}
+
+
+
+static inline void ComputeTreeForceDetectingMergers(Quadtree* &rootNode, const BodyStore &bodies, size_t index, ofVec2f &bodiesAccelerations, std::vector<MergerCandidate> &candidates, float mergeRadiusScale, float G, float theta, double* potential)
+{
+	ofVec2f position = PositionOf(bodies, index);
+	WalkTree(rootNode, index, [&](Quadtree* cell)
+	{
+		float distance = cell->centerOfMass.distance(position);
+		float size = cell->bounds.width;
+		if (size / distance < theta)
+		{
+			ComputeAccelerationDueTo<float>(position, cell->centerOfMass, cell->totalMass, bodiesAccelerations, G, distance);
+			if (potential != nullptr)
+			{
+				*potential += SoftenedPotential(cell->totalMass, distance, G);
+			}
+			return true;
+		}
+		return false;
+	},
+	[&](Quadtree* leaf)
+	{
+		size_t other = leaf->nodeBodyIndex;
+		ofVec2f otherPosition = PositionOf(bodies, other);
+		float dist = otherPosition.distance(position);
+		ComputeAccelerationDueTo<float>(position, otherPosition, bodies.mass[other], bodiesAccelerations, G, dist);
+		if (potential != nullptr)
+		{
+			*potential += SoftenedPotential(bodies.mass[other], dist, G);
+		}
+
+		if (other > index && dist < mergeRadiusScale * (bodies.mass[index] + bodies.mass[other])) // the pair is seen from both sides, record it once
+		{
+			candidates.push_back({index, other, dist});
+		}
+	});
+}
+
+
+
+
+
+
+
+
+static inline size_t ApplyMergers(BodyStore &bodies, BodyHandleTable &bodyHandles, BodyDataTable &bodyData, BodyMergers &mergers)
+{
+	if (mergers.candidates.empty())
+	{
+		return 0;
+	}
+
+
+	// Closest pairs merge first, ties broken by the bodies' indices so the result doesn't depend on the thread count
+	std::sort(mergers.candidates.begin(), mergers.candidates.end(), [](const MergerCandidate &a, const MergerCandidate &b)
+	{
+		if (a.distance != b.distance)
+		{
+			return a.distance < b.distance;
+		}
+		return (a.indexA != b.indexA) ? a.indexA < b.indexA : a.indexB < b.indexB;
+	});
+
+
+	// Merge in place first, nothing moves until every pair is decided
+	mergers.mergedIndices.clear();
+	mergers.absorbedIndices.clear();
+	for (const MergerCandidate &candidate : mergers.candidates)
+	{
+		if (mergers.mergedIndices.count(candidate.indexA) > 0 || mergers.mergedIndices.count(candidate.indexB) > 0)
+		{
+			continue; // one of them already merged this step
+		}
+		mergers.mergedIndices.insert(candidate.indexA);
+		mergers.mergedIndices.insert(candidate.indexB);
+
+		size_t survivor = candidate.indexA, absorbed = candidate.indexB;
+		if (bodies.mass[absorbed] > bodies.mass[survivor])
+		{
+			std::swap(survivor, absorbed); // the heavier body survives
+		}
+
+
+		// Conserve mass and momentum, and keep this step's acceleration consistent with the combined body
+		float survivorMass = bodies.mass[survivor], absorbedMass = bodies.mass[absorbed];
+		float mass = survivorMass + absorbedMass;
+		SetPosition(bodies, survivor, (PositionOf(bodies, survivor) * survivorMass + PositionOf(bodies, absorbed) * absorbedMass) / mass);
+		SetVelocity(bodies, survivor, (VelocityOf(bodies, survivor) * survivorMass + VelocityOf(bodies, absorbed) * absorbedMass) / mass);
+		bodies.ax[survivor] = (bodies.ax[survivor] * survivorMass + bodies.ax[absorbed] * absorbedMass) / mass;
+		bodies.ay[survivor] = (bodies.ay[survivor] * survivorMass + bodies.ay[absorbed] * absorbedMass) / mass;
+		bodies.mass[survivor] = mass;
+		mergers.absorbedIndices.push_back(absorbed);
+	}
+
+
+	// O(1) removals from the highest index down, the last body (and its acceleration and handle) moves into the freed
+	// slot, and it always comes from above the indices still to be removed, so those stay valid
+	std::sort(mergers.absorbedIndices.begin(), mergers.absorbedIndices.end(), std::greater<size_t>());
+	for (size_t absorbedIndex : mergers.absorbedIndices)
+	{
+		RemoveBodyAt(bodies, bodyHandles, absorbedIndex, bodyData);
+	}
+	size_t merged = mergers.absorbedIndices.size();
+
+
+	mergers.candidates.clear();
+	mergers.totalMerged += merged;
+	return merged;
+}
@@ -0,0 +1,322 @@
+//  MultiRateForces.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * MultiRateForces Module: Far-field accelerations reused across steps, near-field recomputed every step
+ *
+ * Description:
+ * The acceleration of a body from a tree walk naturally splits in two parts:
+ * 			- far field, the contributions of the cells accepted by the MAC, which vary slowly because they are
+ * 			  summaries of many distant bodies
+ * 			- near field, the direct body-body contributions from the leaf branch of 'ComputeTreeForce', which vary
+ * 			  quickly since the bodies involved are close to each other
+ *
+ * This module walks the tree only on refresh steps, storing the far-field acceleration of every body together
+ * with the list of bodies that made up its near field. On the steps in between, no tree is built or walked at all,
+ * each body's acceleration is its cached far field plus its near field recomputed directly against the current
+ * positions of its recorded neighbours. A refresh happens every 'refreshInterval' steps, or sooner if any body has
+ * moved further than 'displacementThreshold' since the last refresh.
+ *
+ * Since the far field is held fixed between refreshes the result is an approximation, so the module periodically
+ * measures its error relative to a full recomputation on a fresh tree, see 'MeasureMultiRateError'.
+ */
+#pragma once
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "Quadtree.hpp"
+#include "PhysicsLogic.hpp"
+#include "ParallelUtilities.hpp"
+#include "ofMain.h"
+
+
+
+
+/**
+ * MultiRateFarField: Cached far-field accelerations, near-field neighbour lists, and refresh bookkeeping.
+ */
+class MultiRateFarField
+{
+public:
+	// ------------- Member variables -------------
+	std::vector<ofVec2f> farAccelerations; // Far-field (accepted cells) acceleration of each body as of the last refresh
+	std::vector<std::vector<BodyIndex>> nearLists; // Indices of the bodies in each body's near field (leaf branch of the walk) as of the last refresh
+	std::vector<ofVec2f> referencePositions; // Positions of the bodies at the last refresh
+
+	int refreshInterval = 4;  // Refresh the far field every M steps
+	float displacementThreshold = 50;  // Refresh early if any body moved further than this since the last refresh
+	int errorSampleInterval = 60;  // Measure the error against a full recomputation every this many steps, 0 disables
+
+	int stepsSinceRefresh = 0;  // Steps served from the cached far field since the last refresh
+	int stepsSinceErrorSample = 0;  // Steps since the last error measurement
+	bool isValid = false;  // Whether the cached far field matches the current set of bodies
+	unsigned int threadCount = 0;  // Threads used by the refresh walk and the near-field pass, 0 selects the number of hardware threads
+	float lastRelativeError = 0;  // Last measured sum|a - a_full| / sum|a_full|
+
+	size_t refreshes = 0;  // Number of refresh (full walk) steps, for diagnostics
+	size_t nearOnlySteps = 0;  // Number of steps that only recomputed the near field, for diagnostics
+};
+
+
+
+
+
+
+
+
+// ------------- Refresh Control -------------
+/**
+ * MultiRateNeedsRefresh: Decide whether the far field has to be recomputed on this step.
+ *
+ * @param multiRate The multi-rate state
+ * @param bodies    The bodies
+ * @return true if a refresh (tree build and split walk) is required
+ */
+static inline bool MultiRateNeedsRefresh(MultiRateFarField &multiRate, const BodyStore &bodies);
+
+
+
+/**
+ * MultiRateCoversPositions: Whether the cached far field still applies at the bodies' current positions.
+ *
+ * Unlike 'MultiRateNeedsRefresh' the refresh interval is not considered, so the trial positions of a multi-stage
+ * integrator can be served from the far field cached at the start of the step.
+ *
+ * @param multiRate The multi-rate state
+ * @param bodies    The bodies
+ * @return true if every body is still within 'displacementThreshold' of its reference position
+ */
+static inline bool MultiRateCoversPositions(MultiRateFarField &multiRate, const BodyStore &bodies);
+
+
+
+
+
+
+
+
+// ------------- Gravitational Computations -------------
+/**
+ * ComputeAllForcesMultiRateRefresh: Full split walk, caching the far field and the near-field neighbour lists.
+ *
+ * The accelerations added to ax and ay are exactly those of 'ComputeAllForces'.
+ *
+ * @param rootNode            Root of the quadtree data structure, built from 'bodies'
+ * @param bodies              The bodies, whose ax and ay receive the accelerations
+ * @param multiRate           Multi-rate state to refresh
+ * @param G                   Universal gravitational constant
+ * @param theta               Barnes-Hut theta parameter for MAC
+ */
+static inline void ComputeAllForcesMultiRateRefresh(Quadtree* &rootNode, BodyStore &bodies, MultiRateFarField &multiRate, float G, float theta);
+
+
+
+/**
+ * ComputeTreeForceSplit: Compute the near and far parts of the force on a single body.
+ *
+ * @param rootNode        The current node of the walk.
+ * @param bodies          The bodies the tree was built from.
+ * @param index           Index of the body for which the force is being calculated.
+ * @param nearAcceleration Accumulates the direct body-body (leaf) contributions.
+ * @param farAcceleration  Accumulates the accepted cell contributions.
+ * @param nearList        The indices of the bodies contributing to the near field are appended here.
+ * @param G               The gravitational constant.
+ * @param theta           The Barnes-Hut opening angle.
+ */
+static inline void ComputeTreeForceSplit(Quadtree* &rootNode, const BodyStore &bodies, size_t index, ofVec2f &nearAcceleration, ofVec2f &farAcceleration, std::vector<BodyIndex> &nearList, float G, float theta);
+
+
+
+/**
+ * ComputeAllForcesMultiRateNear: Cached far field plus a direct near-field recomputation, no tree needed.
+ *
+ * @param bodies              The bodies, whose ax and ay receive the accelerations
+ * @param multiRate           Multi-rate state holding the cached far field
+ * @param G                   Universal gravitational constant
+ */
+static inline void ComputeAllForcesMultiRateNear(BodyStore &bodies, MultiRateFarField &multiRate, float G);
+
+
+
+/**
+ * EvaluateMultiRateForces: Cached far field plus the near field at the current positions, without counting a step.
+ *
+ * @param bodies              The bodies, whose ax and ay receive the accelerations
+ * @param multiRate           Multi-rate state holding the cached far field
+ * @param G                   Universal gravitational constant
+ */
+static inline void EvaluateMultiRateForces(BodyStore &bodies, MultiRateFarField &multiRate, float G);
+
+
+
+/**
+ * MeasureMultiRateError: Compare the multi-rate accelerations of this step to a full recomputation.
+ *
+ * Builds a separate, temporary tree so the caller's tree (and anything pointing into it) is left untouched.
+ * The result, sum|a - a_full| / sum|a_full| over all bodies, is stored in 'lastRelativeError' and returned.
+ *
+ * @param bodies              The bodies, with the multi-rate accelerations (ax, ay) computed for this step
+ * @param multiRate           Multi-rate state
+ * @param G                   Universal gravitational constant
+ * @param theta               Barnes-Hut theta parameter for MAC
+ */
+static inline float MeasureMultiRateError(const BodyStore &bodies, MultiRateFarField &multiRate, float G, float theta);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline bool MultiRateNeedsRefresh(MultiRateFarField &multiRate, const BodyStore &bodies)
+{
+	return multiRate.stepsSinceRefresh >= multiRate.refreshInterval || !MultiRateCoversPositions(multiRate, bodies);
+}
+
+
+static inline bool MultiRateCoversPositions(MultiRateFarField &multiRate, const BodyStore &bodies)
+{
+	if(!multiRate.isValid || multiRate.farAccelerations.size() != bodies.size())
+	{
+		return false;
+	}
+
+
+	float thresholdSquared = multiRate.displacementThreshold * multiRate.displacementThreshold;
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		if ((PositionOf(bodies, i) - multiRate.referencePositions[i]).lengthSquared() > thresholdSquared)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+
+
+
+
+
+static inline void ComputeAllForcesMultiRateRefresh(Quadtree* &rootNode, BodyStore &bodies, MultiRateFarField &multiRate, float G, float theta)
+{
+	multiRate.farAccelerations.resize(bodies.size());
+	multiRate.nearLists.resize(bodies.size());
+	multiRate.referencePositions.resize(bodies.size());
+
+	ParallelFor(0, bodies.size(), multiRate.threadCount, [&rootNode, &bodies, &multiRate, G, theta](size_t begin, size_t end, unsigned int) // every body only writes its own entries
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			ofVec2f nearAcceleration(0, 0);
+			ofVec2f farAcceleration(0, 0);
+			multiRate.nearLists[i].clear();
+
+			ComputeTreeForceSplit(rootNode, bodies, i, nearAcceleration, farAcceleration, multiRate.nearLists[i], G, theta);
+
+			multiRate.farAccelerations[i] = farAcceleration;
+			multiRate.referencePositions[i] = PositionOf(bodies, i);
+			AddAcceleration(bodies, i, nearAcceleration + farAcceleration);
+		}
+	}, 256);
+
+
+	multiRate.isValid = true;
+	multiRate.stepsSinceRefresh = 0;
+	multiRate.refreshes++;
+}
+
+
+static inline void ComputeTreeForceSplit(Quadtree* &rootNode, const BodyStore &bodies, size_t index, ofVec2f &nearAcceleration, ofVec2f &farAcceleration, std::vector<BodyIndex> &nearList, float G, float theta)
+{
+	ofVec2f position = PositionOf(bodies, index);
+	WalkTree(rootNode, index, [&](Quadtree* cell)
+	{
+		float distance = cell->centerOfMass.distance(position);
+		float size = cell->bounds.width;
+		if (size / distance < theta) // far field, slowly varying
+		{
+			ComputeAccelerationDueTo<float>(position, cell->centerOfMass, cell->totalMass, farAcceleration, G, distance);
+			return true;
+		}
+		return false;
+	},
+	[&](Quadtree* leaf) // near field, direct body-body interaction
+	{
+		ofVec2f leafPosition = PositionOf(bodies, leaf->nodeBodyIndex);
+		float dist = leafPosition.distance(position);
+		ComputeAccelerationDueTo<float>(position, leafPosition, bodies.mass[leaf->nodeBodyIndex], nearAcceleration, G, dist);
+		nearList.push_back((BodyIndex)leaf->nodeBodyIndex);
+	});
+}
+
+
+static inline void ComputeAllForcesMultiRateNear(BodyStore &bodies, MultiRateFarField &multiRate, float G)
+{
+	EvaluateMultiRateForces(bodies, multiRate, G);
+	multiRate.stepsSinceRefresh++;
+	multiRate.nearOnlySteps++;
+}
+
+
+static inline void EvaluateMultiRateForces(BodyStore &bodies, MultiRateFarField &multiRate, float G)
+{
+	ParallelFor(0, bodies.size(), multiRate.threadCount, [&bodies, &multiRate, G](size_t begin, size_t end, unsigned int)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			ofVec2f position = PositionOf(bodies, i);
+			ofVec2f nearAcceleration(0, 0);
+			std::vector<BodyIndex> &nearList = multiRate.nearLists[i];
+			for (size_t j = 0; j < nearList.size(); j++)
+			{
+				ofVec2f otherPosition = PositionOf(bodies, nearList[j]);
+				float dist = otherPosition.distance(position);
+				ComputeAccelerationDueTo<float>(position, otherPosition, bodies.mass[nearList[j]], nearAcceleration, G, dist);
+			}
+
+			AddAcceleration(bodies, i, nearAcceleration + multiRate.farAccelerations[i]);
+		}
+	}, 256);
+}
+
+
+
+
+
+
+
+
+static inline float MeasureMultiRateError(const BodyStore &bodies, MultiRateFarField &multiRate, float G, float theta)
+{
+	Quadtree* referenceTree = nullptr;
+	BodyStore reference = bodies; // same positions, own accelerations
+	ClearAccelerations(reference);
+
+	BuildQuadtree(referenceTree, reference);
+	ComputeAllForces(referenceTree, reference, G, theta, multiRate.threadCount);
+
+
+	double errorSum = 0;
+	double referenceSum = 0;
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		ofVec2f referenceAcceleration = AccelerationOf(reference, i);
+		errorSum += (AccelerationOf(bodies, i) - referenceAcceleration).length();
+		referenceSum += referenceAcceleration.length();
+	}
+
+
+	delete referenceTree;
+
+	multiRate.lastRelativeError = (referenceSum > 0) ? errorSum / referenceSum : 0;
+	multiRate.stepsSinceErrorSample = 0;
+	return multiRate.lastRelativeError;
+}
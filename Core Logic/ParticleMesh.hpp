@@ -0,0 +1,579 @@
+//  ParticleMesh.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * ParticleMesh Module: Particle-mesh (PM) and TreePM gravity for very large numbers of bodies
+ *
+ * Description:
+ * Instead of walking a tree for every body, the particle-mesh method works on a regular grid:
+ * 			1. mass assignment, every body's mass is spread over the four nearest grid nodes with cloud-in-cell (CIC) weights
+ * 			2. field solve, the acceleration field on the grid is the convolution of the mass grid with the gravitational
+ * 			   kernel, done with FFTs on a grid padded to twice the size so the bodies don't feel periodic images
+ * 			   (Hockney's method for isolated systems)
+ * 			3. interpolation, the field is read back at every body with the same CIC weights
+ * The cost is O(N) for steps 1 and 3 plus O(G^2 log G) for step 2, independent of how the bodies are clustered.
+ *
+ * The kernel is the same softened point-mass law as 'ComputeAccelerationDueTo', sampled on the grid, so pure PM
+ * agrees with the tree for separations of several cells and smooths out everything closer than that.
+ *
+ * TreePM recovers the short range: the kernel is split with the usual Gaussian split of scale r_s,
+ * 			- long range, the force multiplied by (1 - f_s(r)), solved on the grid (smooth, so the grid resolves it)
+ * 			- short range, the force multiplied by f_s(r) = erfc(r / 2r_s) + r / (r_s sqrt(pi)) exp(-r^2 / 4r_s^2),
+ * 			  summed with a walk of the existing 'Quadtree' that skips every node further than the cutoff
+ * The two parts add back up to the full force.
+ *
+ * The FFTs of the kernel only depend on the grid size, the cell size and the split, they are cached and rebuilt only
+ * when one of those changes. The cell size follows the extent of the bodies but is snapped to a geometric ladder
+ * (four steps per doubling) so it stays the same from frame to frame.
+ */
+#pragma once
+#include <complex>
+#include <cmath>
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "Quadtree.hpp"
+#include "PhysicsLogic.hpp"
+#include "FFT.hpp"
+#include "ParallelUtilities.hpp"
+#include "ofMain.h"
+
+
+
+
+/**
+ * ParticleMeshSolver: Grid configuration, cached kernel transforms, and the scratch grids of the PM solve.
+ */
+class ParticleMeshSolver
+{
+public:
+	// ------------- Configuration -------------
+	int gridSize = 256;  // Number of grid nodes along each side of the mass grid, must be a power of two
+	float splitScale = 1.25;  // TreePM split scale r_s, in grid cells
+	float cutoffScale = 4.5;  // TreePM short-range cutoff, in units of r_s (f_s is below 1e-3 beyond 4.5 r_s)
+	float padding = 0.05;  // Fraction of the bodies' extent left empty around them on each side
+	unsigned int threadCount = 0;  // Threads used by every stage, 0 selects the number of hardware threads
+
+
+	// ------------- Grid Placement (updated every solve) -------------
+	ofVec2f origin;  // World position of grid node (0, 0)
+	float cellSize = 0;  // World distance between two neighbouring grid nodes
+
+
+	// ------------- Grids -------------
+	std::vector<float> density;  // Mass per grid node, gridSize x gridSize
+	std::vector<std::vector<float>> threadDensity;  // Private mass grids of the worker threads, summed into 'density'
+	std::vector<std::complex<float>> kernelX, kernelY;  // Transformed kernel components, (2 gridSize)^2
+	std::vector<std::complex<float>> fieldX, fieldY;  // Transformed density times kernel, then the field after the inverse transform
+	std::vector<float> accelerationX, accelerationY;  // Acceleration per unit G on the mass grid, gridSize x gridSize
+
+
+	// ------------- Kernel Cache -------------
+	int kernelGridSize = 0;  // Grid size the cached kernel was built for
+	float kernelCellSize = 0;  // Cell size the cached kernel was built for
+	float kernelSplitScale = 0;  // Split scale the cached kernel was built for, 0 for the unsplit (pure PM) kernel
+	size_t kernelRebuilds = 0;  // Number of times the kernel transforms were recomputed, for diagnostics
+
+
+	// ------------- Short-Range Factor Table -------------
+	std::vector<float> shortRangeTable;  // f_s sampled uniformly from 0 to the cutoff, erfc and exp are far too slow for the inner loop of the walk
+	float shortRangeCutoff = 0;  // Cutoff (world units) the table was built for
+	float shortRangeTableScale = 0;  // Table samples per world unit
+	float tableSplitScale = 0;  // Split scale (world units) the table was built for
+};
+
+
+
+
+
+
+
+
+// ------------- Grid Setup -------------
+/**
+ * PlaceParticleMeshGrid: Fit the grid over the current bounding box of the bodies.
+ *
+ * @param particleMesh The solver state
+ * @param bodies       The bodies
+ */
+static inline void PlaceParticleMeshGrid(ParticleMeshSolver &particleMesh, const BodyStore &bodies);
+
+
+
+/**
+ * BuildParticleMeshKernel: Sample the (optionally long-range) kernel on the padded grid and transform it.
+ *
+ * Does nothing if the cached kernel already matches the grid size, cell size and split.
+ *
+ * @param particleMesh The solver state
+ * @param split        Whether to build the long-range TreePM kernel rather than the full one
+ */
+static inline void BuildParticleMeshKernel(ParticleMeshSolver &particleMesh, bool split);
+
+
+
+/**
+ * ParticleMeshSplitScale: The TreePM split scale r_s in world units for the current grid placement.
+ *
+ * Never less than the softening length, the softened force law has a kink at 'epsilon' that
+ * the grid cannot resolve, so it has to stay entirely in the short-range (tree) part.
+ */
+static inline float ParticleMeshSplitScale(ParticleMeshSolver &particleMesh);
+
+
+
+/**
+ * ShortRangeForceFactor: Fraction f_s(r) of the force that the TreePM short-range part accounts for.
+ *
+ * @param distance   Separation of the two masses
+ * @param splitScale Split scale r_s in world units
+ */
+static inline float ShortRangeForceFactor(float distance, float splitScale);
+
+
+
+/**
+ * BuildShortRangeForceTable: Tabulate 'ShortRangeForceFactor' up to the cutoff, unless the table is already current.
+ */
+static inline void BuildShortRangeForceTable(ParticleMeshSolver &particleMesh);
+
+
+
+/**
+ * LookupShortRangeForceFactor: Linearly interpolated f_s(distance) from the table, 0 beyond the cutoff.
+ */
+static inline float LookupShortRangeForceFactor(const ParticleMeshSolver &particleMesh, float distance);
+
+
+
+
+
+
+
+
+// ------------- Particle-Mesh Stages -------------
+/**
+ * AssignMassCloudInCell: Spread every body's mass over its four nearest grid nodes.
+ */
+static inline void AssignMassCloudInCell(ParticleMeshSolver &particleMesh, const BodyStore &bodies);
+
+
+
+/**
+ * SolveParticleMeshField: Convolve the mass grid with the kernel, leaving the field in 'accelerationX/Y'.
+ */
+static inline void SolveParticleMeshField(ParticleMeshSolver &particleMesh);
+
+
+
+/**
+ * InterpolateParticleMeshAccelerations: Read the field back at every body with CIC weights and add it to its acceleration.
+ */
+static inline void InterpolateParticleMeshAccelerations(ParticleMeshSolver &particleMesh, BodyStore &bodies, float G);
+
+
+
+
+
+
+
+
+// ------------- Gravitational Computations -------------
+/**
+ * ComputeAllForcesParticleMesh: Pure particle-mesh gravity, no tree involved.
+ *
+ * @param bodies              The bodies, whose ax and ay receive the accelerations
+ * @param particleMesh        The solver state
+ * @param G                   Universal gravitational constant
+ */
+static inline void ComputeAllForcesParticleMesh(BodyStore &bodies, ParticleMeshSolver &particleMesh, float G);
+
+
+
+/**
+ * ComputeAllForcesTreePM: Long range from the grid, short range from a cut-off walk of the quadtree.
+ *
+ * @param rootNode            Root of the quadtree data structure, built over the current positions
+ * @param bodies              The bodies, whose ax and ay receive the accelerations
+ * @param particleMesh        The solver state
+ * @param G                   Universal gravitational constant
+ * @param theta               Barnes-Hut theta parameter for MAC, used by the short-range walk
+ */
+static inline void ComputeAllForcesTreePM(Quadtree* &rootNode, BodyStore &bodies, ParticleMeshSolver &particleMesh, float G, float theta);
+
+
+
+/**
+ * ComputeTreeForceShortRange: Short-range part of the force on a single body.
+ *
+ * Identical to 'ComputeTreeForce' except that nodes whose bounds are further than 'cutoff' are skipped and every
+ * contribution is weighted by the tabulated 'ShortRangeForceFactor'.
+ *
+ * @param rootNode            The current node of the walk.
+ * @param bodies              The bodies the tree was built from.
+ * @param index               Index of the body for which the force is being calculated.
+ * @param bodiesAccelerations The computed acceleration for this body.
+ * @param G                   The gravitational constant.
+ * @param theta               The Barnes-Hut opening angle.
+ * @param particleMesh        The solver state, holding the short-range factor table and cutoff.
+ */
+static inline void ComputeTreeForceShortRange(Quadtree* &rootNode, const BodyStore &bodies, size_t index, ofVec2f &bodiesAccelerations, const ParticleMeshSolver &particleMesh, float G, float theta);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline void PlaceParticleMeshGrid(ParticleMeshSolver &particleMesh, const BodyStore &bodies)
+{
+	ofVec2f minimum(0, 0), maximum(0, 0);
+	if (!bodies.empty())
+	{
+		minimum = maximum = PositionOf(bodies, 0);
+	}
+	for (size_t i = 1; i < bodies.size(); i++)
+	{
+		minimum.x = std::min(minimum.x, bodies.x[i]);
+		minimum.y = std::min(minimum.y, bodies.y[i]);
+		maximum.x = std::max(maximum.x, bodies.x[i]);
+		maximum.y = std::max(maximum.y, bodies.y[i]);
+	}
+
+
+	float extent = std::max(std::max(maximum.x - minimum.x, maximum.y - minimum.y), 1.0f) * (1 + 2 * particleMesh.padding);
+	float rawCellSize = extent / (particleMesh.gridSize - 1);
+	float cellSize = std::exp2(std::ceil(4 * std::log2(rawCellSize)) / 4); // snap to the ladder so the cached kernel survives small changes of extent
+
+	particleMesh.cellSize = cellSize;
+	particleMesh.origin = (minimum + maximum) * 0.5 - ofVec2f(cellSize, cellSize) * ((particleMesh.gridSize - 1) * 0.5f);
+}
+
+
+
+static inline void BuildParticleMeshKernel(ParticleMeshSolver &particleMesh, bool split)
+{
+	int n = particleMesh.gridSize;
+	float h = particleMesh.cellSize;
+	float splitScale = split ? ParticleMeshSplitScale(particleMesh) : 0;
+	if (particleMesh.kernelGridSize == n && particleMesh.kernelCellSize == h && particleMesh.kernelSplitScale == splitScale)
+	{
+		return;
+	}
+
+
+	size_t m = 2 * n; // padded size, twice the grid so the convolution is not periodic over the bodies
+	particleMesh.kernelX.assign(m * m, std::complex<float>(0, 0));
+	particleMesh.kernelY.assign(m * m, std::complex<float>(0, 0));
+
+	ParallelFor(0, m, particleMesh.threadCount, [&particleMesh, m, n, h, splitScale](size_t rowBegin, size_t rowEnd, unsigned int)
+	{
+		for (size_t q = rowBegin; q < rowEnd; q++)
+		{
+			int j = (q < (size_t)n) ? (int)q : (int)q - (int)m; // wrapped offset, negative in the upper half
+			for (size_t p = 0; p < m; p++)
+			{
+				int i = (p < (size_t)n) ? (int)p : (int)p - (int)m;
+				if ((i == 0 && j == 0) || i == -n || j == -n)
+				{
+					continue; // no self force, and offsets of exactly n never occur between two nodes of the mass grid
+				}
+
+
+				// Acceleration at a node due to a unit mass at offset -(i, j) cells, same softening as 'ComputeAccelerationDueTo'
+				float dx = i * h, dy = j * h;
+				float distance = std::sqrt(dx * dx + dy * dy);
+				float softened = (distance < epsilon) ? distance + epsilon : distance;
+				float magnitude = 1.0f / (softened * softened * softened);
+				if (splitScale > 0)
+				{
+					magnitude *= 1 - ShortRangeForceFactor(distance, splitScale);
+				}
+
+				particleMesh.kernelX[q * m + p] = std::complex<float>(-dx * magnitude, 0);
+				particleMesh.kernelY[q * m + p] = std::complex<float>(-dy * magnitude, 0);
+			}
+		}
+	}, 16);
+
+	FFT2D(particleMesh.kernelX, m, false, particleMesh.threadCount);
+	FFT2D(particleMesh.kernelY, m, false, particleMesh.threadCount);
+
+
+	particleMesh.kernelGridSize = n;
+	particleMesh.kernelCellSize = h;
+	particleMesh.kernelSplitScale = splitScale;
+	particleMesh.kernelRebuilds++;
+}
+
+
+
+static inline float ParticleMeshSplitScale(ParticleMeshSolver &particleMesh)
+{
+	return std::max(particleMesh.splitScale * particleMesh.cellSize, epsilon);
+}
+
+
+
+static inline float ShortRangeForceFactor(float distance, float splitScale)
+{
+	float u = distance / (2 * splitScale);
+	return std::erfc(u) + (2 / std::sqrt((float)M_PI)) * u * std::exp(-u * u);
+}
+
+
+
+static inline void BuildShortRangeForceTable(ParticleMeshSolver &particleMesh)
+{
+	float splitScale = ParticleMeshSplitScale(particleMesh);
+	if (particleMesh.tableSplitScale == splitScale && !particleMesh.shortRangeTable.empty())
+	{
+		return;
+	}
+
+
+	const size_t samples = 1024;
+	particleMesh.shortRangeCutoff = particleMesh.cutoffScale * splitScale;
+	particleMesh.shortRangeTableScale = (samples - 1) / particleMesh.shortRangeCutoff;
+	particleMesh.shortRangeTable.resize(samples + 1);
+	for (size_t i = 0; i <= samples; i++)
+	{
+		particleMesh.shortRangeTable[i] = ShortRangeForceFactor(i / particleMesh.shortRangeTableScale, splitScale);
+	}
+	particleMesh.tableSplitScale = splitScale;
+}
+
+
+
+static inline float LookupShortRangeForceFactor(const ParticleMeshSolver &particleMesh, float distance)
+{
+	float position = distance * particleMesh.shortRangeTableScale;
+	size_t index = (size_t)position;
+	if (index + 1 >= particleMesh.shortRangeTable.size())
+	{
+		return 0;
+	}
+	float fraction = position - index;
+	return particleMesh.shortRangeTable[index] + fraction * (particleMesh.shortRangeTable[index + 1] - particleMesh.shortRangeTable[index]);
+}
+
+
+
+
+
+
+
+
+static inline void AssignMassCloudInCell(ParticleMeshSolver &particleMesh, const BodyStore &bodies)
+{
+	int n = particleMesh.gridSize;
+	unsigned int threadCount = (particleMesh.threadCount > 0) ? particleMesh.threadCount : DefaultThreadCount();
+	particleMesh.threadDensity.resize(threadCount);
+	particleMesh.density.assign((size_t)n * n, 0);
+
+
+	// Every thread deposits into its own grid, so no two threads ever write the same node
+	ParallelFor(0, bodies.size(), threadCount, [&particleMesh, &bodies, n](size_t begin, size_t end, unsigned int threadIndex)
+	{
+		std::vector<float> &grid = particleMesh.threadDensity[threadIndex];
+		grid.assign((size_t)n * n, 0);
+
+		for (size_t b = begin; b < end; b++)
+		{
+			float u = (bodies.x[b] - particleMesh.origin.x) / particleMesh.cellSize;
+			float v = (bodies.y[b] - particleMesh.origin.y) / particleMesh.cellSize;
+			int i = ofClamp((int)std::floor(u), 0, n - 2);
+			int j = ofClamp((int)std::floor(v), 0, n - 2);
+			float fx = ofClamp(u - i, 0, 1);
+			float fy = ofClamp(v - j, 0, 1);
+			float mass = bodies.mass[b];
+
+			grid[(size_t)j * n + i] += mass * (1 - fx) * (1 - fy);
+			grid[(size_t)j * n + i + 1] += mass * fx * (1 - fy);
+			grid[(size_t)(j + 1) * n + i] += mass * (1 - fx) * fy;
+			grid[(size_t)(j + 1) * n + i + 1] += mass * fx * fy;
+		}
+	}, 1024);
+
+
+	// Reduce the private grids, split by rows this time
+	ParallelFor(0, n, threadCount, [&particleMesh, n](size_t rowBegin, size_t rowEnd, unsigned int)
+	{
+		for (auto &grid : particleMesh.threadDensity)
+		{
+			if (grid.size() != (size_t)n * n)
+			{
+				continue; // this thread had no bodies to deposit
+			}
+			for (size_t k = rowBegin * n; k < rowEnd * n; k++)
+			{
+				particleMesh.density[k] += grid[k];
+			}
+		}
+	}, 8);
+
+
+	for (auto &grid : particleMesh.threadDensity)
+	{
+		grid.clear(); // mark as consumed, keeps the capacity for the next step
+	}
+}
+
+
+
+static inline void SolveParticleMeshField(ParticleMeshSolver &particleMesh)
+{
+	size_t n = particleMesh.gridSize;
+	size_t m = 2 * n;
+
+
+	// Zero padded density, transformed once and multiplied by both kernel components
+	particleMesh.fieldX.assign(m * m, std::complex<float>(0, 0));
+	for (size_t j = 0; j < n; j++)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			particleMesh.fieldX[j * m + i] = std::complex<float>(particleMesh.density[j * n + i], 0);
+		}
+	}
+	FFT2D(particleMesh.fieldX, m, false, particleMesh.threadCount);
+
+	particleMesh.fieldY.resize(m * m);
+	ParallelFor(0, m * m, particleMesh.threadCount, [&particleMesh](size_t begin, size_t end, unsigned int)
+	{
+		for (size_t k = begin; k < end; k++)
+		{
+			particleMesh.fieldY[k] = particleMesh.fieldX[k] * particleMesh.kernelY[k];
+			particleMesh.fieldX[k] *= particleMesh.kernelX[k];
+		}
+	}, 4096);
+
+	FFT2D(particleMesh.fieldX, m, true, particleMesh.threadCount);
+	FFT2D(particleMesh.fieldY, m, true, particleMesh.threadCount);
+
+
+	// Only the first n x n block is the isolated (non periodic) result
+	particleMesh.accelerationX.resize(n * n);
+	particleMesh.accelerationY.resize(n * n);
+	for (size_t j = 0; j < n; j++)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			particleMesh.accelerationX[j * n + i] = particleMesh.fieldX[j * m + i].real();
+			particleMesh.accelerationY[j * n + i] = particleMesh.fieldY[j * m + i].real();
+		}
+	}
+}
+
+
+
+static inline void InterpolateParticleMeshAccelerations(ParticleMeshSolver &particleMesh, BodyStore &bodies, float G)
+{
+	int n = particleMesh.gridSize;
+	ParallelFor(0, bodies.size(), particleMesh.threadCount, [&particleMesh, &bodies, n, G](size_t begin, size_t end, unsigned int)
+	{
+		const std::vector<float> &ax = particleMesh.accelerationX;
+		const std::vector<float> &ay = particleMesh.accelerationY;
+		for (size_t b = begin; b < end; b++)
+		{
+			float u = (bodies.x[b] - particleMesh.origin.x) / particleMesh.cellSize;
+			float v = (bodies.y[b] - particleMesh.origin.y) / particleMesh.cellSize;
+			int i = ofClamp((int)std::floor(u), 0, n - 2);
+			int j = ofClamp((int)std::floor(v), 0, n - 2);
+			float fx = ofClamp(u - i, 0, 1);
+			float fy = ofClamp(v - j, 0, 1);
+
+			size_t k00 = (size_t)j * n + i, k10 = k00 + 1, k01 = k00 + n, k11 = k01 + 1;
+			float w00 = (1 - fx) * (1 - fy), w10 = fx * (1 - fy), w01 = (1 - fx) * fy, w11 = fx * fy;
+
+			bodies.ax[b] += G * (w00 * ax[k00] + w10 * ax[k10] + w01 * ax[k01] + w11 * ax[k11]);
+			bodies.ay[b] += G * (w00 * ay[k00] + w10 * ay[k10] + w01 * ay[k01] + w11 * ay[k11]);
+		}
+	}, 1024);
+}
+
+
+
+
+
+
+
+
+static inline void ComputeAllForcesParticleMesh(BodyStore &bodies, ParticleMeshSolver &particleMesh, float G)
+{
+	PlaceParticleMeshGrid(particleMesh, bodies);
+	BuildParticleMeshKernel(particleMesh, false);
+	AssignMassCloudInCell(particleMesh, bodies);
+	SolveParticleMeshField(particleMesh);
+	InterpolateParticleMeshAccelerations(particleMesh, bodies, G);
+}
+
+
+
+static inline void ComputeAllForcesTreePM(Quadtree* &rootNode, BodyStore &bodies, ParticleMeshSolver &particleMesh, float G, float theta)
+{
+	PlaceParticleMeshGrid(particleMesh, bodies);
+	BuildParticleMeshKernel(particleMesh, true);
+	AssignMassCloudInCell(particleMesh, bodies);
+	SolveParticleMeshField(particleMesh);
+	InterpolateParticleMeshAccelerations(particleMesh, bodies, G);
+
+
+	BuildShortRangeForceTable(particleMesh);
+	ParallelFor(0, bodies.size(), particleMesh.threadCount, [&rootNode, &bodies, &particleMesh, G, theta](size_t begin, size_t end, unsigned int)
+	{
+		for (size_t b = begin; b < end; b++)
+		{
+			ofVec2f acceleration(0, 0);
+			ComputeTreeForceShortRange(rootNode, bodies, b, acceleration, particleMesh, G, theta);
+			AddAcceleration(bodies, b, acceleration);
+		}
+	}, 256);
+}
+
+
+
+static inline void ComputeTreeForceShortRange(Quadtree* &rootNode, const BodyStore &bodies, size_t index, ofVec2f &bodiesAccelerations, const ParticleMeshSolver &particleMesh, float G, float theta)
+{
+	ofVec2f position = PositionOf(bodies, index);
+	WalkTree(rootNode, index, [&](Quadtree* cell)
+	{
+		// Skip the whole node if even its nearest point is beyond the cutoff
+		const ofRectangle &bounds = cell->bounds;
+		float gapX = std::max(std::max(bounds.x - position.x, position.x - (bounds.x + bounds.width)), 0.0f);
+		float gapY = std::max(std::max(bounds.y - position.y, position.y - (bounds.y + bounds.height)), 0.0f);
+		if (gapX * gapX + gapY * gapY > particleMesh.shortRangeCutoff * particleMesh.shortRangeCutoff)
+		{
+			return true;
+		}
+
+
+		float distance = cell->centerOfMass.distance(position);
+		float size = bounds.width;
+		if (size / distance < theta)
+		{
+			ofVec2f acceleration(0, 0);
+			ComputeAccelerationDueTo<float>(position, cell->centerOfMass, cell->totalMass, acceleration, G, distance);
+			bodiesAccelerations += acceleration * LookupShortRangeForceFactor(particleMesh, distance);
+			return true;
+		}
+		return false;
+	},
+	[&](Quadtree* leaf)
+	{
+		ofVec2f leafPosition = PositionOf(bodies, leaf->nodeBodyIndex);
+		float dist = leafPosition.distance(position);
+		if (dist > particleMesh.shortRangeCutoff)
+		{
+			return;
+		}
+		ofVec2f acceleration(0, 0);
+		ComputeAccelerationDueTo<float>(position, leafPosition, bodies.mass[leaf->nodeBodyIndex], acceleration, G, dist);
+		bodiesAccelerations += acceleration * LookupShortRangeForceFactor(particleMesh, dist);
+	});
+}
@@ -0,0 +1,396 @@
+//  PeriodicBoundaries.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * PeriodicBoundaries Module: Periodic domains with Ewald-corrected tree forces
+ *
+ * Description:
+ * Instead of isolated bodies in a fixed root box, the simulation plane is tiled with copies of a square domain of
+ * side 'period'. Every body therefore interacts with every periodic image of every other body:
+ * 			- positions are wrapped back into the domain every step, so the root bounds never change and no body can escape
+ * 			- the tree walk works on minimum images, the displacement to a node (or body) is wrapped to the nearest copy
+ * 			- the contribution of all the other images is added as an Ewald correction, read from a lookup table
+ *
+ * The Ewald sum here is the one for point masses with the usual 1/r^2 law that are periodic in the plane only
+ * (a doubly periodic sheet). For a displacement r, with the splitting parameter alpha, lattice vectors n and
+ * reciprocal vectors k (excluding k = 0, the uniform part exerts no in-plane force):
+ * 			a(r) = -sum_n s_n [erfc(alpha s) / s^3 + 2 alpha / sqrt(pi) exp(-alpha^2 s^2) / s^2],  s_n = r + n
+ * 			       -(2 pi / L^2) sum_k (k / |k|) sin(k . r) erfc(|k| / 2 alpha)
+ * The correction is that minus the minimum image term -r / |r|^3, which is smooth over the whole domain.
+ *
+ * The correction only depends on r / L, so the table is computed once for a unit domain and scaled by 1 / L^2. By
+ * symmetry only the quadrant [0, L/2] x [0, L/2] is stored. Building it takes a noticeable moment, so it is built at
+ * startup and cached to disk, later runs just load it.
+ */
+#pragma once
+#include <fstream>
+#include <cmath>
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "Quadtree.hpp"
+#include "PhysicsLogic.hpp"
+#include "ParallelUtilities.hpp"
+#include "ofMain.h"
+
+
+
+
+/**
+ * PeriodicDomain: The periodic box and its Ewald correction table.
+ */
+class PeriodicDomain
+{
+public:
+	// ------------- Configuration -------------
+	float period = 10000;  // Side length L of the (square) periodic domain, centred on the origin
+	int ewaldTableSize = 64;  // Number of table cells along each side of the stored quadrant
+	unsigned int threadCount = 0;  // Threads used for the table build and the force walk, 0 selects the number of hardware threads
+
+
+	// ------------- Ewald Correction Table -------------
+	std::vector<ofVec2f> ewaldTable;  // Correction for a unit domain and unit G*m, (ewaldTableSize + 1)^2 samples over [0, 1/2]^2
+
+
+	// ------------- Domain -------------
+	ofRectangle bounds() const { return ofRectangle(-period * 0.5f, -period * 0.5f, period, period); } // Root bounds of the tree
+};
+
+
+
+
+
+
+
+
+// ------------- Domain Operations -------------
+/**
+ * WrapPositionsIntoDomain: Move every body back into the periodic domain.
+ *
+ * @param domain The periodic domain
+ * @param bodies The bodies
+ */
+static inline void WrapPositionsIntoDomain(PeriodicDomain &domain, BodyStore &bodies);
+
+
+
+/**
+ * MinimumImage: Wrap a displacement to its nearest periodic copy, each component ends up within [-L/2, L/2].
+ */
+static inline ofVec2f MinimumImage(const PeriodicDomain &domain, ofVec2f displacement);
+
+
+
+
+
+
+
+
+// ------------- Ewald Correction Table -------------
+/**
+ * LoadOrBuildEwaldTable: Load the correction table from 'cachePath', or build it and write it there.
+ *
+ * @param domain    The periodic domain, only 'ewaldTableSize' and 'threadCount' are used
+ * @param cachePath File the table is cached in
+ * @return true if the table was loaded from the cache
+ */
+static inline bool LoadOrBuildEwaldTable(PeriodicDomain &domain, const std::string &cachePath);
+
+
+
+/**
+ * BuildEwaldTable: Evaluate the Ewald correction on every table node.
+ */
+static inline void BuildEwaldTable(PeriodicDomain &domain);
+
+
+
+/**
+ * EwaldCorrectionUnitDomain: Acceleration from all images except the nearest one, unit domain, unit G*m.
+ *
+ * @param displacement Body position minus source position, each component within [-1/2, 1/2]
+ */
+static inline ofVec2f EwaldCorrectionUnitDomain(ofVec2f displacement);
+
+
+
+/**
+ * LookupEwaldCorrection: Bilinearly interpolated correction for a minimum image displacement, unit G*m.
+ *
+ * @param domain       The periodic domain
+ * @param displacement Source position minus body position, minimum image
+ */
+static inline ofVec2f LookupEwaldCorrection(const PeriodicDomain &domain, ofVec2f displacement);
+
+
+
+
+
+
+
+
+// ------------- Gravitational Computations -------------
+/**
+ * ComputeAllForcesPeriodic: Minimum image tree walk plus Ewald correction for every body.
+ *
+ * @param rootNode            Root of the quadtree, built with the domain as root bounds
+ * @param bodies              The bodies, wrapped into the domain, whose ax and ay receive the accelerations
+ * @param domain              The periodic domain, with its Ewald table loaded
+ * @param G                   Universal gravitational constant
+ * @param theta               Barnes-Hut theta parameter for MAC
+ */
+static inline void ComputeAllForcesPeriodic(Quadtree* &rootNode, BodyStore &bodies, PeriodicDomain &domain, float G, float theta);
+
+
+
+/**
+ * ComputeTreeForcePeriodic: Compute the force on a single body from the nearest image of every node.
+ *
+ * @param rootNode            The current node of the walk.
+ * @param bodies              The bodies the tree was built from.
+ * @param index               Index of the body for which the force is being calculated.
+ * @param bodiesAccelerations The computed acceleration for this body.
+ * @param domain              The periodic domain.
+ * @param G                   The gravitational constant.
+ * @param theta               The Barnes-Hut opening angle.
+ */
+static inline void ComputeTreeForcePeriodic(Quadtree* &rootNode, const BodyStore &bodies, size_t index, ofVec2f &bodiesAccelerations, const PeriodicDomain &domain, float G, float theta);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline void WrapPositionsIntoDomain(PeriodicDomain &domain, BodyStore &bodies)
+{
+	float half = domain.period * 0.5f;
+	float* x = bodies.x.data();
+	float* y = bodies.y.data();
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		x[i] -= domain.period * std::floor((x[i] + half) / domain.period);
+		y[i] -= domain.period * std::floor((y[i] + half) / domain.period);
+	}
+}
+
+
+
+static inline ofVec2f MinimumImage(const PeriodicDomain &domain, ofVec2f displacement)
+{
+	displacement.x -= domain.period * std::round(displacement.x / domain.period);
+	displacement.y -= domain.period * std::round(displacement.y / domain.period);
+	return displacement;
+}
+
+
+
+
+
+
+
+
+static inline bool LoadOrBuildEwaldTable(PeriodicDomain &domain, const std::string &cachePath)
+{
+	size_t samples = (size_t)(domain.ewaldTableSize + 1) * (domain.ewaldTableSize + 1);
+
+
+	std::ifstream cacheIn(cachePath, std::ios::binary);
+	if (cacheIn)
+	{
+		int storedSize = 0;
+		cacheIn.read(reinterpret_cast<char*>(&storedSize), sizeof(storedSize));
+		if (storedSize == domain.ewaldTableSize)
+		{
+			std::vector<float> values(2 * samples);
+			cacheIn.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(float));
+			if (cacheIn)
+			{
+				domain.ewaldTable.resize(samples);
+				for (size_t i = 0; i < samples; i++)
+				{
+					domain.ewaldTable[i].set(values[2 * i], values[2 * i + 1]);
+				}
+				return true;
+			}
+		}
+		cout << "\n\nEwald table cache '" << cachePath << "' does not match, rebuilding it";
+	}
+
+
+	BuildEwaldTable(domain);
+
+	std::ofstream cacheOut(cachePath, std::ios::binary | std::ios::trunc);
+	if (cacheOut)
+	{
+		std::vector<float> values(2 * samples);
+		for (size_t i = 0; i < samples; i++)
+		{
+			values[2 * i] = domain.ewaldTable[i].x;
+			values[2 * i + 1] = domain.ewaldTable[i].y;
+		}
+		cacheOut.write(reinterpret_cast<const char*>(&domain.ewaldTableSize), sizeof(domain.ewaldTableSize));
+		cacheOut.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float));
+	}
+	else
+	{
+		cout << "\n\nCould not write the Ewald table cache '" << cachePath << "'";
+	}
+	return false;
+}
+
+
+
+static inline void BuildEwaldTable(PeriodicDomain &domain)
+{
+	int size = domain.ewaldTableSize;
+	domain.ewaldTable.assign((size_t)(size + 1) * (size + 1), ofVec2f(0, 0));
+
+	ParallelFor(0, size + 1, domain.threadCount, [&domain, size](size_t rowBegin, size_t rowEnd, unsigned int)
+	{
+		for (size_t j = rowBegin; j < rowEnd; j++)
+		{
+			for (int i = 0; i <= size; i++)
+			{
+				domain.ewaldTable[j * (size + 1) + i] = EwaldCorrectionUnitDomain(ofVec2f(0.5f * i / size, 0.5f * j / size));
+			}
+		}
+	}, 1);
+}
+
+
+
+static inline ofVec2f EwaldCorrectionUnitDomain(ofVec2f displacement)
+{
+	const double alpha = 2.0; // splitting parameter, in units of 1/L
+	const int realImages = 3; // real space images summed along each axis, erfc(alpha * 2.5) ~ 1e-12
+	const int reciprocalImages = 5; // reciprocal vectors summed along each axis, erfc(pi * 5 / alpha) ~ 1e-29
+	double rx = displacement.x, ry = displacement.y;
+	double ax = 0, ay = 0;
+
+
+	// Real space part, every image including the nearest (n = 0), which is removed again at the end
+	for (int nx = -realImages; nx <= realImages; nx++)
+	{
+		for (int ny = -realImages; ny <= realImages; ny++)
+		{
+			double sx = rx + nx, sy = ry + ny;
+			double s = std::sqrt(sx * sx + sy * sy);
+			if (s < 1e-12)
+			{
+				continue;
+			}
+			double magnitude = std::erfc(alpha * s) / (s * s * s) + 2 * alpha / std::sqrt(M_PI) * std::exp(-alpha * alpha * s * s) / (s * s);
+			ax -= sx * magnitude;
+			ay -= sy * magnitude;
+		}
+	}
+
+
+	// Reciprocal space part, k = 2 pi (hx, hy)
+	for (int hx = -reciprocalImages; hx <= reciprocalImages; hx++)
+	{
+		for (int hy = -reciprocalImages; hy <= reciprocalImages; hy++)
+		{
+			if (hx == 0 && hy == 0)
+			{
+				continue;
+			}
+			double kx = 2 * M_PI * hx, ky = 2 * M_PI * hy;
+			double k = std::sqrt(kx * kx + ky * ky);
+			double magnitude = 2 * M_PI * std::sin(kx * rx + ky * ry) * std::erfc(k / (2 * alpha)) / k;
+			ax -= kx * magnitude;
+			ay -= ky * magnitude;
+		}
+	}
+
+
+	// Remove the nearest image, the tree walk accounts for it
+	double r = std::sqrt(rx * rx + ry * ry);
+	if (r > 1e-12)
+	{
+		ax += rx / (r * r * r);
+		ay += ry / (r * r * r);
+	}
+	return ofVec2f((float)ax, (float)ay);
+}
+
+
+
+static inline ofVec2f LookupEwaldCorrection(const PeriodicDomain &domain, ofVec2f displacement)
+{
+	// The table stores the correction for 'body minus source' in the positive quadrant of a unit domain
+	float scale = 1.0f / domain.period;
+	float u = std::min(std::fabs(displacement.x) * scale, 0.5f) * 2 * domain.ewaldTableSize;
+	float v = std::min(std::fabs(displacement.y) * scale, 0.5f) * 2 * domain.ewaldTableSize;
+	int i = std::min((int)u, domain.ewaldTableSize - 1);
+	int j = std::min((int)v, domain.ewaldTableSize - 1);
+	float fx = u - i, fy = v - j;
+
+	int stride = domain.ewaldTableSize + 1;
+	const ofVec2f &c00 = domain.ewaldTable[j * stride + i];
+	const ofVec2f &c10 = domain.ewaldTable[j * stride + i + 1];
+	const ofVec2f &c01 = domain.ewaldTable[(j + 1) * stride + i];
+	const ofVec2f &c11 = domain.ewaldTable[(j + 1) * stride + i + 1];
+	ofVec2f correction = c00 * ((1 - fx) * (1 - fy)) + c10 * (fx * (1 - fy)) + c01 * ((1 - fx) * fy) + c11 * (fx * fy);
+
+
+	// Each component is odd in its own axis and even in the other, and 'displacement' is the negative of what the table is indexed by
+	correction.x *= (displacement.x > 0) ? -1 : 1;
+	correction.y *= (displacement.y > 0) ? -1 : 1;
+	return correction * (scale * scale);
+}
+
+
+
+
+
+
+
+
+static inline void ComputeAllForcesPeriodic(Quadtree* &rootNode, BodyStore &bodies, PeriodicDomain &domain, float G, float theta)
+{
+	ParallelFor(0, bodies.size(), domain.threadCount, [&rootNode, &bodies, &domain, G, theta](size_t begin, size_t end, unsigned int)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			ofVec2f acceleration(0, 0);
+			ComputeTreeForcePeriodic(rootNode, bodies, i, acceleration, domain, G, theta);
+			AddAcceleration(bodies, i, acceleration);
+		}
+	}, 256);
+}
+
+
+
+static inline void ComputeTreeForcePeriodic(Quadtree* &rootNode, const BodyStore &bodies, size_t index, ofVec2f &bodiesAccelerations, const PeriodicDomain &domain, float G, float theta)
+{
+	ofVec2f position = PositionOf(bodies, index);
+	WalkTree(rootNode, index, [&](Quadtree* cell)
+	{
+		ofVec2f displacement = MinimumImage(domain, cell->centerOfMass - position);
+		float distance = displacement.length();
+		float size = cell->bounds.width;
+		if (size / distance < theta)
+		{
+			ofVec2f nearestImage = position + displacement;
+			ComputeAccelerationDueTo<float>(position, nearestImage, cell->totalMass, bodiesAccelerations, G, distance);
+			bodiesAccelerations += LookupEwaldCorrection(domain, displacement) * (G * cell->totalMass);
+			return true;
+		}
+		return false;
+	},
+	[&](Quadtree* leaf)
+	{
+		float mass = bodies.mass[leaf->nodeBodyIndex];
+		ofVec2f displacement = MinimumImage(domain, PositionOf(bodies, leaf->nodeBodyIndex) - position);
+		ofVec2f nearestImage = position + displacement;
+		ComputeAccelerationDueTo<float>(position, nearestImage, mass, bodiesAccelerations, G, displacement.length());
+		bodiesAccelerations += LookupEwaldCorrection(domain, displacement) * (G * mass);
+	});
+}
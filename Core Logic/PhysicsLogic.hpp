@@ -12,18 +12,19 @@
  * to compute gravitational forces, accelerations, and integrate them over time.
  * It aims to achieve a balance between computational efficiency and accuracy.
  *
+ * The force and integration functions are templates on the scalar type 'Real' of the bodies and tree they are given
+ * (see Precision.hpp), so the same code steps float and double bodies. The force functions take a second scalar,
+ * 'Kernel', which defaults to Real: with double bodies and float kernels, displacements are formed in double and
+ * the distance, inverse cube and mass product are evaluated in float, e.g., ComputeAllForces<double, float>(...).
  */
 #pragma once
-#include "Vects.hpp"
-#include "Geometry.hpp"
-#include "CoordinateSystem.hpp"
-#include "StatisticalMethods.hpp"
-#include "DrawingUtilities.hpp"
 #include "SequenceContainers.hpp"
 #include "SimulationEntities.hpp"
-#include "ObjectPool.hpp"
 #include "Quadtree.hpp"
-#include "ofMain.h"
+#include "BodyStore.hpp"
+#include "PhaseProfiler.hpp"
+#include "ParallelUtilities.hpp"
+#include "CoreTypes.hpp"
 
 
 
@@ -33,17 +34,35 @@
  * ComputeAllForces: Calculate the net gravitational forces on all bodies.
  *
  * Utilizes the quadtree to calculate the net gravitational forces acting on each body in the simulation.
- * Accelerations are stored in the passed `bodiesAccelerations` array for later integration.
+ * Accelerations are added into the bodies' ax and ay arrays for later integration.
  * This is a high-level function that orchestrates the traversal of the quadtree to compute the forces.
  *
  * Parameters:
- * @param rootNode            Root of the quadtree data structure
- * @param bodies              Vector containing pointers to all Body objects
- * @param bodiesAccelerations Pre-allocated array to store calculated accelerations
+ * @param rootNode            Root of the quadtree data structure, built from 'bodies'
+ * @param bodies              The bodies, whose ax and ay receive the accelerations
  * @param G                   Universal gravitational constant
  * @param theta               Barnes-Hut theta parameter for MAC
+ * @param threadCount         Threads the bodies are split over (the chunks the memory placement touches), 0 selects DefaultThreadCount()
  */
-static inline void ComputeAllForces(Quadtree* &rootNode,  std::vector<Body*> &bodies, ofVec2f* &bodiesAccelerations, float G, float theta);
+template<typename Real, typename Kernel = Real>
+static inline void ComputeAllForces(BasicQuadtree<Real>* &rootNode, BasicBodyStore<Real> &bodies, float G, float theta, unsigned int threadCount = 0);
+
+
+
+/**
+ * WalkTree: The Barnes-Hut traversal of one body, shared by every recursive force walk, with the interactions left to callbacks.
+ *
+ * Every cell is offered to 'cell' first, which returns true if it dealt with the cell as a whole (applied it as one mass,
+ * or pruned it) and false to have the walk descend into children 0 to 3 in order. Every leaf holding a body other than
+ * body 'index' is passed to 'leaf'. The nodes are visited in the same order for every caller, so the callbacks' sums are too.
+ *
+ * @param node  The current node of the walk, the root on the first call.
+ * @param index Index of the body the walk is for, its own leaf is skipped; SIZE_MAX for a point that is no body.
+ * @param cell Callable taking the cell's node, returning whether the walk stops there.
+ * @param leaf Callable taking the leaf's node.
+ */
+template<typename Real, typename Cell, typename Leaf>
+static inline void WalkTree(BasicQuadtree<Real>* node, size_t index, const Cell &cell, const Leaf &leaf);
 
 
 
@@ -54,13 +73,24 @@ static inline void ComputeAllForces(Quadtree* &rootNode,  std::vector<Body*> &bo
  * by traversing the quadtree from the root node.
  *
  * @param rootNode The root node of the quadtree.
- * @param body Pointer to the body object for which the force is being calculated.
+ * @param bodies The bodies the tree was built from, its leaves' positions and masses are read there.
+ * @param index Index of the body for which the force is being calculated, SIZE_MAX for a point that is no body.
+ * @param position Position of the body (or point).
  * @param bodiesAccelerations The computed acceleration for this body.
  * @param G The gravitational constant.
  * @param theta The Barnes-Hut opening angle.
  */
-static inline void ComputeTreeForce(Quadtree* &rootNode,  Body* &body, ofVec2f &bodiesAccelerations, float G, float theta);
-static inline void ComputeAccelerationDueTo(Body* &body, ofVec2f &otherBodyPosition, float &otherBodyMass, ofVec2f &bodiesAccelerations, float G, float distance);
+template<typename Real, typename Kernel = Real>
+static inline void ComputeTreeForce(BasicQuadtree<Real>* &rootNode, const BasicBodyStore<Real> &bodies, size_t index, const typename PrecisionTraits<Real>::Vector &position, typename PrecisionTraits<Real>::Vector &bodiesAccelerations, float G, float theta);
+template<typename Real, typename Kernel = Real>
+static inline void ComputeAccelerationDueTo(const typename PrecisionTraits<Real>::Vector &bodyPosition, const typename PrecisionTraits<Real>::Vector &otherBodyPosition, typename PrecisionTraits<Real>::Scalar otherBodyMass, typename PrecisionTraits<Real>::Vector &bodiesAccelerations, float G, typename PrecisionTraits<Real>::Scalar distance);
+
+
+
+/**
+ * SoftenedPotential: Potential of a point mass consistent with 'ComputeAccelerationDueTo', continuous at the softening length.
+ */
+static inline double SoftenedPotential(double mass, double distance, float G);
 
 
 
@@ -88,14 +118,14 @@ static inline void ComputeAccelerationDueTo(Body* &body, ofVec2f &otherBodyPosit
  *
  * Parameters:
  * @param dt                  Time step
- * @param bodies              Vector containing pointers to all Body objects
- * @param bodiesAccelerations Array containing calculated accelerations
+ * @param bodies              The bodies, holding the calculated accelerations in ax and ay
  * @param integrationScheme   Flag to select integration scheme (true for LeapFrog KDK, false for RK4)
  * @param slowMotionMode      Flag to indicate slow motion
  * @param fastMotionMode      Flag to indicate fast motion
  *
  */
-static inline void IntegrationScheme(float dt, std::vector<Body*> &bodies, ofVec2f*& bodiesAccelerations, bool integrationScheme, bool &slowMotionMode, bool &fastMotionMode);
+template<typename Real>
+static inline void IntegrationScheme(float dt, BasicBodyStore<Real> &bodies, bool integrationScheme, bool &slowMotionMode, bool &fastMotionMode);
 
 
 
@@ -105,8 +135,12 @@ static inline void IntegrationScheme(float dt, std::vector<Body*> &bodies, ofVec
  * the solution by taking a weighted average of four different approximations at each
  * time step, however this method does not preserve time symmetry, so errors in the
  * total energy of the system will increase without bound over time.
+ *
+ * Note: every stage reuses the acceleration of the start of the step, so this is only first
+ * order accurate. 'IntegrateRungeKutta4' (RungeKutta.hpp) evaluates the forces at every stage.
  */
-static inline void IntegrateRK4Force(float dt, std::vector<Body*> &bodies, ofVec2f*& bodiesAccelerations);
+template<typename Real>
+static inline void IntegrateRK4Force(float dt, BasicBodyStore<Real> &bodies);
 
 
 
@@ -118,9 +152,12 @@ static inline void IntegrateRK4Force(float dt, std::vector<Body*> &bodies, ofVec
  * significantly cheaper than RK4
  */
 //Helper functions to integrate forces into bodies
-static inline void ResetAccelerations(std::vector<Body*> &bodies);
-static inline void ComputePositionAtHalfTimeStep(float dt,std::vector<Body*> &bodies);  // Drift every body once before resetting acceleration
-static inline void ComputeVelocityAndPosition(float dt, std::vector<Body*> &bodies, ofVec2f*& bodiesAccelerations);   //Kick-Drift-Kick Leap-Frog integration scheme
+template<typename Real>
+static inline void ResetAccelerations(BasicBodyStore<Real> &bodies);
+template<typename Real>
+static inline void ComputePositionAtHalfTimeStep(float dt, BasicBodyStore<Real> &bodies);  // Drift every body once before resetting acceleration
+template<typename Real>
+static inline void ComputeVelocityAndPosition(float dt, BasicBodyStore<Real> &bodies);   //Kick-Drift-Kick Leap-Frog integration scheme
 
 
 
@@ -137,12 +174,13 @@ static inline void ComputeVelocityAndPosition(float dt, std::vector<Body*> &bodi
  * energy for all bodies. Useful for system diagnostics and ensuring energy conservation.
  *
  * Parameters:
- * @param bodies                Vector containing pointers to all Body objects
+ * @param bodies                The bodies
  * @param systemEnergy          Variable to store total system energy
  * @param systemKineticEnergy   Variable to store total kinetic energy
  * @param systemPotentialEnergy Variable to store total potential energy
  */
-static inline void ComputeSystemEnergy(std::vector<Body*> &bodies, float &systemEnergy, float &systemKineticEnergy, float &systemPotentialEnergy);
+template<typename Real>
+static inline void ComputeSystemEnergy(const BasicBodyStore<Real> &bodies, float &systemEnergy, float &systemKineticEnergy, float &systemPotentialEnergy);
 
 
 
@@ -152,9 +190,9 @@ static inline void ComputeSystemEnergy(std::vector<Body*> &bodies, float &system
  *
  *
  * Parameters:
- * @param bodies                Vector containing pointers to all Body objects
+ * @param bodies                The bodies
  */
-static inline void ComputeBodyKineticEnergies(std::vector<Body*> &bodies);
+static inline void ComputeBodyKineticEnergies(BodyStore &bodies);
 
 
 
@@ -162,13 +200,13 @@ static inline void ComputeBodyKineticEnergies(std::vector<Body*> &bodies);
  * ComputeBodyPotentialEnergies: Calculate the potential energy of all bodies
  *
  * very expensive, more than doubles workload of entire force calculation while running, avoid at all costs if possible
- * Need to find a way to pass in distances, other bodies, and bodiesAccelerations
+ * Need to find a way to pass in distances, other bodies, and the accelerations
  *
  *
  * Parameters:
- * @param bodies                Vector containing pointers to all Body objects
+ * @param bodies                The bodies
  */
-static inline void ComputeBodyPotentialEnergies(std::vector<Body*> &bodies, double G, ofVec2f*& bodiesAccelerations);
+static inline void ComputeBodyPotentialEnergies(BodyStore &bodies, double G);
 
 
 
@@ -181,91 +219,107 @@ static inline void ComputeBodyPotentialEnergies(std::vector<Body*> &bodies, doub
 
 
 
-static inline void ComputeAllForces(Quadtree* &rootNode,  std::vector<Body*> &bodies, ofVec2f* &bodiesAccelerations, float G, float theta) //use the quadtree to calculate and store the accelerations of bodies due to gravitational interactions to fill in the empty bodiesAccelerations(done this way so that the same bodiesAccelerations can be used to integrate and update bodies positions/velocities by accelerations)
+template<typename Real, typename Kernel>
+static inline void ComputeAllForces(BasicQuadtree<Real>* &rootNode, BasicBodyStore<Real> &bodies, float G, float theta, unsigned int threadCount) //use the quadtree to calculate the accelerations of bodies due to gravitational interactions and add them into the bodies' ax and ay(done this way so that the same accelerations can be used to integrate and update bodies positions/velocities)
 {
-	for(int i=0;i<bodies.size();i++)
+	PROFILE_PHASE(ComputeForces);
+	ParallelFor(0, bodies.size(), threadCount, [&rootNode, &bodies, G, theta](size_t begin, size_t end, unsigned int) // every body's walk only reads the tree and the positions
 	{
-		ComputeTreeForce(rootNode, bodies[i], bodiesAccelerations[i], G, theta);
-	}
+		for(size_t i = begin; i < end; i++)
+		{
+			typename PrecisionTraits<Real>::Vector acceleration(0, 0);
+			ComputeTreeForce<Real, Kernel>(rootNode, bodies, i, PositionOf(bodies, i), acceleration, G, theta);
+			AddAcceleration(bodies, i, acceleration);
+		}
+	});
 }
 
 
-static inline void ComputeTreeForce(Quadtree* &rootNode,  Body* &body, ofVec2f &bodiesAccelerations, float G, float theta)
+template<typename Real, typename Cell, typename Leaf>
+static inline void WalkTree(BasicQuadtree<Real>* node, size_t index, const Cell &cell, const Leaf &leaf)
 {
-	if(body == nullptr || rootNode == nullptr)
+	if(node == nullptr)
 	{
 		return;
 	}
 	
 	
-	if (rootNode->hasChildren)
+	if (node->hasChildren)
 	{
-		float distance = rootNode->centerOfMass.distance(body->position); //distance between the center of mass and the body, add a small constant to prevent division by zero
-		float size = rootNode->bounds.width;      //size of the quadrant of bodies
-		
-		if (size / distance < theta)  //check if the MAC is acceptable and then if it is use group force approximation
+		if (cell(node)) // accepted as a whole or pruned
 		{
-			//if (rootNode->totalMass != 0)
-			//{
-			
-			ComputeAccelerationDueTo(body, rootNode->centerOfMass, rootNode->totalMass, bodiesAccelerations, G, distance);
-			
-			
-			//float potentialEnergy = -G * body->mass * rootNode->totalMass / distance;
-			//body->potentialEnergy += potentialEnergy;// Note: using += here since potential energy is a sum over all bodies
 			return;
-			//}
 		}
-		else //MAC not satisfied, for the highest level quadrant
+		for (int i = 0; i < 4; i++) // MAC not satisfied, descend
 		{
-			if (rootNode->children[0] != nullptr)
-			{
-				ComputeTreeForce(rootNode->children[0], body, bodiesAccelerations, G, theta);
-			}
-			if (rootNode->children[1] != nullptr)
-			{
-				ComputeTreeForce(rootNode->children[1], body, bodiesAccelerations, G, theta);
-			}
-			if (rootNode->children[2] != nullptr)
+			if (node->children[i] != nullptr)
 			{
-				ComputeTreeForce(rootNode->children[2], body, bodiesAccelerations, G, theta);
-			}
-			if (rootNode->children[3] != nullptr)
-			{
-				ComputeTreeForce(rootNode->children[3], body, bodiesAccelerations, G, theta);
+				WalkTree(node->children[i], index, cell, leaf);
 			}
 		}
 	}
-	else // no hasChildren and one body
+	else if (node->nodeBodyIndex != SIZE_MAX && node->nodeBodyIndex != index) // because this node has no children nodes, it will only have one body in it
 	{
-		if (rootNode->nodeBody != body) //  if (rootNode->bodyCount > 0) //because this node has no children nodes, it will only have one body in it
+		leaf(node);
+	}
+}
+
+
+template<typename Real, typename Kernel>
+static inline void ComputeTreeForce(BasicQuadtree<Real>* &rootNode, const BasicBodyStore<Real> &bodies, size_t index, const typename PrecisionTraits<Real>::Vector &position, typename PrecisionTraits<Real>::Vector &bodiesAccelerations, float G, float theta)
+{
+	WalkTree(rootNode, index, [&](BasicQuadtree<Real>* cell)
+	{
+		Real distance = cell->centerOfMass.distance(position); //distance between the center of mass and the body
+		Real size = cell->bounds.width;      //size of the quadrant of bodies
+		if (size / distance < theta)  //check if the MAC is acceptable and then if it is use group force approximation
 		{
-			//if (rootNode->nodeBody != body)
-			//{
-			float dist = rootNode->nodeBody->position.distance(body->position);
-			ComputeAccelerationDueTo(body, rootNode->nodeBody->position, rootNode->nodeBody->mass, bodiesAccelerations, G, dist);
-			
-			
-			//float potentialEnergy = -G * body->mass * rootNode->nodeBody->mass / dist;
-			//body->potentialEnergy += potentialEnergy; //velocity doesn't get updated here, don't compute kinetic energy here.  // Note: using += here since potential energy is a sum over all bodies
-			return;
-			//}
+			ComputeAccelerationDueTo<Real, Kernel>(position, cell->centerOfMass, cell->totalMass, bodiesAccelerations, G, distance);
+			return true;
 		}
-	}
+		return false;
+	},
+	[&](BasicQuadtree<Real>* leaf)
+	{
+		typename PrecisionTraits<Real>::Vector leafPosition = PositionOf(bodies, leaf->nodeBodyIndex);
+		Real dist = leafPosition.distance(position);
+		ComputeAccelerationDueTo<Real, Kernel>(position, leafPosition, bodies.mass[leaf->nodeBodyIndex], bodiesAccelerations, G, dist);
+	});
 }
 
-static inline void ComputeAccelerationDueTo(Body* &body, ofVec2f &otherBodyPosition, float &otherBodyMass, ofVec2f &bodiesAccelerations, float G, float distance)
+template<typename Real, typename Kernel>
+static inline void ComputeAccelerationDueTo(const typename PrecisionTraits<Real>::Vector &bodyPosition, const typename PrecisionTraits<Real>::Vector &otherBodyPosition, typename PrecisionTraits<Real>::Scalar otherBodyMass, typename PrecisionTraits<Real>::Vector &bodiesAccelerations, float G, typename PrecisionTraits<Real>::Scalar distance)
 {
-	ofVec2f gForce;
-	if (distance < epsilon)
+	// the displacement cancels the large common part of the positions, so it is formed in Real and only then narrowed
+	Kernel dx = (Kernel)(otherBodyPosition.x - bodyPosition.x);
+	Kernel dy = (Kernel)(otherBodyPosition.y - bodyPosition.y);
+	Kernel kernelDistance = (Kernel)distance;
+	Kernel magnitude;
+	if (kernelDistance < epsilon)
 	{
-		gForce = (otherBodyPosition - body->position) * (G * otherBodyMass / ((distance + epsilon) * (distance + epsilon) * (distance + epsilon)));
+		magnitude = (Kernel)G * (Kernel)otherBodyMass / ((kernelDistance + epsilon) * (kernelDistance + epsilon) * (kernelDistance + epsilon));
 	}
 	else
 	{
-		gForce = (otherBodyPosition - body->position) * (G * otherBodyMass / (distance * distance * distance));
+		magnitude = (Kernel)G * (Kernel)otherBodyMass / (kernelDistance * kernelDistance * kernelDistance);
+	}
+	bodiesAccelerations.x += dx * magnitude;
+	bodiesAccelerations.y += dy * magnitude;
+}
+
+
+static inline double SoftenedPotential(double mass, double distance, float G)
+{
+	if (distance >= epsilon)
+	{
+		return -G * mass / distance;
 	}
-	bodiesAccelerations += gForce;
+
+
+	// Integral of the softened force G m r / (r + epsilon)^3 from 'distance' out to epsilon, joined to -G m / epsilon
+	double e = epsilon;
+	double d = distance + e;
+	return -G * mass * (1 / e + 1 / d - e / (2 * d * d) - 3 / (8 * e));
 }
 
 
@@ -275,7 +329,8 @@ static inline void ComputeAccelerationDueTo(Body* &body, ofVec2f &otherBodyPosit
 
 
 
-inline void IntegrationScheme(float dt, std::vector<Body*> &bodies, ofVec2f*& bodiesAccelerations, bool integrationScheme, bool &slowMotionMode, bool &fastMotionMode)
+template<typename Real>
+inline void IntegrationScheme(float dt, BasicBodyStore<Real> &bodies, bool integrationScheme, bool &slowMotionMode, bool &fastMotionMode)
 {
 	
 	if(slowMotionMode)
@@ -298,11 +353,11 @@ inline void IntegrationScheme(float dt, std::vector<Body*> &bodies, ofVec2f*& bo
 	
 	if(integrationScheme) //do LeapFrog KDK
 	{
-		ComputeVelocityAndPosition(dt, bodies, bodiesAccelerations);
+		ComputeVelocityAndPosition(dt, bodies);
 	}
 	else //do fourth-order runge-kutta
 	{
-		IntegrateRK4Force(dt, bodies, bodiesAccelerations);
+		IntegrateRK4Force(dt, bodies);
 	}
 	
 }
@@ -310,26 +365,34 @@ inline void IntegrationScheme(float dt, std::vector<Body*> &bodies, ofVec2f*& bo
 
 
 
-inline void IntegrateRK4Force(float dt, std::vector<Body*> &bodies, ofVec2f*& bodiesAccelerations)
+template<typename Real>
+inline void IntegrateRK4Force(float dt, BasicBodyStore<Real> &bodies)
 {
+	PROFILE_PHASE(Integrate);
+	typedef typename PrecisionTraits<Real>::Vector Vector;
+	const Real h = dt, half = 0.5, two = 2, six = 6;
+	const Real* ax = bodies.ax.data();
+	const Real* ay = bodies.ay.data();
 	for (size_t i = 0; i < bodies.size(); i++)
 	{
-		ofVec2f k1v = dt * bodiesAccelerations[i];
+		Vector acceleration(ax[i], ay[i]);
+		Vector velocity = VelocityOf(bodies, i);
+		Vector k1v = acceleration * h;
 		
-		ofVec2f k1x = dt * bodies[i]->velocity;
+		Vector k1x = velocity * h;
 		
-		ofVec2f k2v = dt * (bodiesAccelerations[i] + 0.5 * k1v);
-		ofVec2f k2x = dt * (bodies[i]->velocity + 0.5 * k1x);
+		Vector k2v = (acceleration + k1v * half) * h;
+		Vector k2x = (velocity + k1x * half) * h;
 		
-		ofVec2f k3v = dt * (bodiesAccelerations[i] + 0.5 * k2v);
-		ofVec2f k3x = dt * (bodies[i]->velocity + 0.5 * k2x);
+		Vector k3v = (acceleration + k2v * half) * h;
+		Vector k3x = (velocity + k2x * half) * h;
 		
-		ofVec2f k4v = dt * (bodiesAccelerations[i] + k3v);
-		ofVec2f k4x = dt * (bodies[i]->velocity + k3x);
+		Vector k4v = (acceleration + k3v) * h;
+		Vector k4x = (velocity + k3x) * h;
 		
 		
-		bodies[i]->velocity = bodies[i]->velocity + (k1v + 2 * k2v + 2 * k3v + k4v) / 6;
-		bodies[i]->position = bodies[i]->position + (k1x + 2 * k2x + 2 * k3x + k4x) / 6;
+		SetVelocity(bodies, i, velocity + (k1v + k2v * two + k3v * two + k4v) / six);
+		SetPosition(bodies, i, PositionOf(bodies, i) + (k1x + k2x * two + k3x * two + k4x) / six);
 		
 		
 		//bodies[i]->kineticEnergy = 0.5 * bodies[i]->mass * bodies[i]->velocity.lengthSquared();
@@ -397,7 +460,8 @@ inline void IntegrateRK4Force(float dt, std::vector<Body*> &bodies, ofVec2f*& bo
 
 
 
-inline void ResetAccelerations(std::vector<Body*> &bodies)
+template<typename Real>
+inline void ResetAccelerations(BasicBodyStore<Real> &bodies)
 {
 	for (size_t i = 0; i < bodies.size(); i++)
 	{
@@ -406,23 +470,40 @@ inline void ResetAccelerations(std::vector<Body*> &bodies)
 	}
 }
 
-inline void ComputePositionAtHalfTimeStep(float dt, std::vector<Body*> &bodies)
+template<typename Real>
+inline void ComputePositionAtHalfTimeStep(float dt, BasicBodyStore<Real> &bodies)
 {
+	const Real h = (Real)(dt * 0.5);
+	Real* x = bodies.x.data();
+	Real* y = bodies.y.data();
+	const Real* vx = bodies.vx.data();
+	const Real* vy = bodies.vy.data();
 	for (size_t i = 0; i < bodies.size(); i++)
 	{
-		bodies[i]->position = bodies[i]->position + bodies[i]->velocity * (dt * 0.5);
+		x[i] = x[i] + vx[i] * h;
+		y[i] = y[i] + vy[i] * h;
 	}
 }
 
-inline void ComputeVelocityAndPosition(float dt, std::vector<Body*> &bodies, ofVec2f*& bodiesAccelerations)
+template<typename Real>
+inline void ComputeVelocityAndPosition(float dt, BasicBodyStore<Real> &bodies)
 {
-	for (size_t i = 0; i < bodies.size(); i++)
+	PROFILE_PHASE(Integrate);
+	const Real h = (Real)(dt);
+	Real* x = bodies.x.data();
+	Real* y = bodies.y.data();
+	Real* vx = bodies.vx.data();
+	Real* vy = bodies.vy.data();
+	const Real* ax = bodies.ax.data();
+	const Real* ay = bodies.ay.data();
+	for (size_t i = 0; i < bodies.size(); i++) // six arrays, unit stride
 	{
 		//KDK Leap Frog
-		bodies[i]->velocity = bodies[i]->velocity + bodiesAccelerations[i] * (dt); // Kick
+		vx[i] = vx[i] + ax[i] * h; // Kick
+		vy[i] = vy[i] + ay[i] * h;
 		
-		bodies[i]->position = bodies[i]->position + bodies[i]->velocity * (dt * 0.5); // Drift
-																					  //bodies[i]->kineticEnergy = 0.5 * bodies[i]->mass * bodies[i]->velocity.lengthSquared();
+		x[i] = x[i] + vx[i] * h; // Drift, a full step, the velocities lag the positions by half a step
+		y[i] = y[i] + vy[i] * h;
 	}
 }
 
@@ -433,8 +514,10 @@ inline void ComputeVelocityAndPosition(float dt, std::vector<Body*> &bodies, ofV
 
 
 
-static inline void ComputeSystemEnergy(std::vector<Body*> &bodies, float &systemEnergy, float &systemKineticEnergy, float &systemPotentialEnergy)
+template<typename Real>
+static inline void ComputeSystemEnergy(const BasicBodyStore<Real> &bodies, float &systemEnergy, float &systemKineticEnergy, float &systemPotentialEnergy)
 {
+	PROFILE_PHASE(SystemEnergy);
 	systemKineticEnergy = 0;
 	systemPotentialEnergy = 0;
 	systemEnergy = 0;
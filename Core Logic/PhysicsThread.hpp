@@ -0,0 +1,257 @@
+//  PhysicsThread.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * PhysicsThread Module: The simulation loop on its own thread, decoupled from rendering
+ *
+ * Description:
+ * Stepping inside the draw call ties the simulation rate to the render rate and to the cost of every GL call. With
+ * the physics thread running, the simulation owns the bodies, the tree and every solver's state outright and steps
+ * them as fast as the cores allow, 'substepsPerFrame' fixed steps at a time. After each batch it copies the bodies
+ * and the diagnostics into a triple-buffered snapshot, the renderer draws whichever snapshot is newest and never
+ * touches the live state, so a slow frame can't stall the physics and a slow batch can't stall the frame.
+ *
+ * Nothing the user interface edits is read by the physics thread directly. Parameter edits (theta, G, e, dt), the
+ * integrator and solver toggles, and benchmark requests travel as commands through a lock-free queue, which the
+ * simulation drains before each batch. The same queue is drained inline when the thread is off, so both paths
+ * apply edits identically, at a step boundary.
+ */
+#pragma once
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "ConcurrentBuffers.hpp"
+#include "ofMain.h"
+
+
+
+
+/**
+ * PhysicsParameters: The values the user interface edits and the physics steps with.
+ */
+class PhysicsParameters
+{
+public:
+	float theta = 1;  // Barnes-Hut theta parameter for MAC
+	double G = 66.743;  // Universal gravitational constant
+	float e = 0.25;  // Coefficient of restitution for collisions
+	float dt = 0.01;  // Size of simulation steps
+};
+
+
+
+/**
+ * PhysicsModes: Which solvers and integrators the step uses, as set by the user interface toggles.
+ */
+class PhysicsModes
+{
+public:
+	bool operator==(const PhysicsModes &other) const;
+
+	bool collisions = false;  // 'Toggle Collisions'
+	bool mergeBodies = false;  // 'Merge Bodies'
+	bool cacheInteractionLists = false;  // 'Cache Interaction Lists'
+	bool multiRateFarField = false;  // 'Multi-Rate Far Field'
+	bool particleMeshGravity = false;  // 'Particle-Mesh Gravity'
+	bool treePMCorrection = false;  // 'TreePM Short-Range Correction'
+	bool periodicBoundaries = false;  // 'Periodic Boundaries'
+	bool blockTimesteps = false;  // 'Block Timesteps'
+	bool fusedLeapfrog = false;  // 'Fused Kick-Drift Leapfrog'
+	bool yoshida = false;  // 'Yoshida 4th Order'
+	bool forestRuth = false;  // 'Forest-Ruth 4th Order'
+	bool adaptiveTimestep = false;  // 'Adaptive Timestep', already off while the galaxy creation table is open
+	bool adaptiveEnergyControl = false;  // 'Energy-Error Control'
+	bool bodyEnergies = false;  // 'Visualize Body Energy Gradient', keeps the bodies' energies
+	bool bodyRotation = false;  // 'Visualize Body Angular Orientation', keeps the bodies' rotation
+};
+
+
+
+/**
+ * PhysicsStats: Diagnostics the step produces for the user interface.
+ */
+class PhysicsStats
+{
+public:
+	float multiRateFarFieldError = 0;  // Last measured relative error of the multi-rate far field
+	size_t mergedBodies = 0;  // Number of bodies absorbed by mergers since the start
+	size_t collisionContacts = 0;  // Number of contacts resolved on the last step
+	double blockForceEvaluations = 0;  // Single-body force evaluations per unit of simulated time with block timesteps
+	int blockDeepestLevel = 0;  // Deepest block level in use on the last step
+	double adaptiveEnergyDrift = 0;  // Relative energy drift per unit time of the adaptive timestep's controller
+	bool adaptiveEnergyControlActive = false;  // Whether the last force computation produced the potentials the energy controller needs
+	double symplecticEnergyError = 0;  // Relative energy error of the symplectic integrator
+	double symplecticWallSeconds = 0;  // Wall-clock time the symplectic integrator has spent stepping
+	double stepsPerSecond = 0;  // Steps the physics thread completes per wall-clock second, 0 while it is off
+};
+
+
+
+/**
+ * PhysicsCommand: One message from the user interface to the simulation.
+ */
+enum class PhysicsCommandType { SetTheta, SetG, SetE, SetDt, SetModes, BenchmarkForceSolvers, BenchmarkIntegrators, BenchmarkPrecision, BenchmarkTraversalScratch, ReportMemoryPlacement };
+
+class PhysicsCommand
+{
+public:
+	PhysicsCommandType type;  // What to do
+	double value = 0;  // New parameter value of the Set commands
+	PhysicsModes modes;  // New modes of 'SetModes'
+};
+
+
+
+/**
+ * PhysicsSnapshot: Everything the renderer draws, copied out at the end of a batch of steps.
+ */
+class PhysicsSnapshot
+{
+public:
+	BodyStore bodies;  // Copy of the bodies, the arrays keep their capacity from one batch to the next
+	PhysicsStats stats;  // Diagnostics of the batch
+	double G = 0;  // Gravitational constant the batch stepped with
+	float dt = 0;  // Step size of the last step
+	float systemEnergy = 0;  // Total energy at the end of the batch
+	float systemKineticEnergy = 0;  // Kinetic energy at the end of the batch
+	float systemPotentialEnergy = 0;  // Potential energy at the end of the batch
+	size_t step = 0;  // Steps taken since the thread started
+};
+
+
+
+/**
+ * PhysicsThread: The worker, its batch size and the two channels to and from the renderer.
+ */
+class PhysicsThread
+{
+public:
+	int substepsPerFrame = 4;  // Fixed steps per published snapshot
+	std::thread worker;  // Runs the simulation's batches while 'running'
+	std::atomic<bool> running{false};  // Cleared to ask the worker to finish its batch and return
+	SingleProducerQueue<PhysicsCommand, 256> commands;  // User interface -> simulation
+	TripleBuffer<PhysicsSnapshot> snapshots;  // Simulation -> renderer
+	size_t steps = 0;  // Steps taken since the thread started, owned by the worker
+	double stepsPerSecond = 0;  // Step rate over the last second, owned by the worker
+};
+
+
+
+
+
+
+
+
+
+/**
+ * StartPhysicsThread: Run 'batch' on the worker over and over until 'StopPhysicsThread'.
+ *
+ * @param physicsThread The worker to start, must not be running
+ * @param batch         Callable advancing the simulation by 'substepsPerFrame' steps and publishing a snapshot
+ */
+template<typename Batch>
+static inline void StartPhysicsThread(PhysicsThread &physicsThread, Batch batch);
+
+
+
+/**
+ * StopPhysicsThread: Let the worker finish its current batch and join it. The live state belongs to the caller afterwards.
+ */
+static inline void StopPhysicsThread(PhysicsThread &physicsThread);
+
+
+
+/**
+ * PublishPhysicsSnapshot: Copy the bodies and diagnostics into the write slot and hand it to the renderer.
+ *
+ * @param physicsThread The worker's channels
+ * @param bodies        The bodies
+ * @param stats         Diagnostics of the batch
+ * @param G             Gravitational constant in use
+ * @param dt            Step size of the last step
+ * @param systemEnergy  Total, kinetic and potential energy at the end of the batch
+ */
+static inline void PublishPhysicsSnapshot(PhysicsThread &physicsThread, const BodyStore &bodies, const PhysicsStats &stats, double G, float dt, float systemEnergy, float systemKineticEnergy, float systemPotentialEnergy);
+
+
+
+
+
+
+
+
+
+
+
+
+inline bool PhysicsModes::operator==(const PhysicsModes &other) const
+{
+	return collisions == other.collisions && mergeBodies == other.mergeBodies && cacheInteractionLists == other.cacheInteractionLists && multiRateFarField == other.multiRateFarField
+		&& particleMeshGravity == other.particleMeshGravity && treePMCorrection == other.treePMCorrection && periodicBoundaries == other.periodicBoundaries
+		&& blockTimesteps == other.blockTimesteps && fusedLeapfrog == other.fusedLeapfrog && yoshida == other.yoshida && forestRuth == other.forestRuth
+		&& adaptiveTimestep == other.adaptiveTimestep && adaptiveEnergyControl == other.adaptiveEnergyControl
+		&& bodyEnergies == other.bodyEnergies && bodyRotation == other.bodyRotation;
+}
+
+
+
+template<typename Batch>
+static inline void StartPhysicsThread(PhysicsThread &physicsThread, Batch batch)
+{
+	if (physicsThread.running.load())
+	{
+		return;
+	}
+	physicsThread.steps = 0;
+	physicsThread.stepsPerSecond = 0;
+	physicsThread.running.store(true);
+	physicsThread.worker = std::thread([&physicsThread, batch]() mutable
+	{
+		auto start = std::chrono::steady_clock::now();
+		size_t firstStep = physicsThread.steps;
+		while (physicsThread.running.load(std::memory_order_acquire))
+		{
+			batch();
+
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (seconds >= 1.0) // rate over the last second or so, the next snapshot reports it
+			{
+				physicsThread.stepsPerSecond = (physicsThread.steps - firstStep) / seconds;
+				start = std::chrono::steady_clock::now();
+				firstStep = physicsThread.steps;
+			}
+		}
+	});
+}
+
+
+
+static inline void StopPhysicsThread(PhysicsThread &physicsThread)
+{
+	physicsThread.running.store(false, std::memory_order_release);
+	if (physicsThread.worker.joinable())
+	{
+		physicsThread.worker.join();
+	}
+}
+
+
+
+static inline void PublishPhysicsSnapshot(PhysicsThread &physicsThread, const BodyStore &bodies, const PhysicsStats &stats, double G, float dt, float systemEnergy, float systemKineticEnergy, float systemPotentialEnergy)
+{
+	PhysicsSnapshot &snapshot = physicsThread.snapshots.writeBuffer();
+	snapshot.bodies = bodies; // one memcpy per array
+	snapshot.stats = stats;
+	snapshot.stats.stepsPerSecond = physicsThread.stepsPerSecond;
+	snapshot.G = G;
+	snapshot.dt = dt;
+	snapshot.systemEnergy = systemEnergy;
+	snapshot.systemKineticEnergy = systemKineticEnergy;
+	snapshot.systemPotentialEnergy = systemPotentialEnergy;
+	snapshot.step = physicsThread.steps;
+	physicsThread.snapshots.publish();
+}
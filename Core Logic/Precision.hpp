@@ -0,0 +1,228 @@
+//  Precision.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * Precision Module: The scalar type the core computes in, and the vector and rectangle types that go with it
+ *
+ * Description:
+ * 'Body', 'Quadtree' and the physics of 'PhysicsLogic' are templates on a scalar type 'Real' (BasicBody<Real>,
+ * BasicQuadtree<Real>). PrecisionTraits maps each Real to the types it stores positions and bounds in:
+ * 			float  -> ofVec2f, ofRectangle         (Body and Quadtree, what the whole application runs on)
+ * 			double -> Vector2<double>, Rectangle2<double>
+ * A float has 24 bits of mantissa, so 200000 units from the origin neighbouring positions are already 1/64 of a unit
+ * apart and the core of a galaxy that drifted out there loses its resolution. Doubles don't, at twice the memory.
+ *
+ * The force kernels additionally take a 'Kernel' scalar: the displacement between two bodies is formed in Real, where
+ * the cancellation happens, and only the (small) displacement is converted to Kernel for the distance, the inverse
+ * cube and the product with the mass. Double positions with float kernels keep the resolution of doubles far from
+ * the origin at close to the arithmetic cost of floats.
+ *
+ * The precision of a run is chosen at startup as a 'Precision' value and turned into template arguments once by
+ * 'WithPrecision', which calls back with a 'PrecisionTag' naming both scalars.
+ */
+#pragma once
+#include <cmath>
+#include <string>
+#include <stdexcept>
+#include "CoreTypes.hpp"
+
+
+
+
+/**
+ * Vector2: Two-component vector with the subset of the ofVec2f interface the core uses.
+ */
+template<typename Real>
+class Vector2
+{
+public:
+	Vector2() : x(0), y(0) {}
+	Vector2(Real _x, Real _y) : x(_x), y(_y) {}
+
+	void set(Real _x, Real _y) { x = _x; y = _y; }
+	Real length() const { return std::sqrt(x * x + y * y); }
+	Real lengthSquared() const { return x * x + y * y; }
+	Real distance(const Vector2 &other) const { return (*this - other).length(); }
+
+	Vector2 operator+(const Vector2 &other) const { return Vector2(x + other.x, y + other.y); }
+	Vector2 operator-(const Vector2 &other) const { return Vector2(x - other.x, y - other.y); }
+	Vector2 operator-() const { return Vector2(-x, -y); }
+	Vector2 operator*(Real scalar) const { return Vector2(x * scalar, y * scalar); }
+	Vector2 operator/(Real scalar) const { return Vector2(x / scalar, y / scalar); }
+	Vector2& operator+=(const Vector2 &other) { x += other.x; y += other.y; return *this; }
+	Vector2& operator-=(const Vector2 &other) { x -= other.x; y -= other.y; return *this; }
+	Vector2& operator*=(Real scalar) { x *= scalar; y *= scalar; return *this; }
+	Vector2& operator/=(Real scalar) { x /= scalar; y /= scalar; return *this; }
+	bool operator==(const Vector2 &other) const { return x == other.x && y == other.y; }
+	bool operator!=(const Vector2 &other) const { return !(*this == other); }
+
+	Real x;
+	Real y;
+};
+
+template<typename Real>
+static inline Vector2<Real> operator*(Real scalar, const Vector2<Real> &vector) { return vector * scalar; }
+
+
+
+/**
+ * Rectangle2: Axis-aligned rectangle with the members of ofRectangle the core uses.
+ */
+template<typename Real>
+class Rectangle2
+{
+public:
+	Rectangle2() : x(0), y(0), width(0), height(0) {}
+	Rectangle2(Real _x, Real _y, Real _width, Real _height) : x(_x), y(_y), width(_width), height(_height) {}
+
+	void set(Real _x, Real _y, Real _width, Real _height) { x = _x; y = _y; width = _width; height = _height; }
+
+	Real x;
+	Real y;
+	Real width;
+	Real height;
+};
+
+
+
+/**
+ * PrecisionTraits: The vector and rectangle types positions and bounds are stored in at a given precision.
+ */
+template<typename Real>
+class PrecisionTraits
+{
+public:
+	typedef Real Scalar;
+	typedef Vector2<Real> Vector;
+	typedef Rectangle2<Real> Rectangle;
+};
+
+template<>
+class PrecisionTraits<float>
+{
+public:
+	typedef float Scalar;
+	typedef ofVec2f Vector;
+	typedef ofRectangle Rectangle;
+};
+
+
+
+/**
+ * Precision: The combinations of position and kernel scalars a run can be started with.
+ */
+enum class Precision { Float, Double, DoubleFloatKernels };
+
+
+
+/**
+ * PrecisionTag: Names the position scalar ('Real') and the force kernel scalar ('Kernel') of a precision.
+ */
+template<typename RealType, typename KernelType>
+class PrecisionTag
+{
+public:
+	typedef RealType Real;
+	typedef KernelType Kernel;
+};
+
+
+
+
+
+
+
+
+/**
+ * ConvertVector: The same vector in another precision.
+ */
+template<typename To, typename From>
+static inline To ConvertVector(const From &vector);
+
+
+
+/**
+ * WithPrecision: Call 'function(PrecisionTag<Real, Kernel>())' with the scalars 'precision' selects.
+ *
+ * @return Whatever 'function' returns
+ */
+template<typename Function>
+static inline auto WithPrecision(Precision precision, Function function) -> decltype(function(PrecisionTag<float, float>()));
+
+
+
+/**
+ * PrecisionName / PrecisionFromName: Precision as written on the command line, "float", "double" or "double-float".
+ */
+static inline const char* PrecisionName(Precision precision);
+static inline Precision PrecisionFromName(const std::string &name);
+
+
+
+
+
+
+
+
+
+
+
+
+template<typename To, typename From>
+static inline To ConvertVector(const From &vector)
+{
+	To converted;
+	converted.x = vector.x;
+	converted.y = vector.y;
+	return converted;
+}
+
+
+
+template<typename Function>
+static inline auto WithPrecision(Precision precision, Function function) -> decltype(function(PrecisionTag<float, float>()))
+{
+	switch (precision)
+	{
+		case Precision::Double:
+			return function(PrecisionTag<double, double>());
+		case Precision::DoubleFloatKernels:
+			return function(PrecisionTag<double, float>());
+		case Precision::Float:
+		default:
+			return function(PrecisionTag<float, float>());
+	}
+}
+
+
+
+static inline const char* PrecisionName(Precision precision)
+{
+	switch (precision)
+	{
+		case Precision::Double: return "double";
+		case Precision::DoubleFloatKernels: return "double-float";
+		case Precision::Float:
+		default: return "float";
+	}
+}
+
+
+
+static inline Precision PrecisionFromName(const std::string &name)
+{
+	if (name == "float")
+	{
+		return Precision::Float;
+	}
+	if (name == "double")
+	{
+		return Precision::Double;
+	}
+	if (name == "double-float")
+	{
+		return Precision::DoubleFloatKernels;
+	}
+	throw std::invalid_argument("Unknown precision '" + name + "', expected float, double or double-float");
+}
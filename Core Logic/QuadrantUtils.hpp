@@ -9,15 +9,9 @@
 
 
 #pragma once
-#include "Vects.hpp"
-#include "Geometry.hpp"
-#include "CoordinateSystem.hpp"
-#include "StatisticalMethods.hpp"
-#include "DrawingUtilities.hpp"
 #include "SequenceContainers.hpp"
 #include "SimulationEntities.hpp"
-#include "ObjectPool.hpp"
-#include "ofMain.h"
+#include "CoreTypes.hpp"
 
 
 
@@ -51,7 +45,8 @@ static const float QuadrantDir[] =
 
 
 
-static inline QuadrantEnum DetermineQuadrant(ofRectangle &nodeBounds, ofVec2f& bodyPosition); //returns the quadrant in which a body lies
+template<typename Rectangle, typename Vector>
+static inline QuadrantEnum DetermineQuadrant(const Rectangle &nodeBounds, const Vector& bodyPosition); //returns the quadrant in which a body lies, for bounds and positions of any precision
 static inline ofVec2f DetermineQuadrantDirection(QuadrantEnum quadrant); // Retrieves the direction for a given octant based on the lookup table.
 
 
@@ -61,11 +56,12 @@ static inline ofVec2f DetermineQuadrantDirection(QuadrantEnum quadrant); // Retr
 
 
 
-static inline QuadrantEnum DetermineQuadrant(ofRectangle &nodeBounds, ofVec2f& bodyPosition) //returns the quadrant in which a body lies
+template<typename Rectangle, typename Vector>
+static inline QuadrantEnum DetermineQuadrant(const Rectangle &nodeBounds, const Vector& bodyPosition) //returns the quadrant in which a body lies
 {
-	float halfWidth = nodeBounds.width * 0.5;
-	float midX = nodeBounds.x + halfWidth;
-	float midY = nodeBounds.y + halfWidth;
+	auto halfWidth = nodeBounds.width * 0.5f;
+	auto midX = nodeBounds.x + halfWidth;
+	auto midY = nodeBounds.y + halfWidth;
 	
 	
 	if (bodyPosition.y <= midY) //either in NE or NW quad
@@ -4,7 +4,7 @@
 
 
 #include "Quadtree.hpp"
-#include "ofMain.h"
+#include "CoreTypes.hpp"
 using namespace std;
 
 
@@ -12,15 +12,17 @@ using namespace std;
 
 
 
-Quadtree::Quadtree()
+template<typename Real>
+BasicQuadtree<Real>::BasicQuadtree()
 {
-	bounds = ofRectangle();
+	bounds = Rectangle();
 	centerOfMass.set(0, 0);
 	totalMass = 0;
 	hasChildren = false;
 	bodyCount = 0;
 	depth = 0;
-	nodeBody = nullptr;
+	nodeBodyIndex = SIZE_MAX;
+	maximumRadius = 0;
 	
 	children[0] = nullptr;
 	children[1] = nullptr;
@@ -28,10 +30,12 @@ Quadtree::Quadtree()
 	children[3] = nullptr;
 }
 
-Quadtree::Quadtree(const Quadtree* other)
+template<typename Real>
+BasicQuadtree<Real>::BasicQuadtree(const BasicQuadtree* other)
 {
 	bounds = other->bounds;
-	nodeBody = other->nodeBody;
+	nodeBodyIndex = other->nodeBodyIndex;
+	maximumRadius = other->maximumRadius;
 	depth = other->depth;
 	totalMass = other->totalMass;
 	centerOfMass = other->centerOfMass;
@@ -46,13 +50,14 @@ Quadtree::Quadtree(const Quadtree* other)
 
 
 
-Quadtree::Quadtree(ofRectangle& nodeBounds, QuadrantEnum quadrant, int depthLevel, float nodeMass, ofVec2f& nodeCOM)
+template<typename Real>
+BasicQuadtree<Real>::BasicQuadtree(Rectangle& nodeBounds, QuadrantEnum quadrant, int depthLevel, Real nodeMass, Vector& nodeCOM)
 {
-	float halfWidth = nodeBounds.width * 0.5;
+	Real halfWidth = nodeBounds.width * 0.5;
 	bounds.width = halfWidth;
 	bounds.height = halfWidth;
 	
-	ofVec2f quadrantDirection = DetermineQuadrantDirection(quadrant);
+	ofVec2f quadrantDirection = DetermineQuadrantDirection(quadrant); // exactly 0 or 1, no precision to lose
 	bounds.x = nodeBounds.x + quadrantDirection.x * halfWidth;
 	bounds.y = nodeBounds.y + quadrantDirection.y * halfWidth;
 	
@@ -60,7 +65,8 @@ Quadtree::Quadtree(ofRectangle& nodeBounds, QuadrantEnum quadrant, int depthLeve
 	bodyCount = 0;
 	totalMass = nodeMass;
 	centerOfMass = nodeCOM;
-	nodeBody = nullptr;
+	nodeBodyIndex = SIZE_MAX;
+	maximumRadius = 0;
 	depth = depthLevel;
 	
 	
@@ -72,16 +78,17 @@ Quadtree::Quadtree(ofRectangle& nodeBounds, QuadrantEnum quadrant, int depthLeve
 }
 
 
-Quadtree::Quadtree(ofRectangle& nodeBounds, QuadrantEnum quadrant)
+template<typename Real>
+BasicQuadtree<Real>::BasicQuadtree(Rectangle& nodeBounds, QuadrantEnum quadrant)
 {
-	float halfWidth = nodeBounds.width * 0.5;
+	Real halfWidth = nodeBounds.width * 0.5;
 	bounds.width = halfWidth;
 	bounds.height = halfWidth;
 	
 	ofVec2f quadrantDirection = DetermineQuadrantDirection(quadrant) * 0.5;
 	//bounds.x = nodeBounds.x + quadrantDirection.x * halfWidth;
 	//bounds.y = nodeBounds.y + quadrantDirection.y * halfWidth;
-	ofVec2f boundsTopLeft = ofVec2f(nodeBounds.x, nodeBounds.y) + quadrantDirection * halfWidth;
+	Vector boundsTopLeft(nodeBounds.x + quadrantDirection.x * halfWidth, nodeBounds.y + quadrantDirection.y * halfWidth);
 	
 	bounds.x = boundsTopLeft.x;
 	bounds.y = boundsTopLeft.y;
@@ -114,7 +121,8 @@ Quadtree::Quadtree(ofRectangle& nodeBounds, QuadrantEnum quadrant)
 	totalMass = 0;
 	centerOfMass.set(0,0);
 	
-	nodeBody = nullptr;
+	nodeBodyIndex = SIZE_MAX;
+	maximumRadius = 0;
 	hasChildren = false;
 	
 	children[0] = nullptr;
@@ -125,15 +133,17 @@ Quadtree::Quadtree(ofRectangle& nodeBounds, QuadrantEnum quadrant)
 
 
 
-Quadtree::~Quadtree()
+template<typename Real>
+BasicQuadtree<Real>::~BasicQuadtree()
 {
-	bounds = ofRectangle();
+	bounds = Rectangle();
 	centerOfMass.set(0, 0);
 	totalMass = 0;
 	hasChildren = false;
 	bodyCount = 0;
 	depth = 0;
-	nodeBody = nullptr;
+	nodeBodyIndex = SIZE_MAX;
+	maximumRadius = 0;
 	
 	
 	delete children[0];
@@ -143,109 +153,123 @@ Quadtree::~Quadtree()
 }
 
 
-void Quadtree::insert(Body *& body)
+template<typename Real>
+void BasicQuadtree<Real>::insert(const BodyStoreType &bodies, size_t bodyIndex)
 {
-	//if(body == nullptr)
-	//{
-	//     return;
-	//}
-	//if(bounds.width < body->mass) // Only insert the body if it fits within the bounds of the node
-	//{
-	
-	//cout<<"\n\nBody insertion failed, node bounds could not enclose body";
-	//cout<<"\nbounds.width: " << bounds.width;
-	//cout << "    \nBounds Position: (" << bounds.x; cout << ", " << bounds.y; cout << ")";
-	
-	
-	//cout << "    \n\nBody Position: (" << body->position.x; cout << ", " << body->position.y; cout << ")";
-	//cout << "    \nBody Mass: " << body->mass << endl << endl << endl;
-	
-	//return;
-	//}
-	
+	Vector position(bodies.x[bodyIndex], bodies.y[bodyIndex]);
+	Real mass = bodies.mass[bodyIndex];
 	
 	
 	if(bodyCount > 1)
 	{
-		QuadrantEnum quad = DetermineQuadrant(bounds, body->position);
+		QuadrantEnum quad = childSlot(position, bodyCount);
 		
 		
 		if (children[quad] == nullptr)
 		{
-			children[quad] = new Quadtree(bounds, quad, depth + 1, body->mass, body->position);
+			children[quad] = createChild(quad, mass, position);
 		}
-		children[quad]->insert(body);
+		children[quad]->insert(bodies, bodyIndex);
 		
 		bodyCount = bodyCount + 1;
-		totalMass += body->mass;
+		totalMass += mass;
 		hasChildren = true;
 	}
 	else if(bodyCount == 1)
 	{
-		QuadrantEnum quad = DetermineQuadrant(bounds, nodeBody->position);
+		QuadrantEnum quad = childSlot(Vector(bodies.x[nodeBodyIndex], bodies.y[nodeBodyIndex]), 0);
 		
 		if (children[quad] == nullptr) //check if child node containing the body exists, if not, create it
 		{
-			children[quad] = new Quadtree(bounds, quad, depth + 1, body->mass, body->position);
+			children[quad] = createChild(quad, mass, position);
 		}
-		children[quad]->insert(nodeBody);
+		children[quad]->insert(bodies, nodeBodyIndex);
 		
 		
 		
 		
-		quad = DetermineQuadrant(bounds, body->position);
+		quad = childSlot(position, 1);
 		if(children[quad] == nullptr) //check if child node containing the body exists, if not, create it
 		{
-			children[quad] = new Quadtree(bounds, quad, depth + 1, body->mass, body->position);
+			children[quad] = createChild(quad, mass, position);
 		}
-		children[quad]->insert(body);
+		children[quad]->insert(bodies, bodyIndex);
 		
 		
 		bodyCount = bodyCount + 1;
-		totalMass += body->mass;
+		totalMass += mass;
 		hasChildren = true;
 	}
 	else if(bodyCount == 0)
 	{
-		nodeBody = body;
+		nodeBodyIndex = bodyIndex;
 		bodyCount = 1;
 	}
 }
 
 
-void Quadtree::computeTreeMassDistribution()
+template<typename Real>
+QuadrantEnum BasicQuadtree<Real>::childSlot(const Vector &position, int ordinal) const
+{
+	if (depth < maxDepth)
+	{
+		return DetermineQuadrant(bounds, position);
+	}
+	return (QuadrantEnum)(ordinal % 4); // too deep to split space any further, deal the bodies out over the slots instead
+}
+
+
+template<typename Real>
+BasicQuadtree<Real>* BasicQuadtree<Real>::createChild(QuadrantEnum quad, Real mass, Vector &position)
+{
+	BasicQuadtree* child = new BasicQuadtree(bounds, quad, depth + 1, mass, position);
+	if (depth >= maxDepth)
+	{
+		child->bounds = bounds; // a bucket slot covers the whole cell, its bodies may lie anywhere in it
+	}
+	return child;
+}
+
+
+template<typename Real>
+void BasicQuadtree<Real>::computeTreeMassDistribution(const BodyStoreType &bodies)
 {
 	if (bodyCount == 0)
 	{
 		totalMass = 0;
+		maximumRadius = 0;
 		centerOfMass.set(0, 0);
 		return;
 	}
 	
 	if (bodyCount == 1)
 	{
-		centerOfMass = nodeBody->position;
-		totalMass = nodeBody->mass;
+		centerOfMass.set(bodies.x[nodeBodyIndex], bodies.y[nodeBodyIndex]);
+		totalMass = bodies.mass[nodeBodyIndex];
+		maximumRadius = bodies.mass[nodeBodyIndex];
 	}
 	else if (hasChildren || bodyCount > 1)
 	{
-		ofVec2f tempCOM(0.0, 0.0);
+		Vector tempCOM(0.0, 0.0);
 		totalMass = 0;
+		maximumRadius = 0;
 		
 		for (int i = 0; i < 4; ++i)
 		{
 			if (children[i] && children[i]->bodyCount > 0)
 			{
-				children[i]->computeTreeMassDistribution();
+				children[i]->computeTreeMassDistribution(bodies);
 				
 				totalMass += children[i]->totalMass;
 				tempCOM +=  children[i]->centerOfMass * children[i]->totalMass;
+				maximumRadius = std::max(maximumRadius, children[i]->maximumRadius);
 			}
 		}
 		centerOfMass = tempCOM / totalMass;
 	}
 }
-void Quadtree::pruneNode(Quadtree* &treeNode)
+template<typename Real>
+void BasicQuadtree<Real>::pruneNode(BasicQuadtree* &treeNode)
 {
 	if(treeNode)
 	{
@@ -272,7 +296,8 @@ void Quadtree::pruneNode(Quadtree* &treeNode)
 	}
 }
 
-void Quadtree::pruneEmptyNodes(Quadtree* &treeNode)
+template<typename Real>
+void BasicQuadtree<Real>::pruneEmptyNodes(BasicQuadtree* &treeNode)
 {
 	if(treeNode == nullptr)
 	{
@@ -307,30 +332,30 @@ void Quadtree::pruneEmptyNodes(Quadtree* &treeNode)
 }
 
 
-void Quadtree::resetNode(Quadtree *&treeNode)
+template<typename Real>
+void BasicQuadtree<Real>::resetNode(BasicQuadtree *&treeNode)
 {
 	if(treeNode)
 	{
-		treeNode->bounds = ofRectangle();
+		treeNode->bounds = Rectangle();
 		treeNode->centerOfMass.set(0, 0);
 		treeNode->totalMass = 0;
 		treeNode->hasChildren = false;
 		treeNode->bodyCount = 0;
 		treeNode->depth = 0;
-		treeNode->nodeBody = nullptr;
+		treeNode->nodeBodyIndex = SIZE_MAX;
+		treeNode->maximumRadius = 0;
 		
-		delete treeNode;
-		delete treeNode->children[0];
-		delete treeNode->children[1];
-		delete treeNode->children[2];
-		delete treeNode->children[3];
+		delete treeNode; // the destructor recursively frees the children, they must not be deleted again here
 	}
 	treeNode = nullptr;
 }
 
 
 
-void Quadtree::draw()
+#if !defined(NBODY_HEADLESS) // no drawing in the headless build
+template<typename Real>
+void BasicQuadtree<Real>::draw()
 {
 	if (hasChildren)
 	{
@@ -346,14 +371,16 @@ void Quadtree::draw()
 	ofNoFill();
 	ofSetLineWidth(0.75);
 	ofSetColor(255, 255, 255, 96.75);
-	ofDrawRectangle(bounds);  // draw the bounding box of the node
+	ofDrawRectangle(bounds.x, bounds.y, bounds.width, bounds.height);  // draw the bounding box of the node
 	
 }
+#endif
 
 
 
 
-void Quadtree:: printTree()
+template<typename Real>
+void BasicQuadtree<Real>:: printTree()
 {
 	cout << "\n\n\n\n\nnodeBounds.size: " << bounds.width;
 	cout << "\nnodeBounds.center: (" << bounds.x;  cout << ", " << bounds.y; cout << " )";
@@ -365,14 +392,9 @@ void Quadtree:: printTree()
 	
 	cout << "\n\nNode Depth: " << depth;
 	cout << "\nbodyCount: " << bodyCount;
-	if(nodeBody)
+	if(!hasChildren && nodeBodyIndex != SIZE_MAX)
 	{
-		cout << "\nNode Quadrant: " << DetermineQuadrant(bounds, nodeBody->position);
-		
-		
-		cout << "\n\nnodeBody.mass: " << nodeBody->mass;
-		cout << "\nnodeBody.position: (" << nodeBody->position.x;  cout << ", " << nodeBody->position.y; cout << " )";
-		cout << "\nnodeBody.velocity: (" << nodeBody->velocity.x;  cout << ", " << nodeBody->velocity.y; cout << " )";
+		cout << "\nnodeBodyIndex: " << nodeBodyIndex;
 	}
 	cout << "\n\n\n\n";
 	
@@ -385,3 +407,9 @@ void Quadtree:: printTree()
 		}
 	}
 }
+
+
+
+
+template class BasicQuadtree<float>;
+template class BasicQuadtree<double>;
@@ -163,18 +163,17 @@
 
 
 #pragma once
-#include "Vects.hpp"
-#include "Geometry.hpp"
-#include "CoordinateSystem.hpp"
-#include "StatisticalMethods.hpp"
-#include "DrawingUtilities.hpp"
 #include "SequenceContainers.hpp"
-#include "ObjectPool.hpp"
 #include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
 #include "QuadrantUtils.hpp"
-#include "ofMain.h"
+#include "Precision.hpp"
+#include "PhaseProfiler.hpp"
+#include "CoreTypes.hpp"
 
 
+#include <array>
+#include <cstdint>
 #include <unordered_set>
 #include <algorithm>  // for std::find
 
@@ -182,49 +181,77 @@
 
 
 
-const float maxDepth = 14; // Barnes-Hut approximation parameter
+/**
+ * maxDepth: Deepest level 'insert' splits space at. A node this deep that receives a second body hands its bodies out over
+ * its four child slots in arrival order, each slot covering the whole node, so bodies at the same (or unresolvably close)
+ * position end up in leaves of their own a few levels further down instead of subdividing forever. The walks need no
+ * change, such a node is an ordinary cell to them. With the default root a node at this depth is about 0.03 wide, around
+ * float's resolution at the edge of the root.
+ */
+const int maxDepth = 24;
 
-class Quadtree
+/**
+ * BasicQuadtree: one node of the tree, a template on the scalar type 'Real' like the bodies it holds.
+ *
+ * Instantiated for float and double in Quadtree.cpp. 'Quadtree' is the float instantiation the application runs on,
+ * its bounds are an ofRectangle and its centre of mass an ofVec2f as before.
+ */
+template<typename Real>
+class BasicQuadtree
 {
 public:
+	typedef typename PrecisionTraits<Real>::Vector Vector;
+	typedef typename PrecisionTraits<Real>::Rectangle Rectangle;
+	typedef BasicBody<Real> BodyType;
+	typedef BasicBodyStore<Real> BodyStoreType;
+	
+	
 	// ------------- Constructors and Destructor -------------
-	Quadtree();
-	Quadtree(const Quadtree* other);
-	Quadtree(ofRectangle& nodeBounds, QuadrantEnum quadrant, int depthLevel, float nodeMass, ofVec2f& nodeCOM);
-	Quadtree(ofRectangle& nodeBounds, QuadrantEnum quadrant);
-	~Quadtree();
+	BasicQuadtree();
+	BasicQuadtree(const BasicQuadtree* other);
+	BasicQuadtree(Rectangle& nodeBounds, QuadrantEnum quadrant, int depthLevel, Real nodeMass, Vector& nodeCOM);
+	BasicQuadtree(Rectangle& nodeBounds, QuadrantEnum quadrant);
+	~BasicQuadtree();
 	
 	
 	// ------------- Spatial Operations -------------
-	void insert(Body *& body); // Inserts a body into the Quadtree.
-	void computeTreeMassDistribution();
-	void pruneNode(Quadtree* &treeNode); //Recursively free this treeNode and all of its children.
-	void pruneEmptyNodes(Quadtree* &treeNode);
+	void insert(const BodyStoreType &bodies, size_t bodyIndex); // Inserts body 'bodyIndex' of 'bodies' into the Quadtree, reading its position and mass there.
+	QuadrantEnum childSlot(const Vector &position, int ordinal) const; // Child a body goes to, by position above maxDepth and by its arrival 'ordinal' at or below it.
+	BasicQuadtree* createChild(QuadrantEnum quad, Real mass, Vector &position); // New child in slot 'quad', a quadrant above maxDepth and a copy of this node's bounds at or below it.
+	void computeTreeMassDistribution(const BodyStoreType &bodies); // Centres of mass and masses of every node, from the current positions in the store the tree was built from.
+	void pruneNode(BasicQuadtree* &treeNode); //Recursively free this treeNode and all of its children.
+	void pruneEmptyNodes(BasicQuadtree* &treeNode);
 	
 	
 	// ------------- Node Operations -------------
-	void resetNode(Quadtree *&treeNode); // Resets a specific node for reuse.
+	void resetNode(BasicQuadtree *&treeNode); // Resets a specific node for reuse.
+#if !defined(NBODY_HEADLESS)
 	void draw(); // Visualization method for debugging and representation.
+#endif
 	void printTree();
 	
 	
 	
 	// ------------- Member Variables(Tree Parameters) -------------
-	ofRectangle bounds; // Bounding box for this quadtree node.
+	Rectangle bounds; // Bounding box for this quadtree node.
 	
-	/** \brief Data for the body.
-	 Only valid if this is a leaf node.
+	/** \brief Index of the body in the store the tree was built from.
+	 Only valid if this is a leaf node, SIZE_MAX in an empty one.
 	 */
-	Body *nodeBody;
+	size_t nodeBodyIndex;
 	
-	std::array<Quadtree*, 4> children; // Child nodes.
+	std::array<BasicQuadtree*, 4> children; // Child nodes.
 	int depth; // Depth level of the node.
-	ofVec2f centerOfMass; // Center of mass of all bodies in this node.
-	float totalMass; // Combined mass of all bodies in this node.
+	Vector centerOfMass; // Center of mass of all bodies in this node.
+	Real totalMass; // Combined mass of all bodies in this node.
+	Real maximumRadius; // Largest radius (mass) of the bodies in this node, set with the mass distribution.
 	bool hasChildren; // Flag indicating the presence of children.
 	int bodyCount; // Number of bodies in this node.
 };
 
+typedef BasicQuadtree<float> Quadtree;
+extern template class BasicQuadtree<float>;
+extern template class BasicQuadtree<double>;
 
 
 
@@ -232,12 +259,19 @@ public:
 
 
 
-static inline void TestBuildQuadtree(Quadtree* &rootNode, std::vector<Body *> &bodies, ObjectPool<Body> &bodyPool);
-static inline void BuildQuadtree(Quadtree* &rootNode,  std::vector<Body *> &bodies, ObjectPool<Body> &bodyPool);
-static inline void ComputeQuadtreeMassDistribution(Quadtree* &rootNode);//compute the barycenters/center of masses of all nodes in tree
-static inline void PruneEmptyNodesFromTree(Quadtree* &rootNode); //prune the empty nodes from the quadtree
-static inline void ResetTree(Quadtree* &rootNode);//reset all nodes in tree nodes except the root node
 
+template<typename Real>
+static inline void TestBuildQuadtree(BasicQuadtree<Real>* &rootNode, BasicBodyStore<Real> &bodies);
+template<typename Real>
+static inline void BuildQuadtree(BasicQuadtree<Real>* &rootNode, const BasicBodyStore<Real> &bodies);
+template<typename Real>
+static inline void BuildQuadtree(BasicQuadtree<Real>* &rootNode, const BasicBodyStore<Real> &bodies, const typename PrecisionTraits<Real>::Rectangle &rootBounds); //build with explicit root bounds, e.g., a periodic domain
+template<typename Real>
+static inline void ComputeQuadtreeMassDistribution(BasicQuadtree<Real>* &rootNode, const BasicBodyStore<Real> &bodies);//compute the barycenters/center of masses of all nodes in tree from the bodies' current positions
+template<typename Real>
+static inline void PruneEmptyNodesFromTree(BasicQuadtree<Real>* &rootNode); //prune the empty nodes from the quadtree
+template<typename Real>
+static inline void ResetTree(BasicQuadtree<Real>* &rootNode);//reset all nodes in tree nodes except the root node
 
 
 
@@ -249,23 +283,26 @@ static inline void ResetTree(Quadtree* &rootNode);//reset all nodes in tree node
 
 
 
-static inline void TestBuildQuadtree(Quadtree* &rootNode, std::vector<Body *> &bodies, ObjectPool<Body> &bodyPool)
+
+template<typename Real>
+static inline void TestBuildQuadtree(BasicQuadtree<Real>* &rootNode, BasicBodyStore<Real> &bodies)
 {
-	rootNode = new Quadtree();  // Create a new Quadtree and have rootQuadtree point to it
+	delete rootNode; // free the previous frame's root (and whatever is left of its subtree) before replacing it
+	rootNode = new BasicQuadtree<Real>();  // Create a new Quadtree and have rootQuadtree point to it
 	rootNode->bounds.set(-250000, -250000, 500000, 500000);
 	
 	
-	for (size_t i = 0; i < bodies.size(); i++)
+	for (size_t i = 0; i < bodies.size(); )
 	{
-		if(bodies[i] != nullptr && bodies[i]->mass != 0)
+		if(bodies.mass[i] != 0)
 		{
-			rootNode->insert(bodies[i]);
+			rootNode->insert(bodies, i);
+			i++;
 		}
 		else
 		{
-			ReleaseObjectFromPool(bodyPool, bodies, i);
-			bodies.erase(bodies.begin() + i);
-			cout<<"\n\nBody insertion failed, either nullptr or mass == 0\n\n" << endl;
+			RemoveBody(bodies, (BodyIndex)i); // O(1), the last body moves into 'i' and is examined next
+			cout<<"\n\nBody insertion failed, mass == 0\n\n" << endl;
 		}
 	}
 	
@@ -273,43 +310,56 @@ static inline void TestBuildQuadtree(Quadtree* &rootNode, std::vector<Body *> &b
 	
 	
 	PruneEmptyNodesFromTree(rootNode);
-	ComputeQuadtreeMassDistribution(rootNode);
+	ComputeQuadtreeMassDistribution(rootNode, bodies);
 	
 	
 	cout<<"\n\n Tree Complete ofGetElapsedTimef(): " << ofGetElapsedTimef();
 }
 
 
-static inline void BuildQuadtree(Quadtree* &rootNode, std::vector<Body *> &bodies, ObjectPool<Body> &bodyPool)
+template<typename Real>
+static inline void BuildQuadtree(BasicQuadtree<Real>* &rootNode, const BasicBodyStore<Real> &bodies)
 {
-	rootNode = new Quadtree();  // Create a new Quadtree and have rootQuadtree point to it
-	rootNode->bounds.set(-250000, -250000, 500000, 500000);
+	BuildQuadtree(rootNode, bodies, typename PrecisionTraits<Real>::Rectangle(-250000, -250000, 500000, 500000));
+}
+
+
+template<typename Real>
+static inline void BuildQuadtree(BasicQuadtree<Real>* &rootNode, const BasicBodyStore<Real> &bodies, const typename PrecisionTraits<Real>::Rectangle &rootBounds)
+{
+	PROFILE_PHASE(BuildQuadtree); // the pruning and mass distribution below are charged to their own phases
+	delete rootNode; // free the previous frame's root (and whatever is left of its subtree) before replacing it
+	rootNode = new BasicQuadtree<Real>();  // Create a new Quadtree and have rootQuadtree point to it
+	rootNode->bounds = rootBounds;
 	
 	
 	for (size_t i = 0; i < bodies.size(); i++)
 	{
-		rootNode->insert(bodies[i]);
-		
+		rootNode->insert(bodies, i);
 	}
 	
 	
 	PruneEmptyNodesFromTree(rootNode);
-	ComputeQuadtreeMassDistribution(rootNode);
+	ComputeQuadtreeMassDistribution(rootNode, bodies);
 }
 
 
 
 
-static inline void ComputeQuadtreeMassDistribution(Quadtree* &rootNode)
+template<typename Real>
+static inline void ComputeQuadtreeMassDistribution(BasicQuadtree<Real>* &rootNode, const BasicBodyStore<Real> &bodies)
 {
-	rootNode->computeTreeMassDistribution();
+	PROFILE_PHASE(MassDistribution);
+	rootNode->computeTreeMassDistribution(bodies);
 }
 
 
 
 
-static inline void PruneEmptyNodesFromTree(Quadtree* &rootNode)
+template<typename Real>
+static inline void PruneEmptyNodesFromTree(BasicQuadtree<Real>* &rootNode)
 {
+	PROFILE_PHASE(PruneEmptyNodes);
 	int mostDepth = 0;
 	rootNode->pruneEmptyNodes(rootNode);
 }
@@ -317,8 +367,10 @@ static inline void PruneEmptyNodesFromTree(Quadtree* &rootNode)
 
 
 
-static inline void ResetTree(Quadtree* &rootNode) //reset and delete all nodes except the root node
+template<typename Real>
+static inline void ResetTree(BasicQuadtree<Real>* &rootNode) //reset and delete all nodes except the root node
 {
+	PROFILE_PHASE(ResetTree);
 	if (rootNode->hasChildren)
 	{
 		for (auto& child : rootNode->children)
@@ -374,9 +426,7 @@ static inline void ResetTree(Quadtree* &rootNode) //reset and delete all nodes e
 
 
 static inline int BarnesHutMAC(Quadtree* &node, ofVec2f bodyPosition, float theta);
-static inline void ComputeQuadTreeForce(Quadtree* &rootNode, std::vector<Body*> &bodies, ofVec2f* &bodiesAccelerations, float G, float theta);
-static inline int TraverseInteractionList(Quadtree* &rootNode, ofVec2f bodyPosition, ofVec2f &bodiesAccelerations, Quadtree** &walkList, Quadtree** &interactList, float G, float theta);
-static inline int ComputeForceInteractionList(Body *&body, ofVec2f &bodiesAccelerations, Quadtree** &interactList, int listLength);
+// ComputeQuadTreeForce, TraverseInteractionList and ComputeForceInteractionList, the walk-list/interact-list walk, live in InteractionWalk.hpp
 
 
 
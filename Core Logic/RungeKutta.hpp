@@ -0,0 +1,192 @@
+//  RungeKutta.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * RungeKutta Module: Classical fourth-order Runge-Kutta with a force evaluation at every stage
+ *
+ * Description:
+ * For x' = v, v' = a(x) the classical RK4 step is
+ * 			k1x = v0,                  k1v = a(x0)
+ * 			k2x = v0 + dt/2 k1v,       k2v = a(x0 + dt/2 k1x)
+ * 			k3x = v0 + dt/2 k2v,       k3v = a(x0 + dt/2 k2x)
+ * 			k4x = v0 + dt k3v,         k4v = a(x0 + dt k3x)
+ * 			x1  = x0 + dt/6 (k1x + 2 k2x + 2 k3x + k4x),    v1 = v0 + dt/6 (k1v + 2 k2v + 2 k3v + k4v)
+ * Only with a(x) evaluated at each trial position is the method fourth order, holding the acceleration of the
+ * start of the step fixed for all stages (as 'IntegrateRK4Force' does) collapses it to a first order scheme.
+ *
+ * k1v is the acceleration the caller already computed for the frame. The three remaining evaluations are made by
+ * the caller supplied 'evaluateForces', with every body temporarily moved to its trial position. The trial positions
+ * are within one step of the start, so the tree built for the frame keeps a valid topology and only its node
+ * masses and centres of mass have to be refit, which makes stages 2-4 much cheaper than a full build-and-walk.
+ */
+#pragma once
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "AlignedArray.hpp"
+#include "PhaseProfiler.hpp"
+#include "ofMain.h"
+
+
+
+
+/**
+ * RungeKuttaStages: Scratch state of the RK4 stages, one aligned array per component, kept between frames to avoid reallocating it.
+ */
+class RungeKuttaStages
+{
+public:
+	AlignedArray<float> initialX;  // x0 of every body
+	AlignedArray<float> initialY;
+	AlignedArray<float> initialVx;  // v0 of every body
+	AlignedArray<float> initialVy;
+	AlignedArray<float> stageVx;  // kx of the current stage
+	AlignedArray<float> stageVy;
+	AlignedArray<float> positionSumX;  // k1x + 2 k2x + 2 k3x + k4x, accumulated over the stages
+	AlignedArray<float> positionSumY;
+	AlignedArray<float> velocitySumX;  // k1v + 2 k2v + 2 k3v + k4v, accumulated over the stages
+	AlignedArray<float> velocitySumY;
+	size_t stageEvaluations = 0;  // Number of force evaluations made for stages 2-4, for diagnostics
+};
+
+
+
+
+
+
+
+
+/**
+ * IntegrateRungeKutta4: Advance all bodies by 'dt' with classical RK4, evaluating the forces at every stage.
+ *
+ * @param dt             Time step
+ * @param bodies         The bodies, their accelerations (ax, ay) are those of the start of the step on entry and the last stage's on return
+ * @param stages         Scratch state of the stages
+ * @param evaluateForces Callable refilling the bodies' accelerations for their current (trial) positions
+ */
+template<typename EvaluateForces>
+static inline void IntegrateRungeKutta4(float dt, BodyStore &bodies, RungeKuttaStages &stages, EvaluateForces evaluateForces);
+
+
+
+/**
+ * ResizeRungeKuttaStages: Size every scratch array for 'count' bodies.
+ */
+static inline void ResizeRungeKuttaStages(RungeKuttaStages &stages, size_t count);
+
+
+
+
+
+
+
+
+
+
+
+
+template<typename EvaluateForces>
+static inline void IntegrateRungeKutta4(float dt, BodyStore &bodies, RungeKuttaStages &stages, EvaluateForces evaluateForces)
+{
+	PROFILE_PHASE(Integrate); // the stage force evaluations are charged to their own phases
+	size_t n = bodies.size();
+	ResizeRungeKuttaStages(stages, n);
+	float* x0 = stages.initialX.data();
+	float* y0 = stages.initialY.data();
+	float* vx0 = stages.initialVx.data();
+	float* vy0 = stages.initialVy.data();
+	float* kx = stages.stageVx.data();
+	float* ky = stages.stageVy.data();
+	float* positionSumX = stages.positionSumX.data();
+	float* positionSumY = stages.positionSumY.data();
+	float* velocitySumX = stages.velocitySumX.data();
+	float* velocitySumY = stages.velocitySumY.data();
+
+
+	// Stage 1, from the accelerations already computed for this frame
+	float* x = bodies.x.data();
+	float* y = bodies.y.data();
+	float* vx = bodies.vx.data();
+	float* vy = bodies.vy.data();
+	const float* ax = bodies.ax.data();
+	const float* ay = bodies.ay.data();
+	for (size_t i = 0; i < n; i++)
+	{
+		x0[i] = x[i];
+		y0[i] = y[i];
+		vx0[i] = vx[i];
+		vy0[i] = vy[i];
+	}
+	for (size_t i = 0; i < n; i++)
+	{
+		kx[i] = vx0[i];
+		ky[i] = vy0[i];
+		positionSumX[i] = vx0[i];
+		positionSumY[i] = vy0[i];
+		velocitySumX[i] = ax[i];
+		velocitySumY[i] = ay[i];
+	}
+
+
+	// Stages 2-4, each moves the bodies to the trial positions of the previous stage and evaluates the forces there
+	const float stageFractions[3] = {0.5f, 0.5f, 1.0f};
+	const float stageWeights[3] = {2.0f, 2.0f, 1.0f};
+	for (int s = 0; s < 3; s++)
+	{
+		float h = stageFractions[s] * dt;
+		for (size_t i = 0; i < n; i++)
+		{
+			x[i] = x0[i] + kx[i] * h;
+			y[i] = y0[i] + ky[i] * h;
+		}
+		for (size_t i = 0; i < n; i++) // the previous stage's kv, before the evaluation overwrites it
+		{
+			kx[i] = vx0[i] + ax[i] * h;
+			ky[i] = vy0[i] + ay[i] * h;
+		}
+
+		evaluateForces();
+		stages.stageEvaluations++;
+
+		float w = stageWeights[s];
+		x = bodies.x.data(); // the evaluation may have reallocated the arrays
+		y = bodies.y.data();
+		ax = bodies.ax.data();
+		ay = bodies.ay.data();
+		for (size_t i = 0; i < n; i++)
+		{
+			positionSumX[i] += kx[i] * w;
+			positionSumY[i] += ky[i] * w;
+			velocitySumX[i] += ax[i] * w;
+			velocitySumY[i] += ay[i] * w;
+		}
+	}
+
+
+	float sixth = dt / 6;
+	vx = bodies.vx.data();
+	vy = bodies.vy.data();
+	for (size_t i = 0; i < n; i++)
+	{
+		x[i] = x0[i] + positionSumX[i] * sixth;
+		y[i] = y0[i] + positionSumY[i] * sixth;
+		vx[i] = vx0[i] + velocitySumX[i] * sixth;
+		vy[i] = vy0[i] + velocitySumY[i] * sixth;
+	}
+}
+
+
+
+static inline void ResizeRungeKuttaStages(RungeKuttaStages &stages, size_t count)
+{
+	stages.initialX.resize(count);
+	stages.initialY.resize(count);
+	stages.initialVx.resize(count);
+	stages.initialVy.resize(count);
+	stages.stageVx.resize(count);
+	stages.stageVy.resize(count);
+	stages.positionSumX.resize(count);
+	stages.positionSumY.resize(count);
+	stages.velocitySumX.resize(count);
+	stages.velocitySumY.resize(count);
+}
@@ -9,14 +9,16 @@
 
 
 
-Body::Body()
+template<typename Real>
+BasicBody<Real>::BasicBody()
 {
 	position.set(0, 0);
 	velocity.set(0, 0);
 	mass = 0;
 }
 
-Body::Body(ofVec2f pos, ofVec2f vel, float _mass)
+template<typename Real>
+BasicBody<Real>::BasicBody(Vector pos, Vector vel, Real _mass)
 {
 	position = pos;
 	velocity = vel;
@@ -26,18 +28,21 @@ Body::Body(ofVec2f pos, ofVec2f vel, float _mass)
 
 
 // Copy constructor
-Body::Body(const Body& other) : position(other.position), velocity(other.velocity), mass(other.mass){}
+template<typename Real>
+BasicBody<Real>::BasicBody(const BasicBody& other) : position(other.position), velocity(other.velocity), mass(other.mass){}
 
-Body::~Body()
+template<typename Real>
+BasicBody<Real>::~BasicBody()
 {
-	position = {0,0};
-	velocity = {0,0};
+	position.set(0, 0);
+	velocity.set(0, 0);
 	mass = 0;
 }
 
 
 // Assignment operator
-Body& Body::operator=(const Body& other)
+template<typename Real>
+BasicBody<Real>& BasicBody<Real>::operator=(const BasicBody& other)
 {
 	if (this != &other)
 	{
@@ -50,7 +55,8 @@ Body& Body::operator=(const Body& other)
 
 
 
-bool Body::operator!=(const Body& other)
+template<typename Real>
+bool BasicBody<Real>::operator!=(const BasicBody& other)
 {
 	bool notEqual = false;
 	if (this == &other)
@@ -63,19 +69,22 @@ bool Body::operator!=(const Body& other)
 
 
 
-void Body::applyForce(ofVec2f& force)
+template<typename Real>
+void BasicBody<Real>::applyForce(Vector& force)
 {
-	ofVec2f acceleration = force / mass;
+	Vector acceleration = force / mass;
 	velocity = velocity + acceleration;
 }
 
-void Body::dampMotion(float dampParameter)
+template<typename Real>
+void BasicBody<Real>::dampMotion(Real dampParameter)
 {
 	velocity = velocity*dampParameter;
 }
 
 
-void Body::setParameters(ofVec2f pos, ofVec2f vel, float _mass)
+template<typename Real>
+void BasicBody<Real>::setParameters(Vector pos, Vector vel, Real _mass)
 {
 	position = pos;
 	velocity = vel;
@@ -84,7 +93,8 @@ void Body::setParameters(ofVec2f pos, ofVec2f vel, float _mass)
 
 
 
-void Body::reset()
+template<typename Real>
+void BasicBody<Real>::reset()
 {
 	position.set(0, 0);
 	velocity.set(0, 0);
@@ -95,7 +105,9 @@ void Body::reset()
 
 
 
-void Body:: draw(bool colorMode)
+#if !defined(NBODY_HEADLESS) // no drawing in the headless build
+template<typename Real>
+void BasicBody<Real>:: draw(bool colorMode)
 {
 	//
 	/*
@@ -150,6 +162,11 @@ void Body:: draw(bool colorMode)
 	//ofVec2f orientationVector = ofVec2f(cos(orientation), sin(orientation)) * mass;
 	//ofDrawLine(position, position + orientationVector);
 }
+#endif
+
+
+template class BasicBody<float>;
+template class BasicBody<double>;
 
 
 
@@ -250,6 +267,7 @@ bool BodyData::operator!=(const BodyData& other)
 
 
 
+#if !defined(NBODY_HEADLESS)
 void BodyData:: draw(bool colorMode, const Body body)
 {
 	float energyNormalized = kineticEnergy / (kineticEnergy + fabs(potentialEnergy));
@@ -303,4 +321,5 @@ void BodyData:: draw(bool colorMode, const Body body)
 	ofVec2f orientationVector = ofVec2f(cos(orientation), sin(orientation)) * orientationLineLength;
 	ofDrawLine(body.position, body.position + orientationVector);
 }
+#endif
 
@@ -4,13 +4,9 @@
 
 
 #pragma once
-#include "Vects.hpp"
-#include "Geometry.hpp"
-#include "CoordinateSystem.hpp"
-#include "StatisticalMethods.hpp"
-#include "DrawingUtilities.hpp"
 #include "SequenceContainers.hpp"
-#include "ofMain.h"
+#include "Precision.hpp"
+#include "CoreTypes.hpp"
 
 
 const float epsilon = 50; // softening parameer in force calculations, (usualy < 1, but set at a higher value to keep bodies from having a too great accel from close encounters);
@@ -27,47 +23,60 @@ const float epsilon = 50; // softening parameer in force calculations, (usualy <
  * Will be computed with some initial conditions, from which a quadctree that encompasses all bodies
  * will be generated.
  *
+ * The class is a template on the scalar type 'Real' (see Precision.hpp), instantiated for float and double in
+ * SimulationEntities.cpp. 'Body' is the float instantiation the application runs on.
+ *
  *  NOTE: Mass is used as analogous to radius for the rigid 2D bodies of this simulation
  */
-class Body
+template<typename Real>
+class BasicBody
 {
 public:
+	typedef typename PrecisionTraits<Real>::Vector Vector;
+	
+	
 	// ------------- Constructors and Destructor -------------
-	Body();
-	Body(ofVec2f pos, ofVec2f vel, float _mass);
-	Body(const Body& other);
-	~Body();
+	BasicBody();
+	BasicBody(Vector pos, Vector vel, Real _mass);
+	BasicBody(const BasicBody& other);
+	~BasicBody();
 	
 	
 	// ------------- Comparison operators -------------
-	Body& operator=(const Body& other);
-	bool operator!=(const Body& other);
+	BasicBody& operator=(const BasicBody& other);
+	bool operator!=(const BasicBody& other);
 	
 	
 	// ------------- Kinematic Operations -------------
-	void applyForce(ofVec2f& force);  //Applies a force vector to update position and velocity.
-	void dampMotion(float dampParameter); //Dampens the body's motion based on the damping parameter.
+	void applyForce(Vector& force);  //Applies a force vector to update position and velocity.
+	void dampMotion(Real dampParameter); //Dampens the body's motion based on the damping parameter.
 	
 	
 	// ------------- Utility Methods For Object Pooling-------------
-	void setParameters(ofVec2f pos, ofVec2f vel, float mass); // Sets the properties of an acquired body from object pool
+	void setParameters(Vector pos, Vector vel, Real mass); // Sets the properties of an acquired body from object pool
 	void reset(); //used to restore the body to a state that makes it ready for reuse     puts the object back to its initial state
 	
 	
 	
 	
 	// ------------- Visualization -------------
+#if !defined(NBODY_HEADLESS)
 	void draw(bool colorMode);
+#endif
 	
 	
 	
 	
 	// ------------- Member variables -------------
-	ofVec2f position; // Position of the body in 2D space.
-	ofVec2f velocity; // Velocity of the body in 2D space.
-	float mass; // Mass of the body, used as analogous to radius for the rigid circular body.
+	Vector position; // Position of the body in 2D space.
+	Vector velocity; // Velocity of the body in 2D space.
+	Real mass; // Mass of the body, used as analogous to radius for the rigid circular body.
 };
 
+typedef BasicBody<float> Body;
+extern template class BasicBody<float>;
+extern template class BasicBody<double>;
+
 
 
 static inline void ComputeEntitiesEnergy();
@@ -86,6 +95,7 @@ static inline void ComputeEntitiesEnergy();
  * that are in constant demand/reference from the parameters of the entities that are only needed
  * in certain circumstances(ex. energy only needs to be kept track of in the non-performance modes of simulation,
  * but for testing and benchmarking simulators)
+ * The simulation itself keeps this state as arrays in a 'BodyDataTable', allocated only while a visualization needs it.
  */
 class BodyData
 {
@@ -111,7 +121,9 @@ public:
 	
 	
 	// ------------- Visualization -------------
+#if !defined(NBODY_HEADLESS)
 	void draw(bool colorMode, const Body body);
+#endif
 	
 	
 	
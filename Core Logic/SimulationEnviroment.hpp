@@ -21,7 +21,7 @@
  *
  *
  * The SimulationConfig class serves as the main hub for configuring and operating
- * the simulation. It holds an object pool for Body objects and initializes the
+ * the simulation. It holds the bodies' store and initializes the
  * quadtree. It encapsulates all the core functionalities of the simulation and acts
  * as the interface for starting, updating, and rendering the simulation. It also
  * contains utility functions to generate initial conditions based on various
@@ -40,7 +40,7 @@
 
 
 #include "SimulationEntities.hpp"
-#include "ObjectPool.hpp"
+#include "BodyStore.hpp"
 #include "Quadtree.hpp"
 #include "PhysicsLogic.hpp"
 #include "VisualizationUtils.hpp"
@@ -50,7 +50,7 @@
 class SimulationEnviroment
 {
 	// ------------- Utility and Management -------------
-	ObjectPool<Body> bodyPool; // Object pool for Body objects
+	BodyStore bodies; // Positions, velocities, accelerations and masses of the bodies
 	
 	
 	// ------------- Coordinate Systems and User Interaction -------------
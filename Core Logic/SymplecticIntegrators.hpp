@@ -0,0 +1,385 @@
+//  SymplecticIntegrators.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * SymplecticIntegrators Module: Fourth-order symplectic compositions (Yoshida, Forest-Ruth) and energy diagnostics
+ *
+ * Description:
+ * Composing three leapfrog steps of lengths w1 dt, w0 dt, w1 dt with
+ * 			w1 = 1 / (2 - 2^(1/3)),   w0 = -2^(1/3) w1
+ * cancels the leapfrog's third order error term and gives a fourth-order integrator that is still symplectic, so the
+ * energy error stays bounded like the leapfrog's but shrinks as dt^4 instead of dt^2. Written out as alternating
+ * drifts (x += c_k v dt) and kicks (v += d_k a(x) dt) there are two forms:
+ * 			- Yoshida (velocity form), kick first:  d = {w1/2, (w0+w1)/2, (w0+w1)/2, w1/2},  c = {w1, w0, w1}
+ * 			- Forest-Ruth (position form), drift first:  c = {w1/2, (w0+w1)/2, (w0+w1)/2, w1/2},  d = {w1, w0, w1}
+ * Both need three new force evaluations per step.
+ * 			- Yoshida's first kick uses the accelerations the frame already computed on a freshly built tree, and its
+ * 			  last kick is evaluated at x_{n+1}, which the next frame computes anyway, so that kick is deferred to the
+ * 			  start of the next call (first same as last). The two evaluations in between refit that tree.
+ * 			- Forest-Ruth never evaluates at x_n, the frame only builds the tree and all three evaluations refit it.
+ * The sub-drifts move bodies by less than a step (w0 < 0 even moves them backwards), so the tree topology stays valid
+ * and only node masses and centres of mass have to be refit between them.
+ *
+ * To choose the cheapest integrator for a scenario, the total energy is sampled every few steps with a tree walk
+ * for the potential, and the relative energy error is reported next to the wall-clock time spent stepping.
+ */
+#pragma once
+#include <cmath>
+#include <chrono>
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "Quadtree.hpp"
+#include "PhysicsLogic.hpp"
+#include "ParallelUtilities.hpp"
+#include "ofMain.h"
+
+
+
+
+/**
+ * SymplecticScheme: The composition used by 'AdvanceSymplectic'.
+ */
+enum class SymplecticScheme
+{
+	LeapfrogKDK, // Second order, one force evaluation per step
+	Yoshida4, // Fourth order, velocity form, three force evaluations per step
+	ForestRuth4 // Fourth order, position form, three force evaluations per step
+};
+
+
+
+/**
+ * SymplecticIntegrator: Scheme, the deferred last kick of the kick-first forms, and the energy diagnostics.
+ */
+class SymplecticIntegrator
+{
+public:
+	// ------------- Configuration -------------
+	SymplecticScheme scheme = SymplecticScheme::Yoshida4;  // Which composition to step with
+	unsigned int threadCount = 0;  // Threads used by the force and potential walks, 0 selects the number of hardware threads
+	int energySampleInterval = 10;  // Steps between energy samples, each one costs a tree walk
+
+
+	// ------------- Per-Step State -------------
+	float pendingKick = 0;  // Length (in time) of the last kick, owed with the accelerations of the next call, the next dt may differ
+
+
+	// ------------- Diagnostics -------------
+	bool hasReferenceEnergy = false;  // Whether 'referenceEnergy' belongs to the current run
+	double referenceEnergy = 0;  // Total energy when the current run started
+	double relativeEnergyError = 0;  // |E - E_0| / |E_0| at the last sample
+	double wallSeconds = 0;  // Wall-clock time spent stepping since the current run started
+	double simulatedTime = 0;  // Simulated time since the current run started
+	size_t forceEvaluations = 0;  // Force evaluations (whole system) since the current run started
+	int stepsSinceEnergySample = 0;  // Steps since the last energy sample
+};
+
+
+
+
+
+
+
+
+// ------------- Energy -------------
+/**
+ * ComputeTreePotential: Gravitational potential at a body from the tree, with the same opening criterion and softening as the forces.
+ *
+ * @param rootNode The current node of the walk
+ * @param bodies   The bodies the tree was built from
+ * @param index    Index of the body the potential is evaluated at, its own leaf is skipped
+ * @param G        Universal gravitational constant
+ * @param theta    Barnes-Hut theta parameter for MAC
+ * @return The potential per unit mass
+ */
+static inline double ComputeTreePotential(Quadtree* &rootNode, const BodyStore &bodies, size_t index, float G, float theta);
+
+
+
+/**
+ * ComputeTreeEnergy: Kinetic plus potential energy of all bodies, the potential from a tree walk.
+ *
+ * @param rootNode    Root of a quadtree built (or refit) over the current positions
+ * @param bodies      The bodies
+ * @param G           Universal gravitational constant
+ * @param theta       Barnes-Hut theta parameter for MAC
+ * @param threadCount Threads used by the walk, 0 selects the number of hardware threads
+ * @return The total energy
+ */
+static inline double ComputeTreeEnergy(Quadtree* &rootNode, const BodyStore &bodies, float G, float theta, unsigned int threadCount);
+
+
+
+
+
+
+
+
+// ------------- Integration -------------
+/**
+ * AdvanceSymplectic: Advance all bodies by 'dt' with the integrator's composition, refitting the tree between sub-drifts.
+ *
+ * For the kick-first forms (leapfrog, Yoshida) the bodies' ax and ay must hold a(x_n) on entry, and the velocities
+ * are synchronized with the positions only after the next call applied the deferred kick. The drift-first form
+ * (Forest-Ruth) ignores the entry accelerations, only the tree built over x_n is needed.
+ *
+ * @param rootNode            Quadtree built over the current positions
+ * @param bodies              The bodies, with the accelerations (ax, ay) at the current positions, the last evaluated accelerations on return
+ * @param integrator          Scheme, deferred kick and diagnostics
+ * @param G                   Universal gravitational constant
+ * @param theta               Barnes-Hut theta parameter for MAC
+ * @param dt                  Time step
+ */
+static inline void AdvanceSymplectic(Quadtree* &rootNode, BodyStore &bodies, SymplecticIntegrator &integrator, float G, float theta, float dt);
+
+
+
+/**
+ * SymplecticCoefficients: Drift and kick weights of a scheme, in the order they are applied.
+ *
+ * @param scheme     The composition
+ * @param drifts     Receives the drift weights c_k
+ * @param kicks      Receives the kick weights d_k
+ * @param driftFirst Receives whether the first operation is a drift
+ */
+static inline void SymplecticCoefficients(SymplecticScheme scheme, std::vector<float> &drifts, std::vector<float> &kicks, bool &driftFirst);
+
+
+
+/**
+ * ResetSymplecticIntegrator: Drop the deferred kick and restart the diagnostics, e.g., when another integrator takes over.
+ */
+static inline void ResetSymplecticIntegrator(SymplecticIntegrator &integrator);
+
+
+
+/**
+ * SymplecticSchemeName: Readable name of a scheme, for the console and the user interface.
+ */
+static inline std::string SymplecticSchemeName(SymplecticScheme scheme);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline double ComputeTreePotential(Quadtree* &rootNode, const BodyStore &bodies, size_t index, float G, float theta)
+{
+	double potential = 0;
+	ofVec2f position = PositionOf(bodies, index);
+	WalkTree(rootNode, index, [&](Quadtree* cell)
+	{
+		float distance = cell->centerOfMass.distance(position);
+		float size = cell->bounds.width;
+		if (size / distance < theta)
+		{
+			potential += SoftenedPotential(cell->totalMass, distance, G);
+			return true;
+		}
+		return false;
+	},
+	[&](Quadtree* leaf)
+	{
+		potential += SoftenedPotential(bodies.mass[leaf->nodeBodyIndex], PositionOf(bodies, leaf->nodeBodyIndex).distance(position), G);
+	});
+	return potential;
+}
+
+
+
+static inline double ComputeTreeEnergy(Quadtree* &rootNode, const BodyStore &bodies, float G, float theta, unsigned int threadCount)
+{
+	unsigned int workers = (threadCount > 0) ? threadCount : DefaultThreadCount();
+	std::vector<double> threadEnergies(workers, 0.0);
+
+	ParallelFor(0, bodies.size(), workers, [&rootNode, &bodies, &threadEnergies, G, theta](size_t begin, size_t end, unsigned int threadIndex)
+	{
+		double energy = 0;
+		for (size_t i = begin; i < end; i++)
+		{
+			energy += 0.5 * bodies.mass[i] * VelocityOf(bodies, i).lengthSquared();
+			energy += 0.5 * bodies.mass[i] * ComputeTreePotential(rootNode, bodies, i, G, theta); // every pair is seen from both sides
+		}
+		threadEnergies[threadIndex] += energy;
+	}, 256);
+
+
+	double total = 0;
+	for (double energy : threadEnergies)
+	{
+		total += energy;
+	}
+	return total;
+}
+
+
+
+
+
+
+
+
+static inline void AdvanceSymplectic(Quadtree* &rootNode, BodyStore &bodies, SymplecticIntegrator &integrator, float G, float theta, float dt)
+{
+	PROFILE_PHASE(Integrate);
+	auto start = std::chrono::steady_clock::now();
+	size_t n = bodies.size();
+	float* x = bodies.x.data();
+	float* y = bodies.y.data();
+	float* vx = bodies.vx.data();
+	float* vy = bodies.vy.data();
+	float* ax = bodies.ax.data();
+	float* ay = bodies.ay.data();
+
+	std::vector<float> drifts, kicks;
+	bool driftFirst;
+	SymplecticCoefficients(integrator.scheme, drifts, kicks, driftFirst);
+
+
+	auto kick = [vx, vy, ax, ay, n](float h)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			vx[i] += ax[i] * h;
+			vy[i] += ay[i] * h;
+		}
+	};
+	auto drift = [x, y, vx, vy, n](float h)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			x[i] += vx[i] * h;
+			y[i] += vy[i] * h;
+		}
+	};
+	auto evaluateForces = [&rootNode, &bodies, ax, ay, &integrator, n, G, theta]()
+	{
+		ComputeQuadtreeMassDistribution(rootNode, bodies); // the sub-drift moved bodies by less than a step, the topology still holds
+		ParallelFor(0, n, integrator.threadCount, [&rootNode, &bodies, ax, ay, G, theta](size_t begin, size_t end, unsigned int)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				ofVec2f acceleration(0, 0);
+				ComputeTreeForce(rootNode, bodies, i, PositionOf(bodies, i), acceleration, G, theta);
+				ax[i] = acceleration.x;
+				ay[i] = acceleration.y;
+			}
+		}, 256);
+		integrator.forceEvaluations++;
+	};
+
+
+	if (!driftFirst)
+	{
+		kick(integrator.pendingKick + kicks[0] * dt); // the previous step's last kick and this step's first share a(x_n)
+		integrator.pendingKick = 0;
+		integrator.forceEvaluations++; // a(x_n) came from the frame's own walk
+	}
+
+
+	// Sample the energy while velocities and positions are synchronized and the tree matches the positions exactly
+	if (integrator.energySampleInterval > 0 && (!integrator.hasReferenceEnergy || ++integrator.stepsSinceEnergySample >= integrator.energySampleInterval))
+	{
+		float firstKick = driftFirst ? 0 : kicks[0] * dt;
+		kick(-firstKick);
+		double energy = ComputeTreeEnergy(rootNode, bodies, G, theta, integrator.threadCount);
+		kick(firstKick);
+
+		if (!integrator.hasReferenceEnergy)
+		{
+			integrator.referenceEnergy = energy;
+			integrator.hasReferenceEnergy = true;
+		}
+		else if (integrator.referenceEnergy != 0)
+		{
+			integrator.relativeEnergyError = std::fabs((energy - integrator.referenceEnergy) / integrator.referenceEnergy);
+		}
+		integrator.stepsSinceEnergySample = 0;
+	}
+
+
+	// Alternate drifts and kicks, evaluating the forces after every drift that is followed by a kick
+	size_t operations = drifts.size() + kicks.size();
+	size_t driftIndex = 0, kickIndex = driftFirst ? 0 : 1;
+	for (size_t op = driftFirst ? 0 : 1; op < operations; op++)
+	{
+		bool isDrift = ((op % 2) == 0) == driftFirst;
+		if (isDrift)
+		{
+			drift(drifts[driftIndex++] * dt);
+		}
+		else if (kickIndex == kicks.size() - 1 && !driftFirst)
+		{
+			integrator.pendingKick = kicks[kickIndex++] * dt; // a(x_{n+1}) comes from the next frame's walk
+		}
+		else
+		{
+			evaluateForces();
+			kick(kicks[kickIndex++] * dt);
+		}
+	}
+
+
+	integrator.simulatedTime += dt;
+	integrator.wallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+
+static inline void SymplecticCoefficients(SymplecticScheme scheme, std::vector<float> &drifts, std::vector<float> &kicks, bool &driftFirst)
+{
+	const double w1 = 1.0 / (2.0 - std::cbrt(2.0));
+	const double w0 = -std::cbrt(2.0) * w1;
+
+	switch (scheme)
+	{
+		case SymplecticScheme::LeapfrogKDK:
+			kicks = {0.5f, 0.5f};
+			drifts = {1.0f};
+			driftFirst = false;
+			break;
+		case SymplecticScheme::Yoshida4:
+			kicks = {(float)(w1 / 2), (float)((w0 + w1) / 2), (float)((w0 + w1) / 2), (float)(w1 / 2)};
+			drifts = {(float)w1, (float)w0, (float)w1};
+			driftFirst = false;
+			break;
+		case SymplecticScheme::ForestRuth4:
+			drifts = {(float)(w1 / 2), (float)((w0 + w1) / 2), (float)((w0 + w1) / 2), (float)(w1 / 2)};
+			kicks = {(float)w1, (float)w0, (float)w1};
+			driftFirst = true;
+			break;
+	}
+}
+
+
+
+static inline void ResetSymplecticIntegrator(SymplecticIntegrator &integrator)
+{
+	integrator.pendingKick = 0;
+	integrator.hasReferenceEnergy = false;
+	integrator.relativeEnergyError = 0;
+	integrator.wallSeconds = 0;
+	integrator.simulatedTime = 0;
+	integrator.forceEvaluations = 0;
+	integrator.stepsSinceEnergySample = 0;
+}
+
+
+
+static inline std::string SymplecticSchemeName(SymplecticScheme scheme)
+{
+	switch (scheme)
+	{
+		case SymplecticScheme::LeapfrogKDK: return "Leapfrog KDK";
+		case SymplecticScheme::Yoshida4: return "Yoshida 4th order";
+		case SymplecticScheme::ForestRuth4: return "Forest-Ruth 4th order";
+	}
+	return "";
+}
@@ -0,0 +1,360 @@
+//  HeadlessSimulation.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * HeadlessSimulation Module: Stepping a galaxy without openFrameworks, timing every phase of the step
+ *
+ * Description:
+ * Runs the application's step on the headless core ('nbody_core', built with NBODY_HEADLESS): a galaxy from
+ * 'GenerateGalaxyBodies' with the parameters the matching initial conditions mode of the application uses, then
+ * 'steps' steps of
+ * 			build      new root and insertion of every body
+ * 			prune      'PruneEmptyNodesFromTree'
+ * 			mass       'ComputeQuadtreeMassDistribution'
+ * 			forces     zeroing the accelerations and the tree walk of every body, over the worker threads
+ * 			integrate  'ComputeVelocityAndPosition' (KDK leapfrog)
+ * 			energy     'ComputeSystemEnergy'
+ * 			reset      'ResetTree'
+ * each timed on its own. The bodies are copied into a BasicBodyStore<Real> for the requested precision the same way the
+ * precision benchmark does, and the root bounds follow the bodies every step so no body is ever left outside.
+ * A checksum of the final positions, summed in double in body order, makes runs comparable bit for bit.
+ * With 'traceSteps' set, the first that many timed steps are recorded by the event tracer, one step per frame.
+ *
+ * The command line driver (main.cpp) prints the result as JSON, the benchmark runs the same function.
+ */
+#pragma once
+#include <chrono>
+#include <vector>
+#include <string>
+#include <ostream>
+#include <algorithm>
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "Quadtree.hpp"
+#include "PhysicsLogic.hpp"
+#include "BodyInjection.hpp"
+#include "ParallelUtilities.hpp"
+#include "Precision.hpp"
+#include "PhaseProfiler.hpp"
+#include "CoreTypes.hpp"
+
+
+
+
+/**
+ * HeadlessConfig: What to run, the defaults are the application's.
+ */
+class HeadlessConfig
+{
+public:
+	GalaxyModel scenario = GalaxyModel::Plummer;  // Initial conditions
+	size_t numBodies = 100000;  // Number of bodies
+	int steps = 10;  // Timed steps
+	int warmupSteps = 1;  // Steps run before the timed ones, not timed
+	unsigned int threadCount = 0;  // Threads of the generation and the force walk, 0 selects DefaultThreadCount()
+	bool pinThreads = false;  // Pin the worker threads to CPUs, see 'workerThreadPinning'
+	Precision precision = Precision::Float;  // Scalar type of the bodies and the tree, and of the force kernels
+	float theta = 1;  // Barnes-Hut theta parameter for MAC
+	float G = 66.743;  // Universal gravitational constant
+	float dt = 0.01;  // Size of the steps
+	uint64_t seed = 1;  // Seed of the galaxy
+	int traceSteps = 0;  // Timed steps to record a Chrome trace of, from the first, 0 records none
+	std::string tracePath = "nbody_trace.json";  // File the trace is written to
+};
+
+
+
+/**
+ * PhaseTiming: The time one phase of the step took in every timed step.
+ */
+class PhaseTiming
+{
+public:
+	std::string name;  // Phase, as in the JSON output
+	std::vector<double> milliseconds;  // One entry per timed step
+
+	double total() const { double sum = 0; for (double ms : milliseconds) sum += ms; return sum; }
+	double mean() const { return milliseconds.empty() ? 0 : total() / milliseconds.size(); }
+	double min() const { return milliseconds.empty() ? 0 : *std::min_element(milliseconds.begin(), milliseconds.end()); }
+	double max() const { return milliseconds.empty() ? 0 : *std::max_element(milliseconds.begin(), milliseconds.end()); }
+	double percentile(double fraction) const { std::vector<double> sorted = milliseconds; return Percentile(sorted, fraction); }  // Nearest rank, see 'Percentile'
+};
+
+
+
+/**
+ * HeadlessResult: The timings of a headless run.
+ */
+class HeadlessResult
+{
+public:
+	HeadlessConfig config;  // What was run, with the thread count resolved
+	double generateMilliseconds = 0;  // Galaxy generation, including the copy to the requested precision
+	std::vector<PhaseTiming> phases;  // In the order of the step
+	double stepMilliseconds = 0;  // Mean time of a whole step
+	double checksum = 0;  // Sum of the final position components, in double and in body order
+	bool traceWritten = false;  // A trace was asked for and written to 'config.tracePath'
+};
+
+
+
+
+
+
+
+
+
+/**
+ * ScenarioGalaxySpec: The galaxy the application's initial conditions mode for 'scenario' generates, with 'numBodies' bodies.
+ */
+static inline GalaxySpec ScenarioGalaxySpec(GalaxyModel scenario, size_t numBodies, uint64_t seed);
+
+
+
+/**
+ * RunHeadless: Generate the configured galaxy and step it, timing every phase.
+ */
+static inline HeadlessResult RunHeadless(const HeadlessConfig &config);
+
+
+
+/**
+ * RunHeadlessAtPrecision: 'RunHeadless' with the bodies and the tree in 'Real' and the force kernels in 'Kernel'.
+ */
+template<typename Real, typename Kernel>
+static inline void RunHeadlessAtPrecision(const BodyStore &bodies, HeadlessResult &result);
+
+
+
+/**
+ * PrintHeadlessJson: Write a headless result as a JSON object.
+ */
+static inline void PrintHeadlessJson(const HeadlessResult &result, std::ostream &out);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline GalaxySpec ScenarioGalaxySpec(GalaxyModel scenario, size_t numBodies, uint64_t seed)
+{
+	GalaxySpec spec;
+	spec.model = scenario;
+	spec.numBodies = numBodies;
+	spec.seed = seed;
+	const float windowWidth = 1920; // the application scales the first two modes by the window
+
+
+	switch (scenario)
+	{
+		case GalaxyModel::ColdStart:
+			spec.bodiesMass = 2;
+			spec.anchorMass = 150;
+			spec.galaxyRadius = windowWidth * 1.5f;
+			break;
+		case GalaxyModel::KeplerOrbit:
+			spec.bodiesMass = 2;
+			spec.anchorMass = 6250;
+			spec.galaxyRadius = windowWidth * 1.5f;
+			break;
+		case GalaxyModel::CollidingDisk:
+			spec.bodiesMass = 10;
+			spec.anchorMass = 180;
+			spec.secondaryAnchorMass = 140;
+			spec.galaxyRadius = 10000;
+			spec.secondaryRadius = 6000;
+			spec.secondaryAnchorPoint.set(spec.galaxyRadius, spec.galaxyRadius);
+			break;
+		case GalaxyModel::Disk:
+			spec.bodiesMass = 5;
+			spec.anchorMass = 50;
+			spec.galaxyRadius = 7500;
+			break;
+		case GalaxyModel::Plummer:
+			spec.bodiesMass = 10;
+			spec.anchorMass = 187500;
+			spec.galaxyRadius = 25000;
+			spec.galaxyScatter = 1;
+			break;
+	}
+	return spec;
+}
+
+
+
+static inline HeadlessResult RunHeadless(const HeadlessConfig &config)
+{
+	HeadlessResult result;
+	result.config = config;
+	result.config.threadCount = (config.threadCount > 0) ? config.threadCount : DefaultThreadCount();
+	workerThreadPinning = config.pinThreads;
+
+
+	auto start = std::chrono::steady_clock::now();
+	BodyStore bodies;
+	GenerateGalaxyBodies(ScenarioGalaxySpec(config.scenario, config.numBodies, config.seed), bodies, result.config.threadCount);
+	result.generateMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+
+	WithPrecision(config.precision, [&bodies, &result](auto tag)
+	{
+		RunHeadlessAtPrecision<typename decltype(tag)::Real, typename decltype(tag)::Kernel>(bodies, result);
+	});
+	return result;
+}
+
+
+
+template<typename Real, typename Kernel>
+static inline void RunHeadlessAtPrecision(const BodyStore &bodies, HeadlessResult &result)
+{
+	typedef typename PrecisionTraits<Real>::Rectangle Rectangle;
+	const HeadlessConfig &config = result.config;
+
+
+	auto start = std::chrono::steady_clock::now();
+	BasicBodyStore<Real> copies;
+	ResizeBodyStore(copies, bodies.size());
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		copies.x[i] = (Real)bodies.x[i];
+		copies.y[i] = (Real)bodies.y[i];
+		copies.vx[i] = (Real)bodies.vx[i];
+		copies.vy[i] = (Real)bodies.vy[i];
+		copies.mass[i] = (Real)bodies.mass[i];
+	}
+	result.generateMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+
+	BasicQuadtree<Real>* tree = nullptr;
+	float systemEnergy = 0, systemKineticEnergy = 0, systemPotentialEnergy = 0;
+
+	enum { Build, Prune, Mass, Forces, Integrate, Energy, Reset, PhaseCount };
+	result.phases.assign(PhaseCount, PhaseTiming());
+	const char* names[PhaseCount] = {"build", "prune", "mass", "forces", "integrate", "energy", "reset"};
+	for (int p = 0; p < PhaseCount; p++)
+	{
+		result.phases[p].name = names[p];
+		result.phases[p].milliseconds.reserve(std::max(config.steps, 0));
+	}
+
+
+	for (int s = 0; s < config.warmupSteps + config.steps; s++)
+	{
+		bool timed = s >= config.warmupSteps;
+		if (s == config.warmupSteps && config.traceSteps > 0)
+		{
+			StartTrace(eventTracer, config.traceSteps, config.tracePath);
+		}
+		auto phaseStart = std::chrono::steady_clock::now();
+		auto endPhase = [&](int phase)
+		{
+			auto now = std::chrono::steady_clock::now();
+			if (timed)
+			{
+				result.phases[phase].milliseconds.push_back(std::chrono::duration<double, std::milli>(now - phaseStart).count());
+			}
+			phaseStart = now;
+		};
+
+
+		// Root bounds around the bodies, with room on every side, so the tree always holds all of them
+		Real minX = copies.empty() ? 0 : copies.x[0], maxX = minX;
+		Real minY = copies.empty() ? 0 : copies.y[0], maxY = minY;
+		for (size_t i = 0; i < copies.size(); i++)
+		{
+			minX = std::min(minX, copies.x[i]);
+			maxX = std::max(maxX, copies.x[i]);
+			minY = std::min(minY, copies.y[i]);
+			maxY = std::max(maxY, copies.y[i]);
+		}
+		Real size = std::max(maxX - minX, maxY - minY) * (Real)1.25 + 1;
+		Rectangle rootBounds((minX + maxX - size) * (Real)0.5, (minY + maxY - size) * (Real)0.5, size, size);
+
+		delete tree;
+		tree = new BasicQuadtree<Real>();
+		tree->bounds = rootBounds;
+		{
+			PROFILE_PHASE(BuildQuadtree);
+			for (size_t i = 0; i < copies.size(); i++)
+			{
+				tree->insert(copies, i);
+			}
+		}
+		endPhase(Build);
+
+		PruneEmptyNodesFromTree(tree);
+		endPhase(Prune);
+
+		ComputeQuadtreeMassDistribution(tree, copies);
+		endPhase(Mass);
+
+		ClearAccelerations(copies);
+		ComputeAllForces<Real, Kernel>(tree, copies, config.G, config.theta, config.threadCount);
+		endPhase(Forces);
+
+		ComputeVelocityAndPosition(config.dt, copies);
+		endPhase(Integrate);
+
+		ComputeSystemEnergy(copies, systemEnergy, systemKineticEnergy, systemPotentialEnergy);
+		endPhase(Energy);
+
+		ResetTree(tree);
+		endPhase(Reset);
+
+		bool written = false;
+		if (timed && EndTraceFrame(eventTracer, written))
+		{
+			result.traceWritten = written;
+		}
+	}
+	delete tree;
+
+
+	for (const PhaseTiming &phase : result.phases)
+	{
+		result.stepMilliseconds += phase.mean();
+	}
+	for (size_t i = 0; i < copies.size(); i++)
+	{
+		result.checksum += (double)copies.x[i] + (double)copies.y[i];
+	}
+}
+
+
+
+static inline void PrintHeadlessJson(const HeadlessResult &result, std::ostream &out)
+{
+	const HeadlessConfig &config = result.config;
+	std::streamsize precision = out.precision(6);
+	out << "{\n";
+	out << "  \"scenario\": \"" << GalaxyModelName(config.scenario) << "\",\n";
+	out << "  \"bodies\": " << config.numBodies << ",\n";
+	out << "  \"steps\": " << config.steps << ",\n";
+	out << "  \"warmup_steps\": " << config.warmupSteps << ",\n";
+	out << "  \"threads\": " << config.threadCount << ",\n";
+	out << "  \"precision\": \"" << PrecisionName(config.precision) << "\",\n";
+	out << "  \"theta\": " << config.theta << ",\n";
+	out << "  \"seed\": " << config.seed << ",\n";
+	out << "  \"generate_ms\": " << result.generateMilliseconds << ",\n";
+	out << "  \"step_ms\": " << result.stepMilliseconds << ",\n";
+	out << "  \"phases\": {";
+	for (size_t p = 0; p < result.phases.size(); p++)
+	{
+		const PhaseTiming &phase = result.phases[p];
+		out << ((p == 0) ? "\n" : ",\n");
+		out << "    \"" << phase.name << "\": {\"mean_ms\": " << phase.mean() << ", \"p50_ms\": " << phase.percentile(0.50) << ", \"p99_ms\": " << phase.percentile(0.99) << ", \"min_ms\": " << phase.min() << ", \"max_ms\": " << phase.max() << ", \"total_ms\": " << phase.total() << "}";
+	}
+	out << "\n  },\n";
+	out.precision(17); // every digit, for comparing runs
+	out << "  \"checksum\": " << result.checksum << "\n";
+	out << "}\n";
+	out.precision(precision);
+}
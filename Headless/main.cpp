@@ -0,0 +1,138 @@
+//  main.cpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * Headless driver: Runs a scenario on the headless core and prints the per-phase timings as JSON
+ *
+ * Description:
+ * 		nbody_headless [--scenario cold-start|kepler|colliding-disk|disk|plummer] [--bodies N] [--steps S]
+ * 		               [--warmup W] [--threads T] [--pin] [--precision float|double|double-float]
+ * 		               [--theta X] [--dt X] [--seed S] [--trace N] [--trace-file PATH]
+ * Without arguments it steps 100000 Plummer bodies 10 times in float on every hardware thread. The JSON goes to
+ * standard output, errors in the arguments to standard error with exit status 2. '--trace N' records the first N
+ * timed steps as a Chrome trace (nbody_trace.json unless '--trace-file' says otherwise), for chrome://tracing or Perfetto.
+ */
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include "HeadlessSimulation.hpp"
+
+
+
+
+/**
+ * ParseHeadlessArguments: The configuration the command line asks for, throws std::invalid_argument on bad arguments.
+ */
+static inline HeadlessConfig ParseHeadlessArguments(int argc, char* argv[]);
+
+
+
+/**
+ * PrintHeadlessUsage: Write the command line arguments to 'out'.
+ */
+static inline void PrintHeadlessUsage(std::ostream &out);
+
+
+
+
+
+
+
+
+
+int main(int argc, char* argv[])
+{
+	HeadlessConfig config;
+	try
+	{
+		config = ParseHeadlessArguments(argc, argv);
+	}
+	catch (const std::invalid_argument &error)
+	{
+		std::cerr << "nbody_headless: " << error.what() << "\n";
+		PrintHeadlessUsage(std::cerr);
+		return 2;
+	}
+
+
+	HeadlessResult result = RunHeadless(config);
+	PrintHeadlessJson(result, std::cout);
+	if (config.traceSteps > 0)
+	{
+		if (!result.traceWritten)
+		{
+			std::cerr << "nbody_headless: could not write the trace to " << config.tracePath << "\n";
+			return 1;
+		}
+		std::cerr << "nbody_headless: trace written to " << config.tracePath << "\n";
+	}
+	return 0;
+}
+
+
+
+static inline HeadlessConfig ParseHeadlessArguments(int argc, char* argv[])
+{
+	HeadlessConfig config;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (argument == "--help" || argument == "-h")
+		{
+			PrintHeadlessUsage(std::cout);
+			std::exit(0);
+		}
+		if (argument == "--pin")
+		{
+			config.pinThreads = true;
+			continue;
+		}
+		if (i + 1 >= argc)
+		{
+			throw std::invalid_argument("Missing value of '" + argument + "'");
+		}
+
+
+		std::string value = argv[++i];
+		try
+		{
+			if (argument == "--scenario") config.scenario = GalaxyModelFromName(value);
+			else if (argument == "--bodies") config.numBodies = std::stoull(value);
+			else if (argument == "--steps") config.steps = std::stoi(value);
+			else if (argument == "--warmup") config.warmupSteps = std::stoi(value);
+			else if (argument == "--threads") config.threadCount = (unsigned int)std::stoul(value);
+			else if (argument == "--precision") config.precision = PrecisionFromName(value);
+			else if (argument == "--theta") config.theta = std::stof(value);
+			else if (argument == "--dt") config.dt = std::stof(value);
+			else if (argument == "--seed") config.seed = std::stoull(value);
+			else if (argument == "--trace") config.traceSteps = std::stoi(value);
+			else if (argument == "--trace-file") config.tracePath = value;
+			else throw std::invalid_argument("Unknown argument '" + argument + "'");
+		}
+		catch (const std::out_of_range &)
+		{
+			throw std::invalid_argument("Value of '" + argument + "' out of range: " + value);
+		}
+	}
+
+
+	if (config.steps < 0 || config.warmupSteps < 0 || config.traceSteps < 0)
+	{
+		throw std::invalid_argument("Steps can't be negative");
+	}
+	if (config.traceSteps > config.steps)
+	{
+		throw std::invalid_argument("Can't trace more steps than are timed");
+	}
+	return config;
+}
+
+
+
+static inline void PrintHeadlessUsage(std::ostream &out)
+{
+	out << "usage: nbody_headless [--scenario cold-start|kepler|colliding-disk|disk|plummer] [--bodies N] [--steps S]\n"
+		<< "                      [--warmup W] [--threads T] [--pin] [--precision float|double|double-float]\n"
+		<< "                      [--theta X] [--dt X] [--seed S] [--trace N] [--trace-file PATH]\n";
+}
@@ -21,9 +21,11 @@
 #include "DrawingUtilities.hpp"
 #include "SequenceContainers.hpp"
 #include "SimulationEntities.hpp"
-#include "ObjectPool.hpp"
 #include "Quadtree.hpp"
 #include "PhysicsLogic.hpp"
+#include "Collisions.hpp"
+#include "BodyStore.hpp"
+#include "BodyDataTable.hpp"
 #include "ofMain.h"
 
 
@@ -34,57 +36,58 @@
 // ------------- Bodies Visualization ------------------
 /// \{
 
-static inline void VisualizeBodies(std::vector<Body*>& bodies, bool visualizeBodyEnergyGradient);
+static inline void VisualizeBodies(const BodyStore &bodies, bool visualizeBodyEnergyGradient);
 
-static inline void VisualizeBodyData(std::vector<Body*>& bodies, std::vector<BodyData*>& bodiesData, bool visualizeBodyEnergyGradient);
+static inline void VisualizeBodyData(const BodyStore &bodies, const BodyDataTable &bodyData, bool visualizeBodyEnergyGradient) // Bodies colored by the share of their energy that is kinetic, blue bound to red escaping
+{
+	if (!bodyData.energies)
+	{
+		return; // the table catches up on the next step
+	}
+	ofFill();
+	for (size_t i = 0; i < std::min(bodies.size(), bodyData.size()); i++)
+	{
+		if (visualizeBodyEnergyGradient)
+		{
+			float total = bodyData.kineticEnergy[i] + std::abs(bodyData.potentialEnergy[i]);
+			float kineticShare = (total > 0) ? bodyData.kineticEnergy[i] / total : 0;
+			ofSetColor(255 * kineticShare, 0, 255 * (1 - kineticShare));
+		}
+		ofDrawCircle(bodies.x[i], bodies.y[i], bodies.mass[i]);
+	}
+}
 
 
-static inline void VisualizeBodiesAngularOrientation(std::vector<Body*>& bodies, const ofVec2f* bodiesAccelerations)
+static inline void VisualizeBodyStore(const BodyStore &bodies) // Same circles as 'Body::draw', e.g., from a snapshot
 {
-	//cout<<"\n\n bodies.size(): " << bodies.size();
+	ofFill();
 	for (size_t i = 0; i < bodies.size(); i++)
 	{
-		
-		float momentOfInertia = 0.25 * bodies[i]->mass * (bodies[i]->mass * bodies[i]->mass); // I = 1/4 * mass * radius^2
-		float angularVelocity = bodies[i]->velocity.lengthSquared() / (bodies[i]->mass * bodies[i]->mass);
-		float orientation = 0 + angularVelocity;
-		
-		
-		float d = 0.5 * bodies[i]->mass;  // off-center distance
-		
-		// Assume a radius vector from center to the point where the force is applied.
-		// This is a simplification; in a real scenario, you'll need to determine this based on the physical situation.
-		ofVec2f radialVector(d, 0);  // Example: assuming d(force applied) is along x-axis, you can rotate this based on body orientation
-		
-		// Calculate torque due to gravitational forces (using 2D cross product, which yields a scalar)
-		float torque = radialVector.x * bodiesAccelerations[i].y * bodies[i]->mass - radialVector.y * bodiesAccelerations[i].x * bodies[i]->mass;
-		
-		
-		// Calculate angular acceleration
-		float angularAcceleration = torque / momentOfInertia;
-		
-		// Update angular velocity (using Euler integration)
-		angularVelocity += angularAcceleration * 0.01; // Assuming a small time step of 0.01
-		
-		
-		// Update orientation (angle), assuming it starts from an initial angle of 0
-		// (assuming no external torques for simplicity)
-		orientation += angularVelocity * 0.01; // Assuming a small time step of 0.01
-		
-		
-		// Draw orientation line
-		ofSetColor(0, 0, 255); // ofColor::white
-		ofSetLineWidth(1);
-		float orientationLineLength = bodies[i]->mass * log2(bodies[i]->velocity.length());  // Length of the line can be proportional to mass or some fixed value
-		ofVec2f orientationVector = ofVec2f(cos(orientation), sin(orientation)) * orientationLineLength;
-		ofDrawLine(bodies[i]->position, bodies[i]->position + orientationVector);
+		ofDrawCircle(bodies.x[i], bodies.y[i], bodies.mass[i]);
+	}
+}
+
+
+static inline void VisualizeBodiesAngularOrientation(const BodyStore &bodies, const BodyDataTable &bodyData) // Orientation of each body as kept by the simulation's step
+{
+	if (!bodyData.rotation)
+	{
+		return; // the table catches up on the next step
+	}
+	ofSetColor(0, 0, 255); // ofColor::white
+	ofSetLineWidth(1);
+	for (size_t i = 0; i < std::min(bodies.size(), bodyData.size()); i++)
+	{
+		ofVec2f position = PositionOf(bodies, i);
+		float orientationLineLength = bodies.mass[i] * log2(VelocityOf(bodies, i).length());  // Length of the line can be proportional to mass or some fixed value
+		ofVec2f orientationVector = ofVec2f(cos(bodyData.orientation[i]), sin(bodyData.orientation[i])) * orientationLineLength;
+		ofDrawLine(position, position + orientationVector);
 	}
-	
 }
 
 
 
-static inline void RenderSimulation(Quadtree *&rootQuadtree, std::vector<Body*>& bodies, std::vector<BodyData*>& bodiesData);
+static inline void RenderSimulation(Quadtree *&rootQuadtree, const BodyStore &bodies, const BodyDataTable &bodyData);
 /// \}
 
 
@@ -117,7 +120,7 @@ static inline void VisualizeQuadtreeBounds(Quadtree *&rootQuadtree)
 
 
 
-static inline void VisualizeQuadtreeCentresOfMass(Quadtree *&rootQuadtree)
+static inline void VisualizeQuadtreeCentresOfMass(Quadtree *&rootQuadtree, const BodyStore &bodies)
 {
 	if (rootQuadtree->hasChildren)
 	{
@@ -125,7 +128,7 @@ static inline void VisualizeQuadtreeCentresOfMass(Quadtree *&rootQuadtree)
 		{
 			if (rootQuadtree->children[i] != nullptr)
 			{
-				VisualizeQuadtreeCentresOfMass(rootQuadtree->children[i]);
+				VisualizeQuadtreeCentresOfMass(rootQuadtree->children[i], bodies);
 			}
 		}
 	}
@@ -140,7 +143,7 @@ static inline void VisualizeQuadtreeCentresOfMass(Quadtree *&rootQuadtree)
 	
 	
 	
-	if(rootQuadtree->nodeBody && rootQuadtree->hasChildren) // Draw a line from this node's body to this node's center of mass
+	if(rootQuadtree->nodeBodyIndex != SIZE_MAX && rootQuadtree->hasChildren) // Draw a line from this node's body to this node's center of mass
 	{
 		ofFill();
 		ofSetColor(118, 101, 133);
@@ -166,7 +169,7 @@ static inline void VisualizeQuadtreeCentresOfMass(Quadtree *&rootQuadtree)
 		
 		
 		ofSetColor(255, 255, 255, 96.75);
-		ofDrawLine(rootQuadtree->centerOfMass, rootQuadtree->nodeBody->position);
+		ofDrawLine(rootQuadtree->centerOfMass, PositionOf(bodies, rootQuadtree->nodeBodyIndex));
 	}
 }
 
@@ -174,7 +177,54 @@ static inline void VisualizeQuadtreeCentresOfMass(Quadtree *&rootQuadtree)
 
 static inline void VisualizeQuadtreeNodeProperties(Quadtree *&rootQuadtree); //Display the node's properties, including: depth, quadrant, mass, body count, etc.
 
-static inline void VisualizeQuadtreeAABB(Quadtree *&rootQuadtree); //Display the "neighbourhood's" of the bodies (rectangles around bodies that are used for broad phase collision detection, will light up when they intersect another body neighbourhood, any node bounds, and of course other bodies)
+static inline void VisualizeQuadtreeAABB(Quadtree *&rootQuadtree, const BodyStore &bodies) //Display the "neighbourhood's" of the bodies (rectangles around bodies that are used for broad phase collision detection, will light up when they intersect another body neighbourhood, any node bounds, and of course other bodies)
+{
+	if(rootQuadtree == nullptr)
+	{
+		return;
+	}
+	
+	
+	std::vector<size_t> treeBodies; // every body held by a leaf of the tree, i.e., exactly what the broad phase can see
+	QueryQuadtreeAABB(rootQuadtree, rootQuadtree->bounds, 0, treeBodies);
+	
+	float maximumRadius = 0;
+	for (size_t body : treeBodies)
+	{
+		maximumRadius = std::max(maximumRadius, bodies.mass[body]);
+	}
+	
+	
+	ofNoFill();
+	std::vector<size_t> candidates;
+	for (size_t body : treeBodies)
+	{
+		ofRectangle neighbourhood = BodyAABB(bodies, body, 0);
+		
+		candidates.clear();
+		QueryQuadtreeAABB(rootQuadtree, BodyAABB(bodies, body, maximumRadius), 0, candidates);
+		bool intersects = false;
+		for (size_t other : candidates)
+		{
+			if (other != body && neighbourhood.intersects(BodyAABB(bodies, other, 0)))
+			{
+				intersects = true;
+				break;
+			}
+		}
+		
+		
+		if (intersects) // light up the neighbourhoods that would reach the narrow phase
+		{
+			ofSetColor(255, 64, 64, 191.25);
+		}
+		else
+		{
+			ofSetColor(64, 191, 255, 96.75);
+		}
+		ofDrawRectangle(neighbourhood);
+	}
+}
 
 
 /// \}
@@ -196,9 +246,9 @@ static inline void VisualizeQuadtreeAABB(Quadtree *&rootQuadtree); //Display the
  * @param HEIGHT The specified height of grid cells, together with WIDTH controls the bounds of the energy field visualization
  * @param CELLSIZE The specified size of grid cells, controls the granularity of the potential energy field visualization across the bounds specified by WIDTH and HEIGHT
  */
-static inline void VisualizeRelativePotentialEnergyField(std::vector<std::vector<float>> &potentialGrid, std::vector<Body*>& bodies, double &G, float &minPotential, float &maxPotential, RectangularGridDragSelection vectorGrid);
+static inline void VisualizeRelativePotentialEnergyField(std::vector<std::vector<float>> &potentialGrid, const BodyStore &bodies, double &G, float &minPotential, float &maxPotential, RectangularGridDragSelection vectorGrid);
 
-static inline void PrepareRelativePotentialEnergyField(std::vector<Body*>& bodies, double &G, RectangularGridDragSelection vectorGrid);
+static inline void PrepareRelativePotentialEnergyField(const BodyStore &bodies, double &G, RectangularGridDragSelection vectorGrid);
 
 /// \}
 
@@ -221,7 +271,25 @@ static inline void PrepareRelativePotentialEnergyField(std::vector<Body*>& bodie
  * @param HEIGHT The specified height of grid cells, together with WIDTH controls the bounds of the energy field visualization
  * @param CELLSIZE The specified size of grid cells, controls the granularity of the potential energy field visualization across the bounds specified by WIDTH and HEIGHT
  */
-static inline void VisualizeGravitationalVectorField(const std::vector<Body*>& bodies, const ofVec2f* bodiesAccelerations, RectangularGridDragSelection vectorGrid);
+static inline void VisualizeGravitationalVectorField(const BodyStore &bodies, RectangularGridDragSelection vectorGrid);
+
+/// \}
+
+
+
+
+
+// ------------- Performance Visualization ------------------
+/// \{
+
+/**
+ * VisualizePhaseProfile: Table of the milliseconds per frame of each phase, the last frame and the mean, median and
+ * 99th percentile over the profiler's window, with the whole frame on the last row.
+ *
+ * @param profiler The profiler the step's PROFILE_PHASE scopes report to.
+ * @param x, y Top left of the table, in screen space.
+ */
+static inline void VisualizePhaseProfile(const PhaseProfiler &profiler, float x, float y);
 
 /// \}
 
@@ -243,7 +311,7 @@ static inline void VisualizeGravitationalVectorField(const std::vector<Body*>& b
 
 
 
-static inline void PrepareRelativePotentialEnergyField(std::vector<Body*>& bodies, double &G, RectangularGridDragSelection vectorGrid)
+static inline void PrepareRelativePotentialEnergyField(const BodyStore &bodies, double &G, RectangularGridDragSelection vectorGrid)
 {
 	//double G = 6.67430; // Define the gravitational constant
 	float minPotential = 0, maxPotential = 10000; // Define the minimum and maximum potential energy in the system
@@ -276,7 +344,7 @@ static inline void PrepareRelativePotentialEnergyField(std::vector<Body*>& bodie
  * @param boundsSize The size of the bounds of the grid.
  * @param CELLSIZE The size of each cell in the grid.
  */
-static inline void VisualizeRelativePotentialEnergyField(std::vector<std::vector<float>> &potentialGrid, std::vector<Body*>& bodies, double &G, float &minPotential, float &maxPotential, RectangularGridDragSelection vectorGrid)
+static inline void VisualizeRelativePotentialEnergyField(std::vector<std::vector<float>> &potentialGrid, const BodyStore &bodies, double &G, float &minPotential, float &maxPotential, RectangularGridDragSelection vectorGrid)
 {
 	// Check if bodies vector is empty
 	if(bodies.empty())
@@ -305,13 +373,13 @@ static inline void VisualizeRelativePotentialEnergyField(std::vector<std::vector
 			float totalPotential = 0;
 			
 			/// Sum up the potentials due to each body
-			for(const auto& body : bodies)
+			for(size_t i = 0; i < bodies.size(); i++)
 			{
-				float dist = point.distance(body->position);
+				float dist = point.distance(PositionOf(bodies, i));
 				
 				if(dist > 0)
 				{
-					float potential = -G * body->mass / dist;  // Calculate the potential due to the body
+					float potential = -G * bodies.mass[i] / dist;  // Calculate the potential due to the body
 					totalPotential += potential;
 				}
 			}
@@ -351,8 +419,10 @@ static inline void VisualizeRelativePotentialEnergyField(std::vector<std::vector
  * This function visualizes the gravitational field of a system of bodies.
  * It calculates the gravitational field at each point in a grid, taking into account the influence of all bodies.
  * The field is then visualized by drawing arrows representing the direction and magnitude of the field at each point.
+ * The inner loop runs over every body for every grid point, so it reads the bodies' positions and accelerations from
+ * the arrays of a BodyStore rather than through one pointer per body.
  */
-static inline void VisualizeGravitationalVectorField(const std::vector<Body*>& bodies, const ofVec2f* bodiesAccelerations, RectangularGridDragSelection vectorGrid)
+static inline void VisualizeGravitationalVectorField(const BodyStore &bodies, RectangularGridDragSelection vectorGrid)
 {
 	ofVec2f gField; // gravitational field at a given point
 	ofVec3f point;  // point in the grid
@@ -368,18 +438,21 @@ static inline void VisualizeGravitationalVectorField(const std::vector<Body*>& b
 		for (int y = -boundsSize*0.5; y < boundsSize; y += CELLSIZE)
 		{
 			point.set(x, y, 0);
-			gField.set(0, 0);
 			
 			/// Sum up the influences from all bodies
+			float fieldX = 0, fieldY = 0;
 			for (size_t i = 0; i < bodies.size(); ++i)
 			{
-				float distance = point.distance(bodies[i]->position);
+				float dx = bodies.x[i] - x, dy = bodies.y[i] - y;
+				float distance = std::sqrt(dx * dx + dy * dy);
 				if (distance < epsilon) continue;  // Skip over the body itself
 				
 				
-				ofVec2f direction = (bodies[i]->position - point).getNormalized();  // Calculate the direction of the influence
-				gField += direction * bodiesAccelerations[i].length() / (distance * distance); // Add the influence to the total gravitational field at this point
+				float influence = std::sqrt(bodies.ax[i] * bodies.ax[i] + bodies.ay[i] * bodies.ay[i]) / (distance * distance * distance); // |a| / d^2 along the unit direction (dx, dy) / d
+				fieldX += dx * influence;
+				fieldY += dy * influence;
 			}
+			gField.set(fieldX, fieldY); // Add the influence to the total gravitational field at this point
 			
 			
 			/// Draw the vector field at this point
@@ -390,3 +463,32 @@ static inline void VisualizeGravitationalVectorField(const std::vector<Body*>& b
 	}
 }
 
+
+
+
+static inline void VisualizePhaseProfile(const PhaseProfiler &profiler, float x, float y)
+{
+	const float rowHeight = 15;
+	const float columnWidth = 60;
+	const float nameWidth = 150;
+	ofSetColor(255);
+	ofDrawBitmapString("Phase (ms / frame)", x, y);
+	const char* columns[] = {"last", "mean", "p50", "p99"};
+	for (int c = 0; c < 4; c++)
+	{
+		ofDrawBitmapString(columns[c], x + nameWidth + c * columnWidth, y);
+	}
+	
+	
+	for (size_t p = 0; p <= ProfilePhaseCount; p++)
+	{
+		const PhaseStatistics &statistics = profiler.statistics[p];
+		float rowY = y + (p + 1) * rowHeight + ((p == ProfilePhaseCount) ? rowHeight * 0.5f : 0); // The frame row set apart from the phases
+		ofDrawBitmapString(ProfilePhaseName((ProfilePhase)p), x, rowY);
+		double values[] = {statistics.last, statistics.mean, statistics.p50, statistics.p99};
+		for (int c = 0; c < 4; c++)
+		{
+			ofDrawBitmapString(ofToString(values[c], 2), x + nameWidth + c * columnWidth, rowY);
+		}
+	}
+}
@@ -0,0 +1,157 @@
+//  ForceSolverBenchmark.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * ForceSolverBenchmark Module: Timing and accuracy comparison of Barnes-Hut, particle-mesh and TreePM
+ *
+ * Description:
+ * Evaluates the accelerations of the current bodies with each solver, a few repetitions each, and reports
+ * the mean wall-clock time per evaluation and the relative difference of the PM and TreePM accelerations
+ * from the Barnes-Hut ones (sum|a - a_BH| / sum|a_BH|). Nothing in the simulation state is modified, the
+ * benchmark uses its own tree and a copy of the bodies per solver, whose ax and ay receive that solver's accelerations.
+ */
+#pragma once
+#include <chrono>
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "Quadtree.hpp"
+#include "PhysicsLogic.hpp"
+#include "ParticleMesh.hpp"
+#include "ofMain.h"
+
+
+
+
+/**
+ * ForceSolverBenchmarkResult: Mean time per force evaluation of each solver and the accuracy of the grid solvers.
+ */
+class ForceSolverBenchmarkResult
+{
+public:
+	size_t bodyCount = 0;  // Number of bodies benchmarked
+	double barnesHutMilliseconds = 0;  // Tree build plus walk
+	double particleMeshMilliseconds = 0;  // Mass assignment, field solve and interpolation
+	double treePMMilliseconds = 0;  // Tree build, PM long range and short-range walk
+	double particleMeshDifference = 0;  // Relative difference of the PM accelerations from Barnes-Hut
+	double treePMDifference = 0;  // Relative difference of the TreePM accelerations from Barnes-Hut
+};
+
+
+
+
+
+
+
+
+/**
+ * BenchmarkForceSolvers: Time every solver on the given bodies and compare their accelerations.
+ *
+ * @param bodies       The bodies
+ * @param particleMesh PM solver state, its configuration (grid size, split, threads) is what gets benchmarked
+ * @param G            Universal gravitational constant
+ * @param theta        Barnes-Hut theta parameter for MAC
+ * @param repetitions  Number of timed evaluations per solver, the first (warm-up) evaluation is not timed
+ * @return The timings and differences
+ */
+static inline ForceSolverBenchmarkResult BenchmarkForceSolvers(const BodyStore &bodies, ParticleMeshSolver &particleMesh, float G, float theta, int repetitions = 3);
+
+
+
+/**
+ * PrintForceSolverBenchmark: Write a benchmark result to the console.
+ */
+static inline void PrintForceSolverBenchmark(const ForceSolverBenchmarkResult &result);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline ForceSolverBenchmarkResult BenchmarkForceSolvers(const BodyStore &bodies, ParticleMeshSolver &particleMesh, float G, float theta, int repetitions)
+{
+	ForceSolverBenchmarkResult result;
+	result.bodyCount = bodies.size();
+	if (bodies.empty())
+	{
+		return result;
+	}
+
+
+	BodyStore barnesHut = bodies, particleMeshAccelerations = bodies, treePM = bodies;
+	BodyStore* accelerations = nullptr;
+	Quadtree* tree = nullptr;
+
+
+	// Runs 'solver' once untimed and then 'repetitions' times, returning the mean time and leaving the last result in 'output'
+	auto timeSolver = [&](BodyStore &output, auto solver)
+	{
+		double totalMilliseconds = 0;
+		for (int r = 0; r <= repetitions; r++)
+		{
+			ClearAccelerations(output);
+			accelerations = &output;
+
+			auto start = std::chrono::steady_clock::now();
+			solver();
+			auto stop = std::chrono::steady_clock::now();
+
+			if (r > 0)
+			{
+				totalMilliseconds += std::chrono::duration<double, std::milli>(stop - start).count();
+			}
+		}
+		return totalMilliseconds / std::max(repetitions, 1);
+	};
+
+
+	result.barnesHutMilliseconds = timeSolver(barnesHut, [&]()
+	{
+		BuildQuadtree(tree, *accelerations);
+		ComputeAllForces(tree, *accelerations, G, theta);
+	});
+
+	result.particleMeshMilliseconds = timeSolver(particleMeshAccelerations, [&]()
+	{
+		ComputeAllForcesParticleMesh(*accelerations, particleMesh, G);
+	});
+
+	result.treePMMilliseconds = timeSolver(treePM, [&]()
+	{
+		BuildQuadtree(tree, *accelerations);
+		ComputeAllForcesTreePM(tree, *accelerations, particleMesh, G, theta);
+	});
+	delete tree;
+
+
+	double referenceSum = 0, particleMeshSum = 0, treePMSum = 0;
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		ofVec2f reference = AccelerationOf(barnesHut, i);
+		referenceSum += reference.length();
+		particleMeshSum += (AccelerationOf(particleMeshAccelerations, i) - reference).length();
+		treePMSum += (AccelerationOf(treePM, i) - reference).length();
+	}
+	if (referenceSum > 0)
+	{
+		result.particleMeshDifference = particleMeshSum / referenceSum;
+		result.treePMDifference = treePMSum / referenceSum;
+	}
+	return result;
+}
+
+
+
+static inline void PrintForceSolverBenchmark(const ForceSolverBenchmarkResult &result)
+{
+	cout << "\n\nForce solver benchmark, " << result.bodyCount << " bodies";
+	cout << "\n Barnes-Hut:    " << result.barnesHutMilliseconds << " ms";
+	cout << "\n Particle-mesh: " << result.particleMeshMilliseconds << " ms, relative difference from Barnes-Hut " << result.particleMeshDifference;
+	cout << "\n TreePM:        " << result.treePMMilliseconds << " ms, relative difference from Barnes-Hut " << result.treePMDifference << "\n";
+}
@@ -0,0 +1,161 @@
+//  IntegratorBenchmark.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * IntegratorBenchmark Module: Energy error against wall-clock time of the symplectic integrators
+ *
+ * Description:
+ * Runs every scheme of 'SymplecticIntegrators.hpp' over the same simulated time on a private copy of the current
+ * bodies, at the frame dt and at twice and four times it, and reports the wall-clock time and the relative energy
+ * error of each run. The fourth-order schemes cost three force evaluations per step instead of one, so whether
+ * they pay off depends on how much larger a step they can take at the same error, which is what this shows for
+ * the scenario at hand. The simulation's own bodies are not modified.
+ */
+#pragma once
+#include <chrono>
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "Quadtree.hpp"
+#include "PhysicsLogic.hpp"
+#include "SymplecticIntegrators.hpp"
+#include "ofMain.h"
+
+
+
+
+/**
+ * IntegratorBenchmarkRun: One scheme at one step size.
+ */
+class IntegratorBenchmarkRun
+{
+public:
+	SymplecticScheme scheme;  // The composition
+	float dt;  // Its step size
+	int steps;  // Number of steps taken
+	size_t forceEvaluations;  // Whole-system force evaluations made
+	double wallSeconds;  // Wall-clock time of the run, tree builds included
+	double relativeEnergyError;  // |E - E_0| / |E_0| at the end of the run
+};
+
+
+
+/**
+ * IntegratorBenchmarkResult: All runs on one set of bodies.
+ */
+class IntegratorBenchmarkResult
+{
+public:
+	size_t bodyCount = 0;  // Number of bodies benchmarked
+	float simulatedTime = 0;  // Simulated time every run covers
+	std::vector<IntegratorBenchmarkRun> runs;  // One entry per scheme and step size
+};
+
+
+
+
+
+
+
+
+/**
+ * BenchmarkIntegrators: Run every symplectic scheme on a copy of the bodies at dt, 2 dt and 4 dt.
+ *
+ * @param bodies The bodies, copied, not modified
+ * @param G      Universal gravitational constant
+ * @param theta  Barnes-Hut theta parameter for MAC
+ * @param dt     The smallest step size, usually the simulation's
+ * @param steps  Number of steps at the smallest step size, the larger ones take proportionally fewer
+ * @return The runs
+ */
+static inline IntegratorBenchmarkResult BenchmarkIntegrators(const BodyStore &bodies, float G, float theta, float dt, int steps = 64);
+
+
+
+/**
+ * PrintIntegratorBenchmark: Write a benchmark result to the console.
+ */
+static inline void PrintIntegratorBenchmark(const IntegratorBenchmarkResult &result);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline IntegratorBenchmarkResult BenchmarkIntegrators(const BodyStore &bodies, float G, float theta, float dt, int steps)
+{
+	IntegratorBenchmarkResult result;
+	result.bodyCount = bodies.size();
+	result.simulatedTime = dt * steps;
+	if (bodies.empty())
+	{
+		return result;
+	}
+
+
+	const SymplecticScheme schemes[3] = {SymplecticScheme::LeapfrogKDK, SymplecticScheme::Yoshida4, SymplecticScheme::ForestRuth4};
+	for (SymplecticScheme scheme : schemes)
+	{
+		for (int stride = 1; stride <= 4; stride *= 2)
+		{
+			BodyStore copies = bodies;
+			ClearAccelerations(copies);
+			Quadtree* tree = nullptr;
+
+			SymplecticIntegrator integrator;
+			integrator.scheme = scheme;
+			integrator.energySampleInterval = 1 << 30; // only the reference at the start, the end is measured below
+			bool driftFirst = (scheme == SymplecticScheme::ForestRuth4);
+
+
+			int runSteps = steps / stride;
+			auto start = std::chrono::steady_clock::now();
+			for (int s = 0; s <= runSteps; s++) // the extra pass only closes the deferred kick
+			{
+				BuildQuadtree(tree, copies);
+				if (!driftFirst)
+				{
+					ClearAccelerations(copies);
+					ComputeAllForces(tree, copies, G, theta);
+				}
+				if (s == runSteps)
+				{
+					for (size_t i = 0; i < copies.size(); i++)
+					{
+						SetVelocity(copies, i, VelocityOf(copies, i) + AccelerationOf(copies, i) * integrator.pendingKick);
+					}
+					break;
+				}
+				AdvanceSymplectic(tree, copies, integrator, G, theta, dt * stride);
+			}
+			double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+
+			double energy = ComputeTreeEnergy(tree, copies, G, theta, 0);
+			double relativeError = (integrator.referenceEnergy != 0) ? std::fabs((energy - integrator.referenceEnergy) / integrator.referenceEnergy) : 0;
+			result.runs.push_back({scheme, dt * stride, runSteps, integrator.forceEvaluations, wallSeconds, relativeError});
+
+			delete tree;
+		}
+	}
+	return result;
+}
+
+
+
+static inline void PrintIntegratorBenchmark(const IntegratorBenchmarkResult &result)
+{
+	cout << "\n\nIntegrator benchmark, " << result.bodyCount << " bodies over a simulated time of " << result.simulatedTime;
+	for (const IntegratorBenchmarkRun &run : result.runs)
+	{
+		cout << "\n " << SymplecticSchemeName(run.scheme) << ", dt " << run.dt << ": " << run.steps << " steps, " << run.forceEvaluations << " force evaluations, "
+			 << run.wallSeconds << " s, relative energy error " << run.relativeEnergyError << ", error per wall second " << run.relativeEnergyError / std::max(run.wallSeconds, 1e-9);
+	}
+	cout << "\n";
+}
@@ -0,0 +1,204 @@
+//  PrecisionBenchmark.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * PrecisionBenchmark Module: Cost and accuracy of float, double and double/float-kernel stepping
+ *
+ * Description:
+ * Steps private copies of the current bodies with the templated core at every 'Precision', the same number of
+ * leapfrog steps each, optionally moved 'originOffset' away from the origin first, where floats lose resolution.
+ * Reports the wall-clock time of each run and how far its bodies ended up from the double run's (RMS and maximum
+ * distance), which is what is needed to pick the cheapest precision that stays accurate for a long run.
+ * The simulation's own bodies are not modified.
+ */
+#pragma once
+#include <chrono>
+#include <cmath>
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "Quadtree.hpp"
+#include "PhysicsLogic.hpp"
+#include "Precision.hpp"
+#include "ofMain.h"
+
+
+
+
+/**
+ * PrecisionBenchmarkRun: One precision.
+ */
+class PrecisionBenchmarkRun
+{
+public:
+	Precision precision;  // Position and kernel scalars
+	double wallSeconds = 0;  // Wall-clock time of the run, tree builds included
+	double rmsDeviation = 0;  // RMS distance of the final positions from the double run's
+	double maxDeviation = 0;  // Largest such distance
+};
+
+
+
+/**
+ * PrecisionBenchmarkResult: All runs on one set of bodies.
+ */
+class PrecisionBenchmarkResult
+{
+public:
+	size_t bodyCount = 0;  // Number of bodies benchmarked
+	int steps = 0;  // Steps every run takes
+	float originOffset = 0;  // Distance the bodies were moved from their positions along both axes
+	std::vector<PrecisionBenchmarkRun> runs;  // Double first, it is the reference
+};
+
+
+
+
+
+
+
+
+/**
+ * BenchmarkPrecision: Step copies of the bodies at every precision and compare their final positions.
+ *
+ * @param bodies       The bodies, copied, not modified
+ * @param G            Universal gravitational constant
+ * @param theta        Barnes-Hut theta parameter for MAC
+ * @param dt           Step size
+ * @param steps        Number of leapfrog steps per run
+ * @param originOffset Added to both coordinates of every copy before stepping
+ * @return The runs
+ */
+static inline PrecisionBenchmarkResult BenchmarkPrecision(const BodyStore &bodies, float G, float theta, float dt, int steps = 64, float originOffset = 0);
+
+
+
+/**
+ * StepAtPrecision: Run 'steps' leapfrog steps of copies of the bodies with positions in Real and kernels in Kernel.
+ *
+ * @param finalPositions Receives the final positions, in double
+ * @return The wall-clock time of the run
+ */
+template<typename Real, typename Kernel>
+static inline double StepAtPrecision(const BodyStore &bodies, float G, float theta, float dt, int steps, double originOffset, std::vector<Vector2<double>> &finalPositions);
+
+
+
+/**
+ * PrintPrecisionBenchmark: Write a benchmark result to the console.
+ */
+static inline void PrintPrecisionBenchmark(const PrecisionBenchmarkResult &result);
+
+
+
+
+
+
+
+
+
+
+
+
+template<typename Real, typename Kernel>
+static inline double StepAtPrecision(const BodyStore &bodies, float G, float theta, float dt, int steps, double originOffset, std::vector<Vector2<double>> &finalPositions)
+{
+	typedef typename PrecisionTraits<Real>::Vector Vector;
+	typedef typename PrecisionTraits<Real>::Rectangle Rectangle;
+
+
+	BasicBodyStore<Real> copies;
+	ResizeBodyStore(copies, bodies.size());
+	double minX = 0, minY = 0, maxX = 0, maxY = 0;
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		Vector position((Real)((double)bodies.x[i] + originOffset), (Real)((double)bodies.y[i] + originOffset)); // offset added in double
+		SetPosition(copies, i, position);
+		SetVelocity(copies, i, ConvertVector<Vector>(VelocityOf(bodies, i)));
+		copies.mass[i] = (Real)bodies.mass[i];
+
+		minX = (i == 0) ? position.x : std::min(minX, (double)position.x);
+		minY = (i == 0) ? position.y : std::min(minY, (double)position.y);
+		maxX = (i == 0) ? position.x : std::max(maxX, (double)position.x);
+		maxY = (i == 0) ? position.y : std::max(maxY, (double)position.y);
+	}
+	double size = std::max(maxX - minX, maxY - minY) * 4 + 1; // room for the bodies to spread during the run
+	Rectangle rootBounds((Real)((minX + maxX - size) * 0.5), (Real)((minY + maxY - size) * 0.5), (Real)size, (Real)size);
+
+
+	BasicQuadtree<Real>* tree = nullptr;
+	auto start = std::chrono::steady_clock::now();
+	for (int s = 0; s < steps; s++)
+	{
+		BuildQuadtree(tree, copies, rootBounds);
+		ClearAccelerations(copies);
+		ComputeAllForces<Real, Kernel>(tree, copies, G, theta);
+		ComputeVelocityAndPosition(dt, copies);
+	}
+	double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+
+	finalPositions.resize(copies.size());
+	for (size_t i = 0; i < copies.size(); i++)
+	{
+		finalPositions[i] = ConvertVector<Vector2<double>>(PositionOf(copies, i));
+	}
+	delete tree;
+	return wallSeconds;
+}
+
+
+
+static inline PrecisionBenchmarkResult BenchmarkPrecision(const BodyStore &bodies, float G, float theta, float dt, int steps, float originOffset)
+{
+	PrecisionBenchmarkResult result;
+	result.bodyCount = bodies.size();
+	result.steps = steps;
+	result.originOffset = originOffset;
+	if (bodies.empty())
+	{
+		return result;
+	}
+
+
+	std::vector<Vector2<double>> reference, positions;
+	const Precision precisions[3] = {Precision::Double, Precision::DoubleFloatKernels, Precision::Float};
+	for (Precision precision : precisions)
+	{
+		PrecisionBenchmarkRun run;
+		run.precision = precision;
+		run.wallSeconds = WithPrecision(precision, [&](auto tag)
+		{
+			typedef typename decltype(tag)::Real Real;
+			typedef typename decltype(tag)::Kernel Kernel;
+			return StepAtPrecision<Real, Kernel>(bodies, G, theta, dt, steps, originOffset, (precision == Precision::Double) ? reference : positions);
+		});
+
+
+		if (precision != Precision::Double)
+		{
+			double sumSquares = 0;
+			for (size_t i = 0; i < positions.size(); i++)
+			{
+				double deviation = positions[i].distance(reference[i]);
+				sumSquares += deviation * deviation;
+				run.maxDeviation = std::max(run.maxDeviation, deviation);
+			}
+			run.rmsDeviation = std::sqrt(sumSquares / positions.size());
+		}
+		result.runs.push_back(run);
+	}
+	return result;
+}
+
+
+
+static inline void PrintPrecisionBenchmark(const PrecisionBenchmarkResult &result)
+{
+	cout << "\n\nPrecision benchmark, " << result.bodyCount << " bodies, " << result.steps << " steps, origin offset " << result.originOffset;
+	for (const PrecisionBenchmarkRun &run : result.runs)
+	{
+		cout << "\n " << PrecisionName(run.precision) << ": " << run.wallSeconds << " s, position deviation from double RMS " << run.rmsDeviation << ", max " << run.maxDeviation;
+	}
+	cout << "\n";
+}
@@ -0,0 +1,211 @@
+//  ScratchBenchmark.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * ScratchBenchmark Module: DynamicBufferArray against std::vector as the scratch lists of the interaction walk
+ *
+ * Description:
+ * Runs the interaction walk of InteractionWalk.hpp over the current bodies on one tree, with its walk list and
+ * interaction list held in
+ * 			- std::vectors constructed for every body (what a straightforward walk does),
+ * 			- std::vectors per thread, cleared for every body (capacity reused within a step, reallocated every step),
+ * 			- DynamicBufferArrays backed by per-thread arenas kept across steps ('ComputeQuadTreeForce'),
+ * and the recursive 'ComputeAllForces' for reference. Reports the mean time of each and the largest difference of
+ * the walks' accelerations from the recursive ones, which should be zero.
+ * Nothing in the simulation state is modified, the benchmark uses its own tree and copies of the bodies.
+ */
+#pragma once
+#include <chrono>
+#include "SimulationEntities.hpp"
+#include "BodyStore.hpp"
+#include "Quadtree.hpp"
+#include "PhysicsLogic.hpp"
+#include "InteractionWalk.hpp"
+#include "ofMain.h"
+
+
+
+
+/**
+ * ScratchBenchmarkResult: Mean time per force evaluation of each way of holding the walk's scratch.
+ */
+class ScratchBenchmarkResult
+{
+public:
+	size_t bodyCount = 0;  // Number of bodies benchmarked
+	unsigned int threadCount = 0;  // Worker threads of the walks
+	double recursiveMilliseconds = 0;  // 'ComputeAllForces', no scratch at all
+	double vectorPerBodyMilliseconds = 0;  // std::vector lists constructed for every body
+	double vectorPerThreadMilliseconds = 0;  // std::vector lists per thread, cleared for every body
+	double bufferArrayMilliseconds = 0;  // DynamicBufferArray lists with per-thread arenas
+	double meanInteractions = 0;  // Mean interaction list length, for sizing the inline capacity
+	size_t arenaBytes = 0;  // Bytes the arenas hold after the runs, zero if every list fit inline
+	float maxDifference = 0;  // Largest |a_walk - a_recursive| over every walk and body
+};
+
+
+
+
+
+
+
+
+/**
+ * BenchmarkTraversalScratch: Time the interaction walk with each kind of scratch list on the given bodies.
+ *
+ * @param bodies      The bodies
+ * @param G           Universal gravitational constant
+ * @param theta       Barnes-Hut theta parameter for MAC
+ * @param threadCount Worker threads of the walks, 0 selects DefaultThreadCount()
+ * @param repetitions Number of timed evaluations per variant, the first (warm-up) evaluation is not timed
+ * @return The timings
+ */
+static inline ScratchBenchmarkResult BenchmarkTraversalScratch(const BodyStore &bodies, float G, float theta, unsigned int threadCount = 0, int repetitions = 5);
+
+
+
+/**
+ * ComputeQuadTreeForceWithVectors: 'ComputeQuadTreeForce' with std::vector scratch, per body or per thread.
+ */
+static inline void ComputeQuadTreeForceWithVectors(Quadtree* &rootNode, BodyStore &bodies, unsigned int threadCount, bool perBody, float G, float theta);
+
+
+
+/**
+ * PrintScratchBenchmark: Write a benchmark result to the console.
+ */
+static inline void PrintScratchBenchmark(const ScratchBenchmarkResult &result);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline ScratchBenchmarkResult BenchmarkTraversalScratch(const BodyStore &bodies, float G, float theta, unsigned int threadCount, int repetitions)
+{
+	ScratchBenchmarkResult result;
+	result.bodyCount = bodies.size();
+	result.threadCount = (threadCount > 0) ? threadCount : DefaultThreadCount();
+	if (bodies.empty())
+	{
+		return result;
+	}
+
+
+	BodyStore reference = bodies, walked = bodies; // same positions, so the one tree serves both
+	Quadtree* tree = nullptr;
+	BuildQuadtree(tree, reference);
+	BodyStore* accelerations = nullptr;
+
+
+	// Runs 'walk' once untimed and then 'repetitions' times, returning the mean time and leaving the last result in 'output'
+	auto timeWalk = [&](BodyStore &output, auto walk)
+	{
+		double totalMilliseconds = 0;
+		for (int r = 0; r <= repetitions; r++)
+		{
+			ClearAccelerations(output);
+			accelerations = &output;
+
+			auto start = std::chrono::steady_clock::now();
+			walk();
+			auto stop = std::chrono::steady_clock::now();
+
+			if (r > 0)
+			{
+				totalMilliseconds += std::chrono::duration<double, std::milli>(stop - start).count();
+			}
+		}
+		return totalMilliseconds / std::max(repetitions, 1);
+	};
+
+	auto maxDifference = [&]()
+	{
+		for (size_t i = 0; i < bodies.size(); i++)
+		{
+			result.maxDifference = std::max(result.maxDifference, (AccelerationOf(walked, i) - AccelerationOf(reference, i)).length());
+		}
+	};
+
+
+	result.recursiveMilliseconds = timeWalk(reference, [&]()
+	{
+		ComputeAllForces(tree, *accelerations, G, theta, result.threadCount);
+	});
+
+	result.vectorPerBodyMilliseconds = timeWalk(walked, [&]()
+	{
+		ComputeQuadTreeForceWithVectors(tree, *accelerations, result.threadCount, true, G, theta);
+	});
+	maxDifference();
+
+	result.vectorPerThreadMilliseconds = timeWalk(walked, [&]()
+	{
+		ComputeQuadTreeForceWithVectors(tree, *accelerations, result.threadCount, false, G, theta);
+	});
+	maxDifference();
+
+	TraversalScratch scratch;
+	scratch.threadCount = result.threadCount;
+	result.bufferArrayMilliseconds = timeWalk(walked, [&]()
+	{
+		ComputeQuadTreeForce(tree, *accelerations, scratch, G, theta);
+	});
+	maxDifference();
+	delete tree;
+
+
+	result.meanInteractions = (scratch.walks > 0) ? (double)scratch.interactions / scratch.walks : 0;
+	for (const ScratchArena &arena : scratch.arenas)
+	{
+		result.arenaBytes += arena.capacity();
+	}
+	return result;
+}
+
+
+
+static inline void ComputeQuadTreeForceWithVectors(Quadtree* &rootNode, BodyStore &bodies, unsigned int threadCount, bool perBody, float G, float theta)
+{
+	ParallelFor(0, bodies.size(), threadCount, [&rootNode, &bodies, perBody, G, theta](size_t begin, size_t end, unsigned int)
+	{
+		std::vector<Quadtree*> threadWalkList, threadInteractList;
+		for (size_t i = begin; i < end; i++)
+		{
+			ofVec2f position = PositionOf(bodies, i);
+			ofVec2f acceleration(0, 0);
+			if (perBody)
+			{
+				std::vector<Quadtree*> walkList, interactList;
+				TraverseInteractionList(rootNode, i, position, walkList, interactList, theta);
+				ComputeForceInteractionList(bodies, position, acceleration, interactList, G);
+			}
+			else
+			{
+				threadInteractList.clear();
+				TraverseInteractionList(rootNode, i, position, threadWalkList, threadInteractList, theta);
+				ComputeForceInteractionList(bodies, position, acceleration, threadInteractList, G);
+			}
+			AddAcceleration(bodies, i, acceleration);
+		}
+	});
+}
+
+
+
+static inline void PrintScratchBenchmark(const ScratchBenchmarkResult &result)
+{
+	cout << "\n\nTraversal scratch benchmark, " << result.bodyCount << " bodies, " << result.threadCount << " threads, " << result.meanInteractions << " interactions per body";
+	cout << "\n Recursive walk:                   " << result.recursiveMilliseconds << " ms";
+	cout << "\n std::vector per body:             " << result.vectorPerBodyMilliseconds << " ms";
+	cout << "\n std::vector per thread:           " << result.vectorPerThreadMilliseconds << " ms";
+	cout << "\n DynamicBufferArray + arena:       " << result.bufferArrayMilliseconds << " ms, arenas hold " << result.arenaBytes << " bytes";
+	cout << "\n Largest difference from recursive: " << result.maxDifference << "\n";
+}
@@ -0,0 +1,172 @@
+//  AlignedArray.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * AlignedArray Module: Contiguous, cache-line aligned, geometrically growing array of trivially copyable values
+ *
+ * Description:
+ * std::vector only guarantees the alignment of its element type, so a float array may start anywhere in a cache line
+ * and a vectorized loop over it has to peel a misaligned head first. AlignedArray always starts on an 'Alignment'
+ * byte boundary (a cache line, which is also the widest SIMD register of any target in use) and rounds its
+ * capacity up to whole cache lines, so loops may run over the padding at the end without a scalar tail.
+ *
+ * Growth doubles the capacity, so adding bodies one at a time costs amortized O(1) copies. Elements are copied
+ * with memcpy, which is why T must be trivially copyable.
+ *
+ * An array with 'setPlacement(true)' allocates through MemoryPlacement.hpp instead: huge pages, and new storage
+ * first-touched (copied or zeroed) by the worker threads that will use each part of it.
+ */
+#pragma once
+#include <cstdlib>
+#include <stdlib.h>
+#include <cstring>
+#include <new>
+#include <algorithm>
+#include <type_traits>
+#include "MemoryPlacement.hpp"
+
+
+
+
+template<typename T, size_t Alignment = 64>
+class AlignedArray
+{
+	static_assert(std::is_trivially_copyable<T>::value, "AlignedArray copies its elements with memcpy");
+	static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two at least alignof(T)");
+
+public:
+	// ------------- Constructors and Destructor -------------
+	AlignedArray() {}
+	AlignedArray(const AlignedArray &other) { *this = other; }
+	AlignedArray(AlignedArray &&other) noexcept : elements(other.elements), count(other.count), allocated(other.allocated), placed(other.placed), placedStorage(other.placedStorage) { other.elements = nullptr; other.count = other.allocated = 0; other.placedStorage = PlacedAllocation(); }
+	~AlignedArray() { release(); }
+
+	AlignedArray& operator=(const AlignedArray &other)
+	{
+		if (this != &other)
+		{
+			resize(other.count);
+			if (other.count > 0)
+			{
+				std::memcpy(elements, other.elements, other.count * sizeof(T));
+			}
+		}
+		return *this;
+	}
+
+	AlignedArray& operator=(AlignedArray &&other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			elements = other.elements;
+			count = other.count;
+			allocated = other.allocated;
+			placed = other.placed;
+			placedStorage = other.placedStorage;
+			other.elements = nullptr;
+			other.count = other.allocated = 0;
+			other.placedStorage = PlacedAllocation();
+		}
+		return *this;
+	}
+
+
+	// ------------- Element Access -------------
+	T* data() { return elements; }
+	const T* data() const { return elements; }
+	T& operator[](size_t i) { return elements[i]; }
+	const T& operator[](size_t i) const { return elements[i]; }
+	size_t size() const { return count; }
+	size_t capacity() const { return allocated; }
+	bool empty() const { return count == 0; }
+
+
+	// ------------- Placement -------------
+	void setPlacement(bool enabled) { placed = enabled; } // Later allocations go through 'AllocatePlaced' and 'FirstTouch'
+	bool isPlaced() const { return placed; }
+
+
+	// ------------- Size Management -------------
+	void reserve(size_t minimumCapacity) // Exactly 'minimumCapacity', rounded up to whole cache lines
+	{
+		if (minimumCapacity <= allocated)
+		{
+			return;
+		}
+		size_t bytes = ((minimumCapacity * sizeof(T) + Alignment - 1) / Alignment) * Alignment;
+		if (placed)
+		{
+			PlacedAllocation grown = AllocatePlaced(bytes, Alignment, memoryPlacement);
+			FirstTouch(grown.memory, elements, count, bytes / sizeof(T), sizeof(T), memoryPlacement);
+			release();
+			placedStorage = grown;
+			elements = static_cast<T*>(grown.memory);
+			allocated = bytes / sizeof(T);
+			return;
+		}
+		void* allocation = nullptr;
+		if (posix_memalign(&allocation, Alignment, bytes) != 0) // std::aligned_alloc is missing from older macOS SDKs
+		{
+			throw std::bad_alloc();
+		}
+		T* grown = static_cast<T*>(allocation);
+		if (count > 0)
+		{
+			std::memcpy(grown, elements, count * sizeof(T));
+		}
+		release();
+		elements = grown;
+		allocated = bytes / sizeof(T);
+	}
+
+	void resize(size_t newCount) // New elements are value-initialized (zero for arithmetic types)
+	{
+		grow(newCount);
+		for (size_t i = count; i < newCount; i++)
+		{
+			elements[i] = T();
+		}
+		count = newCount;
+	}
+
+	void push_back(const T &value)
+	{
+		grow(count + 1);
+		elements[count++] = value;
+	}
+
+	void pop_back() { count--; }
+	void clear() { count = 0; }
+
+
+private:
+	void grow(size_t minimumCapacity) // Geometric growth, doubling until 'minimumCapacity' fits
+	{
+		if (minimumCapacity > allocated)
+		{
+			reserve(std::max(minimumCapacity, allocated * 2));
+		}
+	}
+
+	void release() // Frees the storage the way it was allocated
+	{
+		if (elements != nullptr && elements == placedStorage.memory)
+		{
+			FreePlaced(placedStorage);
+		}
+		else
+		{
+			std::free(elements);
+		}
+		placedStorage = PlacedAllocation();
+		elements = nullptr;
+	}
+
+	T* elements = nullptr;  // Aligned to 'Alignment', owned
+	size_t count = 0;  // Elements in use
+	size_t allocated = 0;  // Elements that fit without reallocating
+	bool placed = false;  // Whether new storage comes from 'AllocatePlaced'
+	PlacedAllocation placedStorage;  // The storage, while it came from 'AllocatePlaced'
+};
@@ -0,0 +1,126 @@
+//  ConcurrentBuffers.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * ConcurrentBuffers Module: Lock-free hand-off of data between exactly two threads
+ *
+ * Description:
+ * Two structures for the case of one producing and one consuming thread, neither of which may ever wait on the other:
+ * 			- TripleBuffer, the producer always has a slot to write the next state into and the consumer always has a
+ * 			  complete state to read. A third slot in between is swapped atomically with either side, so publishing and
+ * 			  acquiring are a single atomic exchange each, and states the consumer never got to are simply overwritten.
+ * 			- SingleProducerQueue, a fixed-capacity ring of messages. Each index is written by one side only, so pushing
+ * 			  and popping need no compare-and-swap, just acquire/release ordering on the two indices. A full ring
+ * 			  rejects the push rather than blocking.
+ */
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+
+
+
+/**
+ * TripleBuffer: Latest-value hand-off, the writer publishes whole states and the reader picks up the newest one.
+ */
+template<typename T>
+class TripleBuffer
+{
+public:
+	// ------------- Producer -------------
+	T& writeBuffer() { return slots[writeIndex]; } // Slot to fill before 'publish'
+	void publish(); // Make the filled slot the newest state, the previous middle slot becomes the next one to write
+
+
+	// ------------- Consumer -------------
+	bool acquire(); // Take the newest state if one was published since the last call, returns whether it did
+	T& readBuffer() { return slots[readIndex]; } // The state taken by the last successful 'acquire'
+
+
+private:
+	static const int freshBit = 4; // Set in 'middle' while it holds a state the reader hasn't taken
+	T slots[3];
+	int writeIndex = 0; // Owned by the producer
+	int readIndex = 1; // Owned by the consumer
+	std::atomic<int> middle{2}; // Index of the slot in between, plus 'freshBit'
+};
+
+
+
+/**
+ * SingleProducerQueue: Bounded ring of messages from one producing thread to one consuming thread.
+ */
+template<typename T, size_t Capacity>
+class SingleProducerQueue
+{
+public:
+	bool push(const T &value); // Producer only, false if the ring is full
+	bool pop(T &value); // Consumer only, false if the ring is empty
+
+
+private:
+	T ring[Capacity];
+	std::atomic<size_t> head{0}; // Next slot to read, written by the consumer
+	std::atomic<size_t> tail{0}; // Next slot to write, written by the producer
+};
+
+
+
+
+
+
+
+
+
+
+
+
+template<typename T>
+void TripleBuffer<T>::publish()
+{
+	writeIndex = middle.exchange(writeIndex | freshBit, std::memory_order_acq_rel) & 3;
+}
+
+
+
+template<typename T>
+bool TripleBuffer<T>::acquire()
+{
+	if (!(middle.load(std::memory_order_relaxed) & freshBit))
+	{
+		return false;
+	}
+	readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & 3; // only the producer can set the bit again, it is still set here
+	return true;
+}
+
+
+
+template<typename T, size_t Capacity>
+bool SingleProducerQueue<T, Capacity>::push(const T &value)
+{
+	size_t currentTail = tail.load(std::memory_order_relaxed);
+	if (currentTail - head.load(std::memory_order_acquire) >= Capacity)
+	{
+		return false;
+	}
+	ring[currentTail % Capacity] = value;
+	tail.store(currentTail + 1, std::memory_order_release);
+	return true;
+}
+
+
+
+template<typename T, size_t Capacity>
+bool SingleProducerQueue<T, Capacity>::pop(T &value)
+{
+	size_t currentHead = head.load(std::memory_order_relaxed);
+	if (currentHead == tail.load(std::memory_order_acquire))
+	{
+		return false;
+	}
+	value = ring[currentHead % Capacity];
+	head.store(currentHead + 1, std::memory_order_release);
+	return true;
+}
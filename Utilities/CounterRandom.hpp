@@ -0,0 +1,94 @@
+//  CounterRandom.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * CounterRandom Module: Counter-based random numbers, the n-th number of a stream computed directly from (key, n)
+ *
+ * Description:
+ * Philox4x32-10 (Salmon, Moraes, Dror and Shaw, "Parallel random numbers: as easy as 1, 2, 3", SC'11) maps a
+ * 128 bit counter and a 64 bit key to 128 random bits with ten rounds of multiplies and xors. There is no state
+ * to carry from one number to the next, so a random stream is just a key and a counter: keyed by the seed and
+ * counted by (index, draw), the numbers of body 'index' are the same on whichever thread, in whichever order and
+ * with however many threads its galaxy is generated, and the generation is embarrassingly parallel.
+ *
+ * 'CounterRandom' hands out the 32 bit words of one such stream in order, four per Philox evaluation. The
+ * outputs match the Random123 reference implementation ('Philox4x32' is checked against its known answers).
+ */
+#pragma once
+#include <array>
+#include <cstdint>
+
+
+
+
+/**
+ * Philox4x32: The 128 random bits of 'counter' under 'key', ten rounds.
+ */
+static inline std::array<uint32_t, 4> Philox4x32(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key);
+
+
+
+/**
+ * UniformFloat: Uniform float in [0, 1) from the top 24 bits of a random word, every value a multiple of 2^-24.
+ */
+static inline float UniformFloat(uint32_t bits);
+
+
+
+/**
+ * CounterRandom: The random stream of one (seed, index) pair, e.g., of one body of a generated galaxy.
+ */
+class CounterRandom
+{
+public:
+	CounterRandom(uint64_t seed, uint64_t index, uint32_t stream = 0) : key{(uint32_t)seed, (uint32_t)(seed >> 32)}, counter{(uint32_t)index, (uint32_t)(index >> 32), 0, stream} {}
+
+	uint32_t next()  // The next 32 random bits of the stream
+	{
+		if (used == 4)
+		{
+			words = Philox4x32(counter, key);
+			counter[2]++;
+			used = 0;
+		}
+		return words[used++];
+	}
+	float uniform() { return UniformFloat(next()); }  // Uniform in [0, 1)
+	float uniform(float min, float max) { return min + (max - min) * uniform(); }  // Uniform in [min, max)
+
+	std::array<uint32_t, 2> key;  // Seed
+	std::array<uint32_t, 4> counter;  // Index (low, high), draw, stream
+	std::array<uint32_t, 4> words = {0, 0, 0, 0};  // Output of the last evaluation
+	int used = 4;  // Words of 'words' handed out already
+};
+
+
+
+
+
+
+
+
+
+static inline std::array<uint32_t, 4> Philox4x32(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key)
+{
+	const uint32_t multiplier0 = 0xD2511F53, multiplier1 = 0xCD9E8D57;
+	const uint32_t weyl0 = 0x9E3779B9, weyl1 = 0xBB67AE85; // key schedule, golden ratio and sqrt(3) - 1
+	for (int round = 0; round < 10; round++)
+	{
+		uint64_t product0 = (uint64_t)multiplier0 * counter[0];
+		uint64_t product1 = (uint64_t)multiplier1 * counter[2];
+		counter = {(uint32_t)(product1 >> 32) ^ counter[1] ^ key[0], (uint32_t)product1, (uint32_t)(product0 >> 32) ^ counter[3] ^ key[1], (uint32_t)product0};
+		key[0] += weyl0;
+		key[1] += weyl1;
+	}
+	return counter;
+}
+
+
+
+static inline float UniformFloat(uint32_t bits)
+{
+	return (bits >> 8) * (1.0f / 16777216.0f);
+}
@@ -0,0 +1,380 @@
+//  EventTracer.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * EventTracer Module: A timeline of what every thread did over a few frames, as a Chrome trace
+ *
+ * Description:
+ * 'StartTrace(tracer, frames, path)' arms the tracer for the next 'frames' frames. While it is armed every
+ * 'ScopedTraceEvent' (every PROFILE_PHASE scope opens one, and ParallelFor one per chunk) records where it began and
+ * ended. When 'EndTraceFrame' has been called 'frames' times the events are written to 'path' as Chrome trace JSON,
+ * which chrome://tracing and Perfetto (ui.perfetto.dev) open as one row per thread, e.g., the chunks of a force walk
+ * side by side on their workers, ending at different times if the work is unevenly split.
+ *
+ * Each thread records into its own ring buffer of 'TraceBuffer::capacity' events: the thread is the buffer's only
+ * writer, an event is a store into the next slot and a release store of the count, no lock and no allocation. A
+ * thread takes a buffer from the tracer the first time it records (under a mutex, once per thread) and gives it back
+ * when it exits, so the threads ParallelFor starts for every loop reuse the same few buffers. If a thread records
+ * more than a buffer holds during one trace, its oldest events are overwritten. Events are stored as complete
+ * events (begin and end together), so a lost begin never leaves an end without its begin.
+ *
+ * Disarmed, a scope costs one relaxed atomic load, so the scopes stay compiled in for real runs.
+ */
+#pragma once
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <algorithm>
+
+
+
+
+/**
+ * TraceEvent: One scope of one thread, times in nanoseconds since the tracer's epoch.
+ */
+class TraceEvent
+{
+public:
+	const char* name = "";  // Scope, a string literal
+	const char* category = "";  // "phase", "task" or "frame"
+	int64_t begin = 0;  // Entered
+	int64_t end = 0;  // Left
+	uint64_t items = 0;  // Indices of a ParallelFor chunk, 0 for other scopes
+};
+
+
+
+/**
+ * TraceBuffer: Ring buffer of the events of one thread at a time, written only by that thread.
+ */
+class TraceBuffer
+{
+public:
+	static const size_t capacity = size_t(1) << 15;  // Events kept, a power of two
+
+	std::array<TraceEvent, capacity> events;  // Ring, event n in slot n % capacity
+	std::atomic<uint64_t> written{0};  // Events ever recorded, published with release
+	int slot = 0;  // Index among the tracer's buffers, the trace's thread id
+};
+
+
+
+/**
+ * EventTracer: The buffers of all threads and the trace in progress.
+ */
+class EventTracer
+{
+public:
+	std::atomic<bool> recording{false};  // Armed, the scopes record
+	std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();  // Time zero of the events
+	int64_t traceBegin = 0;  // When the trace in progress was armed, earlier events in the buffers are left out
+	int64_t frameBegin = 0;  // Start of the current traced frame
+	int framesLeft = 0;  // Frames still to trace
+	std::string path;  // File the trace in progress goes to
+
+	std::mutex buffersMutex;  // Guards 'buffers' and 'freeBuffers', taken once per thread
+	std::vector<std::unique_ptr<TraceBuffer>> buffers;  // Every buffer ever handed out
+	std::vector<TraceBuffer*> freeBuffers;  // Buffers of threads that have exited
+};
+
+inline EventTracer eventTracer;  // The application's tracer
+
+
+
+/**
+ * ScopedTraceEvent: Records its lifetime as an event of the calling thread, if the tracer is armed when it opens.
+ */
+class ScopedTraceEvent
+{
+public:
+	ScopedTraceEvent(const char* _name, const char* _category, uint64_t _items = 0);
+	~ScopedTraceEvent();
+	ScopedTraceEvent(const ScopedTraceEvent&) = delete;
+	ScopedTraceEvent& operator=(const ScopedTraceEvent&) = delete;
+
+	const char* name;  // Scope
+	const char* category;  // Kind of scope
+	uint64_t items;  // See 'TraceEvent::items'
+	int64_t begin = -1;  // When the scope opened, -1 if the tracer was not armed
+	const char* parentName = nullptr;  // Scope this one is nested in on the same thread
+};
+
+inline thread_local const char* currentTraceScope = nullptr;  // Innermost recorded scope of each thread, names the ParallelFor chunks it starts
+
+
+
+
+
+
+
+
+
+/**
+ * TraceClock: Nanoseconds since the tracer's epoch.
+ */
+static inline int64_t TraceClock(const EventTracer &tracer);
+
+
+
+/**
+ * RecordTraceEvent: Append an event to the calling thread's buffer.
+ */
+static inline void RecordTraceEvent(EventTracer &tracer, const TraceEvent &event);
+
+
+
+/**
+ * StartTrace: Arm the tracer for the next 'frames' frames, the trace is written to 'path' after the last.
+ *
+ * @return False if a trace is already in progress
+ */
+static inline bool StartTrace(EventTracer &tracer, int frames, const std::string &path);
+
+
+
+/**
+ * EndTraceFrame: Close a traced frame, write the trace when it was the last. Call it once per frame, from one thread.
+ *
+ * @param written Set to whether the trace could be written, when it ends
+ * @return True when this frame ended the trace
+ */
+static inline bool EndTraceFrame(EventTracer &tracer, bool &written);
+
+
+
+/**
+ * WriteChromeTrace: Write the events recorded since the trace was armed as Chrome trace JSON.
+ *
+ * @return False if the file could not be written
+ */
+static inline bool WriteChromeTrace(EventTracer &tracer, const std::string &path);
+
+
+
+/**
+ * WriteTraceString: Write 'text' as a JSON string.
+ */
+static inline void WriteTraceString(std::ostream &out, const char* text);
+
+
+
+
+
+
+
+
+
+
+
+
+class TraceBufferHandle // Takes a buffer for its thread, gives it back when the thread exits
+{
+public:
+	~TraceBufferHandle()
+	{
+		if (buffer != nullptr)
+		{
+			std::lock_guard<std::mutex> lock(eventTracer.buffersMutex);
+			eventTracer.freeBuffers.push_back(buffer);
+		}
+	}
+
+	TraceBuffer* buffer = nullptr;
+};
+
+inline thread_local TraceBufferHandle traceBufferHandle;
+
+
+
+inline ScopedTraceEvent::ScopedTraceEvent(const char* _name, const char* _category, uint64_t _items) : name(_name), category(_category), items(_items)
+{
+	if (eventTracer.recording.load(std::memory_order_relaxed))
+	{
+		begin = TraceClock(eventTracer);
+		parentName = currentTraceScope;
+		currentTraceScope = name;
+	}
+}
+
+
+
+inline ScopedTraceEvent::~ScopedTraceEvent()
+{
+	if (begin >= 0)
+	{
+		TraceEvent event;
+		event.name = name;
+		event.category = category;
+		event.begin = begin;
+		event.end = TraceClock(eventTracer);
+		event.items = items;
+		RecordTraceEvent(eventTracer, event);
+		currentTraceScope = parentName;
+	}
+}
+
+
+
+static inline int64_t TraceClock(const EventTracer &tracer)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - tracer.epoch).count();
+}
+
+
+
+static inline void RecordTraceEvent(EventTracer &tracer, const TraceEvent &event)
+{
+	TraceBuffer* &buffer = traceBufferHandle.buffer; // the handle is only ever used with the application's tracer
+	if (buffer == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(tracer.buffersMutex);
+		if (!tracer.freeBuffers.empty())
+		{
+			buffer = tracer.freeBuffers.back();
+			tracer.freeBuffers.pop_back();
+		}
+		else
+		{
+			tracer.buffers.push_back(std::unique_ptr<TraceBuffer>(new TraceBuffer()));
+			buffer = tracer.buffers.back().get();
+			buffer->slot = (int)tracer.buffers.size() - 1;
+		}
+	}
+
+
+	uint64_t n = buffer->written.load(std::memory_order_relaxed);
+	buffer->events[n & (TraceBuffer::capacity - 1)] = event;
+	buffer->written.store(n + 1, std::memory_order_release);
+}
+
+
+
+static inline bool StartTrace(EventTracer &tracer, int frames, const std::string &path)
+{
+	if (tracer.recording.load() || frames <= 0)
+	{
+		return false;
+	}
+
+
+	tracer.path = path;
+	tracer.framesLeft = frames;
+	tracer.traceBegin = TraceClock(tracer);
+	tracer.frameBegin = tracer.traceBegin;
+	tracer.recording.store(true, std::memory_order_release);
+	return true;
+}
+
+
+
+static inline bool EndTraceFrame(EventTracer &tracer, bool &written)
+{
+	if (!tracer.recording.load(std::memory_order_relaxed))
+	{
+		return false;
+	}
+
+
+	TraceEvent frame;
+	frame.name = "Frame";
+	frame.category = "frame";
+	frame.begin = tracer.frameBegin;
+	frame.end = TraceClock(tracer);
+	RecordTraceEvent(tracer, frame);
+	tracer.frameBegin = frame.end;
+	if (--tracer.framesLeft > 0)
+	{
+		return false;
+	}
+
+
+	tracer.recording.store(false, std::memory_order_relaxed);
+	written = WriteChromeTrace(tracer, tracer.path);
+	return true;
+}
+
+
+
+static inline bool WriteChromeTrace(EventTracer &tracer, const std::string &path)
+{
+	std::ofstream out(path, std::ios::out | std::ios::trunc);
+	if (!out.is_open())
+	{
+		return false;
+	}
+
+
+	std::lock_guard<std::mutex> lock(tracer.buffersMutex);
+	out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	bool first = true;
+	char number[64];
+	std::vector<TraceEvent> events;
+	for (const std::unique_ptr<TraceBuffer> &buffer : tracer.buffers)
+	{
+		uint64_t written = buffer->written.load(std::memory_order_acquire);
+		uint64_t oldest = (written > TraceBuffer::capacity) ? written - TraceBuffer::capacity : 0;
+		events.clear();
+		for (uint64_t n = oldest; n < written; n++)
+		{
+			events.push_back(buffer->events[n & (TraceBuffer::capacity - 1)]);
+		}
+		uint64_t writtenAfter = buffer->written.load(std::memory_order_acquire); // a thread still closing a scope may have wrapped over the oldest copied
+		size_t skip = (writtenAfter > oldest + TraceBuffer::capacity) ? (size_t)std::min<uint64_t>(events.size(), writtenAfter - oldest - TraceBuffer::capacity) : 0;
+
+
+		out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->slot << ", \"args\": {\"name\": \"Thread " << buffer->slot << "\"}}";
+		first = false;
+		for (size_t e = skip; e < events.size(); e++)
+		{
+			const TraceEvent &event = events[e];
+			if (event.begin < tracer.traceBegin)
+			{
+				continue;
+			}
+			std::snprintf(number, sizeof(number), "%.3f, \"dur\": %.3f", (event.begin - tracer.traceBegin) * 1e-3, (event.end - event.begin) * 1e-3);
+			out << ",\n{\"name\": ";
+			WriteTraceString(out, event.name);
+			out << ", \"cat\": ";
+			WriteTraceString(out, event.category);
+			out << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->slot << ", \"ts\": " << number;
+			if (event.items > 0)
+			{
+				out << ", \"args\": {\"items\": " << event.items << "}";
+			}
+			out << "}";
+		}
+	}
+	out << "\n]}\n";
+	return out.good();
+}
+
+
+
+static inline void WriteTraceString(std::ostream &out, const char* text)
+{
+	out << '"';
+	for (const char* c = text; *c != '\0'; c++)
+	{
+		if (*c == '"' || *c == '\\')
+		{
+			out << '\\' << *c;
+		}
+		else if ((unsigned char)*c < 0x20)
+		{
+			out << ' ';
+		}
+		else
+		{
+			out << *c;
+		}
+	}
+	out << '"';
+}
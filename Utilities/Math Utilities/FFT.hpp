@@ -0,0 +1,147 @@
+//  FFT.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * FFT Module: Header-only radix-2 fast Fourier transforms in one and two dimensions
+ *
+ * Description:
+ * A small iterative Cooley-Tukey FFT, only what the particle-mesh solver needs:
+ * 			- power-of-two lengths
+ * 			- complex single precision data, stored contiguously row by row for the 2D transform
+ * 			- the 2D transform is done as a 1D transform of every row, then of every column, both passes are split
+ * 			  across threads with 'ParallelFor'
+ *
+ * The inverse transforms are normalized (divided by the number of elements), so Inverse(Forward(x)) == x.
+ */
+#pragma once
+#include <complex>
+#include <vector>
+#include <cmath>
+#include "ParallelUtilities.hpp"
+
+
+
+
+/**
+ * IsPowerOfTwo: Whether 'n' is a (non-zero) power of two.
+ */
+static inline bool IsPowerOfTwo(size_t n);
+
+
+
+/**
+ * FFT1D: In-place transform of 'n' contiguous complex values.
+ *
+ * @param data    Pointer to the first element
+ * @param n       Number of elements, must be a power of two
+ * @param inverse Whether to compute the (unnormalized) inverse transform
+ */
+static inline void FFT1D(std::complex<float>* data, size_t n, bool inverse);
+
+
+
+/**
+ * FFT2D: In-place transform of an n x n grid stored row-major.
+ *
+ * @param grid        The grid, 'n * n' elements
+ * @param n           Side length, must be a power of two
+ * @param inverse     Whether to compute the (normalized) inverse transform
+ * @param threadCount Number of threads to split the row and column passes across, 0 for the default
+ */
+static inline void FFT2D(std::vector<std::complex<float>> &grid, size_t n, bool inverse, unsigned int threadCount);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline bool IsPowerOfTwo(size_t n)
+{
+	return n > 0 && (n & (n - 1)) == 0;
+}
+
+
+
+static inline void FFT1D(std::complex<float>* data, size_t n, bool inverse)
+{
+	// Bit reversal permutation
+	for (size_t i = 1, j = 0; i < n; i++)
+	{
+		size_t bit = n >> 1;
+		for (; j & bit; bit >>= 1)
+		{
+			j ^= bit;
+		}
+		j ^= bit;
+
+		if (i < j)
+		{
+			std::swap(data[i], data[j]);
+		}
+	}
+
+
+	// Butterflies, the twiddle factors are computed in double so that long transforms don't accumulate rounding
+	for (size_t length = 2; length <= n; length <<= 1)
+	{
+		double angle = 2 * M_PI / length * (inverse ? 1 : -1);
+		std::complex<double> rootOfUnity(cos(angle), sin(angle));
+		size_t half = length >> 1;
+
+		for (size_t i = 0; i < n; i += length)
+		{
+			std::complex<double> twiddle(1, 0);
+			for (size_t k = 0; k < half; k++)
+			{
+				std::complex<float> even = data[i + k];
+				std::complex<float> odd = data[i + k + half] * std::complex<float>((float)twiddle.real(), (float)twiddle.imag());
+				data[i + k] = even + odd;
+				data[i + k + half] = even - odd;
+				twiddle *= rootOfUnity;
+			}
+		}
+	}
+}
+
+
+
+static inline void FFT2D(std::vector<std::complex<float>> &grid, size_t n, bool inverse, unsigned int threadCount)
+{
+	// Rows are contiguous, transform them in place
+	ParallelFor(0, n, threadCount, [&grid, n, inverse](size_t rowBegin, size_t rowEnd, unsigned int)
+	{
+		for (size_t row = rowBegin; row < rowEnd; row++)
+		{
+			FFT1D(&grid[row * n], n, inverse);
+		}
+	}, 8);
+
+
+	// Columns are gathered into a contiguous scratch buffer first, much friendlier to the cache than a strided transform
+	float scale = inverse ? 1.0f / (float)(n * n) : 1.0f;
+	ParallelFor(0, n, threadCount, [&grid, n, inverse, scale](size_t columnBegin, size_t columnEnd, unsigned int)
+	{
+		std::vector<std::complex<float>> column(n);
+		for (size_t x = columnBegin; x < columnEnd; x++)
+		{
+			for (size_t y = 0; y < n; y++)
+			{
+				column[y] = grid[y * n + x];
+			}
+
+			FFT1D(column.data(), n, inverse);
+
+			for (size_t y = 0; y < n; y++)
+			{
+				grid[y * n + x] = column[y] * scale;
+			}
+		}
+	}, 8);
+}
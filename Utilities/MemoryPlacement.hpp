@@ -0,0 +1,451 @@
+//  MemoryPlacement.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * MemoryPlacement Module: NUMA-aware allocation of the large per-body arrays, huge pages, and a placement report
+ *
+ * Description:
+ * Linux places a page on the NUMA node of the thread that first writes it. The body arrays used to be filled by
+ * the main thread alone (BeginSimulation, resize), so on a multi-socket host every page sat on one node and the
+ * workers of the other sockets read them remotely in every force walk. Memory allocated here is instead
+ * first-touched by the workers that will use it: the range is split exactly as 'ParallelFor' splits a loop of the
+ * same length, and each worker writes its own chunk (copying the old contents, or zeroing). With
+ * 'workerThreadPinning' on, thread t stays on one CPU, so its chunk stays local in every later loop.
+ *
+ * The allocations are mmap'd and asked to be backed by huge pages, either transparently (madvise MADV_HUGEPAGE,
+ * the mapping aligned to 2 MB so whole huge pages fit) or explicitly (MAP_HUGETLB, which needs pages reserved in
+ * /proc/sys/vm/nr_hugepages and falls back to transparent ones when there are none). A 2 MB page covers 512 of
+ * the 4 KB pages a walk over a million bodies would otherwise miss the TLB on.
+ *
+ * 'MemoryPlacementReport' samples pages of given regions and asks the kernel (move_pages) which node holds each,
+ * together with the process' AnonHugePages. Outside Linux allocation falls back to posix_memalign and the report
+ * has nothing to say about nodes.
+ */
+#pragma once
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include "ParallelUtilities.hpp"
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+
+
+
+enum class HugePages { None, Transparent, Explicit };  // Pages backing placed allocations: 4 KB, madvise'd THP, MAP_HUGETLB
+
+
+
+/**
+ * MemoryPlacement: How placed allocations are made.
+ */
+class MemoryPlacement
+{
+public:
+	bool firstTouch = true;  // Touch new memory from the workers that use it, rather than from the allocating thread
+	HugePages hugePages = HugePages::Transparent;  // Huge pages for allocations of at least one huge page
+	unsigned int threadCount = 0;  // Threads of the first touch, must match the loops' count, 0 selects DefaultThreadCount()
+};
+
+inline MemoryPlacement memoryPlacement;  // Policy of every placed allocation, shared by all translation units
+
+
+
+/**
+ * PlacedAllocation: Memory returned by 'AllocatePlaced', which has to be handed back to 'FreePlaced'.
+ */
+class PlacedAllocation
+{
+public:
+	void* memory = nullptr;  // Start of the usable memory
+	size_t bytes = 0;  // Usable bytes
+	size_t mappedBytes = 0;  // Length of the mapping, 0 if it came from posix_memalign
+	bool hugePages = false;  // Whether huge pages were requested for it
+};
+
+
+
+/**
+ * MemoryRegionPlacement: Nodes of the sampled pages of one region.
+ */
+class MemoryRegionPlacement
+{
+public:
+	std::string name;  // What the region holds
+	size_t bytes = 0;  // Size of the region
+	size_t sampledPages = 0;  // Pages asked about
+	size_t unmappedPages = 0;  // Sampled pages not yet touched, or that the kernel wouldn't report
+	std::vector<size_t> pagesOnNode;  // Sampled pages on each NUMA node
+};
+
+
+
+/**
+ * MemoryPlacementReport: Placement of the regions that were added to it.
+ */
+class MemoryPlacementReport
+{
+public:
+	std::vector<MemoryRegionPlacement> regions;  // One per 'AddRegionPlacement'/'AddAddressPlacement'
+	int nodeCount = 1;  // NUMA nodes with CPUs this process may run on
+	unsigned int threadCount = 0;  // Threads of the first touch
+	bool pinned = false;  // Whether worker threads are pinned
+	HugePages hugePages = HugePages::None;  // Policy of the placed allocations
+	long anonHugePagesKB = -1;  // Anonymous memory of the process on transparent huge pages, -1 if unknown
+};
+
+
+
+
+
+
+
+
+
+/**
+ * SystemPageSize: Size of a base page, 4 KB where it can't be asked.
+ */
+static inline size_t SystemPageSize();
+
+
+
+/**
+ * AllocatePlaced: Allocate at least 'bytes' aligned to 'alignment' with the page policy of 'placement'.
+ *
+ * The memory is not touched, 'FirstTouch' decides where it lands.
+ */
+static inline PlacedAllocation AllocatePlaced(size_t bytes, size_t alignment, const MemoryPlacement &placement);
+
+
+
+/**
+ * FreePlaced: Release an allocation of 'AllocatePlaced'.
+ */
+static inline void FreePlaced(const PlacedAllocation &allocation);
+
+
+
+/**
+ * FirstTouch: Write every element of new memory from the thread that will use it in a loop of 'count' elements.
+ *
+ * Element i is copied from 'source' if i < 'copied', zeroed otherwise, by the thread 'ParallelFor' would give
+ * index i to. Serial on the calling thread if the placement doesn't ask for first touch.
+ *
+ * @param destination The new memory, 'count' * 'elementSize' bytes
+ * @param source      Old contents, may be nullptr if 'copied' is 0
+ * @param copied      Elements copied from 'source'
+ * @param count       Elements of 'destination'
+ * @param elementSize Bytes per element
+ * @param placement   Whether to touch in parallel, and with how many threads
+ */
+static inline void FirstTouch(void* destination, const void* source, size_t copied, size_t count, size_t elementSize, const MemoryPlacement &placement);
+
+
+
+/**
+ * BeginPlacementReport: An empty report describing the current topology and policy.
+ */
+static inline MemoryPlacementReport BeginPlacementReport(const MemoryPlacement &placement);
+
+
+
+/**
+ * AddRegionPlacement: Sample up to 'maximumSamples' evenly spaced pages of [memory, memory + bytes) into the report.
+ */
+static inline void AddRegionPlacement(MemoryPlacementReport &report, const std::string &name, const void* memory, size_t bytes, size_t maximumSamples = 4096);
+
+
+
+/**
+ * AddAddressPlacement: Add the pages of scattered objects (e.g. tree nodes) to the report, one sample per address.
+ *
+ * @param bytes Total size of the objects, for the report only
+ */
+static inline void AddAddressPlacement(MemoryPlacementReport &report, const std::string &name, const std::vector<const void*> &addresses, size_t bytes);
+
+
+
+/**
+ * QueryPageNodes: Ask the kernel which node holds each page and tally the answers into 'region'.
+ */
+static inline void QueryPageNodes(const std::vector<void*> &pages, MemoryRegionPlacement &region, int nodeCount);
+
+
+
+/**
+ * PrintMemoryPlacement: Write a report to the console.
+ */
+static inline void PrintMemoryPlacement(const MemoryPlacementReport &report);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline size_t SystemPageSize()
+{
+#if defined(__linux__)
+	static const size_t pageSize = (size_t)std::max(4096L, sysconf(_SC_PAGESIZE));
+	return pageSize;
+#else
+	return 4096;
+#endif
+}
+
+
+
+static inline PlacedAllocation AllocatePlaced(size_t bytes, size_t alignment, const MemoryPlacement &placement)
+{
+	PlacedAllocation allocation;
+	allocation.bytes = bytes;
+	if (bytes == 0)
+	{
+		return allocation;
+	}
+
+
+#if defined(__linux__)
+	const size_t hugePageSize = 2 * 1024 * 1024;
+	size_t pageSize = SystemPageSize();
+	bool huge = placement.hugePages != HugePages::None && bytes >= hugePageSize;
+
+	if (huge && placement.hugePages == HugePages::Explicit)
+	{
+		size_t length = (bytes + hugePageSize - 1) / hugePageSize * hugePageSize;
+		void* mapped = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (mapped != MAP_FAILED)
+		{
+			allocation.memory = mapped;
+			allocation.mappedBytes = length;
+			allocation.hugePages = true;
+			return allocation;
+		}
+		// no huge pages reserved, transparent ones are the next best thing
+	}
+
+
+	// Over-map by one huge page and trim, so the usable range starts on a huge page boundary and THP can back all of it
+	size_t boundary = huge ? hugePageSize : std::max(pageSize, alignment);
+	size_t length = (bytes + pageSize - 1) / pageSize * pageSize;
+	size_t overMapped = length + boundary;
+	void* mapped = mmap(nullptr, overMapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mapped == MAP_FAILED)
+	{
+		throw std::bad_alloc();
+	}
+	uintptr_t start = reinterpret_cast<uintptr_t>(mapped);
+	uintptr_t aligned = (start + boundary - 1) / boundary * boundary;
+	if (aligned > start)
+	{
+		munmap(mapped, aligned - start);
+	}
+	size_t tail = (start + overMapped) - (aligned + length);
+	if (tail > 0)
+	{
+		munmap(reinterpret_cast<void*>(aligned + length), tail);
+	}
+	allocation.memory = reinterpret_cast<void*>(aligned);
+	allocation.mappedBytes = length;
+#if defined(MADV_HUGEPAGE)
+	if (huge)
+	{
+		madvise(allocation.memory, length, MADV_HUGEPAGE); // only a hint, THP may be disabled system-wide
+		allocation.hugePages = true;
+	}
+#endif
+	return allocation;
+#else
+	(void)placement;
+	size_t rounded = (bytes + alignment - 1) / alignment * alignment;
+	if (posix_memalign(&allocation.memory, std::max(alignment, sizeof(void*)), rounded) != 0)
+	{
+		throw std::bad_alloc();
+	}
+	return allocation;
+#endif
+}
+
+
+
+static inline void FreePlaced(const PlacedAllocation &allocation)
+{
+	if (allocation.memory == nullptr)
+	{
+		return;
+	}
+#if defined(__linux__)
+	if (allocation.mappedBytes > 0)
+	{
+		munmap(allocation.memory, allocation.mappedBytes);
+		return;
+	}
+#endif
+	std::free(allocation.memory);
+}
+
+
+
+static inline void FirstTouch(void* destination, const void* source, size_t copied, size_t count, size_t elementSize, const MemoryPlacement &placement)
+{
+	unsigned char* to = static_cast<unsigned char*>(destination);
+	const unsigned char* from = static_cast<const unsigned char*>(source);
+	auto touch = [to, from, copied, elementSize](size_t begin, size_t end, unsigned int)
+	{
+		size_t copyEnd = std::min(end, std::max(begin, copied));
+		if (copyEnd > begin)
+		{
+			std::memcpy(to + begin * elementSize, from + begin * elementSize, (copyEnd - begin) * elementSize);
+		}
+		if (end > copyEnd)
+		{
+			std::memset(to + copyEnd * elementSize, 0, (end - copyEnd) * elementSize);
+		}
+	};
+
+
+	if (placement.firstTouch)
+	{
+		ParallelFor(0, count, placement.threadCount, touch); // same chunks, so the same threads, as the loops over the bodies
+	}
+	else
+	{
+		touch(0, count, 0u);
+	}
+}
+
+
+
+static inline MemoryPlacementReport BeginPlacementReport(const MemoryPlacement &placement)
+{
+	MemoryPlacementReport report;
+	report.nodeCount = GetCpuTopology().nodeCount;
+	report.threadCount = (placement.threadCount > 0) ? placement.threadCount : DefaultThreadCount();
+	report.pinned = workerThreadPinning.load();
+	report.hugePages = placement.hugePages;
+
+
+#if defined(__linux__)
+	std::ifstream smaps("/proc/self/smaps_rollup");
+	std::string line;
+	while (std::getline(smaps, line))
+	{
+		if (line.compare(0, 14, "AnonHugePages:") == 0)
+		{
+			report.anonHugePagesKB = std::atol(line.c_str() + 14);
+			break;
+		}
+	}
+#endif
+	return report;
+}
+
+
+
+static inline void QueryPageNodes(const std::vector<void*> &pages, MemoryRegionPlacement &region, int nodeCount)
+{
+	region.sampledPages += pages.size();
+	region.pagesOnNode.resize(std::max<size_t>(region.pagesOnNode.size(), nodeCount), 0);
+#if defined(__linux__) && defined(SYS_move_pages)
+	std::vector<int> status(pages.size(), -1);
+	// move_pages with no target nodes only reports where each page is, it moves nothing
+	if (!pages.empty() && syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr, status.data(), 0) == 0)
+	{
+		for (int node : status)
+		{
+			if (node < 0)
+			{
+				region.unmappedPages++;
+				continue;
+			}
+			region.pagesOnNode.resize(std::max<size_t>(region.pagesOnNode.size(), node + 1), 0);
+			region.pagesOnNode[node]++;
+		}
+		return;
+	}
+#endif
+	region.unmappedPages += pages.size();
+}
+
+
+
+static inline void AddRegionPlacement(MemoryPlacementReport &report, const std::string &name, const void* memory, size_t bytes, size_t maximumSamples)
+{
+	MemoryRegionPlacement region;
+	region.name = name;
+	region.bytes = bytes;
+	size_t pageSize = SystemPageSize();
+	uintptr_t first = reinterpret_cast<uintptr_t>(memory) / pageSize * pageSize;
+	size_t pageCount = (memory == nullptr || bytes == 0) ? 0 : (reinterpret_cast<uintptr_t>(memory) + bytes - 1 - first) / pageSize + 1;
+
+
+	std::vector<void*> pages;
+	size_t samples = std::min(pageCount, std::max<size_t>(1, maximumSamples));
+	for (size_t i = 0; i < samples && pageCount > 0; i++)
+	{
+		size_t page = (samples > 1) ? i * (pageCount - 1) / (samples - 1) : 0;
+		pages.push_back(reinterpret_cast<void*>(first + page * pageSize));
+	}
+	QueryPageNodes(pages, region, report.nodeCount);
+	report.regions.push_back(region);
+}
+
+
+
+static inline void AddAddressPlacement(MemoryPlacementReport &report, const std::string &name, const std::vector<const void*> &addresses, size_t bytes)
+{
+	MemoryRegionPlacement region;
+	region.name = name;
+	region.bytes = bytes;
+	size_t pageSize = SystemPageSize();
+
+
+	std::vector<void*> pages;
+	pages.reserve(addresses.size());
+	for (const void* address : addresses)
+	{
+		pages.push_back(reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(address) / pageSize * pageSize));
+	}
+	QueryPageNodes(pages, region, report.nodeCount);
+	report.regions.push_back(region);
+}
+
+
+
+static inline void PrintMemoryPlacement(const MemoryPlacementReport &report)
+{
+	const char* hugePages[] = {"none", "transparent", "explicit (MAP_HUGETLB)"};
+	std::cout << "\n\nMemory placement, " << report.nodeCount << " NUMA node(s), " << report.threadCount << " threads, " << (report.pinned ? "pinned" : "not pinned") << ", huge pages " << hugePages[(int)report.hugePages];
+	if (report.anonHugePagesKB >= 0)
+	{
+		std::cout << ", " << report.anonHugePagesKB << " kB of the process on transparent huge pages";
+	}
+	for (const MemoryRegionPlacement &region : report.regions)
+	{
+		std::cout << "\n " << region.name << ": " << region.bytes / 1024 << " kB, " << region.sampledPages << " pages sampled";
+		for (size_t node = 0; node < region.pagesOnNode.size(); node++)
+		{
+			std::cout << ", node " << node << ": " << region.pagesOnNode[node];
+		}
+		if (region.unmappedPages > 0)
+		{
+			std::cout << ", unknown: " << region.unmappedPages;
+		}
+	}
+	std::cout << "\n";
+}
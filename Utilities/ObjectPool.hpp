@@ -3,20 +3,36 @@
 //  DavidRichardson02
 
 /**
- * ObjectPool Class: Templated Object Pool for efficient object allocation
+ * ObjectPool Class: Templated, growable, thread-safe object pool for efficient object allocation
  *
  * This class provides a pool-based memory management strategy for objects
- * to avoid the overhead of dynamic allocation/deallocation. The class utilizes
- * batch allocation to improve memory locality and provides methods to acquire and release objects.
- * ObjectPool implements batch allocation using 'placement new'.
+ * to avoid the overhead of dynamic allocation/deallocation.
  *
- * Note: This class assumes that the templated type T has a 'reset' member function.
+ * 	- Storage is allocated in chunks on demand, the first one sized by the constructor, later ones 'chunkSize'
+ * 	  objects each, so the pool never runs dry and never moves an object it handed out.
+ * 	- Free objects are kept on an intrusive free list, a released object's own storage holds the link to the next
+ * 	  free one, so there is no side container to grow or shrink. Fresh chunks are handed out by bumping an offset,
+ * 	  objects are only constructed when they are acquired.
+ * 	- 'acquire' and 'release' on the pool itself take a short lock. Worker threads that acquire or release many
+ * 	  objects use a 'LocalCache', a private free list that only touches the pool once per batch of objects.
+ * 	- 'reset' returns every object at once in O(1), by rewinding the bump offset to the first chunk and dropping
+ * 	  the free list; chunks are kept for reuse and only freed by the destructor.
+ * 	- With 'setPlacement(true)' chunks come from 'AllocatePlaced' (huge pages) and are first-touched by the worker
+ * 	  threads, slot i of a chunk by the thread a loop over the chunk's slots would give index i to (MemoryPlacement.hpp).
+ *
+ * Note: objects are constructed with T() on 'acquire' and destroyed on 'release'. 'reset' and the destructor don't
+ * run the destructors of objects still handed out, so T must not own resources (true of Body).
  */
 
 
 #pragma once
-#include "ofMain.h"
 #include <new>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "MemoryPlacement.hpp"
 
 
 
@@ -24,99 +40,286 @@
 template <class T>
 class ObjectPool
 {
+	union Slot  // Storage of one object, or the free-list link while it is free
+	{
+		Slot* next;
+		alignas(T) unsigned char storage[sizeof(T)];
+	};
+
+
 public:
-	// ------------- Constructors and Destructor -------------
-	ObjectPool() {}
-	
-	ObjectPool(size_t size)  // Constructor that pre-allocates 'size' objects
+	// ------------- Per-Thread Cache -------------
+	class LocalCache  // Private free list of one thread, refilled from and drained to the pool in batches
 	{
-		allocateBatch(size);
-	}
-	
-	
-	
-	~ObjectPool()  // Destructor that deallocates all batch-allocated objects
-	{
-		// delete all objects from the pool
-		//std::cout << "Starting destructor" << std::endl;
-		for (auto block : blocks)
+	public:
+		LocalCache(ObjectPool &_pool, size_t _batchSize = 256) : pool(_pool), batchSize(std::max<size_t>(1, _batchSize)), epoch(_pool.epoch.load(std::memory_order_acquire)) {}
+		LocalCache(const LocalCache&) = delete;
+		LocalCache& operator=(const LocalCache&) = delete;
+		~LocalCache() { flush(); }
+
+		T* acquire() // Lock-free unless the cache is empty
 		{
-			if (!block)  // Safety check, although this should not happen
+			revalidate();
+			if (head == nullptr)
 			{
-				//std::cout << "Null block detected. Skipping." << std::endl;
-				continue;
+				head = pool.takeSlots(batchSize, count);
 			}
-			
-			for (size_t i = 0; i < batchSize; ++i)
+			Slot* slot = head;
+			head = slot->next;
+			count--;
+			return new (slot->storage) T();
+		}
+
+		void release(T* obj) // Lock-free unless the cache holds two batches
+		{
+			revalidate();
+			obj->~T();
+			Slot* slot = reinterpret_cast<Slot*>(obj);
+			slot->next = head;
+			head = slot;
+			if (++count >= 2 * batchSize)
 			{
-				// Additional Safety Check
-				if (block + i)
-				{
-					//std::cout << "Destroying object at index " << i << std::endl;
-					(block + i)->~T(); // explicit destructor call for each object
-				}
+				returnSlots(batchSize);
+			}
+		}
+
+		void flush() // Hand every cached object back to the pool
+		{
+			revalidate();
+			returnSlots(count);
+		}
+
+	private:
+		void revalidate() // After a reset of the pool the cached slots belong to it again, forget them
+		{
+			uint64_t poolEpoch = pool.epoch.load(std::memory_order_acquire);
+			if (poolEpoch != epoch)
+			{
+				head = nullptr;
+				count = 0;
+				epoch = poolEpoch;
 			}
-			//std::cout << "Deleting block" << std::endl;
-			
-			//::operator delete(static_cast<void*>(block));  // Deallocate the memory block
 		}
-		
-		blocks.clear();
-		//*/
-		
-		
+
+		void returnSlots(size_t returned)
+		{
+			if (returned == 0)
+			{
+				return;
+			}
+			Slot* first = head;
+			Slot* last = head;
+			for (size_t i = 1; i < returned; i++)
+			{
+				last = last->next;
+			}
+			head = last->next;
+			count -= returned;
+			pool.giveSlots(first, last);
+		}
+
+		ObjectPool &pool;
+		size_t batchSize;
+		uint64_t epoch;  // Pool epoch the cached slots belong to
+		Slot* head = nullptr;
+		size_t count = 0;
+	};
+
+
+
+
+	// ------------- Constructors and Destructor -------------
+	ObjectPool(size_t size = 0, size_t _chunkSize = 4096) : chunkSize(std::max<size_t>(1, _chunkSize))  // 'size' objects are allocated up front
+	{
+		if (size > 0)
+		{
+			addChunk(size);
+		}
 	}
-	
-	
-	
-	
-	// ------------- Object Management -------------
-	T* acquire() // Acquires an object from the pool
+
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
+
+	ObjectPool(ObjectPool &&other) noexcept { *this = std::move(other); }
+
+	ObjectPool& operator=(ObjectPool &&other) noexcept  // Neither pool may be in use by another thread
 	{
-		if (pool.empty())
+		if (this != &other)
 		{
-			cout << "\n\nThe object pool is empty";
-			//return nullptr;
+			freeChunks();
+			chunks = std::move(other.chunks);
+			chunkSize = other.chunkSize;
+			placed = other.placed;
+			bumpChunk = other.bumpChunk;
+			bumpOffset = other.bumpOffset;
+			freeList = other.freeList;
+			epoch.store(other.epoch.load() + 1); // caches of either pool must not carry slots across
+			other.chunks.clear();
+			other.bumpChunk = other.bumpOffset = 0;
+			other.freeList = nullptr;
+			other.epoch.fetch_add(1);
 		}
-		
-		auto obj = pool.top();
-		pool.pop();
-		return obj;
+		return *this;
+	}
+
+	~ObjectPool()  // Frees every chunk
+	{
+		freeChunks();
+	}
+
+
+
+
+	// ------------- Object Management -------------
+	T* acquire() // Acquires an object from the pool, growing it by a chunk if none is free
+	{
+		size_t obtained = 0;
+		Slot* slot = takeSlots(1, obtained);
+		return new (slot->storage) T();
 	}
-	
+
 	void release(T* obj) // Releases an object back to the pool
 	{
-		obj->reset();
-		pool.push(obj);
+		obj->~T();
+		Slot* slot = reinterpret_cast<Slot*>(obj);
+		giveSlots(slot, slot);
+	}
+
+	void reset() // Returns every object at once, O(1)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		freeList = nullptr;
+		bumpChunk = 0;
+		bumpOffset = 0;
+		epoch.fetch_add(1, std::memory_order_acq_rel);
+	}
+
+	void setPlacement(bool enabled) // Chunks allocated from now on are placed
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		placed = enabled;
+	}
+
+	template<typename Visitor>
+	void forEachChunk(Visitor visitor) // Calls visitor(const void* memory, size_t bytes) for every chunk, for placement reports
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto &chunk : chunks)
+		{
+			visitor(static_cast<const void*>(chunk.slots), chunk.size * sizeof(Slot));
+		}
+	}
+
+	size_t capacity() // Objects the allocated chunks hold
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t total = 0;
+		for (auto &chunk : chunks)
+		{
+			total += chunk.size;
+		}
+		return total;
 	}
-	
-	
-	
-	
-	
+
+
+
+
 private:
-	// ------------- Batch Allocation -------------
-	void allocateBatch(size_t size)  // Allocates a batch of 'size' objects
-	{
-		batchSize = size;
-		T* block = static_cast<T*>(::operator new(sizeof(T) * batchSize));
-		blocks.emplace_back(block);
-		
-		// Initialize each object in the block using placement new
-		for (size_t i = 0; i < batchSize; ++i)
+	struct Chunk
+	{
+		Slot* slots;
+		size_t size;
+		PlacedAllocation placement;  // The chunk's memory if it was placed, empty if it came from operator new
+	};
+
+
+	// ------------- Chunk Allocation -------------
+	void addChunk(size_t size)  // Allocates room for 'size' objects, constructed only when acquired
+	{
+		if (placed)
+		{
+			PlacedAllocation placement = AllocatePlaced(sizeof(Slot) * size, alignof(Slot), memoryPlacement);
+			FirstTouch(placement.memory, nullptr, 0, size, sizeof(Slot), memoryPlacement);
+			chunks.push_back({static_cast<Slot*>(placement.memory), size, placement});
+			return;
+		}
+		Slot* slots = static_cast<Slot*>(::operator new(sizeof(Slot) * size));
+		chunks.push_back({slots, size, PlacedAllocation()});
+	}
+
+	void freeChunks()
+	{
+		for (auto &chunk : chunks)
+		{
+			if (chunk.placement.memory != nullptr)
+			{
+				FreePlaced(chunk.placement);
+				continue;
+			}
+			::operator delete(static_cast<void*>(chunk.slots));
+		}
+		chunks.clear();
+		freeList = nullptr;
+		bumpChunk = bumpOffset = 0;
+	}
+
+
+	// ------------- Shared Free List -------------
+	Slot* takeSlots(size_t wanted, size_t &obtained)  // Up to 'wanted' linked slots (at least one), free ones first
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Slot* head = nullptr;
+		obtained = 0;
+		while (obtained < wanted && freeList != nullptr)
 		{
-			new (block + i) T();
-			pool.push(block + i);
+			Slot* slot = freeList;
+			freeList = slot->next;
+			slot->next = head;
+			head = slot;
+			obtained++;
 		}
+		while (obtained < wanted)
+		{
+			while (bumpChunk < chunks.size() && bumpOffset == chunks[bumpChunk].size)
+			{
+				bumpChunk++;
+				bumpOffset = 0;
+			}
+			if (bumpChunk == chunks.size())
+			{
+				if (obtained > 0)
+				{
+					break; // a cache refill makes do with what is free rather than growing
+				}
+				addChunk(chunkSize);
+			}
+			Slot* slot = chunks[bumpChunk].slots + bumpOffset++;
+			slot->next = head;
+			head = slot;
+			obtained++;
+		}
+		return head;
 	}
-	
-	
-	
-	
+
+	void giveSlots(Slot* first, Slot* last)  // Links the chain first..last onto the free list
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		last->next = freeList;
+		freeList = first;
+	}
+
+
+
+
 	// ------------- Internal Data Storage -------------
-	std::stack<T*> pool;  // Stack holding pointers to available objects
-	std::vector<T*> blocks;  // Vector to keep track of allocated blocks
-	size_t batchSize;  // Number of objects in each allocation batch
+	std::vector<Chunk> chunks;  // Every allocated chunk, in allocation order
+	size_t chunkSize = 4096;  // Objects per chunk added on demand
+	size_t bumpChunk = 0;  // Chunk the next never-used slot comes from
+	size_t bumpOffset = 0;  // Index of that slot within its chunk
+	Slot* freeList = nullptr;  // Released slots
+	std::mutex mutex;  // Guards all of the above
+	std::atomic<uint64_t> epoch{0};  // Incremented by every reset, invalidates the slots held by local caches
+	bool placed = false;  // Whether new chunks come from 'AllocatePlaced'
 };
 
 
@@ -124,13 +327,17 @@ private:
 
 
 template <class T>
-static inline void ResetObjectPool(ObjectPool<T> &objectPool, std::vector<T*> &objects);
+static inline void ResetObjectPool(ObjectPool<T> &objectPool, std::vector<T*> &objects); //return every object of the pool, 'objects' must hold all that are handed out, O(1)
 
 
 template <class T>
 static inline void ReleaseObjectFromPool(ObjectPool<T> &objectPool, std::vector<T*> &objects, size_t &index);
 
 
+template <class T>
+static inline void RemoveObjectFromPool(ObjectPool<T> &objectPool, std::vector<T*> &objects, size_t index); //release the object and fill its slot with the last one, O(1) but does not preserve order
+
+
 
 
 
@@ -138,13 +345,8 @@ static inline void ReleaseObjectFromPool(ObjectPool<T> &objectPool, std::vector<
 template <class T>
 static inline void ResetObjectPool(ObjectPool<T> &objectPool, std::vector<T*> &objects)
 {
-	for (auto& obj : objects)
-	{
-		if(obj)
-		{
-			objectPool.release(obj);
-		}
-	}
+	objectPool.reset();
+	objects.clear();
 }
 
 
@@ -161,3 +363,14 @@ static inline void ReleaseObjectFromPool(ObjectPool<T> &objectPool, std::vector<
 
 
 
+
+template <class T>
+static inline void RemoveObjectFromPool(ObjectPool<T> &objectPool, std::vector<T*> &objects, size_t index)
+{
+	if(objects[index])
+	{
+		objectPool.release(objects[index]);
+	}
+	objects[index] = objects.back();
+	objects.pop_back();
+}
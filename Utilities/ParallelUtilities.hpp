@@ -0,0 +1,341 @@
+//  ParallelUtilities.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * ParallelUtilities Module: Splitting loops over bodies or grid rows across worker threads
+ *
+ * Description:
+ * Most of the heavy loops in the simulator (force evaluation per body, per-row FFT passes, mass assignment)
+ * are independent per index, so they are parallelized the simplest way possible: the index range is cut into
+ * one contiguous chunk per thread, the calling thread processes the first chunk itself and joins the others.
+ *
+ * The loop body receives its chunk as [begin, end) together with the index of the thread running it, which lets
+ * callers keep per-thread scratch buffers (e.g. private mass grids that are reduced afterwards) without locking.
+ *
+ * Since the chunks are a pure function of the range and the thread count, thread t works on the same indices in
+ * every loop. With 'workerThreadPinning' on, thread t also always runs on the same CPU ('PinThread', CPUs ordered
+ * node by node so neighbouring threads share a NUMA node), which is what lets memory first-touched by thread t
+ * (MemoryPlacement.hpp) stay local to it in every later loop. Unpinned, the calling thread runs chunk 0 itself;
+ * pinned, chunk 0 runs on a pinned worker like the other chunks and the caller only waits, so the calling thread (the
+ * UI thread, say) is never pinned itself.
+ *
+ * While the event tracer is armed every chunk is an event of the thread running it, named after the scope ParallelFor
+ * was called from, so a trace shows how long each thread worked on its share.
+ *
+ * Every chunk runs on its own thread at the same time, so a loop body may wait at a 'ThreadBarrier' of
+ * 'ParallelForChunks' threads, e.g. to finish reading shared state in every chunk before any chunk writes it.
+ */
+#pragma once
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "EventTracer.hpp"
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+
+
+inline std::atomic<bool> workerThreadPinning{false};  // Pin every ParallelFor thread to a CPU, shared by all translation units
+
+
+
+
+/**
+ * DefaultThreadCount: Number of worker threads used when none is configured.
+ *
+ * @return The number of hardware threads, at least 1
+ */
+static inline unsigned int DefaultThreadCount();
+
+
+
+/**
+ * ParallelFor: Run 'function(chunkBegin, chunkEnd, threadIndex)' over [begin, end) split into contiguous chunks.
+ *
+ * Ranges smaller than 'minimumChunk' per thread use fewer threads, so tiny loops don't pay for thread start-up.
+ *
+ * @param begin        First index of the range
+ * @param end          One past the last index of the range
+ * @param threadCount  Maximum number of threads to use, 0 selects DefaultThreadCount()
+ * @param function     Callable taking (size_t chunkBegin, size_t chunkEnd, unsigned int threadIndex)
+ * @param minimumChunk Minimum number of indices handed to each thread
+ */
+template<typename Function>
+static inline void ParallelFor(size_t begin, size_t end, unsigned int threadCount, Function function, size_t minimumChunk = 64);
+
+
+
+/**
+ * ParallelForChunks: The number of chunks, each on its own thread, ParallelFor splits 'count' indices into.
+ */
+static inline unsigned int ParallelForChunks(size_t count, unsigned int threadCount, size_t minimumChunk = 64);
+
+
+
+/**
+ * ThreadBarrier: Blocks the threads calling 'arriveAndWait' until all 'threads' of them have, reusable.
+ */
+class ThreadBarrier
+{
+public:
+	explicit ThreadBarrier(unsigned int _threads) : threads(_threads) {}
+	void arriveAndWait();
+
+	std::mutex mutex;  // Guards the counters
+	std::condition_variable released;  // Signalled when the last thread arrives
+	unsigned int threads;  // Threads that have to arrive
+	unsigned int arrived = 0;  // Threads waiting in the current round
+	uint64_t round = 0;  // Completed rounds, a waiter leaves when it changes
+};
+
+
+
+/**
+ * CpuTopology: The CPUs this process may run on, node by node, and the NUMA node of each.
+ */
+class CpuTopology
+{
+public:
+	std::vector<int> cpus;  // CPU ids, those of node 0 first, then node 1, ...
+	std::vector<int> nodeOfCpu;  // NUMA node of each entry of 'cpus'
+	int nodeCount = 1;  // Nodes that have at least one of the CPUs
+};
+
+
+
+/**
+ * GetCpuTopology: Read the topology once from /sys, a single node of every allowed CPU where there is no NUMA information.
+ */
+static inline const CpuTopology& GetCpuTopology();
+
+
+
+/**
+ * ParseCpuList: The CPU ids of a /sys cpulist such as "0-3,8,10-11".
+ */
+static inline std::vector<int> ParseCpuList(const std::string &list);
+
+
+
+/**
+ * PinThread: Restrict the calling thread to the 'threadIndex'-th CPU of the topology (wrapping around).
+ *
+ * @return Whether the thread was pinned, always false outside Linux
+ */
+static inline bool PinThread(unsigned int threadIndex);
+
+
+
+
+
+
+
+
+
+
+
+
+static inline unsigned int DefaultThreadCount()
+{
+	unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	return (hardwareThreads > 0) ? hardwareThreads : 1;
+}
+
+
+
+template<typename Function>
+static inline void ParallelFor(size_t begin, size_t end, unsigned int threadCount, Function function, size_t minimumChunk)
+{
+	if (end <= begin)
+	{
+		return;
+	}
+
+
+	size_t count = end - begin;
+	unsigned int chunks = ParallelForChunks(count, threadCount, minimumChunk);
+	bool pin = workerThreadPinning.load(std::memory_order_relaxed);
+	const char* task = (currentTraceScope != nullptr) ? currentTraceScope : "ParallelFor";
+	if (chunks == 1 && !pin)
+	{
+		ScopedTraceEvent trace(task, "task", count);
+		function(begin, end, 0u);
+		return;
+	}
+
+
+	size_t chunk = (count + chunks - 1) / chunks;
+	std::vector<std::thread> workers;
+	workers.reserve(chunks);
+	for (unsigned int t = pin ? 0 : 1; t < chunks; t++) // pinned, chunk 0 needs its CPU too, so a worker takes it
+	{
+		size_t chunkBegin = begin + t * chunk;
+		size_t chunkEnd = std::min(end, chunkBegin + chunk);
+		workers.emplace_back([&function, chunkBegin, chunkEnd, t, pin, task]()
+		{
+			if (pin)
+			{
+				PinThread(t);
+			}
+			ScopedTraceEvent trace(task, "task", chunkEnd - chunkBegin);
+			function(chunkBegin, chunkEnd, t);
+		});
+	}
+
+	if (!pin)
+	{
+		ScopedTraceEvent trace(task, "task", std::min(end, begin + chunk) - begin);
+		function(begin, std::min(end, begin + chunk), 0u); // the calling thread takes the first chunk
+	}
+
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+
+
+static inline unsigned int ParallelForChunks(size_t count, unsigned int threadCount, size_t minimumChunk)
+{
+	if (count == 0)
+	{
+		return 1;
+	}
+	if (threadCount == 0)
+	{
+		threadCount = DefaultThreadCount();
+	}
+	size_t threads = std::max<size_t>(1, std::min<size_t>(threadCount, count / std::max<size_t>(1, minimumChunk)));
+	size_t chunk = (count + threads - 1) / threads;
+	return (unsigned int)((count + chunk - 1) / chunk); // rounding the chunks up can leave fewer of them than threads
+}
+
+
+
+inline void ThreadBarrier::arriveAndWait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	uint64_t arrivedIn = round;
+	if (++arrived == threads)
+	{
+		arrived = 0;
+		round++;
+		released.notify_all();
+		return;
+	}
+	released.wait(lock, [this, arrivedIn]() { return round != arrivedIn; });
+}
+
+
+
+static inline std::vector<int> ParseCpuList(const std::string &list)
+{
+	std::vector<int> cpus;
+	std::stringstream stream(list);
+	std::string range;
+	while (std::getline(stream, range, ','))
+	{
+		if (range.empty() || range[0] < '0' || range[0] > '9')
+		{
+			continue;
+		}
+		size_t dash = range.find('-');
+		int first = std::stoi(range.substr(0, dash));
+		int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+		for (int cpu = first; cpu <= last; cpu++)
+		{
+			cpus.push_back(cpu);
+		}
+	}
+	return cpus;
+}
+
+
+
+static inline const CpuTopology& GetCpuTopology()
+{
+	static const CpuTopology topology = []()
+	{
+		CpuTopology result;
+		result.nodeCount = 0;
+#if defined(__linux__)
+		cpu_set_t allowed;
+		CPU_ZERO(&allowed);
+		bool haveMask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+		for (int node = 0; node < 1024; node++)
+		{
+			std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+			if (!file)
+			{
+				if (node > 0 && result.nodeCount > 0)
+				{
+					break; // node ids are dense in practice, stop at the first gap after one was found
+				}
+				continue;
+			}
+			std::string list;
+			std::getline(file, list);
+			size_t before = result.cpus.size();
+			for (int cpu : ParseCpuList(list))
+			{
+				if (!haveMask || CPU_ISSET(cpu, &allowed))
+				{
+					result.cpus.push_back(cpu);
+					result.nodeOfCpu.push_back(node);
+				}
+			}
+			result.nodeCount += (result.cpus.size() > before) ? 1 : 0;
+		}
+		if (result.cpus.empty() && haveMask)
+		{
+			for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			{
+				if (CPU_ISSET(cpu, &allowed))
+				{
+					result.cpus.push_back(cpu);
+					result.nodeOfCpu.push_back(0);
+				}
+			}
+		}
+#endif
+		if (result.cpus.empty())
+		{
+			for (unsigned int cpu = 0; cpu < DefaultThreadCount(); cpu++)
+			{
+				result.cpus.push_back((int)cpu);
+				result.nodeOfCpu.push_back(0);
+			}
+		}
+		result.nodeCount = std::max(1, result.nodeCount);
+		return result;
+	}();
+	return topology;
+}
+
+
+
+static inline bool PinThread(unsigned int threadIndex)
+{
+#if defined(__linux__)
+	const CpuTopology &topology = GetCpuTopology();
+	cpu_set_t cpu;
+	CPU_ZERO(&cpu);
+	CPU_SET(topology.cpus[threadIndex % topology.cpus.size()], &cpu);
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpu), &cpu) == 0;
+#else
+	(void)threadIndex;
+	return false; // macOS has no affinity API that pins, only hints
+#endif
+}
@@ -0,0 +1,301 @@
+//  PhaseProfiler.hpp
+//  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
+//  DavidRichardson02
+
+/*
+ * PhaseProfiler Module: How a frame splits between the phases of the step and the drawing
+ *
+ * Description:
+ * 'PROFILE_PHASE(Phase)' at the top of a block times the rest of the block as that phase. The scopes nest: a scope
+ * is charged only its own (exclusive) time, the time of the scopes opened inside it goes to their phases, e.g., the
+ * 'BuildQuadtree' scope around insertion, pruning and the mass distribution is charged the insertion alone. So the
+ * phases of a frame add up to no more than the frame, whichever functions call which.
+ *
+ * Every thread adds its scopes' times to the current frame's per-phase totals (relaxed atomics, a scope costs two
+ * clock reads and one add). Once per frame the rendering thread calls 'EndProfilerFrame', which moves the totals
+ * into a rolling window of the last 'window' frames, updates each phase's mean, median and 99th percentile over
+ * the window, and appends a row to the CSV file while one is being recorded. With the physics thread running, a
+ * frame holds whatever steps the physics thread finished while it was drawn.
+ *
+ * Every scope is also an event of the timeline 'eventTracer' records while it is armed (EventTracer.hpp).
+ *
+ * Compiled with NBODY_PROFILE=0, 'PROFILE_PHASE' expands to nothing and the frames only record their own length.
+ */
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <algorithm>
+#include "EventTracer.hpp"
+
+#ifndef NBODY_PROFILE
+#define NBODY_PROFILE 1
+#endif
+
+
+
+
+/**
+ * ProfilePhase: The phases a frame is split into.
+ */
+enum class ProfilePhase { BuildQuadtree, PruneEmptyNodes, MassDistribution, ComputeForces, Integrate, SystemEnergy, ResetTree, InterfaceDraw, Count };
+
+const size_t ProfilePhaseCount = (size_t)ProfilePhase::Count;
+
+
+
+/**
+ * PhaseStatistics: Rolling statistics of one phase over the profiler's window, in milliseconds per frame.
+ */
+class PhaseStatistics
+{
+public:
+	double last = 0;  // The last frame
+	double mean = 0;  // Mean over the window
+	double p50 = 0;  // Median over the window
+	double p99 = 0;  // 99th percentile over the window
+};
+
+
+
+/**
+ * PhaseProfiler: Per-phase totals of the current frame, the window of past frames and the CSV being recorded.
+ */
+class PhaseProfiler
+{
+public:
+	std::array<std::atomic<int64_t>, ProfilePhaseCount> frameNanoseconds{};  // Exclusive time of each phase so far this frame
+	size_t window = 240;  // Frames the statistics are taken over
+	std::array<std::vector<float>, ProfilePhaseCount + 1> history;  // Milliseconds of each phase in the window's frames, ring buffers, the last entry is the whole frame
+	std::array<PhaseStatistics, ProfilePhaseCount + 1> statistics;  // Over the window, the last entry is the whole frame
+	size_t frames = 0;  // Frames ended since the start
+	std::chrono::steady_clock::time_point frameStart;  // Start of the current frame
+	std::ofstream csv;  // Per-frame rows while recording
+	std::string csvPath;  // File being recorded, empty while not recording
+};
+
+inline PhaseProfiler phaseProfiler;  // The application's profiler, every PROFILE_PHASE scope reports to it
+
+
+
+/**
+ * ScopedPhaseTimer: Charges its lifetime, less that of the timers opened inside it on the same thread, to a phase.
+ */
+class ScopedPhaseTimer
+{
+public:
+	ScopedPhaseTimer(ProfilePhase _phase);
+	~ScopedPhaseTimer();
+	ScopedPhaseTimer(const ScopedPhaseTimer&) = delete;
+	ScopedPhaseTimer& operator=(const ScopedPhaseTimer&) = delete;
+
+	ProfilePhase phase;  // Phase charged
+	std::chrono::steady_clock::time_point start;  // When the scope was entered
+	int64_t childNanoseconds = 0;  // Time of the scopes nested in this one
+	ScopedPhaseTimer* parent;  // Enclosing timer of the same thread, or nullptr
+	ScopedTraceEvent trace;  // The scope on the timeline, while the tracer is armed
+};
+
+inline thread_local ScopedPhaseTimer* currentPhaseTimer = nullptr;  // Innermost open timer of each thread
+
+
+#define NBODY_PROFILE_CONCAT_(a, b) a##b
+#define NBODY_PROFILE_CONCAT(a, b) NBODY_PROFILE_CONCAT_(a, b)
+#if NBODY_PROFILE
+#define PROFILE_PHASE(phase) ScopedPhaseTimer NBODY_PROFILE_CONCAT(phaseTimer, __LINE__)(ProfilePhase::phase)
+#else
+#define PROFILE_PHASE(phase) do {} while (0)
+#endif
+
+
+
+
+
+
+
+
+
+/**
+ * ProfilePhaseName: Name of a phase, as shown in the performance table and the CSV header.
+ */
+static inline const char* ProfilePhaseName(ProfilePhase phase);
+
+
+
+/**
+ * EndProfilerFrame: Close the current frame, update the rolling statistics and record the frame if a CSV is open.
+ *
+ * Call it once per frame, from one thread.
+ */
+static inline void EndProfilerFrame(PhaseProfiler &profiler);
+
+
+
+/**
+ * StartProfilerCsv / StopProfilerCsv: Start recording one row per frame to 'path', and stop.
+ *
+ * @return False if the file could not be opened
+ */
+static inline bool StartProfilerCsv(PhaseProfiler &profiler, const std::string &path);
+static inline void StopProfilerCsv(PhaseProfiler &profiler);
+
+
+
+/**
+ * Percentile: The 'fraction' quantile of 'values' (nearest rank), reorders them.
+ */
+template<typename T>
+static inline T Percentile(std::vector<T> &values, double fraction);
+
+
+
+
+
+
+
+
+
+
+
+
+inline ScopedPhaseTimer::ScopedPhaseTimer(ProfilePhase _phase) : phase(_phase), start(std::chrono::steady_clock::now()), parent(currentPhaseTimer), trace(ProfilePhaseName(_phase), "phase")
+{
+	currentPhaseTimer = this;
+}
+
+
+
+inline ScopedPhaseTimer::~ScopedPhaseTimer()
+{
+	int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	phaseProfiler.frameNanoseconds[(size_t)phase].fetch_add(elapsed - childNanoseconds, std::memory_order_relaxed);
+	if (parent != nullptr)
+	{
+		parent->childNanoseconds += elapsed;
+	}
+	currentPhaseTimer = parent;
+}
+
+
+
+static inline const char* ProfilePhaseName(ProfilePhase phase)
+{
+	switch (phase)
+	{
+		case ProfilePhase::BuildQuadtree: return "Build Quadtree";
+		case ProfilePhase::PruneEmptyNodes: return "Prune Empty Nodes";
+		case ProfilePhase::MassDistribution: return "Mass Distribution";
+		case ProfilePhase::ComputeForces: return "Compute Forces";
+		case ProfilePhase::Integrate: return "Integrate";
+		case ProfilePhase::SystemEnergy: return "System Energy";
+		case ProfilePhase::ResetTree: return "Reset Tree";
+		case ProfilePhase::InterfaceDraw: return "Draw";
+		case ProfilePhase::Count:
+		default: return "Frame";
+	}
+}
+
+
+
+static inline void EndProfilerFrame(PhaseProfiler &profiler)
+{
+	auto now = std::chrono::steady_clock::now();
+	std::array<float, ProfilePhaseCount + 1> milliseconds;
+	for (size_t p = 0; p < ProfilePhaseCount; p++)
+	{
+		milliseconds[p] = profiler.frameNanoseconds[p].exchange(0, std::memory_order_relaxed) * 1e-6f;
+	}
+	milliseconds[ProfilePhaseCount] = (profiler.frames == 0) ? 0 : std::chrono::duration<float, std::milli>(now - profiler.frameStart).count();
+	profiler.frameStart = now;
+
+
+	size_t slot = profiler.frames % std::max<size_t>(profiler.window, 1);
+	std::vector<float> sorted;
+	for (size_t p = 0; p <= ProfilePhaseCount; p++)
+	{
+		std::vector<float> &history = profiler.history[p];
+		if (history.size() <= slot)
+		{
+			history.push_back(milliseconds[p]);
+		}
+		else
+		{
+			history[slot] = milliseconds[p];
+		}
+
+		PhaseStatistics &statistics = profiler.statistics[p];
+		statistics.last = milliseconds[p];
+		double sum = 0;
+		for (float ms : history)
+		{
+			sum += ms;
+		}
+		statistics.mean = sum / history.size();
+		sorted.assign(history.begin(), history.end());
+		statistics.p50 = Percentile(sorted, 0.50);
+		statistics.p99 = Percentile(sorted, 0.99);
+	}
+	profiler.frames++;
+
+
+	if (profiler.csv.is_open())
+	{
+		profiler.csv << profiler.frames;
+		for (float ms : milliseconds)
+		{
+			profiler.csv << ',' << ms;
+		}
+		profiler.csv << '\n';
+	}
+}
+
+
+
+static inline bool StartProfilerCsv(PhaseProfiler &profiler, const std::string &path)
+{
+	StopProfilerCsv(profiler);
+	profiler.csv.open(path, std::ios::out | std::ios::trunc);
+	if (!profiler.csv.is_open())
+	{
+		return false;
+	}
+
+
+	profiler.csvPath = path;
+	profiler.csv << "frame";
+	for (size_t p = 0; p <= ProfilePhaseCount; p++)
+	{
+		profiler.csv << ',' << ProfilePhaseName((ProfilePhase)p) << " (ms)";
+	}
+	profiler.csv << '\n';
+	return true;
+}
+
+
+
+static inline void StopProfilerCsv(PhaseProfiler &profiler)
+{
+	if (profiler.csv.is_open())
+	{
+		profiler.csv.close();
+	}
+	profiler.csvPath.clear();
+}
+
+
+
+template<typename T>
+static inline T Percentile(std::vector<T> &values, double fraction)
+{
+	if (values.empty())
+	{
+		return T();
+	}
+	size_t rank = std::min(values.size() - 1, (size_t)(fraction * values.size()));
+	std::nth_element(values.begin(), values.begin() + rank, values.end());
+	return values[rank];
+}
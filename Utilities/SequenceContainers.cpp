@@ -10,209 +10,92 @@
 
 
 
-template <typename T>
-DynamicBufferArray<T>::ListData::ListData() : data(buffer), size(0), capacity(fixed_cap){}
+ScratchArena::ScratchArena(size_t _blockSize) : blockSize(std::max<size_t>(256, _blockSize)) {}
 
 
-template <typename T>
-DynamicBufferArray<T>::DynamicBufferArray() {}
-
-
-template <typename T>
-DynamicBufferArray<T>::DynamicBufferArray(const DynamicBufferArray& other)
-{
-	if (other.listData.capacity == fixed_cap)
-	{
-		listData = other.listData;
-		listData.data = listData.buffer;
-	}
-	else
-	{
-		reserve(other.listData.size);
-		for (int j=0; j < other.size(); ++j)
-		{
-			listData.data[j] = other.listData.data[j];
-		}
-		listData.size = other.listData.size;
-		listData.capacity = other.listData.capacity;
-	}
-}
-
-
-
-
-template <typename T>
-DynamicBufferArray<T> &DynamicBufferArray<T>::operator=(const DynamicBufferArray<T>& other)
+ScratchArena::ScratchArena(ScratchArena &&other) noexcept : blocks(std::move(other.blocks)), blockSize(other.blockSize), currentBlock(other.currentBlock), offset(other.offset)
 {
-	DynamicBufferArray(other).swap(*this);
-	return *this;
+	other.blocks.clear();
+	other.currentBlock = other.offset = 0;
 }
 
 
-
-
-template <typename T>
-DynamicBufferArray<T>::~DynamicBufferArray()
+ScratchArena &ScratchArena::operator=(ScratchArena &&other) noexcept
 {
-	if(listData.data != listData.buffer)
+	if (this != &other)
 	{
-		delete[] listData.data;
+		freeBlocks();
+		blocks = std::move(other.blocks);
+		blockSize = other.blockSize;
+		currentBlock = other.currentBlock;
+		offset = other.offset;
+		other.blocks.clear();
+		other.currentBlock = other.offset = 0;
 	}
+	return *this;
 }
 
 
-
-// Returns size() == 0.
-template <typename T>
-bool DynamicBufferArray<T> :: empty() const
-{
-	return listData.size == 0;
-}
-
-// Returns the number of elements in the list.
-template <typename T>
-int DynamicBufferArray<T> :: size() const
-{
-	return listData.size;
-}
-
-template <typename T>
-T &DynamicBufferArray<T>::operator[](size_t index)
-{
-	assert(index >= 0 && index < listData.size);
-	return listData.data[index];
-}
-
-template <typename T>
-const T &DynamicBufferArray<T>::operator[](size_t index) const
-{
-	assert(index >= 0 && index < listData.size);
-	return listData.data[index];
-}
-
-
-template <typename T>
-void DynamicBufferArray<T> ::clear()
+ScratchArena::~ScratchArena()
 {
-	listData.size = 0;
+	freeBlocks();
 }
 
 
 
 
-
-template <typename T>
-void DynamicBufferArray<T> ::reserve(size_t _size)
+void* ScratchArena::allocate(size_t bytes, size_t alignment)
 {
-	if (_size > listData.capacity)
+	while (currentBlock < blocks.size())
 	{
-		T* newMemory = new T[_size];
-		if (!newMemory)
-		{
-			throw std::bad_alloc();
-		}
-		std::copy(listData.data, listData.data + listData.capacity, newMemory);
-		if (listData.data != listData.buffer)
+		Block &block = blocks[currentBlock];
+		uintptr_t address = reinterpret_cast<uintptr_t>(block.memory) + offset;
+		size_t padding = (alignment - address % alignment) % alignment;
+		if (offset + padding + bytes <= block.size)
 		{
-			delete[] listData.data;
+			offset += padding + bytes;
+			return block.memory + offset - bytes;
 		}
-		
-		listData.data = newMemory;
-		listData.capacity = _size;
+		currentBlock++; // the rest of this block is wasted until the next reset
+		offset = 0;
 	}
-}
 
 
+	size_t size = std::max(blockSize, bytes + alignment);
+	unsigned char* memory = static_cast<unsigned char*>(::operator new(size));
+	blocks.push_back({memory, size});
+	currentBlock = blocks.size() - 1;
+	offset = 0;
+	return allocate(bytes, alignment);
+}
 
 
-template <typename T>
-void DynamicBufferArray<T> ::resize(size_t _size, const T &fill)
+void ScratchArena::reset()
 {
-	if (_size > listData.capacity)
-	{
-		reserve(_size + 1);
-	}
-	if (_size > listData.size)
-	{
-		for (int j = listData.size; j < _size; ++j)
-		{
-			listData.data[j] = fill;
-		}
-	}
-	listData.size = _size;
+	currentBlock = 0;
+	offset = 0;
 }
 
 
 
 
-
-
-
-
-template <typename T>
-void DynamicBufferArray<T> :: push_back(const T &_data)
+size_t ScratchArena::capacity() const
 {
-	if (listData.size >= listData.capacity)
+	size_t total = 0;
+	for (const Block &block : blocks)
 	{
-		reserve(static_cast<size_t>(listData.capacity * 1.618)); // Golden Ratio
+		total += block.size;
 	}
-	listData.data[listData.size++] = _data;
-	
-}
-
-
-
-template <typename T>
-T DynamicBufferArray<T> :: pop_back()
-{
-	return listData.data[--listData.size];
-	
+	return total;
 }
 
 
-
-
-
-
-
-
-template <typename T>
-void DynamicBufferArray<T>::swap(DynamicBufferArray &other)
+void ScratchArena::freeBlocks()
 {
-	ListData& ld1 = listData;
-	ListData& ld2 = other.listData;
-	
-	const int use_fixed1 = ld1.data == ld1.buffer;
-	const int use_fixed2 = ld2.data == ld2.buffer;
-	
-	const ListData temp = ld1;
-	ld1 = ld2;
-	ld2 = temp;
-	
-	if (use_fixed1)
-		ld2.data = ld2.buffer;
-	if (use_fixed2)
-		ld1.data = ld1.buffer;
-}
-
-
-
-
-
-
-template <typename T>
-template <typename... Args>
-void DynamicBufferArray<T>::emplace_back(Args&&... args)
-{
-	// Make sure there's enough space for a new element
-	if (listData.size >= listData.capacity)
+	for (Block &block : blocks)
 	{
-		reserve(listData.capacity * 2);
+		::operator delete(static_cast<void*>(block.memory));
 	}
-	// Construct the object in-place at the end of the array using std::forward to preserve argument types
-	new (&listData.data[listData.size]) T(std::forward<Args>(args)...);
-	++listData.size;
+	blocks.clear();
+	currentBlock = offset = 0;
 }
-
-
-
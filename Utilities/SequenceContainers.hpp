@@ -2,88 +2,313 @@
 //  Generic Quadtree Barnes-Hut  N-Body Simulator 0_1
 //  DavidRichardson02
 
-/**
- dev NOTE:
- This shit ain't ready for release, not to this program anyways, probably could find use for something, but after looking at std::vector there's not much
- I could even feasibly consider doing to make a single improvement for my project's use, I tried exploring this avenue for optimizing performance but
- it just doesn't seem like a worthwhile bottleneck for me to pursure, and now feels like a waste to delete this so I'm keeping this antiquated shit around cuz i feel like it...
- basically, maybe it could be good for something, but I'm not really qualified to offer an opinion on that sentiment.
- */
-
 /**
  * DynamicBufferArray
  *
- * DynamicBufferArray is a templated dynamic array class that
- * provides similar functionalities to the C++ Standard Library's std::vector.
- * It manages its memory internally and resizes the array dynamically, offering
- * better memory management compared to traditional C++ arrays.
+ * DynamicBufferArray is a templated small-vector: a dynamic array with the std::vector interface the simulator
+ * uses, whose first 'InlineCapacity' elements live in a buffer inside the object itself. Short lists never
+ * allocate, longer ones spill into heap storage, or into a 'ScratchArena' if one is given at construction.
  *
- * The class uses a fixed-size buffer for the first `fixed_capacity` elements
- * to avoid heap allocations until necessary. The class adheres to RAII principles.
+ * It exists for the per-thread scratch of the tree walks (the explicit traversal stack, the interaction list),
+ * lists that are built and thrown away once per body or group, millions of times per step. Sized so the common
+ * case fits inline, the rare long list comes out of a per-thread arena that is rewound between walks, so after
+ * the first step the walks don't touch the heap at all.
+ *
+ * 	- Elements are constructed and destroyed properly (placement new), T need not be default constructible.
+ * 	- Moving steals spilled storage and moves inline elements one by one, the arena moves with the storage.
+ * 	- Copies are heap-backed (the arena belongs to the thread that owns the original); copy assignment keeps the
+ * 	  target's own storage and arena.
+ * 	- The class adheres to RAII principles. Arena storage is only reclaimed by the arena, so every array using an
+ * 	  arena must be destroyed before 'ScratchArena::reset' is called.
  */
 
 
 #pragma once
-#include "ofMain.h"
-#include <inttypes.h>
-#include <stdbool.h>
-#include <stdlib.h>
+#include <new>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <cassert>
+
+
+
+
+/**
+ * ScratchArena
+ *
+ * Bump allocator for short-lived scratch storage. Allocation advances an offset through large blocks, individual
+ * allocations are never freed, 'reset' rewinds to the first block in O(1) and keeps every block for reuse.
+ * One arena per thread, it is not thread-safe.
+ */
+class ScratchArena
+{
+public:
+	// ------------- Constructors and Destructor -------------
+	ScratchArena(size_t _blockSize = 64 * 1024);
+	ScratchArena(const ScratchArena&) = delete;
+	ScratchArena& operator=(const ScratchArena&) = delete;
+	ScratchArena(ScratchArena &&other) noexcept;
+	ScratchArena& operator=(ScratchArena &&other) noexcept;
+	~ScratchArena();
+
 
+	// ------------- Allocation -------------
+	void* allocate(size_t bytes, size_t alignment); // Storage for 'bytes' bytes, adds a block if none has room
+	void reset(); // Every allocation becomes invalid, blocks are kept
 
 
+	// ------------- Statistics -------------
+	size_t capacity() const; // Bytes held in blocks
+	size_t blockCount() const { return blocks.size(); }
+
+
+private:
+	struct Block
+	{
+		unsigned char* memory;
+		size_t size;
+	};
+
+	void freeBlocks();
 
-template <typename T>
+	std::vector<Block> blocks;  // Every block, in allocation order
+	size_t blockSize;  // Size of a block added on demand, larger requests get a block of their own size
+	size_t currentBlock = 0;  // Block allocations currently come from
+	size_t offset = 0;  // First unused byte of that block
+};
+
+
+
+
+
+
+
+
+template <typename T, size_t InlineCapacity = 64>
 class DynamicBufferArray
 {
 public:
-	
+	typedef T value_type;
+	typedef T* iterator;
+	typedef const T* const_iterator;
+
+
 	// ------------- Constructors and Destructor -------------
-	DynamicBufferArray();
-	DynamicBufferArray(size_t _capacity) ;
-	DynamicBufferArray(const DynamicBufferArray& other);
-	DynamicBufferArray& operator=(const DynamicBufferArray& other);
-	~DynamicBufferArray();
-	
-	
+	explicit DynamicBufferArray(ScratchArena* _arena = nullptr) : data_(inlineBuffer()), arena(_arena) {}
+	explicit DynamicBufferArray(size_t _capacity, ScratchArena* _arena = nullptr) : data_(inlineBuffer()), arena(_arena) { reserve(_capacity); }
+
+	DynamicBufferArray(const DynamicBufferArray& other) : data_(inlineBuffer()), arena(nullptr)
+	{
+		reserve(other.count);
+		std::uninitialized_copy(other.begin(), other.end(), data_);
+		count = other.count;
+	}
+
+	DynamicBufferArray(DynamicBufferArray&& other) noexcept : data_(inlineBuffer()), arena(nullptr)
+	{
+		takeFrom(other);
+	}
+
+	DynamicBufferArray& operator=(const DynamicBufferArray& other)
+	{
+		if (this != &other)
+		{
+			clear();
+			reserve(other.count);
+			std::uninitialized_copy(other.begin(), other.end(), data_);
+			count = other.count;
+		}
+		return *this;
+	}
+
+	DynamicBufferArray& operator=(DynamicBufferArray&& other) noexcept
+	{
+		if (this != &other)
+		{
+			clear();
+			releaseStorage();
+			takeFrom(other);
+		}
+		return *this;
+	}
+
+	~DynamicBufferArray()
+	{
+		clear();
+		releaseStorage();
+	}
+
+
 	// ------------- Element Access -------------
-	T& operator[](size_t index); //must return as reference as array element can be put on left side
-	const T& operator[](size_t index) const;
-	
-	
+	T& operator[](size_t index) { assert(index < count); return data_[index]; } //must return as reference as array element can be put on left side
+	const T& operator[](size_t index) const { assert(index < count); return data_[index]; }
+	T& front() { assert(count > 0); return data_[0]; }
+	T& back() { assert(count > 0); return data_[count - 1]; }
+	const T& back() const { assert(count > 0); return data_[count - 1]; }
+	T* data() { return data_; }
+	const T* data() const { return data_; }
+
+	iterator begin() { return data_; }
+	iterator end() { return data_ + count; }
+	const_iterator begin() const { return data_; }
+	const_iterator end() const { return data_ + count; }
+
+
 	// ------------- Capacity and Size -------------
-	bool empty() const; // Returns size() == 0.
-	int size() const;  // Returns the number of elements in the list.
-	
-	
-	void reserve(size_t _size); //Reserves a minimum capacity for the array.
-	void resize(size_t _size, const T& fill); //resizes the list to contain _size elements, filling new elements with fill
-	
-	
-	
+	bool empty() const { return count == 0; } // Returns size() == 0.
+	size_t size() const { return count; } // Returns the number of elements in the list.
+	size_t capacity() const { return capacity_; } // Elements that fit before the storage has to grow
+	bool isInline() const { return data_ == inlineBuffer(); } // Whether the elements still live in the inline buffer
+	ScratchArena* getArena() const { return arena; } // Arena spilled storage comes from, nullptr for the heap
+
+	void reserve(size_t _size) //Reserves a minimum capacity for the array.
+	{
+		if (_size > capacity_)
+		{
+			reallocate(_size);
+		}
+	}
+
+	void resize(size_t _size) //resizes the list to contain _size elements, value-initializing new elements
+	{
+		reserve(_size);
+		for (size_t j = count; j < _size; ++j)
+		{
+			new (data_ + j) T();
+		}
+		shrinkTo(_size);
+		count = _size;
+	}
+
+	void resize(size_t _size, const T& fill) //resizes the list to contain _size elements, filling new elements with fill
+	{
+		if (_size > capacity_)
+		{
+			T value(fill); // 'fill' may live in the storage about to be moved
+			reserve(_size);
+			std::uninitialized_fill(data_ + count, data_ + _size, value);
+		}
+		else if (_size > count)
+		{
+			std::uninitialized_fill(data_ + count, data_ + _size, fill);
+		}
+		shrinkTo(_size);
+		count = _size;
+	}
+
+
 	// ------------- Modifiers -------------
-	void push_back(const T& _data);
-	T pop_back();
-	void clear();
-	void swap(DynamicBufferArray &other);
-	
+	void push_back(const T& _data) { emplace_back(_data); }
+	void push_back(T&& _data) { emplace_back(std::move(_data)); }
+
 	template <typename... Args>
-	void emplace_back(Args&&... args);
-	
-	
+	T& emplace_back(Args&&... args)
+	{
+		if (count == capacity_)
+		{
+			T value(std::forward<Args>(args)...); // the arguments may refer into the storage about to be moved
+			reallocate(grownCapacity());
+			new (data_ + count) T(std::move(value));
+		}
+		else
+		{
+			// Construct the object in-place at the end of the array using std::forward to preserve argument types
+			new (data_ + count) T(std::forward<Args>(args)...);
+		}
+		return data_[count++];
+	}
+
+	T pop_back() // Removes and returns the last element
+	{
+		assert(count > 0);
+		T last(std::move(data_[count - 1]));
+		data_[--count].~T();
+		return last;
+	}
+
+	void clear() // Destroys the elements, the capacity is kept
+	{
+		shrinkTo(0);
+		count = 0;
+	}
+
+	void swap(DynamicBufferArray &other)
+	{
+		DynamicBufferArray temp(std::move(other));
+		other = std::move(*this);
+		*this = std::move(temp);
+	}
+
+
 private:
-	// ------------- Internal storage and metadata for DynamicBufferArray. -------------
-	
-	enum { fixed_cap = 64 };
-	struct alignas(16) ListData //is memory-aligned for optimal access speed. In C++11 and newer, you can use the alignas keyword.
-	{
-	ListData();
-	T buffer[fixed_cap];// Stores a fixed-size buffer in advance to avoid requiring a heap allocation until we run out of space.
-	T* data;  // Pointer to the actual data
-	size_t size;   //total current size of array/vector, i.e., number of elements
-	size_t capacity;  // Total capacity of the allocated array, i.e., max size
-};
-ListData listData;  // Internal data storage
+	// ------------- Storage Management -------------
+	T* inlineBuffer() { return reinterpret_cast<T*>(buffer); }
+	const T* inlineBuffer() const { return reinterpret_cast<const T*>(buffer); }
 
+	size_t grownCapacity() const
+	{
+		return std::max<size_t>(capacity_ + 1, static_cast<size_t>(capacity_ * 1.618)); // Golden Ratio
+	}
 
-};
+	void shrinkTo(size_t _size) // Destroys the elements past '_size'
+	{
+		for (size_t j = _size; j < count; ++j)
+		{
+			data_[j].~T();
+		}
+	}
 
+	void reallocate(size_t newCapacity) // Moves the elements to spilled storage of 'newCapacity' elements
+	{
+		T* newMemory = (arena != nullptr) ? static_cast<T*>(arena->allocate(newCapacity * sizeof(T), alignof(T))) : static_cast<T*>(::operator new(newCapacity * sizeof(T), std::align_val_t(alignof(T))));
+		std::uninitialized_move(data_, data_ + count, newMemory);
+		for (size_t j = 0; j < count; ++j)
+		{
+			data_[j].~T();
+		}
+		releaseStorage();
+		data_ = newMemory;
+		capacity_ = newCapacity;
+	}
+
+	void releaseStorage() // Frees spilled heap storage and returns to the inline buffer, elements must be destroyed
+	{
+		if (data_ != inlineBuffer() && arena == nullptr)
+		{
+			::operator delete(static_cast<void*>(data_), std::align_val_t(alignof(T)));
+		}
+		data_ = inlineBuffer();
+		capacity_ = InlineCapacity;
+	}
+
+	void takeFrom(DynamicBufferArray &other) // Move construction into an empty array with inline storage
+	{
+		arena = other.arena;
+		if (other.isInline())
+		{
+			std::uninitialized_move(other.begin(), other.end(), data_);
+			count = other.count;
+			other.clear();
+		}
+		else
+		{
+			data_ = other.data_;
+			capacity_ = other.capacity_;
+			count = other.count;
+			other.data_ = other.inlineBuffer();
+			other.capacity_ = InlineCapacity;
+			other.count = 0;
+		}
+	}
+
+
+	// ------------- Internal storage and metadata for DynamicBufferArray. -------------
+	T* data_;  // Pointer to the actual data, the inline buffer until it overflows
+	size_t count = 0;  //total current size of array/vector, i.e., number of elements
+	size_t capacity_ = InlineCapacity;  // Total capacity of the storage in use, i.e., max size
+	ScratchArena* arena;  // Source of spilled storage, nullptr for the heap
+	alignas(T) unsigned char buffer[(InlineCapacity > 0 ? InlineCapacity : 1) * sizeof(T)];  // Stores a fixed-size buffer in advance to avoid requiring an allocation until we run out of space.
+};
@@ -44,6 +44,7 @@ void BarnesHutSimulation::config(std::string simulatorTitle, std::string simulat
 	 * initialConditionsMode == 4 : PlummerModelInitialConditions
 	 */
 	initialConditionsMode = 5;
+	placeMemory();
 	BeginSimulation(simulationConfigure, bodies, initialConditionsMode);
 	
 	
@@ -55,24 +56,24 @@ void BarnesHutSimulation::config(std::string simulatorTitle, std::string simulat
 	
 	
 	
-	TestBuildQuadtree(rootQuadtree,  bodies, simulationConfigure.bodyPool);
+	TestBuildQuadtree(rootQuadtree, bodies);
 	
 	
-	//ofVec2f* bodiesAccelerations;
-	bodiesAccelerations = new ofVec2f[bodies.size()];
+	ResetBodyHandles(bodyHandles, bodies.size());
 	
 	
 	
-	ComputeAllForces(rootQuadtree,  bodies, bodiesAccelerations, G, theta);
-	//IntegrationScheme(dt, bodies, bodiesAccelerations, simulationConfigure.userInterface.switchIntegrationMethod->isOn, simulationConfigure.userInterface.slowMotionMode->isOn, simulationConfigure.userInterface.fastMotionMode->isOn);
-	IntegrateRK4Force(dt, bodies, bodiesAccelerations);
+	ComputeAllForces(rootQuadtree, bodies, G, theta);
+	//IntegrationScheme(dt, bodies, simulationConfigure.userInterface.switchIntegrationMethod->isOn, simulationConfigure.userInterface.slowMotionMode->isOn, simulationConfigure.userInterface.fastMotionMode->isOn);
+	IntegrateRungeKutta4(dt, bodies, rungeKuttaStages, [this]() { computeTrialForces(); });
 	
 	
 	ComputeSystemEnergy(bodies, systemEnergy, systemKineticEnergy, systemPotentialEnergy);
 	
 	
 	ResetAccelerations(bodies);
-	//delete[] bodiesAccelerations;
+	
+	LoadOrBuildEwaldTable(periodicDomain, ofToDataPath("ewald_correction.bin")); // built once, later runs load it from disk
 	
 	cout<<"\n\n Setup Complete ofGetElapsedTimef(): " << ofGetElapsedTimef();
 	
@@ -80,7 +81,9 @@ void BarnesHutSimulation::config(std::string simulatorTitle, std::string simulat
 	
 	
 	RectangularGridDragSelection vectorGrid("Test grid", (ofGetWidth() * 0.5 - 1250), (ofGetHeight() * 0.5 - 1250), 2500, 2500);
-	simulationConfigure.config(simulatorTitle, simulationMode, rootQuadtree, bodies, bodiesAccelerations, vectorGrid, theta, G, e, dt);
+	interfaceParameters = {theta, G, e, dt}; // the interface edits its own copies, the physics only sees them as commands
+	forwardedParameters = interfaceParameters;
+	simulationConfigure.config(simulatorTitle, simulationMode, rootQuadtree, bodies, bodyData, vectorGrid, interfaceParameters.theta, interfaceParameters.G, interfaceParameters.e, interfaceParameters.dt);
 	
 }
 
@@ -114,6 +117,7 @@ void BarnesHutSimulation::setup()
 	 * initialConditionsMode == 4 : PlummerModelInitialConditions
 	 */
 	initialConditionsMode = 5;
+	placeMemory();
 	BeginSimulation(simulationConfigure, bodies, initialConditionsMode);
 	
 	
@@ -126,23 +130,24 @@ void BarnesHutSimulation::setup()
 	
 	
 	
-	TestBuildQuadtree(rootQuadtree,  bodies, simulationConfigure.bodyPool);
+	TestBuildQuadtree(rootQuadtree, bodies);
 	
 	
-	bodiesAccelerations = new ofVec2f[bodies.size()];
+	ResetBodyHandles(bodyHandles, bodies.size());
 	
 	
 	
-	ComputeAllForces(rootQuadtree,  bodies, bodiesAccelerations, G, theta);
-	//IntegrationScheme(dt, bodies, bodiesAccelerations, simulationConfigure.userInterface.switchIntegrationMethod->isOn, simulationConfigure.userInterface.slowMotionMode->isOn, simulationConfigure.userInterface.fastMotionMode->isOn);
-	IntegrateRK4Force(dt, bodies, bodiesAccelerations);
+	ComputeAllForces(rootQuadtree, bodies, G, theta);
+	//IntegrationScheme(dt, bodies, simulationConfigure.userInterface.switchIntegrationMethod->isOn, simulationConfigure.userInterface.slowMotionMode->isOn, simulationConfigure.userInterface.fastMotionMode->isOn);
+	IntegrateRungeKutta4(dt, bodies, rungeKuttaStages, [this]() { computeTrialForces(); });
 	
 	
 	ComputeSystemEnergy(bodies, systemEnergy, systemKineticEnergy, systemPotentialEnergy);
 	
 	
-	ResetofVec2f(bodiesAccelerations, bodies.size());
-	//delete[] bodiesAccelerations;
+	ClearAccelerations(bodies);
+	
+	LoadOrBuildEwaldTable(periodicDomain, ofToDataPath("ewald_correction.bin")); // built once, later runs load it from disk
 	
 	cout<<"\n\n Setup Complete ofGetElapsedTimef(): " << ofGetElapsedTimef();
 	
@@ -154,7 +159,7 @@ void BarnesHutSimulation::setup()
 
 void BarnesHutSimulation::update()
 {
-	simulationConfigure.update(rootQuadtree, theta, G, e, dt);
+	simulationConfigure.update(rootQuadtree, interfaceParameters.theta, interfaceParameters.G, interfaceParameters.e, interfaceParameters.dt);
 }
 
 
@@ -166,47 +171,621 @@ void BarnesHutSimulation::update()
 
 void BarnesHutSimulation::draw()
 {
-	//ResetAccelerations(bodies);
-	//if(simulationConfigure.userInterface.switchIntegrationMethod) {ComputePositionAtHalfTimeStep(dt, bodies);}  //only do halftimestep for LeapFrog KDK integration scheme
-	
-	
-	BuildQuadtree(rootQuadtree,  bodies, simulationConfigure.bodyPool);
-	
-	
-	
-	//bodiesAccelerations = new ofVec2f[bodies.size()];
-	//for (int i = 0; i < bodies.size(); i++)
-	//{
-	//	bodiesAccelerations[i] = {0,0};
-	//}
-	
-	
-	ComputeAllForces(rootQuadtree,  bodies, bodiesAccelerations, G, theta);
-	//IntegrationScheme(dt, bodies, bodiesAccelerations, simulationConfigure.userInterface.switchIntegrationMethod->isOn, simulationConfigure.userInterface.slowMotionMode->isOn, simulationConfigure.userInterface.fastMotionMode->isOn);
-	IntegrateRK4Force(dt, bodies, bodiesAccelerations);
-	
+	UserInterface &userInterface = simulationConfigure.userInterface;
+	bool threaded = userInterface.physicsThread && userInterface.physicsThread->isOn;
+	if(threaded && !physicsThread.running.load())
+	{
+		PublishPhysicsSnapshot(physicsThread, bodies, stats, G, dt, systemEnergy, systemKineticEnergy, systemPotentialEnergy); // something to draw until the first batch is done
+		userInterface.physicsThreadRunning = true; // the tree and accelerations the visualizations read are the worker's from here on
+		StartPhysicsThread(physicsThread, [this]() { runPhysicsBatch(); });
+	}
+	else if(!threaded && physicsThread.running.load())
+	{
+		StopPhysicsThread(physicsThread); // joined, the live state is this thread's again
+		userInterface.physicsThreadRunning = false;
+		stats.stepsPerSecond = 0;
+	}
+	forwardInterfaceEdits();
+	
+	
+	if(threaded) // draw the newest snapshot, never the live state
+	{
+		physicsThread.snapshots.acquire(); // keeps the previous snapshot if no batch finished since
+		PhysicsSnapshot &snapshot = physicsThread.snapshots.readBuffer();
+		showStats(snapshot.stats);
+		simulationConfigure.draw(snapshot.bodies, snapshot.G, snapshot.dt, snapshot.systemEnergy, snapshot.systemKineticEnergy, snapshot.systemPotentialEnergy);
+		endProfilerFrame();
+		return;
+	}
+	
+	
+	applyCommands();
+	step();
 	ComputeSystemEnergy(bodies, systemEnergy, systemKineticEnergy, systemPotentialEnergy);
+	showStats(stats);
 	
-	simulationConfigure.draw(rootQuadtree, bodies, bodiesAccelerations, G, dt, systemEnergy, systemKineticEnergy, systemPotentialEnergy);
+	simulationConfigure.draw(rootQuadtree, bodies, G, dt, systemEnergy, systemKineticEnergy, systemPotentialEnergy);
 	
+	finishStep();
+	endProfilerFrame();
+}
+
+
+void BarnesHutSimulation::step()
+{
+	//ResetAccelerations(bodies);
+	//if(simulationConfigure.userInterface.switchIntegrationMethod) {ComputePositionAtHalfTimeStep(dt, bodies);}  //only do halftimestep for LeapFrog KDK integration scheme
 	
 	
-	ResetofVec2f(bodiesAccelerations, bodies.size());
-	//delete[] bodiesAccelerations;
+	ConfigureBodyData(bodyData, bodies, modes.bodyEnergies, modes.bodyRotation); // allocates or frees the cold data when its visualizations are toggled
+	bool fusedLeapfrog = modes.fusedLeapfrog;
+	bool yoshida = modes.yoshida;
+	bool forestRuth = modes.forestRuth;
+	SymplecticScheme scheme = forestRuth ? SymplecticScheme::ForestRuth4 : SymplecticScheme::Yoshida4;
+	if(!(yoshida || forestRuth) || symplecticIntegrator.scheme != scheme) // another integrator moved the bodies, or the composition changed
+	{
+		ResetSymplecticIntegrator(symplecticIntegrator);
+		symplecticIntegrator.scheme = scheme;
+	}
+	
+	if(fusedLeapfrog) // accelerations never leave the walk, so there is nothing to integrate or reset afterwards
+	{
+		BuildQuadtree(rootQuadtree, bodies);
+		if(modes.collisions)
+		{
+			stats.collisionContacts = ComputeCollisions(rootQuadtree, bodies, collisions, e);
+		}
+		ComputeForcesKickDrift(rootQuadtree, bodies, fusedLeapfrogState, G, theta, dt);
+		
+		InvalidateInteractionLists(interactionListCache);
+		multiRate.isValid = false;
+		ResetBlockTimesteps(blockTimesteps);
+		retainQuadtree = false;
+	}
+	else if(forestRuth) // drift first, the frame's tree is only refit by the three evaluations, no walk at x_n
+	{
+		ResetFusedLeapfrog(fusedLeapfrogState);
+		ResetBlockTimesteps(blockTimesteps);
+		auto start = std::chrono::steady_clock::now();
+		BuildQuadtree(rootQuadtree, bodies);
+		symplecticIntegrator.wallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if(modes.collisions)
+		{
+			stats.collisionContacts = ComputeCollisions(rootQuadtree, bodies, collisions, e);
+		}
+		AdvanceSymplectic(rootQuadtree, bodies, symplecticIntegrator, G, theta, dt);
+		
+		InvalidateInteractionLists(interactionListCache);
+		multiRate.isValid = false;
+		retainQuadtree = false;
+	}
+	else
+	{
+		ResetFusedLeapfrog(fusedLeapfrogState);
+		auto start = std::chrono::steady_clock::now();
+		computeForces();
+		if(yoshida)
+		{
+			symplecticIntegrator.wallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		
+		if(modes.collisions) // broad phase reuses the tree the forces were computed on
+		{
+			stats.collisionContacts = ComputeCollisions(rootQuadtree, bodies, collisions, e, quadtreeSlack);
+		}
+		if(modes.mergeBodies && ApplyMergers(bodies, bodyHandles, bodyData, mergers) > 0)
+		{
+			// the tree and anything recorded on it still hold the indices from before the merge
+			InvalidateInteractionLists(interactionListCache);
+			multiRate.isValid = false;
+			retainQuadtree = false;
+			quadtreeStale = true;
+			potentialsComputed = false; // indexed like the bodies before the merge
+			stats.mergedBodies = mergers.totalMerged;
+		}
+		if(modes.adaptiveTimestep)
+		{
+			dt = ChooseAdaptiveTimestep(bodies, adaptiveTimestep, potentialsComputed); // from the accelerations the step is about to integrate
+			stats.adaptiveEnergyDrift = adaptiveTimestep.relativeEnergyDrift;
+		}
+		else
+		{
+			ResetAdaptiveTimestep(adaptiveTimestep);
+		}
+		//IntegrationScheme(dt, bodies, simulationConfigure.userInterface.switchIntegrationMethod->isOn, simulationConfigure.userInterface.slowMotionMode->isOn, simulationConfigure.userInterface.fastMotionMode->isOn);
+		if(yoshida)
+		{
+			ResetBlockTimesteps(blockTimesteps);
+			if(quadtreeStale) // the substeps refit the tree, which still holds the absorbed bodies
+			{
+				BuildQuadtree(rootQuadtree, bodies);
+				quadtreeStale = false;
+				symplecticIntegrator.hasReferenceEnergy = false; // mergers don't conserve energy, measure from here
+			}
+			AdvanceSymplectic(rootQuadtree, bodies, symplecticIntegrator, G, theta, dt); // first kick uses the accelerations computeForces() just made
+		}
+		else if(modes.blockTimesteps)
+		{
+			if(quadtreeStale) // the ticks refit and walk the tree, which still holds the absorbed bodies
+			{
+				BuildQuadtree(rootQuadtree, bodies);
+				quadtreeStale = false;
+			}
+			AdvanceBlockTimesteps(rootQuadtree, bodies, blockTimesteps, G, theta, dt); // substeps refit the tree computeForces() just built
+			stats.blockForceEvaluations = blockTimesteps.forceEvaluations / std::max(blockTimesteps.simulatedTime, 1e-9);
+			stats.blockDeepestLevel = blockTimesteps.deepestLevel;
+		}
+		else
+		{
+			ResetBlockTimesteps(blockTimesteps); // any closing kick still owed belongs to the block scheme
+			IntegrateRungeKutta4(dt, bodies, rungeKuttaStages, [this]() { computeTrialForces(); });
+		}
+	}
+	if(yoshida || forestRuth)
+	{
+		stats.symplecticEnergyError = symplecticIntegrator.relativeEnergyError;
+		stats.symplecticWallSeconds = symplecticIntegrator.wallSeconds;
+	}
+	UpdateBodyData(bodyData, rootQuadtree, bodies, G, theta, dt); // returns at once unless a visualization needs it
+}
+
+
+void BarnesHutSimulation::finishStep()
+{
+	if(!modes.fusedLeapfrog) // the fused walk keeps its accelerations in locals, there is nothing to reset
+	{
+		ClearAccelerations(bodies);
+	}
 	
 	
 	
 	
 	/*-----------   Reset the tree(free memory) after drawing the quadrant bounds(if applicable)   -----------*/
-	ResetTree(rootQuadtree);
+	if(!retainQuadtree) // cached interaction lists point into the tree, it is freed by the next rebuild instead
+	{
+		ResetTree(rootQuadtree);
+	}
+}
+
+
+void BarnesHutSimulation::runPhysicsBatch()
+{
+	for(int s = 0; s < physicsThread.substepsPerFrame; s++)
+	{
+		applyCommands(); // edits take effect at the next step boundary
+		step();
+		finishStep();
+		physicsThread.steps++;
+	}
+	ComputeSystemEnergy(bodies, systemEnergy, systemKineticEnergy, systemPotentialEnergy);
+	PublishPhysicsSnapshot(physicsThread, bodies, stats, G, dt, systemEnergy, systemKineticEnergy, systemPotentialEnergy);
+}
+
+
+void BarnesHutSimulation::applyCommands()
+{
+	PhysicsCommand command;
+	while(physicsThread.commands.pop(command))
+	{
+		switch (command.type)
+		{
+			case PhysicsCommandType::SetTheta: theta = command.value; break;
+			case PhysicsCommandType::SetG: G = command.value; break;
+			case PhysicsCommandType::SetE: e = command.value; break;
+			case PhysicsCommandType::SetDt: dt = command.value; break;
+			case PhysicsCommandType::SetModes: modes = command.modes; break;
+			case PhysicsCommandType::BenchmarkForceSolvers: // compare Barnes-Hut against the particle-mesh and TreePM solvers on the current bodies
+				PrintForceSolverBenchmark(BenchmarkForceSolvers(bodies, particleMesh, G, theta));
+				break;
+			case PhysicsCommandType::BenchmarkIntegrators: // energy error against wall-clock time of the symplectic integrators on a copy of the current bodies
+				PrintIntegratorBenchmark(BenchmarkIntegrators(bodies, G, theta, dt));
+				break;
+			case PhysicsCommandType::BenchmarkPrecision: // float, double and double positions with float kernels on copies of the current bodies, near and far from the origin
+				PrintPrecisionBenchmark(BenchmarkPrecision(bodies, G, theta, dt));
+				PrintPrecisionBenchmark(BenchmarkPrecision(bodies, G, theta, dt, 64, 200000));
+				break;
+			case PhysicsCommandType::BenchmarkTraversalScratch: // the interaction walk with std::vector and DynamicBufferArray scratch lists
+				PrintScratchBenchmark(BenchmarkTraversalScratch(bodies, G, theta));
+				break;
+			case PhysicsCommandType::ReportMemoryPlacement:
+				reportMemoryPlacement();
+				break;
+		}
+	}
+	spliceInjectedBodies(); // a galaxy generated in the background joins at the same boundary
+}
+
+
+void BarnesHutSimulation::spliceInjectedBodies()
+{
+	size_t added = SpliceInjectedBodies(bodyInjection, bodies, bodyHandles);
+	if(added == 0)
+	{
+		return;
+	}
+	SyncBodyData(bodyData, bodies); // a merger later in the step swaps entries of the table, so it must cover the new bodies already
+	
+	
+	// same as after mergers, with the count growing instead of shrinking
+	InvalidateInteractionLists(interactionListCache);
+	multiRate.isValid = false;
+	retainQuadtree = false;
+	quadtreeStale = true;
+	potentialsComputed = false;
+	symplecticIntegrator.hasReferenceEnergy = false; // the energy jumps with the new bodies, measure from here
+	cout << "\n\nInjected " << added << " bodies (generated in " << bodyInjection.generationSeconds << " s), " << bodies.size() << " in total\n" << endl;
+}
+
+
+void BarnesHutSimulation::forwardInterfaceEdits()
+{
+	PhysicsModes interfaceModes = readInterfaceModes();
+	bool modesChanged = !(interfaceModes == forwardedModes);
+	bool delivered = true;
+	if(modesChanged)
+	{
+		PhysicsCommand command;
+		command.type = PhysicsCommandType::SetModes;
+		command.modes = interfaceModes;
+		delivered = physicsThread.commands.push(command) && delivered;
+	}
+	
+	
+	// A mode change resends everything, e.g., dt must fall back to the interface's value when the adaptive step is switched off
+	if(modesChanged || interfaceParameters.theta != forwardedParameters.theta)
+	{
+		delivered = physicsThread.commands.push({PhysicsCommandType::SetTheta, interfaceParameters.theta}) && delivered;
+	}
+	if(modesChanged || interfaceParameters.G != forwardedParameters.G)
+	{
+		delivered = physicsThread.commands.push({PhysicsCommandType::SetG, interfaceParameters.G}) && delivered;
+	}
+	if(modesChanged || interfaceParameters.e != forwardedParameters.e)
+	{
+		delivered = physicsThread.commands.push({PhysicsCommandType::SetE, interfaceParameters.e}) && delivered;
+	}
+	if(modesChanged || interfaceParameters.dt != forwardedParameters.dt)
+	{
+		delivered = physicsThread.commands.push({PhysicsCommandType::SetDt, interfaceParameters.dt}) && delivered;
+	}
+	
+	
+	if(delivered) // a full queue is retried next frame, the commands are idempotent
+	{
+		forwardedModes = interfaceModes;
+		forwardedParameters = interfaceParameters;
+	}
+}
+
+
+PhysicsModes BarnesHutSimulation::readInterfaceModes()
+{
+	UserInterface &userInterface = simulationConfigure.userInterface;
+	auto isOn = [](Toggle* toggle) { return toggle != nullptr && toggle->isOn; };
+	
+	
+	PhysicsModes interfaceModes;
+	interfaceModes.collisions = isOn(userInterface.toggleCollisions);
+	interfaceModes.mergeBodies = isOn(userInterface.mergeBodies);
+	interfaceModes.cacheInteractionLists = isOn(userInterface.cacheInteractionLists);
+	interfaceModes.multiRateFarField = isOn(userInterface.multiRateFarField);
+	interfaceModes.particleMeshGravity = isOn(userInterface.particleMeshGravity);
+	interfaceModes.treePMCorrection = isOn(userInterface.treePMCorrection);
+	interfaceModes.periodicBoundaries = isOn(userInterface.periodicBoundaries);
+	interfaceModes.blockTimesteps = isOn(userInterface.blockTimesteps);
+	interfaceModes.fusedLeapfrog = isOn(userInterface.fusedLeapfrog);
+	interfaceModes.yoshida = !interfaceModes.fusedLeapfrog && isOn(userInterface.yoshidaIntegrator);
+	interfaceModes.forestRuth = !interfaceModes.fusedLeapfrog && !interfaceModes.yoshida && isOn(userInterface.forestRuthIntegrator);
+	interfaceModes.adaptiveTimestep = isOn(userInterface.adaptiveTimestep) && !userInterface.tableManager->galaxyCreationMode;
+	interfaceModes.adaptiveEnergyControl = isOn(userInterface.adaptiveEnergyControl);
+	interfaceModes.bodyEnergies = isOn(userInterface.bodyEnergyGradient) && !userInterface.physicsThreadRunning; // paused visualizations need no data
+	interfaceModes.bodyRotation = isOn(userInterface.bodyAngularOrientation) && !userInterface.physicsThreadRunning;
+
+
+	// Only the plain tree walk records the close pairs, the cached, multi-rate, grid and periodic solvers and the fused and drift-first integrators never see them
+	bool refitIntegrator = interfaceModes.yoshida || interfaceModes.blockTimesteps;
+	bool otherSolver = interfaceModes.cacheInteractionLists || interfaceModes.multiRateFarField || interfaceModes.particleMeshGravity || interfaceModes.periodicBoundaries;
+	bool mergersDetected = !interfaceModes.fusedLeapfrog && !interfaceModes.forestRuth && (refitIntegrator || !otherSolver);
+	if(interfaceModes.mergeBodies && !mergersDetected)
+	{
+		cout << "\n\n'Merge Bodies' turned off, the selected solver or integrator doesn't detect mergers (only the plain tree walk does)\n" << endl;
+		userInterface.mergeBodies->isOn = false;
+		interfaceModes.mergeBodies = false;
+	}
+	return interfaceModes;
+}
+
+
+void BarnesHutSimulation::showStats(const PhysicsStats &shownStats)
+{
+	UserInterface &userInterface = simulationConfigure.userInterface;
+	userInterface.multiRateFarFieldError = shownStats.multiRateFarFieldError;
+	userInterface.mergedBodies = shownStats.mergedBodies;
+	userInterface.collisionContacts = shownStats.collisionContacts;
+	userInterface.blockForceEvaluations = shownStats.blockForceEvaluations;
+	userInterface.blockDeepestLevel = shownStats.blockDeepestLevel;
+	userInterface.adaptiveEnergyDrift = shownStats.adaptiveEnergyDrift;
+	userInterface.adaptiveEnergyControlActive = shownStats.adaptiveEnergyControlActive;
+	userInterface.symplecticEnergyError = shownStats.symplecticEnergyError;
+	userInterface.symplecticWallSeconds = shownStats.symplecticWallSeconds;
+	userInterface.physicsStepsPerSecond = shownStats.stepsPerSecond;
+}
+
+
+void BarnesHutSimulation::computeForces()
+{
+	PROFILE_PHASE(ComputeForces); // whichever solver runs, the builds and refits it does are charged to their own phases
+	bool refitIntegrator = modes.yoshida || modes.blockTimesteps; // the substeps refit a freshly built tree, the other force modes don't apply
+	bool periodicBoundaries = !refitIntegrator && modes.periodicBoundaries;
+	bool particleMeshGravity = !refitIntegrator && !periodicBoundaries && modes.particleMeshGravity;
+	bool multiRateFarField = !refitIntegrator && !periodicBoundaries && !particleMeshGravity && modes.multiRateFarField;
+	bool cacheInteractionLists = !refitIntegrator && !periodicBoundaries && !particleMeshGravity && modes.cacheInteractionLists;
+	
+	
+	quadtreeStale = false; // every branch below leaves a tree matching the current bodies
+	potentialsComputed = false;
+	bool energyControl = modes.adaptiveTimestep && modes.adaptiveEnergyControl;
+	std::vector<double>* potentials = energyControl ? &adaptiveTimestep.potentials : nullptr; // filled by the walks that can sum them on the way
+	if(!multiRateFarField)
+	{
+		multiRate.isValid = false;
+	}
+	if(!cacheInteractionLists)
+	{
+		InvalidateInteractionLists(interactionListCache);
+	}
+	
+	
+	if(periodicBoundaries) // fixed periodic root box, minimum image walk plus Ewald correction for the other images
+	{
+		WrapPositionsIntoDomain(periodicDomain, bodies);
+		BuildQuadtree(rootQuadtree, bodies, periodicDomain.bounds());
+		ComputeAllForcesPeriodic(rootQuadtree, bodies, periodicDomain, G, theta);
+		retainQuadtree = false;
+		quadtreeSlack = 0;
+	}
+	else if(particleMeshGravity) // grid solve, with the tree only used for the short-range part of TreePM
+	{
+		if(modes.treePMCorrection)
+		{
+			BuildQuadtree(rootQuadtree, bodies);
+			ComputeAllForcesTreePM(rootQuadtree, bodies, particleMesh, G, theta);
+		}
+		else
+		{
+			if(modes.collisions)
+			{
+				BuildQuadtree(rootQuadtree, bodies); // gravity doesn't need it, but the collision broad phase does
+			}
+			else
+			{
+				ResetTree(rootQuadtree); // nothing to visualize, and a retained tree from another mode would be stale
+			}
+			ComputeAllForcesParticleMesh(bodies, particleMesh, G);
+		}
+		retainQuadtree = false;
+		quadtreeSlack = 0;
+	}
+	else if(multiRateFarField) // far field refreshed every few steps, near field every step
+	{
+		InvalidateInteractionLists(interactionListCache); // the tree is rebuilt on refreshes, any recorded lists would dangle
+		
+		if(MultiRateNeedsRefresh(multiRate, bodies))
+		{
+			BuildQuadtree(rootQuadtree, bodies);
+			ComputeAllForcesMultiRateRefresh(rootQuadtree, bodies, multiRate, G, theta);
+			quadtreeSlack = 0;
+		}
+		else
+		{
+			ComputeAllForcesMultiRateNear(bodies, multiRate, G);
+			quadtreeSlack = multiRate.displacementThreshold; // bodies moved at most this far since the tree was built
+			
+			if(multiRate.errorSampleInterval > 0 && ++multiRate.stepsSinceErrorSample >= multiRate.errorSampleInterval)
+			{
+				MeasureMultiRateError(bodies, multiRate, G, theta);
+				cout << "\nMulti-rate far field relative error: " << multiRate.lastRelativeError << " (" << multiRate.refreshes << " refreshes, " << multiRate.nearOnlySteps << " near-only steps)";
+			}
+		}
+		stats.multiRateFarFieldError = multiRate.lastRelativeError;
+		retainQuadtree = true; // keep the last refresh's tree around for the visualizations
+	}
+	else if(cacheInteractionLists && !InteractionListsNeedRebuild(interactionListCache, bodies))
+	{
+		ComputeQuadtreeMassDistribution(rootQuadtree, bodies); // keep the topology the lists point into, only refresh the centres of mass
+		ComputeAllForcesFromInteractionLists(bodies, interactionListCache, G, potentials);
+		potentialsComputed = energyControl;
+		retainQuadtree = true;
+		quadtreeSlack = interactionListCache.margin;
+	}
+	else
+	{
+		BuildQuadtree(rootQuadtree, bodies);
+		
+		
+		
+		//bodiesAccelerations = new ofVec2f[bodies.size()];
+		//for (int i = 0; i < bodies.size(); i++)
+		//{
+		//	bodiesAccelerations[i] = {0,0};
+		//}
+		
+		
+		if(cacheInteractionLists)
+		{
+			ComputeAllForcesRecordingInteractions(rootQuadtree, bodies, interactionListCache, G, theta, potentials);
+			potentialsComputed = energyControl;
+		}
+		else if(modes.mergeBodies)
+		{
+			ComputeAllForcesDetectingMergers(rootQuadtree, bodies, mergers, G, theta, potentials); // the leaf branch records pairs within the merge radius
+			potentialsComputed = energyControl;
+		}
+		else if(energyControl)
+		{
+			ComputeAllForcesWithPotential(rootQuadtree, bodies, adaptiveTimestep, G, theta); // the energy controller needs the potentials, the walk visits the same nodes anyway
+			potentialsComputed = true;
+		}
+		else
+		{
+			ComputeAllForces(rootQuadtree, bodies, G, theta);
+		}
+		retainQuadtree = cacheInteractionLists;
+		quadtreeSlack = 0;
+	}
+	stats.adaptiveEnergyControlActive = potentialsComputed; // the periodic, particle-mesh and multi-rate solvers compute no potentials
+}
+
+
+void BarnesHutSimulation::computeTrialForces()
+{
+	PROFILE_PHASE(ComputeForces);
+	bool periodicBoundaries = modes.periodicBoundaries;
+	bool particleMeshGravity = !periodicBoundaries && modes.particleMeshGravity;
+	bool treePMCorrection = particleMeshGravity && modes.treePMCorrection;
+	bool multiRateFarField = !periodicBoundaries && !particleMeshGravity && modes.multiRateFarField;
+	bool cacheInteractionLists = !periodicBoundaries && !particleMeshGravity && modes.cacheInteractionLists;
+	
+	
+	ClearAccelerations(bodies);
+	if(particleMeshGravity && !treePMCorrection) // no tree involved, the grid is simply solved again
+	{
+		ComputeAllForcesParticleMesh(bodies, particleMesh, G);
+		return;
+	}
+	if(multiRateFarField && MultiRateCoversPositions(multiRate, bodies)) // the stages stay on the far field cached for the step, only the near field follows them
+	{
+		EvaluateMultiRateForces(bodies, multiRate, G);
+		return;
+	}
+	
+	
+	// The trial positions are within a step of the ones the tree was built on, so its topology is kept and only refit
+	if(quadtreeStale || multiRateFarField) // bodies were removed since the build, or the multi-rate tree is from the last refresh and up to the displacement threshold out of date
+	{
+		if(periodicBoundaries)
+		{
+			BuildQuadtree(rootQuadtree, bodies, periodicDomain.bounds());
+		}
+		else
+		{
+			BuildQuadtree(rootQuadtree, bodies);
+		}
+		quadtreeStale = false;
+	}
+	else
+	{
+		ComputeQuadtreeMassDistribution(rootQuadtree, bodies);
+	}
+	
+	
+	if(periodicBoundaries)
+	{
+		ComputeAllForcesPeriodic(rootQuadtree, bodies, periodicDomain, G, theta);
+	}
+	else if(treePMCorrection)
+	{
+		ComputeAllForcesTreePM(rootQuadtree, bodies, particleMesh, G, theta);
+	}
+	else if(cacheInteractionLists && InteractionListsCoverPositions(interactionListCache, bodies)) // recorded with the margin, so the lists hold for trial positions within it
+	{
+		EvaluateInteractionLists(bodies, interactionListCache, G);
+	}
+	else
+	{
+		ComputeAllForces(rootQuadtree, bodies, G, theta);
+	}
+}
+
+
+void BarnesHutSimulation::endProfilerFrame()
+{
+	UserInterface &userInterface = simulationConfigure.userInterface;
+	bool recordCsv = userInterface.recordFrameProfile && userInterface.recordFrameProfile->isOn;
+	if(recordCsv && phaseProfiler.csvPath.empty())
+	{
+		std::string path = ofToDataPath("frame_profile.csv", true);
+		if(StartProfilerCsv(phaseProfiler, path))
+		{
+			cout << "\n\nRecording per-frame phase timings to " << path << "\n" << endl;
+		}
+		else
+		{
+			cout << "\n\nCould not open " << path << " for the frame profile\n" << endl;
+			userInterface.recordFrameProfile->isOn = false;
+		}
+	}
+	else if(!recordCsv && !phaseProfiler.csvPath.empty())
+	{
+		cout << "\n\nFrame profile written to " << phaseProfiler.csvPath << "\n" << endl;
+		StopProfilerCsv(phaseProfiler);
+	}
+	EndProfilerFrame(phaseProfiler);
+	
+	bool written = false;
+	if(EndTraceFrame(eventTracer, written))
+	{
+		cout << "\n\n" << (written ? "Trace written to " : "Could not write the trace to ") << eventTracer.path << "\n" << endl;
+	}
+}
+
+
+void BarnesHutSimulation::placeMemory()
+{
+	// The force walks split the bodies with ParallelFor, so every array of the store is first-touched in the same chunks
+	memoryPlacement.hugePages = hugePages;
+	workerThreadPinning = pinWorkerThreads;
+	SetBodyPlacement(bodies, true);
+}
+
+
+void BarnesHutSimulation::reportMemoryPlacement()
+{
+	MemoryPlacementReport report = BeginPlacementReport(memoryPlacement);
+	AddRegionPlacement(report, "Positions (x)", bodies.x.data(), bodies.x.capacity() * sizeof(float));
+	AddRegionPlacement(report, "Positions (y)", bodies.y.data(), bodies.y.capacity() * sizeof(float));
+	AddRegionPlacement(report, "Velocities (x)", bodies.vx.data(), bodies.vx.capacity() * sizeof(float));
+	AddRegionPlacement(report, "Velocities (y)", bodies.vy.data(), bodies.vy.capacity() * sizeof(float));
+	AddRegionPlacement(report, "Accelerations (x)", bodies.ax.data(), bodies.ax.capacity() * sizeof(float));
+	AddRegionPlacement(report, "Accelerations (y)", bodies.ay.data(), bodies.ay.capacity() * sizeof(float));
+	AddRegionPlacement(report, "Masses", bodies.mass.data(), bodies.mass.capacity() * sizeof(float));
+
+
+	// The tree's nodes are allocated one by one by the thread building it, sample them rather than a range
+	std::vector<const void*> nodes;
+	std::vector<Quadtree*> stack;
+	size_t nodeCount = 0;
+	if(rootQuadtree != nullptr)
+	{
+		stack.push_back(rootQuadtree);
+	}
+	while(!stack.empty())
+	{
+		Quadtree* node = stack.back();
+		stack.pop_back();
+		if(nodeCount++ % 16 == 0)
+		{
+			nodes.push_back(node);
+		}
+		for(int i = 0; i < 4; i++)
+		{
+			if(node->children[i] != nullptr)
+			{
+				stack.push_back(node->children[i]);
+			}
+		}
+	}
+	AddAddressPlacement(report, "Quadtree nodes (every 16th)", nodes, nodeCount * sizeof(Quadtree));
+	PrintMemoryPlacement(report);
 }
 
 
 void BarnesHutSimulation::exit()
 {
+	StopPhysicsThread(physicsThread);
+	FinishBodyInjection(bodyInjection);
 	simulationConfigure.exit();
-	ResetObjectPool(simulationConfigure.bodyPool, bodies);
-	bodies.clear();
+	ResizeBodyStore(bodies, 0);
 	ResetTree(rootQuadtree);
 }
 
@@ -216,6 +795,52 @@ void BarnesHutSimulation::exit()
 void BarnesHutSimulation::keyPressed(int key)
 {
 	simulationConfigure.keyPressed(key);
+	
+	if (key == 'b') // run by whichever thread steps the bodies, at its next step boundary
+	{
+		physicsThread.commands.push({PhysicsCommandType::BenchmarkForceSolvers});
+	}
+	else if (key == 'i')
+	{
+		physicsThread.commands.push({PhysicsCommandType::BenchmarkIntegrators});
+	}
+	else if (key == 'p')
+	{
+		physicsThread.commands.push({PhysicsCommandType::BenchmarkPrecision});
+	}
+	else if (key == 'w')
+	{
+		physicsThread.commands.push({PhysicsCommandType::BenchmarkTraversalScratch});
+	}
+	else if (key == 'n') // NUMA placement of the bodies' arrays and the tree
+	{
+		physicsThread.commands.push({PhysicsCommandType::ReportMemoryPlacement});
+	}
+	else if (key == 't') // Chrome trace of the next frames, open it in chrome://tracing or Perfetto
+	{
+		std::string path = ofToDataPath("nbody_trace.json", true);
+		if(StartTrace(eventTracer, traceFrames, path))
+		{
+			cout << "\n\nTracing the next " << traceFrames << " frames\n" << endl;
+		}
+	}
+	else if (key == 'g') // inject a Plummer galaxy with the galaxy creation parameters at the centre of the view
+	{
+		CoordinateSystem2D &view = simulationConfigure.coordinateSystem2D;
+		UserInterface &userInterface = simulationConfigure.userInterface;
+		GalaxySpec spec;
+		spec.model = GalaxyModel::Plummer;
+		spec.numBodies = (size_t)userInterface.numBodies;
+		spec.bodiesMass = userInterface.bodiesMass;
+		spec.anchorMass = userInterface.anchorMass;
+		spec.galaxyRadius = userInterface.galaxyRadius;
+		spec.anchorPoint.set((ofGetWidth() * 0.5 - view.offset.x) * view.inverseZoomScale, (ofGetHeight() * 0.5 - view.offset.y) * view.inverseZoomScale);
+		spec.seed = ++injectionRequests; // not the body count, the step thread may be resizing 'bodies'
+		if(!RequestBodyInjection(bodyInjection, spec))
+		{
+			cout << "\n\nThe previous galaxy is still being injected\n" << endl;
+		}
+	}
 }
 
 
@@ -228,7 +853,7 @@ void BarnesHutSimulation::keyReleased(int key)
 
 void BarnesHutSimulation::mouseDragged(int x, int y, int button)
 {
-	simulationConfigure.mouseDragged(x, y, button, rootQuadtree, bodies, theta, G);
+	simulationConfigure.mouseDragged(x, y, button, rootQuadtree, bodies, interfaceParameters.theta, interfaceParameters.G);
 	
 	
 }
@@ -237,7 +862,7 @@ void BarnesHutSimulation::mouseDragged(int x, int y, int button)
 
 void BarnesHutSimulation::mousePressed(int x, int y, int button)
 {
-	simulationConfigure.mousePressed(x, y, button, bodies, theta, G, lastG, e, dt, systemEnergy, systemKineticEnergy, systemPotentialEnergy);
+	simulationConfigure.mousePressed(x, y, button, bodies, interfaceParameters.theta, interfaceParameters.G, lastG, interfaceParameters.e, interfaceParameters.dt, systemEnergy, systemKineticEnergy, systemPotentialEnergy);
 	
 }
 
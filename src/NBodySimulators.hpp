@@ -21,7 +21,6 @@
 
 
 #include "SequenceContainers.hpp"
-#include "ObjectPool.hpp"
 #include "DrawingUtilities.hpp"
 
 
@@ -29,6 +28,26 @@
 #include "QuadrantUtils.hpp"
 #include "Quadtree.hpp"
 #include "PhysicsLogic.hpp"
+#include "InteractionLists.hpp"
+#include "MultiRateForces.hpp"
+#include "ParticleMesh.hpp"
+#include "PeriodicBoundaries.hpp"
+#include "Collisions.hpp"
+#include "Mergers.hpp"
+#include "BlockTimesteps.hpp"
+#include "RungeKutta.hpp"
+#include "FusedLeapfrog.hpp"
+#include "SymplecticIntegrators.hpp"
+#include "AdaptiveTimestep.hpp"
+#include "BodyStore.hpp"
+#include "BodyHandles.hpp"
+#include "BodyDataTable.hpp"
+#include "BodyInjection.hpp"
+#include "PhysicsThread.hpp"
+#include "ForceSolverBenchmark.hpp"
+#include "IntegratorBenchmark.hpp"
+#include "PrecisionBenchmark.hpp"
+#include "ScratchBenchmark.hpp"
 #include "SimulationConfig.hpp"
 
 #include "VisualizationUtils.hpp"
@@ -73,6 +92,8 @@ public:
 	double lastG;  // Previous value of the gravitation constant for toggling gravity
 	float e = 0.25;  // Coefficient of restitution for collisions
 	float dt = 0.01;  // Size of simulation steps (time delta)
+	PhysicsParameters interfaceParameters;  // theta, G, e and dt as the user interface edits them, forwarded to the ones above as commands
+	PhysicsParameters forwardedParameters;  // The values last forwarded, to detect edits
 	
 	
 	float systemKineticEnergy = 0;  // Kinetic energy of the entire system
@@ -80,9 +101,34 @@ public:
 	float systemEnergy = 0;  // Total energy of the entire system
 	
 	
-	std::vector<Body*> bodies; // Vector of pointers to Body objects managed by object pool in SimulationConfig class
-	Quadtree* rootQuadtree; // Root node of the Quadtree
-	ofVec2f* bodiesAccelerations; // Array of accelerations for each Body object
+	BodyStore bodies; // Positions, velocities, accelerations and masses of the bodies, one array per component
+	Quadtree* rootQuadtree = nullptr; // Root node of the Quadtree
+	BodyHandleTable bodyHandles; // Stable handles of the bodies, kept in step with their dense indices by every removal
+	BodyInjection bodyInjection; // Galaxy generated in the background by 'g', spliced in at the next step boundary
+	uint64_t injectionRequests = 0; // Galaxies requested with 'g', seeds the next one; read and written by the UI thread only
+	BodyDataTable bodyData; // Energies and rotation of the bodies, kept only while a visualization that shows them is on
+	InteractionListCache interactionListCache; // Per-body interaction lists reused across steps while 'Cache Interaction Lists' is on
+	MultiRateFarField multiRate; // Cached far-field accelerations while 'Multi-Rate Far Field' is on
+	ParticleMeshSolver particleMesh; // Grid, kernel cache and configuration of the particle-mesh and TreePM solvers
+	PeriodicDomain periodicDomain; // Periodic box and Ewald correction table used while 'Periodic Boundaries' is on
+	CollisionSystem collisions; // Contacts and batches of the collision response while 'Toggle Collisions' is on
+	BodyMergers mergers; // Merger candidates and totals while 'Merge Bodies' is on
+	BlockTimesteps blockTimesteps; // Per-body power-of-two step levels while 'Block Timesteps' is on
+	RungeKuttaStages rungeKuttaStages; // Trial positions and stage sums of the RK4 integrator
+	SymplecticIntegrator symplecticIntegrator; // Composition, deferred kick and energy diagnostics of the 4th order symplectic integrators
+	AdaptiveTimestep adaptiveTimestep; // Criterion, bounds and energy controller of the adaptive global step while 'Adaptive Timestep' is on
+	FusedLeapfrog fusedLeapfrogState; // Staged positions of the fused kick-drift leapfrog while 'Fused Kick-Drift Leapfrog' is on
+	bool retainQuadtree = false; // Whether the current tree must outlive this frame (cached lists point into it)
+	float quadtreeSlack = 0; // How far bodies may have moved since the current tree was built
+	bool potentialsComputed = false; // Whether this frame's walk also filled adaptiveTimestep.potentials
+	bool quadtreeStale = false; // Whether bodies were removed since the current tree was built, so it must be rebuilt rather than refit
+	PhysicsModes modes; // Solvers and integrators the steps use, forwarded from the user interface toggles as a command
+	PhysicsModes forwardedModes; // The toggles last forwarded, to detect changes
+	PhysicsStats stats; // Diagnostics of the last step, shown by the user interface
+	PhysicsThread physicsThread; // Worker stepping the simulation while 'Physics Thread' is on, with its command queue and snapshots
+	bool pinWorkerThreads = false; // Pin the worker threads to CPUs node by node, so first-touched memory stays local to them
+	HugePages hugePages = HugePages::Transparent; // Pages backing the bodies' arrays, Explicit needs reserved huge pages
+	int traceFrames = 120; // Frames 't' records a Chrome trace of
 	
 	int simulationMode; // The current simulation mode
 	int initialConditionsMode; // The initial conditions of bodies for a simulation
@@ -94,6 +140,19 @@ public:
 	void setup(); // Initializes simulation parameters and prepares for simulation run.
 	void update(); //Updates the simulation by calculating forces, updating Body states, and reorganizing the quadtree.
 	void draw(); // Draws the Body objects and any other visualization elements to the screen.
+	void computeForces(); // Fills the accelerations of the bodies using whichever force evaluation strategy the user interface selects.
+	void computeTrialForces(); // Refills the accelerations of the bodies at the RK4 trial positions, refitting the tree computeForces() built.
+	void step(); // Advances the bodies by one step of the selected solver and integrator, leaving the tree and accelerations for the visualizations.
+	void finishStep(); // Clears what step() left for the visualizations.
+	void runPhysicsBatch(); // Takes 'substepsPerFrame' steps and publishes a snapshot, the physics thread's loop body.
+	void applyCommands(); // Drains the command queue into the parameters, modes and benchmark requests, on whichever thread steps.
+	void spliceInjectedBodies(); // Appends a finished injected galaxy and invalidates everything indexed like the bodies.
+	void endProfilerFrame(); // Closes the frame's phase timings and trace frame, and starts or stops the CSV as 'Record Frame Profile' says.
+	void placeMemory(); // Sets the NUMA placement policy, before the body pool and the accelerations are first allocated.
+	void reportMemoryPlacement(); // Prints which NUMA nodes hold the bodies, their accelerations and the tree nodes.
+	void forwardInterfaceEdits(); // Queues a command for every parameter or toggle the user interface changed since the last frame.
+	PhysicsModes readInterfaceModes(); // The modes the user interface toggles currently select.
+	void showStats(const PhysicsStats &shownStats); // Copies diagnostics into the user interface.
 	
 	
 	// --------------- Event Handlers ---------------
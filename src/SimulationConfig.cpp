@@ -17,16 +17,16 @@ SimulationConfig:: ~SimulationConfig()
 
 
 
-void SimulationConfig::config(std::string simulatorTitle, std::string simulationMode, Quadtree* &rootQuadtree,  std::vector<Body *> &bodies, const ofVec2f* bodiesAccelerations, RectangularGridDragSelection vectorGrid, float &theta, double &G, float &e, float &dt)
+void SimulationConfig::config(std::string simulatorTitle, std::string simulationMode, Quadtree* &rootQuadtree, BodyStore &bodies, const BodyDataTable &bodyData, RectangularGridDragSelection vectorGrid, float &theta, double &G, float &e, float &dt)
 {
-	userInterface.config(simulatorTitle, simulationMode, rootQuadtree, bodies, bodiesAccelerations, vectorGrid, theta, G, e, dt);
+	userInterface.config(simulatorTitle, simulationMode, rootQuadtree, bodies, bodyData, vectorGrid, theta, G, e, dt);
 	
 	/*----------------------   2D plane coordinate system navigation  ----------------------*/
 	coordinateSystem2D = {ofRectangle(-10000, -10000, 20000, 20000)};
 	
 	
 	/*------------------------------------------------------------------   BARNES HUT, QUADTREE  ------------------------------------------------------------------*/
-	bodyPool = ObjectPool<Body>(500000);
+	// the bodies live in the simulator's store, seeded by 'BeginSimulation'
 }
 
 
@@ -40,7 +40,7 @@ void SimulationConfig::setup(float &theta, double &G, float &e, float &dt)
 	
 	
 	/*------------------------------------------------------------------   BARNES HUT, QUADTREE  ------------------------------------------------------------------*/
-	bodyPool = ObjectPool<Body>(500000);
+	// the bodies live in the simulator's store, seeded by 'BeginSimulation'
 }
 
 
@@ -54,10 +54,11 @@ void SimulationConfig::update(Quadtree* &rootQuadtree, float &theta, double &G,
 
 
 
-void SimulationConfig::draw(Quadtree* &rootQuadtree, std::vector<Body *> &bodies, ofVec2f* &bodiesAccelerations, double &G, float &dt,float &systemEnergy, float &systemKineticEnergy, float &systemPotentialEnergy)
+void SimulationConfig::draw(Quadtree* &rootQuadtree, const BodyStore &bodies, double &G, float &dt,float &systemEnergy, float &systemKineticEnergy, float &systemPotentialEnergy)
 {
+	PROFILE_PHASE(InterfaceDraw); // the visualizations' own tree builds and force walks are charged to their phases
 	/*-----------   Draw things in the isolated coordinate system transform   -----------*/
-	userInterface.drawICST(coordinateSystem2D, rootQuadtree, bodies, bodiesAccelerations, startMouse, dt);
+	userInterface.drawICST(coordinateSystem2D, rootQuadtree, bodies, startMouse, dt);
 	
 	/*-----------   Draw things out of the isolated coordinate system transform   -----------*/
 	int numBodies = bodies.size();
@@ -65,6 +66,16 @@ void SimulationConfig::draw(Quadtree* &rootQuadtree, std::vector<Body *> &bodies
 }
 
 
+void SimulationConfig::draw(const BodyStore &snapshotBodies, double &G, float &dt, float &systemEnergy, float &systemKineticEnergy, float &systemPotentialEnergy)
+{
+	PROFILE_PHASE(InterfaceDraw);
+	userInterface.drawICST(coordinateSystem2D, snapshotBodies);
+	
+	int numBodies = snapshotBodies.size();
+	userInterface.draw(G, dt, numBodies, systemEnergy, systemKineticEnergy, systemPotentialEnergy);
+}
+
+
 void SimulationConfig::exit()
 {
 	userInterface.exit();
@@ -86,7 +97,7 @@ void SimulationConfig::keyReleased(int key)
 }
 
 
-void SimulationConfig::mouseDragged(int x, int y, int button, Quadtree* &rootQuadtree, std::vector<Body *> &bodies, float &theta, double &G)
+void SimulationConfig::mouseDragged(int x, int y, int button, Quadtree* &rootQuadtree, BodyStore &bodies, float &theta, double &G)
 {
 	userInterface.mouseDragged(x, y, button);
 	
@@ -159,7 +170,7 @@ void SimulationConfig::mouseDragged(int x, int y, int button, Quadtree* &rootQua
 
 
 
-void SimulationConfig::mousePressed(int x, int y, int button, std::vector<Body *> &bodies, float &theta, double &G, double &lastG, float &e, float &dt, float &systemEnergy, float &systemKineticEnergy, float &systemPotentialEnergy)
+void SimulationConfig::mousePressed(int x, int y, int button, BodyStore &bodies, float &theta, double &G, double &lastG, float &e, float &dt, float &systemEnergy, float &systemKineticEnergy, float &systemPotentialEnergy)
 {
 	userInterface.mousePressed(x, y, button, theta, G, lastG, e, dt);
 	
@@ -185,14 +196,10 @@ void SimulationConfig::mousePressed(int x, int y, int button, std::vector<Body *
 	 userInterface.diskGalaxyCreate->isPressed = false;
 	 userInterface.collidingDiskGalaxyCreate->isPressed = false;
 	 userInterface.createGalaxy->isOn = false;
-	 std::vector<Body *> galaxyBodies = ColdStartInitialConditions(userInterface.numBodies, userInterface.bodiesMass, bodyPool, userInterface.anchorMass, userInterface.galaxyRadius, ofVec2f((x - coordinateSystem2D.offset.x) * coordinateSystem2D.inverseZoomScale, (y - coordinateSystem2D.offset.y) * coordinateSystem2D.inverseZoomScale));
+	 BodyStore galaxyBodies = ColdStartInitialConditions(userInterface.numBodies, userInterface.bodiesMass, userInterface.anchorMass, userInterface.galaxyRadius, ofVec2f((x - coordinateSystem2D.offset.x) * coordinateSystem2D.inverseZoomScale, (y - coordinateSystem2D.offset.y) * coordinateSystem2D.inverseZoomScale));
 	 userInterface.coldStartCreate->isPressed = false;
 	 
-	 for (auto& galaxyBody : galaxyBodies)
-	 {
-	 bodies.emplace_back(galaxyBody);
-	 }
-	 galaxyBodies.clear();
+	 AppendBodies(bodies, galaxyBodies);
 	 }
 	 }
 	 
@@ -210,13 +217,9 @@ void SimulationConfig::mousePressed(int x, int y, int button, std::vector<Body *
 	 userInterface.diskGalaxyCreate->isPressed = false;
 	 userInterface.collidingDiskGalaxyCreate->isPressed = false;
 	 userInterface.createGalaxy->isOn = false;
-	 std::vector<Body *> galaxyBodies = KeplerOrbitInitialConditions(userInterface.numBodies, userInterface.anchorMass, userInterface.bodiesMass, bodyPool, userInterface.galaxyRadius, ofVec2f((x - coordinateSystem2D.offset.x) * coordinateSystem2D.inverseZoomScale, (y - coordinateSystem2D.offset.y)* coordinateSystem2D.inverseZoomScale));
+	 BodyStore galaxyBodies = KeplerOrbitInitialConditions(userInterface.numBodies, userInterface.anchorMass, userInterface.bodiesMass, userInterface.galaxyRadius, ofVec2f((x - coordinateSystem2D.offset.x) * coordinateSystem2D.inverseZoomScale, (y - coordinateSystem2D.offset.y)* coordinateSystem2D.inverseZoomScale));
 	 userInterface.keplerOrbitCreate->isPressed = false;
-	 for (auto& galaxyBody : galaxyBodies)
-	 {
-	 bodies.emplace_back(galaxyBody);
-	 }
-	 galaxyBodies.clear();
+	 AppendBodies(bodies, galaxyBodies);
 	 
 	 }
 	 
@@ -232,13 +235,9 @@ void SimulationConfig::mousePressed(int x, int y, int button, std::vector<Body *
 	 userInterface.keplerOrbitCreate->isPressed = false;
 	 userInterface.diskGalaxyCreate->isPressed = false;
 	 userInterface.collidingDiskGalaxyCreate->isPressed = false;
-	 std::vector<Body *> galaxyBodies = PlummerModelInitialConditions(userInterface.numBodies, userInterface.bodiesMass, bodyPool, userInterface.anchorMass, 1, userInterface.galaxyRadius, ofVec2f((x - coordinateSystem2D.offset.x) * coordinateSystem2D.inverseZoomScale, (y - coordinateSystem2D.offset.y) * coordinateSystem2D.inverseZoomScale));
+	 BodyStore galaxyBodies = PlummerModelInitialConditions(userInterface.numBodies, userInterface.bodiesMass, userInterface.anchorMass, 1, userInterface.galaxyRadius, ofVec2f((x - coordinateSystem2D.offset.x) * coordinateSystem2D.inverseZoomScale, (y - coordinateSystem2D.offset.y) * coordinateSystem2D.inverseZoomScale));
 	 userInterface.plummerModelCreate->isPressed = false;
-	 for (auto& galaxyBody : galaxyBodies)
-	 {
-	 bodies.emplace_back(galaxyBody);
-	 }
-	 galaxyBodies.clear();
+	 AppendBodies(bodies, galaxyBodies);
 	 }
 	 }
 	 if (userInterface.diskGalaxyCreate->isPressed)
@@ -254,14 +253,10 @@ void SimulationConfig::mousePressed(int x, int y, int button, std::vector<Body *
 	 userInterface.collidingDiskGalaxyCreate->isPressed = false;
 	 userInterface.createGalaxy->isOn = false;
 	 
-	 std::vector<Body *> galaxyBodies = DiskModelInitialConditions(userInterface.numBodies, userInterface.bodiesMass, bodyPool, userInterface.anchorMass, userInterface.galaxyRadius, ofVec2f((x - coordinateSystem2D.offset.x) * coordinateSystem2D.inverseZoomScale, (y - coordinateSystem2D.offset.y) * coordinateSystem2D.inverseZoomScale));
+	 BodyStore galaxyBodies = DiskModelInitialConditions(userInterface.numBodies, userInterface.bodiesMass, userInterface.anchorMass, userInterface.galaxyRadius, ofVec2f((x - coordinateSystem2D.offset.x) * coordinateSystem2D.inverseZoomScale, (y - coordinateSystem2D.offset.y) * coordinateSystem2D.inverseZoomScale));
 	 
 	 userInterface.diskGalaxyCreate->isPressed = false;
-	 for (auto& galaxyBody : galaxyBodies)
-	 {
-	 bodies.emplace_back(galaxyBody);
-	 }
-	 galaxyBodies.clear();
+	 AppendBodies(bodies, galaxyBodies);
 	 }
 	 
 	 }
@@ -279,14 +274,10 @@ void SimulationConfig::mousePressed(int x, int y, int button, std::vector<Body *
 	 
 	 ofVec2f galaxyAnchorPoint((x - coordinateSystem2D.offset.x) * coordinateSystem2D.inverseZoomScale, (y - coordinateSystem2D.offset.y) * coordinateSystem2D.inverseZoomScale);
 	 
-	 std::vector<Body *> galaxyBodies = CollidingDiskModelInitialConditions(userInterface.numBodies, userInterface.bodiesMass, bodyPool, userInterface.anchorMass, userInterface.anchorMass*0.80, userInterface.galaxyRadius, userInterface.galaxyRadius*0.80, galaxyAnchorPoint*1.20, galaxyAnchorPoint*0.20);
+	 BodyStore galaxyBodies = CollidingDiskModelInitialConditions(userInterface.numBodies, userInterface.bodiesMass, userInterface.anchorMass, userInterface.anchorMass*0.80, userInterface.galaxyRadius, userInterface.galaxyRadius*0.80, galaxyAnchorPoint*1.20, galaxyAnchorPoint*0.20);
 	 
 	 userInterface.collidingDiskGalaxyCreate->isPressed = false;
-	 for (auto& galaxyBody : galaxyBodies)
-	 {
-	 bodies.emplace_back(galaxyBody);
-	 }
-	 galaxyBodies.clear();
+	 AppendBodies(bodies, galaxyBodies);
 	 }
 	 }
 	 
@@ -302,8 +293,7 @@ void SimulationConfig::mousePressed(int x, int y, int button, std::vector<Body *
 	 systemKineticEnergy = 0;
 	 systemPotentialEnergy = 0;
 	 systemEnergy = 0;
-	 ResetObjectPool(bodyPool, bodies);
-	 bodies = PlummerModelInitialConditions(5555, 5, bodyPool, 138875, 1, 1500, ofVec2f(ofGetWidth() * 0.5, ofGetHeight() * 0.5));
+	 bodies = PlummerModelInitialConditions(5555, 5, 138875, 1, 1500, ofVec2f(ofGetWidth() * 0.5, ofGetHeight() * 0.5));
 	 userInterface.diskGalaxyReset->isPressed = false;
 	 userInterface.collidingDiskReset->isPressed = false;
 	 coordinateSystem2D.resetCoordinateSystem();
@@ -313,9 +303,8 @@ void SimulationConfig::mousePressed(int x, int y, int button, std::vector<Body *
 	 systemKineticEnergy = 0;
 	 systemPotentialEnergy = 0;
 	 systemEnergy = 0;
-	 ResetObjectPool(bodyPool, bodies);
 	 
-	 bodies = DiskModelInitialConditions(6666, 5, bodyPool, 50, 7777, ofVec2f(ofGetWidth() * 0.5, ofGetHeight() * 0.5));
+	 bodies = DiskModelInitialConditions(6666, 5, 50, 7777, ofVec2f(ofGetWidth() * 0.5, ofGetHeight() * 0.5));
 	 
 	 
 	 userInterface.plummerModelReset->isPressed = false;
@@ -327,9 +316,8 @@ void SimulationConfig::mousePressed(int x, int y, int button, std::vector<Body *
 	 systemKineticEnergy = 0;
 	 systemPotentialEnergy = 0;
 	 systemEnergy = 0;
-	 ResetObjectPool(bodyPool, bodies);
 	 
-	 bodies = CollidingDiskModelInitialConditions(10000, 10, bodyPool, 180, 140, 10000, 6000, ofVec2f(ofGetWidth() * 1.5, ofGetHeight() * 1.5), ofVec2f(ofGetWidth() * 0.25, ofGetHeight() * 0.25));
+	 bodies = CollidingDiskModelInitialConditions(10000, 10, 180, 140, 10000, 6000, ofVec2f(ofGetWidth() * 1.5, ofGetHeight() * 1.5), ofVec2f(ofGetWidth() * 0.25, ofGetHeight() * 0.25));
 	 
 	 userInterface.plummerModelReset->isPressed = false;
 	 userInterface.diskGalaxyReset->isPressed = false;
@@ -373,9 +361,7 @@ void SimulationConfig::mousePressed(int x, int y, int button, std::vector<Body *
 	 {
 	 float bodyX = startX + (col * (mass + spacing));// Calculate the position of the current body
 	 float bodyY = startY + (row * (mass + spacing));
-	 auto newBody = bodyPool.acquire();
-	 newBody->setParameters(ofVec2f(bodyX, bodyY), ofVec2f(0, 0), mass); //set body with the calculated position and mass
-	 bodies.emplace_back(newBody);
+	 AddBody(bodies, ofVec2f(bodyX, bodyY), ofVec2f(0, 0), mass); //add a body with the calculated position and mass
 	 }
 	 }
 	 userInterface.applyForces->isOn = false;
@@ -427,7 +413,7 @@ void SimulationConfig::mousePressed(int x, int y, int button, std::vector<Body *
 }
 
 
-void SimulationConfig::mouseReleased(int x, int y, int button, Quadtree* &rootQuadtree, std::vector<Body *> &bodies)
+void SimulationConfig::mouseReleased(int x, int y, int button, Quadtree* &rootQuadtree, BodyStore &bodies)
 {
 	//userInterface.mouseReleased(x, y, button);
 	
@@ -7,12 +7,14 @@
  * SimulationConfig Class: Configures and governs the overall simulation environment.
  *
  * The SimulationConfig class serves as the main hub for configuring and operating
- * the simulation. It holds an object pool for Body objects and initializes the
+ * the simulation. It seeds the bodies' store and initializes the
  * quadtree. It encapsulates all the core functionalities of the simulation and acts
  * as the interface for starting, updating, and rendering the simulation. It also
  * contains utility functions to generate initial conditions based on various
  * astrophysical models. These models range from cold starts with random positions to
- * more complex arrangements like the Plummer model.
+ * more complex arrangements like the Plummer model. They all generate through
+ * 'GenerateGalaxyBodies', in parallel, each body drawing from its own random stream keyed
+ * by (seed, index), so a seed always gives the same bodies, bit for bit.
  */
 
 
@@ -26,9 +28,10 @@
 
 
 #include "SimulationEntities.hpp"
-#include "ObjectPool.hpp"
+#include "BodyStore.hpp"
 #include "Quadtree.hpp"
 #include "PhysicsLogic.hpp"
+#include "BodyInjection.hpp"
 #include "VisualizationUtils.hpp"
 #include "UserInterface.hpp"
 #include "ofMain.h"
@@ -51,10 +54,10 @@ class SimulationConfig;
  * Begin the simulation based on the specified simulation mode.
  *
  * @param simulationConfigure A reference to the simulation configuration object.
- * @param bodies A reference to the vector containing body pointers.
+ * @param bodies The simulation's bodies, replaced by the initial conditions.
  * @param initialConditionsMode An integer specifying the simulation mode.
  */
-static inline void BeginSimulation(SimulationConfig &simulationConfigure, std::vector<Body*> &bodies, int initialConditionsMode);
+static inline void BeginSimulation(SimulationConfig &simulationConfigure, BodyStore &bodies, int initialConditionsMode);
 
 
 
@@ -75,13 +78,13 @@ static inline void BeginSimulation(SimulationConfig &simulationConfigure, std::v
  *
  * @param numBodies Number of bodies in the simulation.
  * @param bodiesMass Mass of each individual body.
- * @param bodyPool Object pool for acquiring body objects.
  * @param anchorMass Mass at the center of the galaxy.
  * @param galaxySize Size of the circular area where bodies are positioned.
  * @param galaxyAnchorPoint Central point of the galaxy.
- * @return A vector of pointers to the bodies.
+ * @param seed Seed of the bodies' random streams, the same seed gives the same bodies.
+ * @return The bodies.
  */
-static inline std::vector<Body *> ColdStartInitialConditions(int numBodies, float bodiesMass, ObjectPool<Body> &bodyPool, float anchorMass, float galaxySize, ofVec2f galaxyAnchorPoint);
+static inline BodyStore ColdStartInitialConditions(int numBodies, float bodiesMass, float anchorMass, float galaxySize, ofVec2f galaxyAnchorPoint, uint64_t seed = 1);
 
 
 
@@ -97,12 +100,12 @@ static inline std::vector<Body *> ColdStartInitialConditions(int numBodies, floa
  * @param numBodies Number of bodies in the simulation.
  * @param anchorMass Mass at the center of the galaxy.
  * @param bodiesMass Mass of each individual body.
- * @param bodyPool Object pool for acquiring body objects.
  * @param orbitalRadius Radius of the orbit.
  * @param galaxyAnchorPoint Central point of the galaxy.
- * @return A vector of pointers to the bodies.
+ * @param seed Seed of the bodies' random streams, the same seed gives the same bodies.
+ * @return The bodies.
  */
-static inline std::vector<Body*> KeplerOrbitInitialConditions(int numBodies, float anchorMass, float bodiesMass, ObjectPool<Body> &bodyPool, float orbitalRadius, ofVec2f galaxyAnchorPoint);
+static inline BodyStore KeplerOrbitInitialConditions(int numBodies, float anchorMass, float bodiesMass, float orbitalRadius, ofVec2f galaxyAnchorPoint, uint64_t seed = 1);
 
 
 
@@ -117,13 +120,13 @@ static inline std::vector<Body*> KeplerOrbitInitialConditions(int numBodies, flo
  *
  * @param numBodies Number of bodies in the simulation.
  * @param bodiesMass Mass of each individual body.
- * @param bodyPool Object pool for acquiring body objects.
  * @param anchorMass Mass at the center of the galaxy.
  * @param galaxyRadius Radius of the galaxy disk.
  * @param galaxyAnchorPoint Central point of the galaxy.
- * @return A vector of pointers to the bodies.
+ * @param seed Seed of the bodies' random streams, the same seed gives the same bodies.
+ * @return The bodies.
  */
-static inline std::vector<Body*> DiskModelInitialConditions(int numBodies, float bodiesMass, ObjectPool<Body> &bodyPool,float anchorMass, float galaxyRadius, ofVec2f galaxyAnchorPoint);
+static inline BodyStore DiskModelInitialConditions(int numBodies, float bodiesMass, float anchorMass, float galaxyRadius, ofVec2f galaxyAnchorPoint, uint64_t seed = 1);
 
 
 
@@ -137,16 +140,16 @@ static inline std::vector<Body*> DiskModelInitialConditions(int numBodies, float
  *
  * @param numBodies Number of bodies in the simulation.
  * @param bodiesMass Mass of each individual body.
- * @param bodyPool Object pool for acquiring body objects.
  * @param mainAnchorMass Mass at the center of the main galaxy.
  * @param secondaryAnchorMass Mass at the center of the secondary galaxy.
  * @param mainRadius Radius of the main galaxy disk.
  * @param secondaryRadius Radius of the secondary galaxy disk.
  * @param mainAnchorPoint Central point of the main galaxy.
  * @param secondaryAnchorPoint Central point of the secondary galaxy.
- * @return A vector of pointers to the bodies.
+ * @param seed Seed of the bodies' random streams, the same seed gives the same bodies.
+ * @return The bodies.
  */
-static inline std::vector<Body*> CollidingDiskModelInitialConditions(int numBodies, float bodiesMass, ObjectPool<Body> &bodyPool, float mainAnchorMass, float secondaryAnchorMass, float mainRadius, float secondaryRadius, ofVec2f mainAnchorPoint, ofVec2f secondaryAnchorPoint);
+static inline BodyStore CollidingDiskModelInitialConditions(int numBodies, float bodiesMass, float mainAnchorMass, float secondaryAnchorMass, float mainRadius, float secondaryRadius, ofVec2f mainAnchorPoint, ofVec2f secondaryAnchorPoint, uint64_t seed = 1);
 
 
 
@@ -162,10 +165,10 @@ static inline std::vector<Body*> CollidingDiskModelInitialConditions(int numBodi
  *
  * @param numBodies Number of bodies in the simulation.
  * @param bodiesMass Mass of each individual body.
- * @param bodyPool Object pool for acquiring body objects.
  * @param scaleLength Characteristic scale length of the Plummer sphere.
  * @param galaxyAnchorPoint Central point of the Plummer sphere.
- * @return A vector of pointers to the bodies.
+ * @param seed Seed of the bodies' random streams, the same seed gives the same bodies.
+ * @return The bodies.
  *
  * @details
  * The Plummer model is a spherically symmetric stable isotropic distribution of particles.
@@ -182,7 +185,7 @@ static inline std::vector<Body*> CollidingDiskModelInitialConditions(int numBodi
  * Cumulative mass distribution: M(r) = M * r³ / (a² + r²)^(3/2)
  * Velocity distribution: Based on isotropic Gaussian distribution scaled by (G * M / a)^(1/2)
  */
-static inline std::vector<Body*> PlummerModelInitialConditions(int numBodies, float bodiesMass, ObjectPool<Body> &bodyPool, float anchorMass,  float galaxyScatter, float orbitalRadius, ofVec2f galaxyAnchorPoint);
+static inline BodyStore PlummerModelInitialConditions(int numBodies, float bodiesMass, float anchorMass,  float galaxyScatter, float orbitalRadius, ofVec2f galaxyAnchorPoint, uint64_t seed = 1);
 
 
 
@@ -203,7 +206,7 @@ public:
 	
 	// ------------- Setup and Initialization -------------
 	// Sets up the initial simulation configuration parameters.
-	void config(std::string simulatorTitle, std::string simulationMode, Quadtree* &rootQuadtree, std::vector<Body *> &bodies, const ofVec2f* bodiesAccelerations, RectangularGridDragSelection vectorGrid, float &theta, double &G, float &e, float &dt);
+	void config(std::string simulatorTitle, std::string simulationMode, Quadtree* &rootQuadtree, BodyStore &bodies, const BodyDataTable &bodyData, RectangularGridDragSelection vectorGrid, float &theta, double &G, float &e, float &dt);
 	void setup(float &theta, double &G, float &e, float &dt);
 	
 	// ------------- Update and Compute -------------
@@ -212,7 +215,8 @@ public:
 	
 	// ------------- Rendering -------------
 	// Draws the Quadtree and Body objects.
-	void draw(Quadtree* &rootQuadtree,  std::vector<Body *> &bodies, ofVec2f* &bodiesAccelerations, double &G, float &dt, float &systemEnergy, float &systemKineticEnergy, float &systemPotentialEnergy);
+	void draw(Quadtree* &rootQuadtree, const BodyStore &bodies, double &G, float &dt, float &systemEnergy, float &systemKineticEnergy, float &systemPotentialEnergy);
+	void draw(const BodyStore &snapshotBodies, double &G, float &dt, float &systemEnergy, float &systemKineticEnergy, float &systemPotentialEnergy); // a physics thread snapshot
 	
 	
 	
@@ -220,15 +224,15 @@ public:
 	void exit();
 	void keyPressed(int key);
 	void keyReleased(int key);
-	void mouseDragged(int x, int y, int button, Quadtree* &rootQuadtree, std::vector<Body *> &bodies, float &theta, double &G);
-	void mousePressed(int x, int y, int button, std::vector<Body *> &bodies, float &theta, double &G, double &lastG, float &e, float &dt, float &systemEnergy, float &systemKineticEnergy, float &systemPotentialEnergy);
-	void mouseReleased(int x, int y, int button, Quadtree* &rootQuadtree, std::vector<Body *> &bodies);
+	void mouseDragged(int x, int y, int button, Quadtree* &rootQuadtree, BodyStore &bodies, float &theta, double &G);
+	void mousePressed(int x, int y, int button, BodyStore &bodies, float &theta, double &G, double &lastG, float &e, float &dt, float &systemEnergy, float &systemKineticEnergy, float &systemPotentialEnergy);
+	void mouseReleased(int x, int y, int button, Quadtree* &rootQuadtree, BodyStore &bodies);
 	void mouseScrolled(int x, int y, float scrollX, float scrollY);
 	void windowResized(int w, int h);
 	
 	
 	// ------------- Utility and Management -------------
-	ObjectPool<Body> bodyPool; // Object pool for Body objects
+	uint64_t initialConditionsSeed = 1; // Seed of the initial conditions, the same seed starts the same simulation
 	UserInterface userInterface; // Handles user interface components
 	
 	// ------------- Coordinate Systems and User Interaction -------------
@@ -245,42 +249,43 @@ public:
 
 
 
-static inline void BeginSimulation(SimulationConfig &simulationConfigure, std::vector<Body*> &bodies, int initialConditionsMode)
+static inline void BeginSimulation(SimulationConfig &simulationConfigure, BodyStore &bodies, int initialConditionsMode)
 {
 	assert(initialConditionsMode >= 0 && initialConditionsMode <= 5);
+	uint64_t seed = simulationConfigure.initialConditionsSeed;
+	BodyStore initialBodies;
 	
 	
 	if(initialConditionsMode == 0)
 	{
-		bodies  = ColdStartInitialConditions(10000, 2, simulationConfigure.bodyPool, 150, ofGetWidth()*1.5, ofVec2f(ofGetWidth() * 0.5, ofGetHeight() * 0.5));
+		initialBodies = ColdStartInitialConditions(10000, 2, 150, ofGetWidth()*1.5, ofVec2f(ofGetWidth() * 0.5, ofGetHeight() * 0.5), seed);
 	}
 	else if(initialConditionsMode == 1)
 	{
-		bodies = KeplerOrbitInitialConditions(12500, 6250, 2, simulationConfigure.bodyPool, ofGetWidth()*1.5, ofVec2f(ofGetWidth() * 0.5, ofGetHeight() * 0.5));
+		initialBodies = KeplerOrbitInitialConditions(12500, 6250, 2, ofGetWidth()*1.5, ofVec2f(ofGetWidth() * 0.5, ofGetHeight() * 0.5), seed);
 	}
 	else if(initialConditionsMode == 2)
 	{
-		bodies = CollidingDiskModelInitialConditions(10000, 10, simulationConfigure.bodyPool, 180, 140, 10000, 6000, ofVec2f(ofGetWidth() * 1.75, ofGetHeight() * 1.75), ofVec2f(ofGetWidth() * 0.125, ofGetHeight() * 0.125));
+		initialBodies = CollidingDiskModelInitialConditions(10000, 10, 180, 140, 10000, 6000, ofVec2f(ofGetWidth() * 1.75, ofGetHeight() * 1.75), ofVec2f(ofGetWidth() * 0.125, ofGetHeight() * 0.125), seed);
 	}
 	else if(initialConditionsMode == 3)
 	{
-		bodies = DiskModelInitialConditions(5000, 5, simulationConfigure.bodyPool, 50, 7500, ofVec2f(ofGetWidth() * 0.5, ofGetHeight() * 0.5));
+		initialBodies = DiskModelInitialConditions(5000, 5, 50, 7500, ofVec2f(ofGetWidth() * 0.5, ofGetHeight() * 0.5), seed);
 	}
 	else if(initialConditionsMode == 4)
 	{
-		bodies = PlummerModelInitialConditions(25000, 10, simulationConfigure.bodyPool, 187500, 1, 25000, ofVec2f(ofGetWidth() * 0.5, ofGetHeight() * 0.5));
+		initialBodies = PlummerModelInitialConditions(25000, 10, 187500, 1, 25000, ofVec2f(ofGetWidth() * 0.5, ofGetHeight() * 0.5), seed);
 	}
 	else if(initialConditionsMode == 5)
 	{
-		bodies = PlummerModelInitialConditions(2500, 10, simulationConfigure.bodyPool, 187500, 1, 5000, ofVec2f(ofGetWidth() * 0.5, ofGetHeight() * 0.5));
+		initialBodies = PlummerModelInitialConditions(2500, 10, 187500, 1, 5000, ofVec2f(ofGetWidth() * 0.5, ofGetHeight() * 0.5), seed);
 	}
 	else
 	{
 		throw std::runtime_error("Initial Conditions Mode index is out of bounds");
 	}
-	
-	
-	
+	ResizeBodyStore(bodies, 0);
+	AppendBodies(bodies, initialBodies); // copied rather than moved in, so the arrays keep their placement (see 'SetBodyPlacement')
 }
 
 
@@ -290,19 +295,20 @@ static inline void BeginSimulation(SimulationConfig &simulationConfigure, std::v
 
 
 
-inline  std::vector<Body *> ColdStartInitialConditions(int numBodies, float bodiesMass, ObjectPool<Body> &bodyPool, float anchorMass, float galaxySize, ofVec2f galaxyAnchorPoint)
+inline BodyStore ColdStartInitialConditions(int numBodies, float bodiesMass, float anchorMass, float galaxySize, ofVec2f galaxyAnchorPoint, uint64_t seed)
 {
-	std::vector<Body *> coldStartBodies;
-	for (int i = 0; i < numBodies; i++)
-	{
-		ofVec2f position = ofVec2f(ofRandom(galaxyAnchorPoint.x - galaxySize * 0.5, galaxyAnchorPoint.x + galaxySize * 0.5), ofRandom(galaxyAnchorPoint.y - galaxySize * 0.5, galaxyAnchorPoint.y + galaxySize * 0.5));
-		ofVec2f velocity = ofVec2f(0, 0);
-		
-		
-		auto coldBody = bodyPool.acquire();
-		coldBody->setParameters(position, velocity, bodiesMass);
-		coldStartBodies.emplace_back(coldBody);
-	}
+	GalaxySpec spec;
+	spec.model = GalaxyModel::ColdStart;
+	spec.numBodies = std::max(numBodies, 0);
+	spec.bodiesMass = bodiesMass;
+	spec.anchorMass = anchorMass;
+	spec.galaxyRadius = galaxySize;
+	spec.anchorPoint = galaxyAnchorPoint;
+	spec.seed = seed;
+	
+	
+	BodyStore coldStartBodies;
+	GenerateGalaxyBodies(spec, coldStartBodies);
 	return(coldStartBodies);
 }
 
@@ -310,174 +316,83 @@ inline  std::vector<Body *> ColdStartInitialConditions(int numBodies, float bodi
 
 
 
-inline std::vector<Body*> KeplerOrbitInitialConditions(int numBodies, float anchorMass, float bodiesMass, ObjectPool<Body> &bodyPool,float orbitalRadius, ofVec2f galaxyAnchorPoint)
+inline BodyStore KeplerOrbitInitialConditions(int numBodies, float anchorMass, float bodiesMass, float orbitalRadius, ofVec2f galaxyAnchorPoint, uint64_t seed)
 {
-	std::vector<Body *> keplerBodies;
-	for (int i = 0; i < numBodies; i++)
-	{
-		ofVec2f position = ofVec2f(orbitalRadius * cos(i * 2 * PI / (numBodies - 1)), orbitalRadius * sin(i * 2 * PI / (numBodies - 1)));    // place other bodies in orbit around the  body
-		position.x += galaxyAnchorPoint.x;
-		position.y += galaxyAnchorPoint.y;
-		ofVec2f velocity = ofVec2f(-(6.67430e-11 * anchorMass / orbitalRadius) * sin(i * 2 * PI / (numBodies - 1)), (6.67430e-11 * anchorMass / orbitalRadius) * cos(i * 2 * PI / (numBodies - 1)));     // set velocity for a circular orbit
-		
-		auto keplerBodY = bodyPool.acquire();
-		keplerBodY->setParameters(position, velocity, bodiesMass);
-		keplerBodies.emplace_back(keplerBodY);
-	}
-	//keplerBodies[0]->radius = sqrt(anchorMass)*2;  // bodies[0] is the central body
-	keplerBodies[0]->mass = anchorMass;
-	keplerBodies[0]->position = galaxyAnchorPoint;
-	keplerBodies[0]->velocity = ofVec2f(0, 0);
+	GalaxySpec spec;
+	spec.model = GalaxyModel::KeplerOrbit;
+	spec.numBodies = std::max(numBodies, 0);
+	spec.bodiesMass = bodiesMass;
+	spec.anchorMass = anchorMass;  // bodies[0] is the central body
+	spec.galaxyRadius = orbitalRadius;
+	spec.anchorPoint = galaxyAnchorPoint;
+	spec.seed = seed;
+	
+	
+	BodyStore keplerBodies;
+	GenerateGalaxyBodies(spec, keplerBodies);
 	return(keplerBodies);
 }
 
 
 
 
-inline std::vector<Body*>  DiskModelInitialConditions(int numBodies, float bodiesMass, ObjectPool<Body> &bodyPool,float anchorMass, float galaxyRadius, ofVec2f galaxyAnchorPoint)
+inline BodyStore DiskModelInitialConditions(int numBodies, float bodiesMass, float anchorMass, float galaxyRadius, ofVec2f galaxyAnchorPoint, uint64_t seed)
 {
-	std::vector<Body *> diskModelBodies;
-	std::default_random_engine generator;
+	GalaxySpec spec;
+	spec.model = GalaxyModel::Disk;
+	spec.numBodies = std::max(numBodies, 0);
+	spec.bodiesMass = bodiesMass;  // the radii and the central body follow from the bodies' mass
+	spec.anchorMass = anchorMass;
+	spec.galaxyRadius = galaxyRadius;
+	spec.anchorPoint = galaxyAnchorPoint;
+	spec.seed = seed;
 	
-	std::uniform_real_distribution<float> uniform(0.0, 2.0);
-	std::uniform_real_distribution<float> distribution(1.5*bodiesMass*10, 12*bodiesMass*10);
-	std::uniform_real_distribution<float> distribution_theta(0.0, 2 * PI);
 	
-	for (int i = 0; i < numBodies; ++i)
-	{
-		float theta = distribution_theta(generator);
-		float r = distribution(generator);
-		ofVec2f position, velocity;
-		
-		// set velocity of particle
-		auto diskModelBody = bodyPool.acquire();
-		
-		if (i == 0)
-		{
-			position = galaxyAnchorPoint;
-			velocity = ofVec2f(0, 0);
-			
-			diskModelBody->setParameters(position, velocity, bodiesMass*5);
-			diskModelBodies.emplace_back(diskModelBody);
-		}
-		else
-		{
-			position = ofVec2f(r * cos(theta) + galaxyAnchorPoint.x, r * sin(theta) + galaxyAnchorPoint.y);
-			float v = sqrt(6.67430e-11 * (bodiesMass*5) / r);
-			velocity = ofVec2f(-v * sin(theta), v * cos(theta));
-			
-			diskModelBody->setParameters(position, velocity, bodiesMass);
-			diskModelBodies.emplace_back(diskModelBody);
-			
-			
-		}
-	}
+	BodyStore diskModelBodies;
+	GenerateGalaxyBodies(spec, diskModelBodies);
 	return diskModelBodies;
 }
 
 
 
 
-inline std::vector<Body*> CollidingDiskModelInitialConditions(int numBodies, float bodiesMass, ObjectPool<Body> &bodyPool,float mainAnchorMass, float secondaryAnchorMass, float mainRadius, float secondaryRadius, ofVec2f mainAnchorPoint, ofVec2f secondaryAnchorPoint)
+inline BodyStore CollidingDiskModelInitialConditions(int numBodies, float bodiesMass, float mainAnchorMass, float secondaryAnchorMass, float mainRadius, float secondaryRadius, ofVec2f mainAnchorPoint, ofVec2f secondaryAnchorPoint, uint64_t seed)
 {
-	std::vector<Body *> collidingDiskBodies;
-	std::default_random_engine generator;
-	std::uniform_real_distribution<float> distribution1(1.5*mainAnchorMass, 12*mainAnchorMass);
-	std::uniform_real_distribution<float> distribution2(1*secondaryAnchorMass, 8*secondaryAnchorMass);
-	std::uniform_real_distribution<float> distribution_theta(0.0, 2 * PI);
+	GalaxySpec spec;
+	spec.model = GalaxyModel::CollidingDisk;
+	spec.numBodies = std::max(numBodies, 0);
+	spec.bodiesMass = bodiesMass;
+	spec.anchorMass = mainAnchorMass;  // the radii of each disk follow from the mass of its anchor
+	spec.galaxyRadius = mainRadius;
+	spec.anchorPoint = mainAnchorPoint;
+	spec.secondaryAnchorMass = secondaryAnchorMass;
+	spec.secondaryRadius = secondaryRadius;
+	spec.secondaryAnchorPoint = secondaryAnchorPoint;
+	spec.seed = seed;
 	
 	
-	for (int i = 0; i < numBodies; ++i)
-	{
-		float theta = distribution_theta(generator);
-		float r1 = distribution1(generator);
-		float r2 = distribution2(generator);
-		ofVec2f position, velocity;
-		
-		auto collidingDiskModelBody = bodyPool.acquire();
-		
-		
-		if (i == 0)
-		{
-			position = mainAnchorPoint;
-			velocity = ofVec2f(0, 0);
-			
-			collidingDiskModelBody->setParameters(position, velocity, mainAnchorMass*0.5);
-			collidingDiskBodies.emplace_back(collidingDiskModelBody);
-			
-		}
-		else if (i == 1)
-		{
-			position = secondaryAnchorPoint;
-			velocity = ofVec2f(0, 0);
-			
-			collidingDiskModelBody->setParameters(position, velocity, secondaryAnchorMass*0.5);
-			collidingDiskBodies.emplace_back(collidingDiskModelBody);
-		}
-		else if (i <= 3 * numBodies / 4)
-		{
-			position = ofVec2f(r1 * cos(theta) + mainAnchorPoint.x, r1 * sin(theta) + mainAnchorPoint.y);
-			float v1 = sqrt(6.67430e-11 * mainAnchorMass / r1);
-			velocity = ofVec2f(-v1 * sin(theta), v1 * cos(theta));
-			
-			collidingDiskModelBody->setParameters(position, velocity, bodiesMass);
-			collidingDiskBodies.emplace_back(collidingDiskModelBody);
-		}
-		else
-		{
-			position = ofVec2f(r2 * cos(theta) + secondaryAnchorPoint.x, r2 * sin(theta) + secondaryAnchorPoint.y);
-			float v2 = sqrt(6.67430e-11 * secondaryAnchorMass / r2);
-			velocity = ofVec2f(-v2 * sin(theta), v2 * cos(theta));
-			
-			collidingDiskModelBody->setParameters(position, velocity, bodiesMass);
-			collidingDiskBodies.emplace_back(collidingDiskModelBody);
-			
-		}
-	}
+	BodyStore collidingDiskBodies;
+	GenerateGalaxyBodies(spec, collidingDiskBodies);
 	return collidingDiskBodies;
 }
 
 
 
 
-inline std::vector<Body*> PlummerModelInitialConditions(int numBodies, float bodiesMass, ObjectPool<Body> &bodyPool,float anchorMass, float galaxyScatter, float orbitalRadius, ofVec2f galaxyAnchorPoint)
+inline BodyStore PlummerModelInitialConditions(int numBodies, float bodiesMass, float anchorMass, float galaxyScatter, float orbitalRadius, ofVec2f galaxyAnchorPoint, uint64_t seed)
 {
-	std::vector<Body *> plummerModelBodies;
-	//float squaredAnchorMass = anchorMass * anchorMass / orbitalRadius; //want the bodies to be distributed around the anchor mass, using the square of the anchor mass to avoid having to compue the square root of the position later, sqrt() very slow
-	//the position is dictated by the orbital radius, so by dividing the anchormass/centralbody by the orbital radius, it's being scaled to the bodies position magnitude. This ensures that the bodies will be distributed following the plummer distribution, while also maintaining a nearby perimeter around the central body of the galaxy
-	
-	
-	float mass, uniformRandom, r, theta, phi, x, y, u1, u2, z1, v, vx, vy;
-	ofVec2f position, velocity;
-	for (int i = 0; i < numBodies; ++i)
-	{
-		uniformRandom = ofRandom(galaxyScatter);          // Generate uniform random number between 0 and 1
-		r = orbitalRadius * sqrt(pow(uniformRandom, -2.0 / 3) - 1);
-		theta = 2 * PI * ofRandom(1.0);      // Generate random angles uniformly distributed
-		phi = acos(1 - 2 * ofRandom(1.0));
-		x = r * sin(phi) * cos(theta);
-		y = r * sin(phi) * sin(theta);
-		
-		
-		
-		
-		position = ofVec2f(x + galaxyAnchorPoint.x, y + galaxyAnchorPoint.y);
-		
-		
-		//Generate normal distributed random numbers using Box-Muller transformation
-		u1 = ofRandom(1.0);
-		u2 = ofRandom(1.0);
-		z1 = sqrt(-2.0 * log(u1)) * cos(2.0 * PI * u2); // Box-Muller transformation
-		v = sqrt(2) * pow((1 + r * r), -0.25);
-		vx = v * sqrt(2) * pow(1 + r * r, -0.25) * z1;
-		vy = sqrt(v * v - vx * vx) * (ofRandom(1.0) > 0.5 ? 1 : -1);
-		velocity = ofVec2f(vx, vy);
-		
-		auto plummerModelBodY = bodyPool.acquire();
-		plummerModelBodY->setParameters(position, velocity, bodiesMass);
-		plummerModelBodies.emplace_back(plummerModelBodY);
-	}
+	GalaxySpec spec;
+	spec.model = GalaxyModel::Plummer;
+	spec.numBodies = std::max(numBodies, 0);
+	spec.bodiesMass = bodiesMass;
+	spec.anchorMass = anchorMass;
+	spec.galaxyScatter = galaxyScatter;  // upper bound of the uniform variate the radii are drawn with
+	spec.galaxyRadius = orbitalRadius;
+	spec.anchorPoint = galaxyAnchorPoint;
+	spec.seed = seed;
 	
 	
+	BodyStore plummerModelBodies;
+	GenerateGalaxyBodies(spec, plummerModelBodies);
 	return(plummerModelBodies);
 }
@@ -22,7 +22,7 @@ UserInterface::~UserInterface()
 
 
 
-void UserInterface::config(std::string simulatorTitle, std::string simulationMode, Quadtree* &rootQuadtree, std::vector<Body *> &bodies, const ofVec2f* bodiesAccelerations, RectangularGridDragSelection vectorGrid, float &theta, double &G, float &e, float &dt)
+void UserInterface::config(std::string simulatorTitle, std::string simulationMode, Quadtree* &rootQuadtree, BodyStore &bodies, const BodyDataTable &bodyData, RectangularGridDragSelection vectorGrid, float &theta, double &G, float &e, float &dt)
 {
 	int simMode = stoi(simulationMode);
 	assert(simMode >= 0 && simMode <= 3);
@@ -40,17 +40,25 @@ void UserInterface::config(std::string simulatorTitle, std::string simulationMod
 		 * The Toggle is initially set to off (false).
 		 */
 		Toggle* visualizeQuadtreeBounds = new Toggle("Visualize Quadtree Bounds", 125, 175, 20, 15, false,
-													 [&rootQuadtree]() {
+													 [this, &rootQuadtree]() {
 			/// The lambda function begins here.
 			// The VisualizeQuadtreeBounds function is called with rootQuadtree as an argument.
+			if(physicsThreadRunning) return; // the live tree is the physics thread's
 			VisualizeQuadtreeBounds(rootQuadtree);
 			/// The lambda function ends here.
 		});
 		
 		
 		
-		Toggle *visualizeQuadtreeCentresOfMass = new Toggle("Visualize Quadtree Centres of Mass", 125, 175, 20, 15, false, [&rootQuadtree]() {
-			VisualizeQuadtreeCentresOfMass(rootQuadtree);
+		Toggle *visualizeQuadtreeCentresOfMass = new Toggle("Visualize Quadtree Centres of Mass", 125, 175, 20, 15, false, [this, &rootQuadtree, &bodies]() {
+			if(physicsThreadRunning) return;
+			VisualizeQuadtreeCentresOfMass(rootQuadtree, bodies);
+		});
+		
+		
+		Toggle *visualizeQuadtreeAABB = new Toggle("Visualize Quadtree AABB", 125, 175, 20, 15, false, [this, &rootQuadtree, &bodies]() {
+			if(physicsThreadRunning) return;
+			VisualizeQuadtreeAABB(rootQuadtree, bodies);
 		});
 		
 		
@@ -60,6 +68,7 @@ void UserInterface::config(std::string simulatorTitle, std::string simulationMod
 		Table *quadtreeVisualization = new Table("Quadtree Visualization", 0 + ofGetWidth() * 0.05, ofGetHeight() * 0.0625, 15, 15, false, 1);
 		quadtreeVisualization->addToggleElement(visualizeQuadtreeBounds);
 		quadtreeVisualization->addToggleElement(visualizeQuadtreeCentresOfMass);
+		quadtreeVisualization->addToggleElement(visualizeQuadtreeAABB);
 		quadtreeVisualization->addToggleElement(visualizeQuadtreeNodeProperties);
 		quadtreeVisualization->addToggleElement(visualizeQuadtreeDiagram);
 		
@@ -67,27 +76,33 @@ void UserInterface::config(std::string simulatorTitle, std::string simulationMod
 		
 		
 		
-		Toggle *visualizeBodiesAngularOrientation = new Toggle("Visualize Body Angular Orientation", 375, 175, 20, 15, false, [&bodies, bodiesAccelerations]() {
-			VisualizeBodiesAngularOrientation(bodies, bodiesAccelerations);
+		bodyAngularOrientation = new Toggle("Visualize Body Angular Orientation", 375, 175, 20, 15, false, [this, &bodies, &bodyData]() {
+			if(physicsThreadRunning) return;
+			VisualizeBodiesAngularOrientation(bodies, bodyData);
+		});
+		bodyEnergyGradient = new Toggle("Visualize Body Energy Gradient", 375, 200, 20, 15, false, [this, &bodies, &bodyData]() {
+			if(physicsThreadRunning) return;
+			VisualizeBodyData(bodies, bodyData, true);
 		});
-		Toggle *visualizeBodiesEnergyGradient = new Toggle("Visualize Body Energy Gradient", 375, 200, 20, 15, false);
 		
 		Table *bodiesVisualization = new Table("N-Bodies Visualization", 0 + ofGetWidth() * 0.05, ofGetHeight() * 0.125, 15, 15, false, 0);
-		bodiesVisualization->addToggleElement(visualizeBodiesAngularOrientation);
-		bodiesVisualization->addToggleElement(visualizeBodiesEnergyGradient);
+		bodiesVisualization->addToggleElement(bodyAngularOrientation);
+		bodiesVisualization->addToggleElement(bodyEnergyGradient);
 		
 		
 		
 		
 		
-		Toggle* visualizeGravitationalVectorField = new Toggle("Visualize Gravitational Vector Field", 125, 200, 20, 15, false, [&bodies, bodiesAccelerations, vectorGrid]() {
-			VisualizeGravitationalVectorField(bodies, bodiesAccelerations, vectorGrid);
+		Toggle* visualizeGravitationalVectorField = new Toggle("Visualize Gravitational Vector Field", 125, 200, 20, 15, false, [this, &bodies, vectorGrid]() {
+			if(physicsThreadRunning) return;
+			VisualizeGravitationalVectorField(bodies, vectorGrid); // the simulation's store, its arrays read each frame since growing them frees the old blocks
 		});
 		
 		
 		
 		
-		Toggle* visualizeRelativePotentialEnergyFields = new Toggle("Visualize Relative Potential Energy Fields", 125, 225, 20, 15, false, [&bodies, &G, vectorGrid]() {
+		Toggle* visualizeRelativePotentialEnergyFields = new Toggle("Visualize Relative Potential Energy Fields", 125, 225, 20, 15, false, [this, &bodies, &G, vectorGrid]() {
+			if(physicsThreadRunning) return;
 			PrepareRelativePotentialEnergyField(bodies, G, vectorGrid);
 		}); //Computing the gravitational potential at each point on a grid and color-coding these points to visualize "gravitational wells". Then, to make the visualization more insightful, sophisticated color mapping algorithms are used.
 		
@@ -112,14 +127,40 @@ void UserInterface::config(std::string simulatorTitle, std::string simulationMod
 		
 		
 		
+		Toggle *visualizePhaseTimings = new Toggle("Show Phase Timings", 125, 325, 20, 15, false, []() {
+			VisualizePhaseProfile(phaseProfiler, ofGetWidth() - 350, 550);
+		});
+		recordFrameProfile = new Toggle("Record Frame Profile CSV", 125, 350, 20, 15, false); // Read by BarnesHutSimulation::endProfilerFrame
+		
+		Table *performance = new Table("Performance", 0 + ofGetWidth() * 0.05, ofGetHeight() * 0.375, 15, 15, false, 0);
+		performance->addToggleElement(visualizePhaseTimings);
+		performance->addToggleElement(recordFrameProfile);
+		
+		
+		
+		
+		
 		Slider* thetaSlider = new Slider("MAC", 125, 50, 150, 10, 0, 2, theta);
 		Slider* coefOfRestitution = new Slider("e", 125, 100, 150, 10, 0, 1, e);
 		TextField* GTextField = new TextField("G", 125, 75, 200, 35, 6.67430e-11, 6.67430e4, G, 15);
 		Toggle* toggleGravity = new Toggle("Toggle Gravity", 125, 125, 20, 15, false);
-		Toggle* toggleCollisions = new Toggle("Toggle Collisions", 125, 150, 20, 15, false);
+		toggleCollisions = new Toggle("Toggle Collisions", 125, 150, 20, 15, false);
 		Toggle* switchIntegrationMethod = new Toggle("Toggle Integration \nMethods: ", 125, 175, 20, 15, false);
 		Toggle* slowMotionMode = new Toggle("Toggle Slow-Motion Mode", 225, 150, 20, 15, false);
 		Toggle* fastMotionMode = new Toggle("Toggle Fast-Motion Mode", 225, 150, 20, 15, false);
+		cacheInteractionLists = new Toggle("Cache Interaction Lists", 225, 175, 20, 15, false);
+		multiRateFarField = new Toggle("Multi-Rate Far Field", 225, 200, 20, 15, false);
+		particleMeshGravity = new Toggle("Particle-Mesh Gravity", 225, 225, 20, 15, false);
+		treePMCorrection = new Toggle("TreePM Short-Range Correction", 225, 250, 20, 15, false);
+		periodicBoundaries = new Toggle("Periodic Boundaries", 225, 275, 20, 15, false);
+		mergeBodies = new Toggle("Merge Bodies", 225, 300, 20, 15, false);
+		blockTimesteps = new Toggle("Block Timesteps", 225, 325, 20, 15, false);
+		fusedLeapfrog = new Toggle("Fused Kick-Drift Leapfrog", 225, 350, 20, 15, false);
+		yoshidaIntegrator = new Toggle("Yoshida 4th Order", 225, 375, 20, 15, false);
+		forestRuthIntegrator = new Toggle("Forest-Ruth 4th Order", 225, 400, 20, 15, false);
+		adaptiveTimestep = new Toggle("Adaptive Timestep", 225, 425, 20, 15, false);
+		adaptiveEnergyControl = new Toggle("Energy-Error Control", 225, 450, 20, 15, false);
+		physicsThread = new Toggle("Physics Thread", 225, 475, 20, 15, false);
 		
 		Table* parametersConfiguration = new Table("Configure Simulation Parameters", 0 + ofGetWidth() * 0.05, ofGetHeight() * 0.3125, 15, 15, false, 1);
 		parametersConfiguration->addSliderElement(thetaSlider);
@@ -130,6 +171,19 @@ void UserInterface::config(std::string simulatorTitle, std::string simulationMod
 		parametersConfiguration->addToggleElement(switchIntegrationMethod);
 		parametersConfiguration->addToggleElement(slowMotionMode);
 		parametersConfiguration->addToggleElement(fastMotionMode);
+		parametersConfiguration->addToggleElement(cacheInteractionLists);
+		parametersConfiguration->addToggleElement(multiRateFarField);
+		parametersConfiguration->addToggleElement(particleMeshGravity);
+		parametersConfiguration->addToggleElement(treePMCorrection);
+		parametersConfiguration->addToggleElement(periodicBoundaries);
+		parametersConfiguration->addToggleElement(mergeBodies);
+		parametersConfiguration->addToggleElement(blockTimesteps);
+		parametersConfiguration->addToggleElement(fusedLeapfrog);
+		parametersConfiguration->addToggleElement(yoshidaIntegrator);
+		parametersConfiguration->addToggleElement(forestRuthIntegrator);
+		parametersConfiguration->addToggleElement(adaptiveTimestep);
+		parametersConfiguration->addToggleElement(adaptiveEnergyControl);
+		parametersConfiguration->addToggleElement(physicsThread);
 		
 		
 		tableManager->addTable(quadtreeVisualization);
@@ -137,6 +191,7 @@ void UserInterface::config(std::string simulatorTitle, std::string simulationMod
 		tableManager->addTable(physicsVisualization);
 		tableManager->addTable(benchmarksVisualization);
 		tableManager->addTable(parametersConfiguration);
+		tableManager->addTable(performance);
 	}
 	else if(simMode == 1) // performance mode
 	{
@@ -200,7 +255,7 @@ void UserInterface::update(float &theta, double &G, float &e, float &dt)
 		tableManager->galaxyMode(); //set all other tables to closed
 		dt = 0.001; //slowmo affect while the create galaxy table is open, looks really cool
 	}
-	else if (!tableManager->galaxyCreationMode)
+	else if (!tableManager->galaxyCreationMode && !(adaptiveTimestep && adaptiveTimestep->isOn)) // the adaptive step is chosen by the simulation every frame
 	{
 		dt = 0.01;
 	}
@@ -222,6 +277,39 @@ void UserInterface::draw(double &G, float &dt, int &numBodies, float &systemEner
 	ofDrawBitmapString("FPS: " + ofToString(ofGetFrameRate(), 2), ofGetWidth() - 350, 340);
 	ofDrawBitmapString("Bodies: " + ofToString(numBodies, 1), ofGetWidth() - 350, 355);
 	ofDrawBitmapString("Total Energy: " + ofToString(systemEnergy, 8) + "\n" + "Kinetic Energy: " + ofToString(systemKineticEnergy, 8) + "\n" + "Potential Energy: " + ofToString(systemPotentialEnergy, 8) + "\nUniversal Constant G: " + ofToString(G, 16), ofGetWidth() - 350, 370);
+	if(multiRateFarField && multiRateFarField->isOn)
+	{
+		ofDrawBitmapString("Far-Field Relative Error: " + ofToString(multiRateFarFieldError, 6), ofGetWidth() - 350, 430);
+	}
+	if(toggleCollisions && toggleCollisions->isOn)
+	{
+		ofDrawBitmapString("Collision Contacts: " + ofToString(collisionContacts), ofGetWidth() - 350, 445);
+	}
+	if(mergeBodies && mergeBodies->isOn)
+	{
+		ofDrawBitmapString("Merged Bodies: " + ofToString(mergedBodies), ofGetWidth() - 350, 460);
+	}
+	if(blockTimesteps && blockTimesteps->isOn)
+	{
+		ofDrawBitmapString("Force Evaluations / Time: " + ofToString(blockForceEvaluations, 1) + "  Deepest Level: " + ofToString(blockDeepestLevel), ofGetWidth() - 350, 475);
+	}
+	if((yoshidaIntegrator && yoshidaIntegrator->isOn) || (forestRuthIntegrator && forestRuthIntegrator->isOn))
+	{
+		ofDrawBitmapString("Energy Error: " + ofToString(symplecticEnergyError, 8) + "  / Wall s: " + ofToString(symplecticEnergyError / std::max(symplecticWallSeconds, 1e-9), 8), ofGetWidth() - 350, 490);
+	}
+	if(adaptiveTimestep && adaptiveTimestep->isOn)
+	{
+		std::string energyControl = "";
+		if(adaptiveEnergyControl && adaptiveEnergyControl->isOn)
+		{
+			energyControl = adaptiveEnergyControlActive ? "  Energy Drift / Time: " + ofToString(adaptiveEnergyDrift, 8) : "  Energy Control inactive (solver has no potentials)";
+		}
+		ofDrawBitmapString("Adaptive dt: " + ofToString(dt, 6) + energyControl, ofGetWidth() - 350, 505);
+	}
+	if(physicsThread && physicsThread->isOn)
+	{
+		ofDrawBitmapString("Physics Steps / s: " + ofToString(physicsStepsPerSecond, 1), ofGetWidth() - 350, 520);
+	}
 	//}
 }
 
@@ -229,7 +317,7 @@ void UserInterface::draw(double &G, float &dt, int &numBodies, float &systemEner
 
 
 //draw inside the isolated coordinate system transform
-void UserInterface::drawICST(CoordinateSystem2D &coordinateSystem2D, Quadtree* &rootQuadtree,  std::vector<Body *> &bodies, ofVec2f* &bodiesAccelerations, ofVec2f &startMouse, float &dt)
+void UserInterface::drawICST(CoordinateSystem2D &coordinateSystem2D, Quadtree* &rootQuadtree, const BodyStore &bodies, ofVec2f &startMouse, float &dt)
 {
 	/*----------------------   Begin the isolated coordinate system transform   ----------------------*/
 	ofPushMatrix();
@@ -237,12 +325,9 @@ void UserInterface::drawICST(CoordinateSystem2D &coordinateSystem2D, Quadtree* &
 	ofScale(coordinateSystem2D.zoomScale, coordinateSystem2D.zoomScale);
 	
 	
-	for (int i = 0; i < bodies.size(); i++)
-	{
-		//ofSetColor(140, 140, 222, 127); // Set the color to bluish-gray
-		ofSetColor(140, 140, 140); // Set the color to bluish-gray
-		bodies[i]->draw(false);
-	}
+	//ofSetColor(140, 140, 222, 127); // Set the color to bluish-gray
+	ofSetColor(140, 140, 140); // Set the color to bluish-gray
+	VisualizeBodyStore(bodies);
 	
 	
 	
@@ -270,6 +355,21 @@ void UserInterface::drawICST(CoordinateSystem2D &coordinateSystem2D, Quadtree* &
 
 
 
+//draw a physics thread snapshot inside the isolated coordinate system transform
+void UserInterface::drawICST(CoordinateSystem2D &coordinateSystem2D, const BodyStore &snapshotBodies)
+{
+	ofPushMatrix();
+	ofTranslate(coordinateSystem2D.offset.x, coordinateSystem2D.offset.y);
+	ofScale(coordinateSystem2D.zoomScale, coordinateSystem2D.zoomScale);
+	
+	ofSetColor(140, 140, 140);
+	VisualizeBodyStore(snapshotBodies);
+	
+	ofPopMatrix();
+}
+
+
+
 
 
 
@@ -44,17 +44,18 @@ public:
 	~UserInterface();
 	
 	
-	void config(std::string simulatorTitle, std::string simulationMode, Quadtree* &rootQuadtree, std::vector<Body *> &bodies, const ofVec2f* bodiesAccelerations, RectangularGridDragSelection vectorGrid, float &theta, double &G, float &e, float &dt);
+	void config(std::string simulatorTitle, std::string simulationMode, Quadtree* &rootQuadtree, BodyStore &bodies, const BodyDataTable &bodyData, RectangularGridDragSelection vectorGrid, float &theta, double &G, float &e, float &dt);
 	
 	
 	
 	
 	void update(float &theta, double &G, float &e, float &dt);
 	void draw(double &G, float &dt, int &numBodies, float &systemEnergy, float &systemKineticEnergy, float &systemPotentialEnergy);
-	void drawICST(CoordinateSystem2D &coordinateSystem2D, Quadtree* &rootQuadtree,  std::vector<Body *> &bodies, ofVec2f* &bodiesAccelerations, ofVec2f &startMouse, float &dt); //draw inside the isolated coordinate system transform
+	void drawICST(CoordinateSystem2D &coordinateSystem2D, Quadtree* &rootQuadtree, const BodyStore &bodies, ofVec2f &startMouse, float &dt); //draw inside the isolated coordinate system transform
+	void drawICST(CoordinateSystem2D &coordinateSystem2D, const BodyStore &snapshotBodies); //draw a physics thread snapshot inside the isolated coordinate system transform
 	
 	
-	void visualizeSimulation(CoordinateSystem2D &coordinateSystem2D, Quadtree* &rootQuadtree,  std::vector<Body *> &bodies, ObjectPool<Body> &bodyPool, ofVec2f* &bodiesAccelerations, ofVec2f &startMouse, double &G, float &dt, int &numBodies, float &systemEnergy, float &systemKineticEnergy, float &systemPotentialEnergy);
+	void visualizeSimulation(CoordinateSystem2D &coordinateSystem2D, Quadtree* &rootQuadtree, BodyStore &bodies, ofVec2f &startMouse, double &G, float &dt, int &numBodies, float &systemEnergy, float &systemKineticEnergy, float &systemPotentialEnergy);
 	void exit();
 	
 	void keyPressed(int key);
@@ -71,6 +72,37 @@ public:
 	
 	
 	
+	Toggle *cacheInteractionLists = nullptr; // Reuse each body's interaction list for several steps instead of re-walking the tree every frame
+	Toggle *multiRateFarField = nullptr; // Refresh far-field accelerations every few steps, recompute the near field every step
+	Toggle *particleMeshGravity = nullptr; // Compute gravity on a grid with FFTs (particle-mesh) instead of walking the tree
+	Toggle *treePMCorrection = nullptr; // With particle-mesh gravity, add the short-range forces from a cut-off tree walk (TreePM)
+	Toggle *toggleCollisions = nullptr; // Detect overlapping bodies through the quadtree and resolve them with the coefficient of restitution 'e'
+	Toggle *mergeBodies = nullptr; // Merge bodies closer than a mass-dependent radius, conserving mass and momentum
+	Toggle *periodicBoundaries = nullptr; // Wrap the bodies into a periodic domain and add the forces of its periodic images (Ewald)
+	Toggle *fusedLeapfrog = nullptr; // Kick and drift each body inside the force walk (leapfrog), without an accelerations array
+	Toggle *yoshidaIntegrator = nullptr; // Step with Yoshida's 4th order symplectic composition (kick first), refitting the tree between sub-drifts
+	Toggle *forestRuthIntegrator = nullptr; // Step with the Forest-Ruth 4th order symplectic composition (drift first), refitting the tree between sub-drifts
+	Toggle *adaptiveTimestep = nullptr; // Choose dt every step from the largest acceleration, within bounds and with limited growth
+	Toggle *adaptiveEnergyControl = nullptr; // With the adaptive timestep, tighten or relax its accuracy parameter to hold the energy drift to a budget
+	Toggle *blockTimesteps = nullptr; // Give every body its own power-of-two fraction of dt, only bodies finishing a step get new forces
+	Toggle *physicsThread = nullptr; // Step the simulation on its own thread, the renderer draws snapshots of it
+	Toggle *recordFrameProfile = nullptr; // Append each frame's phase timings to frame_profile.csv in the data folder
+	Toggle *bodyAngularOrientation = nullptr; // Draw each body's orientation, the simulation keeps the bodies' rotation while it is on
+	Toggle *bodyEnergyGradient = nullptr; // Color each body by its share of kinetic energy, the simulation keeps the bodies' energies while it is on
+	bool physicsThreadRunning = false; // Set while the physics thread owns the tree, bodies and accelerations, the visualizations that read them pause
+	float multiRateFarFieldError = 0; // Last measured relative error of the multi-rate accelerations against a full recomputation
+	size_t mergedBodies = 0; // Number of bodies absorbed by mergers since the start
+	size_t collisionContacts = 0; // Number of contacts resolved on the last step
+	double blockForceEvaluations = 0; // Single-body force evaluations per unit of simulated time with block timesteps
+	int blockDeepestLevel = 0; // Deepest block level in use on the last step, the smallest step is dt / 2^level
+	double adaptiveEnergyDrift = 0; // Relative energy change per unit time measured by the adaptive timestep's controller
+	bool adaptiveEnergyControlActive = false; // Whether the active force solver feeds the energy controller its potentials
+	double symplecticEnergyError = 0; // Relative energy error of the symplectic integrator since it was switched on
+	double symplecticWallSeconds = 0; // Wall-clock time the symplectic integrator has spent stepping since it was switched on
+	double physicsStepsPerSecond = 0; // Steps the physics thread completes per wall-clock second
+	
+	
+	
 	float numBodies = 2500; //parameters used for creating galaxies
 	float bodiesMass = 5;
 	float anchorMass = 500;